@@ -0,0 +1,378 @@
+#include "AcvCurves.h"
+#include "PipelineStats.h"
+#include <iostream>
+#include <algorithm>
+#include <limits>
+#include <cassert>
+#include <cstdio>
+
+namespace
+{
+
+template <typename T>
+T clamp(const T& value, const T& min, const T& max)
+{
+	if (value > max)
+	{
+		return max;
+	}
+	else if (value < min)
+	{
+		return min;
+	}
+	else
+	{
+		return value;
+	}
+}
+
+template <typename T>
+T saturate(const T& value)
+{
+	return clamp(value, T(0), T(1));
+}
+
+bool ReadBigEndianUShort(FILE* file, unsigned short& value)
+{
+	unsigned char bytes[2];
+	if (fread(bytes, 1, sizeof(bytes), file) != sizeof(bytes))
+	{
+		std::cerr << "Unable to read data from file!" << std::endl;
+		return false;
+	}
+	value = (unsigned short)((bytes[0] << 8) | bytes[1]);
+	return true;
+}
+
+} // namespace
+
+bool IsValidCurve(const CurvePoints& curve)
+{
+	if (curve.size() < MIN_CURVE_POINTS || curve.size() > MAX_CURVE_POINTS)
+	{
+		return false;
+	}
+	for (size_t i = 1; i < curve.size(); ++i)
+	{
+		if (!(curve[i - 1].first < curve[i].first))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+CubicSpline CubicSpline::InterpolateCubicSplineFromCurvePoints(const CurvePoints& curve)
+{
+	assert(IsValidCurve(curve) && "Splines need 2 to 19 points with ascending inputs!");
+	std::vector<float> y2(curve.size()); // second derivatives
+	std::vector<float> u(curve.size());
+
+	y2[0] = 0;
+
+	for (size_t i = 1; i < curve.size() - 1; ++i)
+	{
+		float sig = (curve[i].first - curve[i - 1].first) / (curve[i + 1].first - curve[i - 1].first);
+		float p = sig * y2[i - 1] + 2.0f;
+		y2[i] = (sig - 1.0f) / p;
+		u[i] = (curve[i+1].second - curve[i].second)/(curve[i+1].first - curve[i].first) - (curve[i].second - curve[i-1].second)/(curve[i].first - curve[i-1].first);
+		u[i] = (6.0f * u[i] / (curve[i+1].first - curve[i-1].first) - sig*u[i-1]) / p;
+	}
+
+	y2[curve.size() - 1] = 0;
+
+	for (int i = (int)curve.size() - 2; i >= 0; --i)
+	{
+		y2[i] = y2[i] * y2[i + 1] + u[i];
+	}
+
+	CubicSpline spline(curve, std::move(y2));
+	return spline;
+}
+
+float CubicSpline::ComputeAtPoint(float x) const
+{
+	return ComputeInSegment(FindSegment(x), x);
+}
+
+void CubicSpline::ComputeAtPoints(const float* x, float* y, size_t count) const
+{
+	const size_t last = m_Curve.size() > 1 ? m_Curve.size() - 2 : 0;
+	size_t lo = 0;
+	for (size_t i = 0; i < count; ++i)
+	{
+		const float value = x[i];
+		if ((lo > 0 && !(m_Curve[lo].first <= value)) || value != value)
+		{
+			lo = FindSegment(value);
+		}
+		else
+		{
+			while (lo < last && m_Curve[lo + 1].first <= value)
+			{
+				++lo;
+			}
+		}
+		y[i] = ComputeInSegment(lo, value);
+	}
+}
+
+bool CubicSpline::FindChangedInputs(const CubicSpline& before, float& lo, float& hi) const
+{
+	lo = std::numeric_limits<float>::max();
+	hi = -std::numeric_limits<float>::max();
+
+	// Either spline may be skipped as an identity, and segments only line up
+	// between curves with as many points
+	const size_t count = m_Curve.size();
+	if (m_Identity != before.m_Identity || count != before.m_Curve.size() || count < 2)
+	{
+		if (m_Identity != before.m_Identity || m_Curve != before.m_Curve || m_Y2 != before.m_Y2)
+		{
+			lo = -std::numeric_limits<float>::max();
+			hi = std::numeric_limits<float>::max();
+			return true;
+		}
+		return false;
+	}
+
+	// Inputs beyond the end points fall in the end segments
+	for (size_t i = 0; i + 1 < count; ++i)
+	{
+		if (m_Curve[i] == before.m_Curve[i] && m_Curve[i + 1] == before.m_Curve[i + 1] &&
+			m_Y2[i] == before.m_Y2[i] && m_Y2[i + 1] == before.m_Y2[i + 1])
+		{
+			continue;
+		}
+
+		const float first = i == 0 ? -std::numeric_limits<float>::max() : std::min(m_Curve[i].first, before.m_Curve[i].first);
+		const float last = i + 2 == count ? std::numeric_limits<float>::max() : std::max(m_Curve[i + 1].first, before.m_Curve[i + 1].first);
+		lo = std::min(lo, first);
+		hi = std::max(hi, last);
+	}
+	return lo <= hi;
+}
+
+size_t CubicSpline::FindSegment(float x) const
+{
+	int lo = 0;
+	int hi = (int)(m_Curve.size() - 1);
+	while (hi - lo > 1)
+	{
+		int k = (hi + lo) / 2;
+		if (m_Curve[k].first > x)
+		{
+			hi = k;
+		}
+		else
+		{
+			lo = k;
+		}
+	}
+	return (size_t)lo;
+}
+
+float CubicSpline::ComputeInSegment(size_t lo, float x) const
+{
+	const size_t hi = lo + 1 < m_Curve.size() ? lo + 1 : lo; // single points are not curves
+
+	float xhi = m_Curve[hi].first;
+	float xlo = m_Curve[lo].first;
+	float yhi = m_Curve[hi].second;
+	float ylo = m_Curve[lo].second;
+	float y2hi = m_Y2[hi];
+	float y2lo = m_Y2[lo];
+
+	float h = xhi - xlo;
+	if (h == 0) throw "Not a curve!";
+
+	float a = (xhi - x) / h;
+	float b = (x - xlo) / h;
+	float y = a*ylo + b*yhi + ((a*a*a - a)*y2lo + (b*b*b - b)*y2hi)*h*h/6.0f;
+	return y;
+}
+
+CubicSpline::CubicSpline(const CurvePoints& curve, std::vector<float>&& y2)
+	: m_Curve(curve)
+	, m_Y2(std::forward<std::vector<float>>(y2))
+	, m_Identity(curve.size() >= 2)
+{
+	for (size_t i = 0; i < curve.size(); ++i)
+	{
+		if (curve[i].first != curve[i].second)
+		{
+			m_Identity = false;
+		}
+	}
+}
+
+bool ReadACVCurvePoints(const PathChar* filename, std::vector<CurvePoints>& outCurves)
+{
+	StageTimer timer(PIPELINE_STAGE_PARSE);
+	FILE* file = OpenNativeFile(filename, "rb");
+	if (!file)
+	{
+		std::cerr << "Unable to open file: " << NarrowPath(filename) << std::endl;
+		return false;
+	}
+
+	bool ok = true;
+
+	unsigned short version = 0;
+	unsigned short curvesCount = 0;
+	if (!ReadBigEndianUShort(file, version) || !ReadBigEndianUShort(file, curvesCount))
+	{
+		ok = false;
+	}
+	else if (version != 0x4)
+	{
+		std::cerr << "Unsupported ACV version - only version 4 is supported (cubic spline interpolation)." << std::endl;
+		ok = false;
+	}
+
+	for (unsigned i = 0; ok && i < curvesCount; ++i)
+	{
+		unsigned short curvePointsCount;
+		if (!ReadBigEndianUShort(file, curvePointsCount))
+		{
+			ok = false;
+			break;
+		}
+
+		CurvePoints curvePoints(curvePointsCount);
+
+		for (int j = 0; j < curvePointsCount; ++j)
+		{
+			unsigned short x, y;
+			if (!ReadBigEndianUShort(file, y) || !ReadBigEndianUShort(file, x))
+			{
+				ok = false;
+				break;
+			}
+
+			curvePoints[j]  = std::make_pair((float)x, (float)y);
+		}
+
+		// Anything else would leave the spline without segments, or with
+		// segments of no width
+		if (ok && !IsValidCurve(curvePoints))
+		{
+			std::cerr << "Curve " << i << " of " << NarrowPath(filename) << " needs 2 to 19 points with ascending inputs." << std::endl;
+			ok = false;
+		}
+
+		if (ok)
+		{
+			outCurves.push_back(curvePoints);
+		}
+	}
+
+	AddPipelineCount(PIPELINE_COUNTER_BYTES_READ, (unsigned long long)ftell(file));
+	fclose(file);
+	return ok;
+}
+
+bool ReadACVFile(const PathChar* filename, std::vector<CubicSpline>& outCubicSplines)
+{
+	std::vector<CurvePoints> curves;
+	if (!ReadACVCurvePoints(filename, curves))
+	{
+		return false;
+	}
+
+	StageTimer timer(PIPELINE_STAGE_SPLINE_SOLVE);
+	for (size_t i = 0; i < curves.size(); ++i)
+	{
+		outCubicSplines.push_back(CubicSpline::InterpolateCubicSplineFromCurvePoints(curves[i]));
+	}
+	return true;
+}
+
+bool ReadCurves(const PathChar* filename, std::vector<CubicSpline>& outCubicSplines)
+{
+	if (!ReadACVFile(filename, outCubicSplines))
+	{
+		return false;
+	}
+
+	if (outCubicSplines.size() != 5)
+	{
+		std::cerr << "ACV file contains an extraordinary amount of curves (" << outCubicSplines.size() << ")" << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+float EvaluateCurves(const std::vector<CubicSpline>& cubicSplines, int channel, float input)
+{
+	const CubicSpline& curve = cubicSplines[1 + channel];
+	const CubicSpline& composite = cubicSplines[0];
+
+	float value = clamp(curve.IsIdentity() ? input * 255.0f : curve.ComputeAtPoint(input * 255.0f), 0.0f, 255.0f);
+	if (!composite.IsIdentity())
+	{
+		value = composite.ComputeAtPoint(value);
+	}
+	return saturate(value / 255.0f);
+}
+
+void EvaluateCurves(const std::vector<CubicSpline>& cubicSplines, int channel, const float* inputs, float* outputs, size_t count)
+{
+	const CubicSpline& curve = cubicSplines[1 + channel];
+	const CubicSpline& composite = cubicSplines[0];
+	AddPipelineCount(PIPELINE_COUNTER_SPLINE_EVALUATIONS, count);
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		outputs[i] = inputs[i] * 255.0f;
+	}
+	if (!curve.IsIdentity())
+	{
+		curve.ComputeAtPoints(outputs, outputs, count);
+	}
+	for (size_t i = 0; i < count; ++i)
+	{
+		outputs[i] = clamp(outputs[i], 0.0f, 255.0f);
+	}
+	if (!composite.IsIdentity())
+	{
+		composite.ComputeAtPoints(outputs, outputs, count);
+	}
+	for (size_t i = 0; i < count; ++i)
+	{
+		outputs[i] = saturate(outputs[i] / 255.0f);
+	}
+}
+
+bool IsIdentityChannel(const std::vector<CubicSpline>& cubicSplines, int channel)
+{
+	return cubicSplines[0].IsIdentity() && cubicSplines[1 + channel].IsIdentity();
+}
+
+void BakeCurveTables(
+	const std::vector<CubicSpline>& cubicSplines,
+	size_t cubeSize,
+	std::vector<float>& red,
+	std::vector<float>& green,
+	std::vector<float>& blue)
+{
+	StageTimer timer(PIPELINE_STAGE_BAKE);
+	std::vector<float>* tables[3] = { &red, &green, &blue };
+
+	for (int c = 0; c < 3; ++c)
+	{
+		std::vector<float>& table = *tables[c];
+		const bool identity = IsIdentityChannel(cubicSplines, c);
+
+		table.resize(cubeSize);
+		for (size_t i = 0; i < cubeSize; ++i)
+		{
+			table[i] = (float)i / (float)(cubeSize - 1);
+		}
+		if (!identity)
+		{
+			EvaluateCurves(cubicSplines, c, &table[0], &table[0], cubeSize);
+		}
+	}
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "Platform.h"
+#include <vector>
+#include <utility>
+
+//
+// http://www.adobe.com/devnet-apps/photoshop/fileformatashtml/PhotoshopFileFormats.htm#50577411_pgfId-1056330
+//  Curves file format
+//
+// 	Length		Description
+//
+// 	2			Version ( = 1 or = 4)
+// 	2			Count of curves in the file.
+//
+// 	The following is the data for each curve specified by count above
+//
+// 	2			Count of points in the curve (short integer from 2...19)
+//
+// 	point		Curve points.Each curve point is a pair of short integers where the
+//  cnt * 4		first number is the output value (vertical coordinate on the Curves
+// 				dialog graph) and the second is the input value. All coordinates have
+// 				range 0 to 255. See also "Null curves" below.
+//
+
+typedef std::vector<std::pair<float, float>> CurvePoints;
+
+// Points an ACV curve may have
+const size_t MIN_CURVE_POINTS = 2;
+const size_t MAX_CURVE_POINTS = 19;
+
+// True when a spline can go through the points: 2 to 19 of them, with
+// strictly ascending inputs
+bool IsValidCurve(const CurvePoints& curve);
+
+class CubicSpline
+{
+public:
+	// Interpolation of natural splines, through points IsValidCurve accepts
+	static CubicSpline InterpolateCubicSplineFromCurvePoints(const CurvePoints& curve);
+
+	float ComputeAtPoint(float x) const;
+
+	// Same for many inputs at once, x and y may be the same array. Each input
+	// starts from the segment of the one before, so ascending inputs walk the
+	// points once instead of bisecting for every input.
+	void ComputeAtPoints(const float* x, float* y, size_t count) const;
+
+	// True when every point sits on the diagonal, like the two-point
+	// (0,0)-(255,255) curves of untouched channels. The spline is then the
+	// straight line through them and maps every input to itself.
+	bool IsIdentity() const { return m_Identity; }
+
+	// The inputs, as [lo, hi], where this spline may give other values than
+	// before does, from the segments whose points or second derivatives are
+	// not the same. False when it gives the same values everywhere.
+	bool FindChangedInputs(const CubicSpline& before, float& lo, float& hi) const;
+
+private:
+	CubicSpline(const CurvePoints& curve, std::vector<float>&& y2);
+
+	// First point of the segment x falls in, ends included
+	size_t FindSegment(float x) const;
+	float ComputeInSegment(size_t lo, float x) const;
+
+private:
+	CurvePoints m_Curve;
+	std::vector<float> m_Y2;
+	bool m_Identity;
+};
+
+// Reads the points of every curve of a version 4 ACV file
+bool ReadACVCurvePoints(const PathChar* filename, std::vector<CurvePoints>& outCurves);
+
+// Same, interpolating a spline through each curve
+bool ReadACVFile(const PathChar* filename, std::vector<CubicSpline>& outCubicSplines);
+
+// Same, also checking for the five curves (composite, red, green, blue and
+// the unused alpha) the converter expects
+bool ReadCurves(const PathChar* filename, std::vector<CubicSpline>& outCubicSplines);
+
+// One channel (0 red, 1 green, 2 blue) of the curves at input in [0, 1]: the
+// channel curve followed by the composite curve. Identity curves are skipped.
+float EvaluateCurves(const std::vector<CubicSpline>& cubicSplines, int channel, float input);
+
+// Same for many inputs, giving exactly the same results. Tables fill much
+// faster with their inputs in ascending order (see ComputeAtPoints).
+void EvaluateCurves(const std::vector<CubicSpline>& cubicSplines, int channel, const float* inputs, float* outputs, size_t count);
+
+// True when both the channel curve and the composite curve are identities
+bool IsIdentityChannel(const std::vector<CubicSpline>& cubicSplines, int channel);
+
+// Evaluates the curves at cubeSize evenly spaced inputs, identity channels
+// getting the evenly spaced inputs themselves
+void BakeCurveTables(
+	const std::vector<CubicSpline>& cubicSplines,
+	size_t cubeSize,
+	std::vector<float>& red,
+	std::vector<float>& green,
+	std::vector<float>& blue
+	);
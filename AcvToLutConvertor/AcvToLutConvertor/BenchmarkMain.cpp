@@ -0,0 +1,15 @@
+#include "PipelineBenchmark.h"
+#include "CpuFeatures.h"
+
+// Entry point of the stand-alone benchmark that make bench builds, for
+// machines without Direct3D. The converter's bench command runs the same suite.
+#ifdef _WIN32
+int wmain(int argc, wchar_t* argv[])
+#else
+int main(int argc, char* argv[])
+#endif
+{
+	// Kernels are picked against the level from here on
+	GetCpuLevel();
+	return RunPipelineBenchmarkCommand(argc - 1, argv + 1);
+}
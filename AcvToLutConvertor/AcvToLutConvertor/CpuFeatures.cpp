@@ -0,0 +1,172 @@
+#include "CpuFeatures.h"
+#include <atomic>
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#define HAS_CPUID 1
+#include <intrin.h>
+#elif defined(__i386__) || defined(__x86_64__)
+#define HAS_CPUID 1
+#include <cpuid.h>
+#endif
+
+namespace
+{
+
+const char* const LEVEL_NAMES[] = { "scalar", "sse2", "sse4.1", "avx2", "avx512" };
+
+#ifdef HAS_CPUID
+
+void QueryCpuid(unsigned leaf, unsigned registers[4])
+{
+#ifdef _MSC_VER
+	int values[4];
+	__cpuidex(values, (int)leaf, 0);
+	memcpy(registers, values, sizeof(values));
+#else
+	__cpuid_count(leaf, 0, registers[0], registers[1], registers[2], registers[3]);
+#endif
+}
+
+// Register state the OS saves on context switches (XCR0)
+unsigned long long QueryEnabledState()
+{
+#ifdef _MSC_VER
+	return _xgetbv(0);
+#else
+	unsigned lo;
+	unsigned hi;
+	__asm__ __volatile__("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+	return ((unsigned long long)hi << 32) | lo;
+#endif
+}
+
+CpuLevel DetectCpuLevel()
+{
+	unsigned basic[4];
+	QueryCpuid(0, basic);
+	const unsigned maxLeaf = basic[0];
+
+	unsigned features[4];
+	QueryCpuid(1, features);
+	const bool sse2 = (features[3] & (1u << 26)) != 0;
+	const bool sse41 = (features[2] & (1u << 19)) != 0;
+	const bool osxsave = (features[2] & (1u << 27)) != 0;
+	const bool avx = (features[2] & (1u << 28)) != 0;
+
+	if (!sse2)
+	{
+		return CPU_LEVEL_SCALAR;
+	}
+	if (!sse41)
+	{
+		return CPU_LEVEL_SSE2;
+	}
+
+	// The wide registers also need the OS to save them: XMM and YMM state
+	// for AVX2, plus the opmask and upper ZMM state for AVX-512
+	const unsigned long long state = osxsave ? QueryEnabledState() : 0;
+	unsigned extended[4] = {};
+	if (maxLeaf >= 7)
+	{
+		QueryCpuid(7, extended);
+	}
+
+	const bool avx2 = avx && (state & 0x6) == 0x6 && (extended[1] & (1u << 5)) != 0;
+	if (!avx2)
+	{
+		return CPU_LEVEL_SSE41;
+	}
+
+	const bool avx512 = (state & 0xE6) == 0xE6 && (extended[1] & (1u << 16)) != 0;
+	return avx512 ? CPU_LEVEL_AVX512 : CPU_LEVEL_AVX2;
+}
+
+#else
+
+CpuLevel DetectCpuLevel()
+{
+	return CPU_LEVEL_SCALAR;
+}
+
+#endif
+
+bool CheckCpuLevel(CpuLevel level)
+{
+	if (level > GetSupportedCpuLevel())
+	{
+		std::cerr << "This CPU cannot run " << GetCpuLevelName(level) << " kernels, the widest it runs is "
+			<< GetCpuLevelName(GetSupportedCpuLevel()) << "." << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// The supported level, or the one ACVTOLUT_CPU asks for
+CpuLevel ReadCpuLevel()
+{
+	const char* forced = getenv("ACVTOLUT_CPU");
+	CpuLevel level;
+	if (!forced || !*forced)
+	{
+		return GetSupportedCpuLevel();
+	}
+	if (!ParseCpuLevel(forced, level))
+	{
+		std::cerr << "Ignoring ACVTOLUT_CPU, it must be scalar, sse2, sse4.1, avx2 or avx512." << std::endl;
+		return GetSupportedCpuLevel();
+	}
+	return CheckCpuLevel(level) ? level : GetSupportedCpuLevel();
+}
+
+// Read from the environment by whichever thread gets here first; kernels
+// picked on other threads see SetCpuLevel calls without a lock
+std::atomic<int>& GetLevelSetting()
+{
+	static std::atomic<int> level(ReadCpuLevel());
+	return level;
+}
+
+} // namespace
+
+CpuLevel GetSupportedCpuLevel()
+{
+	static const CpuLevel supported = DetectCpuLevel();
+	return supported;
+}
+
+CpuLevel GetCpuLevel()
+{
+	return (CpuLevel)GetLevelSetting().load(std::memory_order_relaxed);
+}
+
+bool SetCpuLevel(CpuLevel level)
+{
+	if (!CheckCpuLevel(level))
+	{
+		return false;
+	}
+
+	GetLevelSetting().store(level, std::memory_order_relaxed);
+	return true;
+}
+
+bool ParseCpuLevel(const char* name, CpuLevel& level)
+{
+	for (int i = CPU_LEVEL_SCALAR; i <= CPU_LEVEL_AVX512; ++i)
+	{
+		if (strcmp(name, LEVEL_NAMES[i]) == 0)
+		{
+			level = (CpuLevel)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+const char* GetCpuLevelName(CpuLevel level)
+{
+	return LEVEL_NAMES[level];
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+// Instruction sets the SIMD kernels are built for, each level including the
+// ones before it. One binary carries them all and picks at run time.
+enum CpuLevel
+{
+	CPU_LEVEL_SCALAR, // portable C++ only
+	CPU_LEVEL_SSE2,
+	CPU_LEVEL_SSE41,
+	CPU_LEVEL_AVX2,
+	CPU_LEVEL_AVX512, // AVX-512F
+};
+
+// The widest level this CPU and OS can run
+CpuLevel GetSupportedCpuLevel();
+
+// The level kernels are picked for: the supported one, unless capped lower
+// through the ACVTOLUT_CPU environment variable or SetCpuLevel. The variable
+// is read once; any thread may call these.
+CpuLevel GetCpuLevel();
+
+// Caps the level, mainly to test the narrower kernels. False, with a
+// message, for levels the CPU cannot run.
+bool SetCpuLevel(CpuLevel level);
+
+// scalar, sse2, sse4.1, avx2 or avx512
+bool ParseCpuLevel(const char* name, CpuLevel& level);
+const char* GetCpuLevelName(CpuLevel level);
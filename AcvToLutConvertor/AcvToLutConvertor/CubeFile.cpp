@@ -0,0 +1,51 @@
+#include "CubeFile.h"
+#include "Lut3D.h"
+#include "LutShaper.h"
+#include "PipelineStats.h"
+#include <iostream>
+#include <cstdio>
+
+bool WriteCubeFile(const PathChar* path, const Lut3D& lut, const LutShaper* shaper)
+{
+	StageTimer timer(PIPELINE_STAGE_WRITE);
+	FILE* file = OpenNativeFile(path, "wb");
+	if (!file)
+	{
+		std::cerr << "Unable to create file: " << NarrowPath(path) << std::endl;
+		return false;
+	}
+
+	const size_t size = lut.GetSize();
+	const bool shaped = shaper && !shaper->IsIdentity();
+	bool ok = true;
+	if (shaped)
+	{
+		const std::vector<float>& table = shaper->GetTable();
+		ok = fprintf(file, "LUT_1D_SIZE %u\n", (unsigned)table.size()) > 0;
+		ok = ok && fprintf(file, "LUT_3D_SIZE %u\n\n", (unsigned)size) > 0;
+		for (size_t i = 0; ok && i < table.size(); ++i)
+		{
+			ok = fprintf(file, "%.6f %.6f %.6f\n", table[i], table[i], table[i]) > 0;
+		}
+		ok = ok && fprintf(file, "\n") > 0;
+	}
+	else
+	{
+		ok = fprintf(file, "LUT_3D_SIZE %u\n\n", (unsigned)size) > 0;
+	}
+
+	const float* texels = lut.GetTexel(0, 0, 0);
+	for (size_t i = 0; ok && i < size * size * size; ++i)
+	{
+		ok = fprintf(file, "%.6f %.6f %.6f\n", texels[i * 3], texels[i * 3 + 1], texels[i * 3 + 2]) > 0;
+	}
+
+	const long bytes = ftell(file);
+	if (fclose(file) != 0 || !ok)
+	{
+		std::cerr << "Unable to write file: " << NarrowPath(path) << std::endl;
+		return false;
+	}
+	AddPipelineCount(PIPELINE_COUNTER_BYTES_WRITTEN, bytes > 0 ? (unsigned long long)bytes : 0);
+	return true;
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include "Platform.h"
+
+class Lut3D;
+class LutShaper;
+
+//
+// Writes LUTs as .cube text files, which grading and game tools read. Red
+// varies fastest, as in Lut3D. A shaper goes in front of the cube as a 1D
+// table in the same file (LUT_1D_SIZE ahead of LUT_3D_SIZE), the layout
+// Resolve reads as a shaper followed by a cube.
+//
+bool WriteCubeFile(const PathChar* path, const Lut3D& lut, const LutShaper* shaper = nullptr);
@@ -0,0 +1,165 @@
+#include "CubeSizing.h"
+#include "LutApplier.h"
+#include "PipelineStats.h"
+#include <vector>
+#include <cmath>
+#include <cassert>
+
+namespace
+{
+
+// Entries of the grey ramp for separable chains
+const size_t RAMP_SIZE = 4096;
+
+// Colours along each axis for the others, prime so that test points fall
+// inside the cells of every candidate rather than on their corners
+const size_t LATTICE_SIZE = 41;
+
+// Test colours and what the chain makes of them
+struct Reference
+{
+	std::vector<unsigned short> Pixels; // RGB16
+	std::vector<float> Exact;
+};
+
+unsigned short ToCode(size_t index, size_t count)
+{
+	return (unsigned short)((index * 65535 + (count - 1) / 2) / (count - 1));
+}
+
+void BuildReference(const LutChain& chain, Reference& reference)
+{
+	if (chain.IsSeparable())
+	{
+		for (size_t i = 0; i < RAMP_SIZE; ++i)
+		{
+			const unsigned short code = ToCode(i, RAMP_SIZE);
+			reference.Pixels.insert(reference.Pixels.end(), 3, code);
+		}
+	}
+	else
+	{
+		for (size_t b = 0; b < LATTICE_SIZE; ++b)
+		{
+			for (size_t g = 0; g < LATTICE_SIZE; ++g)
+			{
+				for (size_t r = 0; r < LATTICE_SIZE; ++r)
+				{
+					reference.Pixels.push_back(ToCode(r, LATTICE_SIZE));
+					reference.Pixels.push_back(ToCode(g, LATTICE_SIZE));
+					reference.Pixels.push_back(ToCode(b, LATTICE_SIZE));
+				}
+			}
+		}
+	}
+
+	reference.Exact.resize(reference.Pixels.size());
+	for (size_t i = 0; i < reference.Pixels.size(); i += 3)
+	{
+		const float in[3] =
+		{
+			reference.Pixels[i] / 65535.0f,
+			reference.Pixels[i + 1] / 65535.0f,
+			reference.Pixels[i + 2] / 65535.0f,
+		};
+		chain.Evaluate(in, &reference.Exact[i]);
+	}
+}
+
+CubeSizeError GetError(size_t size, const std::vector<float>& results, const Reference& reference, const CubeSizeCriteria& criteria)
+{
+	const double steps = (double)((1u << criteria.Bits) - 1);
+	double maximum = 0.0;
+	double sum = 0.0;
+	for (size_t i = 0; i < results.size(); ++i)
+	{
+		const double error = std::fabs((double)results[i] - reference.Exact[i]) * steps;
+		maximum = error > maximum ? error : maximum;
+		sum += error;
+	}
+
+	CubeSizeError result;
+	result.Size = size;
+	result.MaxError = maximum;
+	result.MeanError = sum / results.size();
+	return result;
+}
+
+// Trilinear and tetrahedral lookups in a separable cube both come down to
+// linear interpolation in its channel tables, so no cube is needed
+CubeSizeError MeasureSeparable(const LutChain& chain, size_t size, const LutShaper& shaper, const Reference& reference, const CubeSizeCriteria& criteria)
+{
+	std::vector<float> tables[3];
+	for (int c = 0; c < 3; ++c)
+	{
+		tables[c].resize(size);
+	}
+	for (size_t i = 0; i < size; ++i)
+	{
+		const float value = shaper.Inverse((float)i / (float)(size - 1));
+		const float in[3] = { value, value, value };
+		float out[3];
+		chain.Evaluate(in, out);
+		for (int c = 0; c < 3; ++c)
+		{
+			tables[c][i] = out[c];
+		}
+	}
+
+	std::vector<float> results(reference.Pixels.size());
+	for (size_t i = 0; i < results.size(); ++i)
+	{
+		results[i] = SampleTable(tables[i % 3], shaper.Forward(reference.Pixels[i] / 65535.0f));
+	}
+	return GetError(size, results, reference, criteria);
+}
+
+CubeSizeError MeasureCube(const LutChain& chain, size_t size, const LutShaper& shaper, const Reference& reference, const CubeSizeCriteria& criteria)
+{
+	const Lut3D lut = chain.Bake(size, &shaper);
+	LutApplier applier(lut, LUT_FILTER_EXACT, LUT_LAYOUT_AUTO, &shaper);
+	applier.SetInterpolation(criteria.Interpolation);
+
+	std::vector<unsigned short> output(reference.Pixels.size());
+	applier.Apply(&reference.Pixels[0], IMAGE_FORMAT_RGB16, &output[0], IMAGE_FORMAT_RGB16, output.size() / 3);
+
+	std::vector<float> results(output.size());
+	for (size_t i = 0; i < output.size(); ++i)
+	{
+		results[i] = output[i] / 65535.0f;
+	}
+	return GetError(size, results, reference, criteria);
+}
+
+} // namespace
+
+CubeSizeCriteria::CubeSizeCriteria()
+	: Bits(8)
+	, MaxError(1.0)
+	, MeanError(0.25)
+	, Interpolation(LUT_INTERPOLATION_TRILINEAR)
+	, Shaper(LUT_SHAPER_NONE)
+	, MaxSize(65)
+{}
+
+bool SelectCubeSize(const LutChain& chain, const CubeSizeCriteria& criteria, CubeSizeError& result)
+{
+	assert(criteria.MaxSize >= 2);
+	TraceSpan span("select-cube-size");
+	Reference reference;
+	BuildReference(chain, reference);
+	const bool separable = chain.IsSeparable();
+
+	for (size_t size = 2; size <= criteria.MaxSize; ++size)
+	{
+		const LutShaper shaper = LutShaper::Create(criteria.Shaper, chain, size);
+		result = separable ?
+			MeasureSeparable(chain, size, shaper, reference, criteria) :
+			MeasureCube(chain, size, shaper, reference, criteria);
+		if (result.MaxError <= criteria.MaxError && result.MeanError <= criteria.MeanError)
+		{
+			return true;
+		}
+	}
+	return false;
+}
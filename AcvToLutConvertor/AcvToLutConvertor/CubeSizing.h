@@ -0,0 +1,48 @@
+#pragma once
+
+#include "LutChain.h"
+#include "LutKernels.h"
+#include <cstddef>
+
+//
+// Picks the smallest cube that reproduces a chain of looks within an error
+// budget. Every candidate size is baked and run through the apply engine,
+// with the interpolation its consumers use, on a set of 16-bit test colours;
+// the results are compared to the chain evaluated exactly, curves and all.
+// Sizes are tried from the smallest up, and the first within budget wins.
+// Errors are counted in steps of the output bit depth: one step is 1/255 at
+// 8 bits, 1/1023 at 10. Storing the cube in 8-bit texels adds its own
+// rounding on top, whatever the size.
+//
+// Separable chains are tested on a grey ramp, which covers every channel at
+// once since each depends on its own input only, and through their channel
+// tables: both interpolations reduce to linear interpolation in those, so no
+// cube has to be baked. The others are tested on a lattice of colours spaced
+// so that it does not line up with the cubes.
+//
+// With a shaper the cubes are baked and applied behind it, which is how a
+// smaller cube reaches the same error.
+//
+
+struct CubeSizeCriteria
+{
+	CubeSizeCriteria();
+
+	unsigned Bits; // 8 or 10
+	double MaxError; // in steps
+	double MeanError;
+	LutInterpolation Interpolation; // trilinear or tetrahedral
+	LutShaperKind Shaper;
+	size_t MaxSize;
+};
+
+struct CubeSizeError
+{
+	size_t Size;
+	double MaxError; // in steps
+	double MeanError;
+};
+
+// The smallest size from 2 to criteria.MaxSize whose errors are within both
+// bounds. False when none is, with the errors of the largest size.
+bool SelectCubeSize(const LutChain& chain, const CubeSizeCriteria& criteria, CubeSizeError& result);
@@ -0,0 +1,176 @@
+#include "CurveGrader.h"
+#include "Half.h"
+#include "PipelineStats.h"
+#include <vector>
+#include <cassert>
+
+namespace
+{
+
+unsigned char ToUnorm8(float value)
+{
+	float scaled = value * 255.0f + 0.5f;
+	if (scaled <= 0.0f)
+	{
+		return 0;
+	}
+	if (scaled >= 255.0f)
+	{
+		return 255;
+	}
+	return (unsigned char)scaled;
+}
+
+unsigned short ToUnorm16(float value)
+{
+	float scaled = value * 65535.0f + 0.5f;
+	if (scaled <= 0.0f)
+	{
+		return 0;
+	}
+	if (scaled >= 65535.0f)
+	{
+		return 65535;
+	}
+	return (unsigned short)scaled;
+}
+
+// Curves only span [0, 1]; NaN goes to 0 like SampleTable does
+float ClampInput(float value)
+{
+	if (!(value > 0.0f))
+	{
+		return 0.0f;
+	}
+	return value < 1.0f ? value : 1.0f;
+}
+
+// Pixels with and without alpha share an encoding
+bool SameEncoding(ImageFormat a, ImageFormat b)
+{
+	return GetBytesPerChannel(a) == GetBytesPerChannel(b) && (a == IMAGE_FORMAT_RGBA16F) == (b == IMAGE_FORMAT_RGBA16F);
+}
+
+template <class Code>
+void MapPlaneRow(Code* row, const Code* table, unsigned width)
+{
+	for (unsigned x = 0; x < width; ++x)
+	{
+		row[x] = table[row[x]];
+	}
+}
+
+} // namespace
+
+CurveGrader::CurveGrader(const std::vector<CubicSpline>& cubicSplines, ImageFormat format)
+	: m_Format(format)
+	, m_Context()
+{
+	assert(cubicSplines.size() == 5 && "Grading needs the five ACV curves!");
+	StageTimer timer(PIPELINE_STAGE_BAKE);
+
+	// The input of every code, evaluated in one batch per channel
+	const unsigned codeCount = GetBytesPerChannel(format) == 1 ? 256 : 65536;
+	std::vector<float> inputs(codeCount);
+	for (unsigned i = 0; i < codeCount; ++i)
+	{
+		inputs[i] = format == IMAGE_FORMAT_RGBA16F ? ClampInput(HalfToFloat((unsigned short)i)) : (float)i / (float)(codeCount - 1);
+	}
+	std::vector<float> outputs(codeCount);
+
+	for (int c = 0; c < 3; ++c)
+	{
+		const bool identity = IsIdentityChannel(cubicSplines, c);
+		if (identity)
+		{
+			outputs = inputs;
+		}
+		else
+		{
+			EvaluateCurves(cubicSplines, c, &inputs[0], &outputs[0], codeCount);
+		}
+
+		if (codeCount == 256)
+		{
+			m_Table8.resize(3 * 256);
+			for (unsigned i = 0; i < 256; ++i)
+			{
+				m_Table8[c * 256 + i] = identity ? (unsigned char)i : ToUnorm8(outputs[i]);
+			}
+		}
+		else if (format == IMAGE_FORMAT_RGBA16F)
+		{
+			m_Table16.resize(3 * 65536);
+			for (unsigned i = 0; i < 65536; ++i)
+			{
+				m_Table16[c * 65536 + i] = FloatToHalf(outputs[i]);
+			}
+		}
+		else
+		{
+			m_Table16.resize(3 * 65536);
+			for (unsigned i = 0; i < 65536; ++i)
+			{
+				m_Table16[c * 65536 + i] = identity ? (unsigned short)i : ToUnorm16(outputs[i]);
+			}
+		}
+	}
+
+	// The separable kernels of a format graded into itself read nothing but
+	// these tables
+	if (!m_Table8.empty())
+	{
+		m_Context.Codes8 = &m_Table8[0];
+	}
+	else if (format == IMAGE_FORMAT_RGBA16F)
+	{
+		m_Context.CodesHalf = &m_Table16[0];
+	}
+	else
+	{
+		m_Context.Codes16 = &m_Table16[0];
+	}
+}
+
+void CurveGrader::Apply(const void* src, void* dst, ImageFormat format, size_t count) const
+{
+	assert(SameEncoding(format, m_Format) && "Tables were built for another encoding!");
+	GetLutKernel(format, format, LUT_INTERPOLATION_SEPARABLE, LUT_TRANSFER_NONE)(m_Context, src, dst, count);
+}
+
+void CurveGrader::Apply(Image& image) const
+{
+	StageTimer timer(PIPELINE_STAGE_APPLY);
+	if (image.GetLayout() == IMAGE_LAYOUT_PLANAR)
+	{
+		ApplyPlanes(image);
+		return;
+	}
+
+	for (unsigned y = 0; y < image.GetHeight(); ++y)
+	{
+		Apply(image.GetRow(y), image.GetRow(y), image.GetFormat(), image.GetWidth());
+	}
+}
+
+void CurveGrader::ApplyPlanes(Image& image) const
+{
+	assert(SameEncoding(image.GetFormat(), m_Format) && "Tables were built for another encoding!");
+
+	// Each plane maps through its own channel's table, alpha is left alone
+	for (unsigned c = 0; c < 3; ++c)
+	{
+		for (unsigned y = 0; y < image.GetHeight(); ++y)
+		{
+			unsigned char* row = image.GetPlaneRow(c, y);
+			if (!m_Table8.empty())
+			{
+				MapPlaneRow(row, &m_Table8[c * 256], image.GetWidth());
+			}
+			else
+			{
+				MapPlaneRow(reinterpret_cast<unsigned short*>(row), &m_Table16[c * 65536], image.GetWidth());
+			}
+		}
+	}
+}
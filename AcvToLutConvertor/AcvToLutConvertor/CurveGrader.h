@@ -0,0 +1,42 @@
+#pragma once
+
+#include "AcvCurves.h"
+#include "LutKernels.h"
+#include "Image.h"
+#include <vector>
+#include <cstddef>
+
+// Grades images with ACV curves directly, without baking a cube. Each colour
+// curve and the composite curve are fused into one table per channel holding
+// the graded value of every input code: 256 entries for 8-bit pixels, 65536
+// for 16-bit unorm pixels and for the bit patterns of half floats. A pixel is
+// then three lookups, and the curves are evaluated exactly at every code
+// instead of being interpolated between the texels of a 16^3 volume.
+class CurveGrader
+{
+public:
+	// Tables are built for the encoding of format only; pixels with or without
+	// alpha share them
+	CurveGrader(const std::vector<CubicSpline>& cubicSplines, ImageFormat format);
+
+	// Interleaved pixels of format, or of its sibling with or without alpha.
+	// Alpha is left untouched, src and dst may alias.
+	void Apply(const void* src, void* dst, ImageFormat format, size_t count) const;
+
+	// The whole image in place, interleaved or planar
+	void Apply(Image& image) const;
+
+private:
+	// The kernel context points into the members
+	CurveGrader(const CurveGrader&);
+	CurveGrader& operator=(const CurveGrader&);
+
+	void ApplyPlanes(Image& image) const;
+
+	ImageFormat m_Format;
+	LutKernelContext m_Context;
+
+	// Fused tables, channel-major
+	std::vector<unsigned char> m_Table8;
+	std::vector<unsigned short> m_Table16;
+};
@@ -0,0 +1,242 @@
+#include "CurveSet.h"
+#include "PipelineStats.h"
+#include <algorithm>
+#include <iostream>
+#include <cassert>
+#include <cstring>
+
+namespace
+{
+
+bool ComesBefore(const std::pair<float, float>& knot, float input)
+{
+	return knot.first < input;
+}
+
+} // namespace
+
+CurveSet::CurveSet(const std::vector<CurvePoints>& curves, size_t cubeSize)
+	: m_Points(curves)
+	, m_Edited(curves.size(), false)
+	, m_Lattice(cubeSize)
+{
+	assert(curves.size() == 5 && "Editing needs the five ACV curves!");
+	assert(cubeSize >= 2);
+	StageTimer timer(PIPELINE_STAGE_BAKE);
+
+	for (size_t k = 0; k < curves.size(); ++k)
+	{
+		m_Splines.push_back(CubicSpline::InterpolateCubicSplineFromCurvePoints(curves[k]));
+	}
+
+	// The inputs LutChain::Bake puts on the lattice
+	std::vector<size_t> entries(cubeSize);
+	for (size_t i = 0; i < cubeSize; ++i)
+	{
+		m_Lattice[i] = (float)i / (float)(cubeSize - 1);
+		entries[i] = i;
+	}
+	for (int c = 0; c < 3; ++c)
+	{
+		EvaluateEntries(c, entries, m_Tables[c], m_Levels[c]);
+	}
+	m_Cube = Lut3D::FromSeparableTables(m_Tables[0], m_Tables[1], m_Tables[2]);
+}
+
+bool CurveSet::CheckPoints(const CurvePoints& points) const
+{
+	bool ok = IsValidCurve(points);
+	for (size_t i = 0; ok && i < points.size(); ++i)
+	{
+		ok = points[i].first >= 0.0f && points[i].first <= 255.0f && points[i].second >= 0.0f && points[i].second <= 255.0f;
+	}
+	if (!ok)
+	{
+		std::cerr << "Curves take 2 to 19 knots in [0, 255], each with an input of its own." << std::endl;
+	}
+	return ok;
+}
+
+bool CurveSet::MoveKnot(size_t curve, size_t knot, float input, float output)
+{
+	assert(curve < m_Points.size() && knot < m_Points[curve].size());
+	CurvePoints points = m_Points[curve];
+	points[knot] = std::make_pair(input, output);
+	return SetPoints(curve, points);
+}
+
+bool CurveSet::InsertKnot(size_t curve, float input, float output)
+{
+	assert(curve < m_Points.size());
+	CurvePoints points = m_Points[curve];
+	points.insert(std::lower_bound(points.begin(), points.end(), input, ComesBefore), std::make_pair(input, output));
+	return SetPoints(curve, points);
+}
+
+bool CurveSet::RemoveKnot(size_t curve, size_t knot)
+{
+	assert(curve < m_Points.size() && knot < m_Points[curve].size());
+	CurvePoints points = m_Points[curve];
+	points.erase(points.begin() + knot);
+	return SetPoints(curve, points);
+}
+
+bool CurveSet::SetPoints(size_t curve, const CurvePoints& points)
+{
+	assert(curve < m_Points.size());
+	if (!CheckPoints(points))
+	{
+		return false;
+	}
+	m_Points[curve] = points;
+	m_Edited[curve] = true;
+	return true;
+}
+
+size_t CurveSet::Update()
+{
+	StageTimer timer(PIPELINE_STAGE_BAKE);
+	const size_t size = m_Lattice.size();
+
+	// Splines of the edited curves, and the table entries that read the
+	// inputs where they changed. Alpha is read by nothing.
+	std::vector<bool> dirty[3];
+	for (int c = 0; c < 3; ++c)
+	{
+		dirty[c].assign(size, false);
+	}
+	for (size_t k = 0; k < m_Points.size(); ++k)
+	{
+		if (!m_Edited[k])
+		{
+			continue;
+		}
+		m_Edited[k] = false;
+
+		const CubicSpline spline = CubicSpline::InterpolateCubicSplineFromCurvePoints(m_Points[k]);
+		float lo, hi;
+		const bool changed = spline.FindChangedInputs(m_Splines[k], lo, hi);
+		m_Splines[k] = spline;
+
+		for (int c = 0; changed && c < 3; ++c)
+		{
+			if (k != 0 && k != (size_t)(1 + c))
+			{
+				continue;
+			}
+			for (size_t i = 0; i < size; ++i)
+			{
+				// Channel curves read the lattice in 0..255, the composite
+				// what they give
+				const float input = k == 0 ? m_Levels[c][i] : m_Lattice[i] * 255.0f;
+				if (input >= lo && input <= hi)
+				{
+					dirty[c][i] = true;
+				}
+			}
+		}
+	}
+
+	// The entries again, keeping those that came out different
+	std::vector<bool> changed[3];
+	for (int c = 0; c < 3; ++c)
+	{
+		std::vector<size_t> entries;
+		for (size_t i = 0; i < size; ++i)
+		{
+			if (dirty[c][i])
+			{
+				entries.push_back(i);
+			}
+		}
+
+		std::vector<float> values;
+		std::vector<float> levels;
+		EvaluateEntries(c, entries, values, levels);
+
+		m_Changed[c].clear();
+		changed[c].assign(size, false);
+		for (size_t j = 0; j < entries.size(); ++j)
+		{
+			const size_t i = entries[j];
+			m_Levels[c][i] = levels[j];
+			if (memcmp(&values[j], &m_Tables[c][i], sizeof(float)) != 0)
+			{
+				m_Tables[c][i] = values[j];
+				m_Changed[c].push_back(i);
+				changed[c][i] = true;
+			}
+		}
+	}
+
+	// An entry of red is a column of texels, of green a row in every slice,
+	// of blue a whole slice. One pass through the cube in memory order writes
+	// them all, skipping rows where nothing changed.
+	size_t written = 0;
+	const std::vector<size_t>& columns = m_Changed[0];
+	for (size_t slice = 0; slice < size; ++slice)
+	{
+		for (size_t row = 0; row < size; ++row)
+		{
+			float* texels = m_Cube.GetTexel(0, row, slice);
+			if (changed[1][row] || changed[2][slice])
+			{
+				for (size_t col = 0; col < size; ++col)
+				{
+					float* texel = texels + 3 * col;
+					texel[0] = m_Tables[0][col];
+					texel[1] = m_Tables[1][row];
+					texel[2] = m_Tables[2][slice];
+				}
+				written += size;
+			}
+			else
+			{
+				for (size_t j = 0; j < columns.size(); ++j)
+				{
+					texels[3 * columns[j]] = m_Tables[0][columns[j]];
+				}
+				written += columns.size();
+			}
+		}
+	}
+	return written;
+}
+
+void CurveSet::EvaluateEntries(int channel, const std::vector<size_t>& entries, std::vector<float>& values, std::vector<float>& levels) const
+{
+	const size_t count = entries.size();
+	values.resize(count);
+	levels.resize(count);
+	if (!count)
+	{
+		return;
+	}
+
+	for (size_t j = 0; j < count; ++j)
+	{
+		values[j] = m_Lattice[entries[j]];
+	}
+
+	// The channel curve alone, clamped as EvaluateCurves clamps it
+	const CubicSpline& curve = m_Splines[1 + channel];
+	for (size_t j = 0; j < count; ++j)
+	{
+		levels[j] = values[j] * 255.0f;
+	}
+	if (!curve.IsIdentity())
+	{
+		curve.ComputeAtPoints(&levels[0], &levels[0], count);
+	}
+	for (size_t j = 0; j < count; ++j)
+	{
+		levels[j] = std::min(std::max(levels[j], 0.0f), 255.0f);
+	}
+
+	// Tables of identity channels keep their inputs, as BakeCurveTables and
+	// LutChain leave them
+	if (!IsIdentityChannel(m_Splines, channel))
+	{
+		EvaluateCurves(m_Splines, channel, &values[0], &values[0], count);
+	}
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "AcvCurves.h"
+#include "Lut3D.h"
+#include <vector>
+#include <cstddef>
+
+//
+// The five curves of an ACV file held for editing, with their splines, a
+// table per channel and a preview cube, so that an editor dragging a knot
+// around gets its cube back without baking it again.
+//
+// Edits only change points and mark the curve. Update then goes step by
+// step: it solves the splines of the marked curves again, evaluates the
+// table entries whose inputs fall in the segments that changed (for the
+// composite curve, the entries whose channel curve lands there), and writes
+// the entries that came out different into the texels that hold them: a
+// slice of the cube for blue, rows for green, columns for red.
+//
+// Tables and cube are what BakeCurveTables and LutChain::Bake make of the
+// same curves, to the bit.
+//
+class CurveSet
+{
+public:
+	// Composite, red, green, blue and alpha, as ReadACVCurvePoints gives them
+	CurveSet(const std::vector<CurvePoints>& curves, size_t cubeSize);
+
+	const CurvePoints& GetPoints(size_t curve) const { return m_Points[curve]; }
+
+	// Knots are (input, output) pairs in [0, 255], inputs ascending. Edits
+	// that would leave two knots on one input, a knot out of range or a curve
+	// with fewer than 2 or more than 19 of them are refused.
+	bool MoveKnot(size_t curve, size_t knot, float input, float output);
+	bool InsertKnot(size_t curve, float input, float output);
+	bool RemoveKnot(size_t curve, size_t knot);
+	bool SetPoints(size_t curve, const CurvePoints& points);
+
+	// Brings the splines, tables and cube up to the edits, returning the
+	// texels written
+	size_t Update();
+
+	// As of the last Update
+	const std::vector<CubicSpline>& GetSplines() const { return m_Splines; }
+	const std::vector<float>& GetTable(int channel) const { return m_Tables[channel]; }
+	const Lut3D& GetCube() const { return m_Cube; }
+
+	// Table entries of the channel the last Update changed, ascending, as
+	// lattice indices along its axis of the cube
+	const std::vector<size_t>& GetChangedEntries(int channel) const { return m_Changed[channel]; }
+
+private:
+	bool CheckPoints(const CurvePoints& points) const;
+
+	// The table values and the channel curve's outputs of the listed entries
+	void EvaluateEntries(int channel, const std::vector<size_t>& entries, std::vector<float>& values, std::vector<float>& levels) const;
+
+	std::vector<CurvePoints> m_Points;
+	std::vector<CubicSpline> m_Splines;
+	std::vector<bool> m_Edited;
+
+	// The input of every lattice index, the channel curve's output for it in
+	// [0, 255] (what the composite curve reads), and the table
+	std::vector<float> m_Lattice;
+	std::vector<float> m_Levels[3];
+	std::vector<float> m_Tables[3];
+	std::vector<size_t> m_Changed[3];
+	Lut3D m_Cube;
+};
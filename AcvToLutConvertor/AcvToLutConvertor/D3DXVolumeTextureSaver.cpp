@@ -1,4 +1,6 @@
 #include "D3DXVolumeTextureSaver.h"
+#include "PipelineStats.h"
+#include "Platform.h"
 #include <d3dx9.h>
 #include <cassert>
 
@@ -84,6 +86,7 @@ bool D3DXVolumeTextureSaver::SaveToVolumeTexture(
 
 	char* pData = (char*)box.pBits;
 
+	StageTimer fillTimer(PIPELINE_STAGE_FILL);
 	for (size_t slice = 0; slice < cubeSize; ++slice)
 	{
 		char* pSlice = &pData[slice * box.SlicePitch];
@@ -106,7 +109,9 @@ bool D3DXVolumeTextureSaver::SaveToVolumeTexture(
 	}
 
 	hr = pVolumeTex->UnlockBox(0);
+	fillTimer.Stop();
 
+	StageTimer encodeTimer(PIPELINE_STAGE_ENCODE);
 	hr = D3DXSaveTextureToFileW(outputFile, D3DXIFF_DDS, pVolumeTex, nullptr);
 	if (FAILED(hr))
 	{
@@ -114,5 +119,10 @@ bool D3DXVolumeTextureSaver::SaveToVolumeTexture(
 		return false;
 	}
 
+	FileStamp stamp;
+	if (GetFileStamp(outputFile, stamp))
+	{
+		AddPipelineCount(PIPELINE_COUNTER_BYTES_WRITTEN, stamp.Size);
+	}
 	return true;
 }
\ No newline at end of file
@@ -0,0 +1,514 @@
+#include "DdsVolume.h"
+#include "Lut3D.h"
+#include "PlanarLut3D.h"
+#include "LutShaper.h"
+#include "MappedFile.h"
+#include "PipelineStats.h"
+#include <iostream>
+#include <vector>
+#include <cstring>
+#include <cctype>
+#include <cassert>
+
+namespace
+{
+
+const unsigned DDS_HEADER_SIZE = 124;
+
+const unsigned DDSD_CAPS = 0x1;
+const unsigned DDSD_HEIGHT = 0x2;
+const unsigned DDSD_WIDTH = 0x4;
+const unsigned DDSD_PIXELFORMAT = 0x1000;
+const unsigned DDSD_MIPMAPCOUNT = 0x20000;
+const unsigned DDSD_DEPTH = 0x800000;
+
+const unsigned DDPF_RGB = 0x40;
+const unsigned DDPF_LUMINANCE = 0x20000;
+const unsigned DDPF_FOURCC = 0x4;
+
+const unsigned DDSCAPS_COMPLEX = 0x8;
+const unsigned DDSCAPS_TEXTURE = 0x1000;
+const unsigned DDSCAPS_MIPMAP = 0x400000;
+const unsigned DDSCAPS2_VOLUME = 0x200000;
+
+// Offsets of the fields used here, from the start of the file
+enum DdsField
+{
+	DDS_SIZE = 4,
+	DDS_FLAGS = 8,
+	DDS_HEIGHT = 12,
+	DDS_WIDTH = 16,
+	DDS_DEPTH = 24,
+	DDS_MIPMAPCOUNT = 28,
+	DDS_PF_SIZE = 76,
+	DDS_PF_FLAGS = 80,
+	DDS_PF_BITCOUNT = 88,
+	DDS_PF_RMASK = 92,
+	DDS_PF_GMASK = 96,
+	DDS_PF_BMASK = 100,
+	DDS_PF_AMASK = 104,
+	DDS_CAPS = 108,
+	DDS_CAPS2 = 112,
+};
+
+unsigned ReadUInt(const unsigned char* header, DdsField field)
+{
+	const unsigned char* p = &header[field];
+	return p[0] | ((unsigned)p[1] << 8) | ((unsigned)p[2] << 16) | ((unsigned)p[3] << 24);
+}
+
+void WriteUInt(unsigned char* header, DdsField field, unsigned value)
+{
+	header[field] = (unsigned char)(value & 0xFF);
+	header[field + 1] = (unsigned char)((value >> 8) & 0xFF);
+	header[field + 2] = (unsigned char)((value >> 16) & 0xFF);
+	header[field + 3] = (unsigned char)((value >> 24) & 0xFF);
+}
+
+int GetMaskShift(unsigned mask)
+{
+	int shift = 0;
+	while (shift < 32 && !(mask & (1u << shift)))
+	{
+		++shift;
+	}
+	return shift;
+}
+
+unsigned ReadTexel(const unsigned char* p)
+{
+	return p[0] | ((unsigned)p[1] << 8) | ((unsigned)p[2] << 16) | ((unsigned)p[3] << 24);
+}
+
+// Same rounding as the D3DXCOLOR to DWORD conversion
+unsigned ToUnorm8(float value)
+{
+	return value >= 1.0f ? 0xFF : (value <= 0.0f ? 0x00 : (unsigned)(value * 255.0f + 0.5f));
+}
+
+unsigned GetMipCount(size_t size)
+{
+	unsigned count = 1;
+	while (size > 1)
+	{
+		size >>= 1;
+		++count;
+	}
+	return count;
+}
+
+// Where the channels sit in each 32-bit texel
+struct ChannelMasks
+{
+	unsigned Masks[3];
+	int Shifts[3];
+	unsigned Maximums[3]; // of each channel once shifted down
+};
+
+// Each channel a run of at most 16 bits, none of them overlapping
+bool GetChannelMasks(const unsigned masks[3], ChannelMasks& channels)
+{
+	unsigned used = 0;
+	for (int c = 0; c < 3; ++c)
+	{
+		const unsigned mask = masks[c];
+		channels.Masks[c] = mask;
+		channels.Shifts[c] = GetMaskShift(mask);
+		channels.Maximums[c] = mask ? mask >> channels.Shifts[c] : 0;
+
+		const unsigned maximum = channels.Maximums[c];
+		if (!mask || (maximum & (maximum + 1)) != 0 || maximum > 0xFFFF || (used & mask))
+		{
+			return false;
+		}
+		used |= mask;
+	}
+	return true;
+}
+
+void DecodeTexels(const unsigned char* texels, size_t size, const ChannelMasks& channels, Lut3D& lut)
+{
+	float scales[3];
+	for (int c = 0; c < 3; ++c)
+	{
+		scales[c] = 1.0f / (float)channels.Maximums[c];
+	}
+
+	lut.Resize(size);
+	float* out = lut.GetTexel(0, 0, 0);
+	for (size_t i = 0; i < size * size * size; ++i)
+	{
+		const unsigned value = ReadTexel(&texels[i * 4]);
+		for (int c = 0; c < 3; ++c)
+		{
+			out[i * 3 + c] = (float)((value & channels.Masks[c]) >> channels.Shifts[c]) * scales[c];
+		}
+	}
+}
+
+// Checks the header and maps the top level, leaving the mip tail untouched.
+// Returns the first texel, or null after reporting the problem.
+const unsigned char* MapTopLevel(MappedFile& file, const PathChar* path, size_t& size, ChannelMasks& channels)
+{
+	if (!file.Open(path, false))
+	{
+		return nullptr;
+	}
+
+	const unsigned long long headerSize = 4 + DDS_HEADER_SIZE;
+	const unsigned char* header = file.GetSize() >= headerSize ? file.MapWindow(0, (size_t)headerSize) : nullptr;
+	if (!header || memcmp(header, "DDS ", 4) != 0 || ReadUInt(header, DDS_SIZE) != DDS_HEADER_SIZE)
+	{
+		std::cerr << "Not a DDS file: " << NarrowPath(path) << std::endl;
+		return nullptr;
+	}
+
+	const unsigned width = ReadUInt(header, DDS_WIDTH);
+	const unsigned height = ReadUInt(header, DDS_HEIGHT);
+	const unsigned depth = ReadUInt(header, DDS_DEPTH);
+	const unsigned pixelFlags = ReadUInt(header, DDS_PF_FLAGS);
+
+	const bool volume = (ReadUInt(header, DDS_CAPS2) & DDSCAPS2_VOLUME) && (ReadUInt(header, DDS_FLAGS) & DDSD_DEPTH);
+	const bool rgb32 = (pixelFlags & DDPF_RGB) && !(pixelFlags & DDPF_FOURCC) && ReadUInt(header, DDS_PF_BITCOUNT) == 32;
+	if (!volume || !rgb32 || width != height || width != depth || width < 2 || width > 256)
+	{
+		std::cerr << "Only uncompressed 32-bit RGB cube volumes can be used as LUTs: " << NarrowPath(path) << std::endl;
+		return nullptr;
+	}
+
+	unsigned masks[3];
+	for (int c = 0; c < 3; ++c)
+	{
+		masks[c] = ReadUInt(header, (DdsField)(DDS_PF_RMASK + c * 4));
+	}
+	if (!GetChannelMasks(masks, channels))
+	{
+		std::cerr << "Unsupported channel masks in DDS file: " << NarrowPath(path) << std::endl;
+		return nullptr;
+	}
+
+	// Every level the header announces has to be there, even though only the
+	// top one is read
+	size = width;
+	const unsigned fullChain = GetMipCount(size);
+	unsigned mipCount = (ReadUInt(header, DDS_FLAGS) & DDSD_MIPMAPCOUNT) ? ReadUInt(header, DDS_MIPMAPCOUNT) : 1;
+	if (mipCount == 0)
+	{
+		mipCount = 1;
+	}
+
+	unsigned long long dataSize = 0;
+	for (unsigned level = 0; level < mipCount && level < fullChain; ++level)
+	{
+		const unsigned long long levelSize = size >> level > 0 ? size >> level : 1;
+		dataSize += levelSize * levelSize * levelSize * 4;
+	}
+
+	if (mipCount > fullChain || file.GetSize() < headerSize + dataSize)
+	{
+		std::cerr << "DDS file is truncated or has a bad mip count: " << NarrowPath(path) << std::endl;
+		return nullptr;
+	}
+
+	const unsigned char* texels = file.MapWindow(headerSize, size * size * size * 4);
+	if (!texels)
+	{
+		std::cerr << "Unable to map file: " << NarrowPath(path) << std::endl;
+	}
+	return texels;
+}
+
+} // namespace
+
+bool ReadDdsVolume(const PathChar* path, Lut3D& lut)
+{
+	StageTimer timer(PIPELINE_STAGE_PARSE);
+	MappedFile file;
+	size_t size;
+	ChannelMasks channels;
+	const unsigned char* texels = MapTopLevel(file, path, size, channels);
+	if (!texels)
+	{
+		return false;
+	}
+
+	AddPipelineCount(PIPELINE_COUNTER_BYTES_READ, DDS_VOLUME_TEXEL_OFFSET + size * size * size * 4);
+	DecodeTexels(texels, size, channels, lut);
+	return true;
+}
+
+bool ReadDdsVolumeLayout(const PathChar* path, DdsVolumeLayout& layout)
+{
+	MappedFile file;
+	ChannelMasks channels;
+	if (!MapTopLevel(file, path, layout.Size, channels))
+	{
+		return false;
+	}
+
+	layout.TexelOffset = DDS_VOLUME_TEXEL_OFFSET;
+	for (int c = 0; c < 3; ++c)
+	{
+		layout.Masks[c] = channels.Masks[c];
+	}
+	return true;
+}
+
+bool DecodeDdsVolume(const unsigned char* texels, const DdsVolumeLayout& layout, Lut3D& lut)
+{
+	ChannelMasks channels;
+	if (layout.Size < 2 || layout.Size > 256 || !GetChannelMasks(layout.Masks, channels))
+	{
+		return false;
+	}
+
+	DecodeTexels(texels, layout.Size, channels, lut);
+	return true;
+}
+
+bool ReadDdsVolume(const PathChar* path, PlanarLut3D& cube, PlanarLutFormat format)
+{
+	StageTimer timer(PIPELINE_STAGE_PARSE);
+	MappedFile file;
+	size_t size;
+	ChannelMasks channels;
+	const unsigned char* texels = MapTopLevel(file, path, size, channels);
+	if (!texels || !cube.Allocate(size, format))
+	{
+		return false;
+	}
+
+	AddPipelineCount(PIPELINE_COUNTER_BYTES_READ, DDS_VOLUME_TEXEL_OFFSET + size * size * size * 4);
+
+	const size_t count = size * size * size;
+	for (int c = 0; c < 3; ++c)
+	{
+		const unsigned mask = channels.Masks[c];
+		const int shift = channels.Shifts[c];
+		const unsigned maximum = channels.Maximums[c];
+
+		if (format == PLANAR_LUT_FLOAT)
+		{
+			// Same values as the Lut3D reader gives
+			const float scale = 1.0f / (float)maximum;
+			float* plane = cube.GetFloatPlane(c);
+			for (size_t i = 0; i < count; ++i)
+			{
+				plane[i] = (float)((ReadTexel(&texels[i * 4]) & mask) >> shift) * scale;
+			}
+		}
+		else
+		{
+			unsigned short* plane = cube.GetUnorm16Plane(c);
+			for (size_t i = 0; i < count; ++i)
+			{
+				const unsigned level = (ReadTexel(&texels[i * 4]) & mask) >> shift;
+				plane[i] = (unsigned short)((level * 65535ull + maximum / 2) / maximum);
+			}
+		}
+	}
+
+	return true;
+}
+
+void EncodeDdsVolume(const Lut3D& lut, std::vector<unsigned char>& bytes)
+{
+	StageTimer timer(PIPELINE_STAGE_FILL);
+	const size_t size = lut.GetSize();
+	const unsigned mipCount = GetMipCount(size);
+
+	// The lower mip levels stay zeroed, just as D3DX leaves them
+	size_t dataSize = 0;
+	for (unsigned level = 0; level < mipCount; ++level)
+	{
+		const size_t levelSize = size >> level > 0 ? size >> level : 1;
+		dataSize += levelSize * levelSize * levelSize * 4;
+	}
+	bytes.assign(4 + DDS_HEADER_SIZE + dataSize, 0);
+
+	unsigned char* header = &bytes[0];
+	memcpy(header, "DDS ", 4);
+	WriteUInt(header, DDS_SIZE, DDS_HEADER_SIZE);
+	WriteUInt(header, DDS_FLAGS, DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT | DDSD_DEPTH);
+	WriteUInt(header, DDS_HEIGHT, (unsigned)size);
+	WriteUInt(header, DDS_WIDTH, (unsigned)size);
+	WriteUInt(header, DDS_DEPTH, (unsigned)size);
+	WriteUInt(header, DDS_MIPMAPCOUNT, mipCount);
+	WriteUInt(header, DDS_PF_SIZE, 32);
+	WriteUInt(header, DDS_PF_FLAGS, DDPF_RGB);
+	WriteUInt(header, DDS_PF_BITCOUNT, 32);
+	WriteUInt(header, DDS_PF_RMASK, 0x00FF0000);
+	WriteUInt(header, DDS_PF_GMASK, 0x0000FF00);
+	WriteUInt(header, DDS_PF_BMASK, 0x000000FF);
+	WriteUInt(header, DDS_CAPS, DDSCAPS_COMPLEX | DDSCAPS_TEXTURE | DDSCAPS_MIPMAP);
+	WriteUInt(header, DDS_CAPS2, DDSCAPS2_VOLUME);
+
+	unsigned char* texels = &bytes[4 + DDS_HEADER_SIZE];
+	for (size_t slice = 0; slice < size; ++slice)
+	{
+		for (size_t row = 0; row < size; ++row)
+		{
+			for (size_t col = 0; col < size; ++col)
+			{
+				const float* texel = lut.GetTexel(col, row, slice);
+				unsigned char* p = &texels[((slice * size + row) * size + col) * 4];
+				p[0] = (unsigned char)ToUnorm8(texel[2]);
+				p[1] = (unsigned char)ToUnorm8(texel[1]);
+				p[2] = (unsigned char)ToUnorm8(texel[0]);
+				p[3] = 0xFF;
+			}
+		}
+	}
+}
+
+namespace
+{
+
+bool WriteDdsBytes(const PathChar* path, const std::vector<unsigned char>& bytes)
+{
+	StageTimer timer(PIPELINE_STAGE_WRITE);
+	FILE* file = OpenNativeFile(path, "wb");
+	if (!file)
+	{
+		std::cerr << "Unable to create file: " << NarrowPath(path) << std::endl;
+		return false;
+	}
+
+	const bool ok = fwrite(&bytes[0], 1, bytes.size(), file) == bytes.size();
+	if (fclose(file) != 0 || !ok)
+	{
+		std::cerr << "Unable to write file: " << NarrowPath(path) << std::endl;
+		return false;
+	}
+	AddPipelineCount(PIPELINE_COUNTER_BYTES_WRITTEN, bytes.size());
+	return true;
+}
+
+} // namespace
+
+bool WriteDdsVolume(const PathChar* path, const Lut3D& lut)
+{
+	std::vector<unsigned char> bytes;
+	EncodeDdsVolume(lut, bytes);
+	return WriteDdsBytes(path, bytes);
+}
+
+PathString GetDdsShaperPath(const PathChar* volumePath)
+{
+	PathString path = volumePath;
+	if (GetPathExtension(volumePath) == "dds")
+	{
+		path.resize(path.size() - 4);
+	}
+	return path + PATH_LITERAL(".shaper.dds");
+}
+
+bool IsDdsShaperPath(const PathChar* path)
+{
+	static const char suffix[] = ".shaper.dds";
+	const size_t suffixLength = sizeof(suffix) - 1;
+
+	const std::string narrow = NarrowPath(path);
+	if (narrow.size() < suffixLength)
+	{
+		return false;
+	}
+	for (size_t i = 0; i < suffixLength; ++i)
+	{
+		if (tolower((unsigned char)narrow[narrow.size() - suffixLength + i]) != suffix[i])
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool ReadDdsShaper(const PathChar* path, LutShaper& shaper)
+{
+	StageTimer timer(PIPELINE_STAGE_PARSE);
+	MappedFile file;
+	if (!file.Open(path, false))
+	{
+		return false;
+	}
+
+	const unsigned long long headerSize = 4 + DDS_HEADER_SIZE;
+	const unsigned char* header = file.GetSize() >= headerSize ? file.MapWindow(0, (size_t)headerSize) : nullptr;
+	if (!header || memcmp(header, "DDS ", 4) != 0 || ReadUInt(header, DDS_SIZE) != DDS_HEADER_SIZE)
+	{
+		std::cerr << "Not a DDS file: " << NarrowPath(path) << std::endl;
+		return false;
+	}
+
+	const unsigned width = ReadUInt(header, DDS_WIDTH);
+	const bool luminance16 = (ReadUInt(header, DDS_PF_FLAGS) & DDPF_LUMINANCE) && ReadUInt(header, DDS_PF_BITCOUNT) == 16 &&
+		ReadUInt(header, DDS_PF_RMASK) == 0xFFFF;
+	if (!luminance16 || ReadUInt(header, DDS_HEIGHT) != 1 || width < 2 || width > 65536)
+	{
+		std::cerr << "Shapers must be 16-bit luminance textures one row high: " << NarrowPath(path) << std::endl;
+		return false;
+	}
+
+	const unsigned char* texels = file.GetSize() >= headerSize + width * 2 ? file.MapWindow(headerSize, width * 2) : nullptr;
+	if (!texels)
+	{
+		std::cerr << "DDS file is truncated: " << NarrowPath(path) << std::endl;
+		return false;
+	}
+	AddPipelineCount(PIPELINE_COUNTER_BYTES_READ, headerSize + width * 2);
+
+	if (!DecodeDdsShaper(texels, width, shaper))
+	{
+		std::cerr << "Shaper does not rise from 0 to 1: " << NarrowPath(path) << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool WriteDdsShaper(const PathChar* path, const LutShaper& shaper)
+{
+	const std::vector<float>& table = shaper.GetTable();
+	assert(!table.empty() && "An identity shaper has no table to write!");
+
+	std::vector<unsigned char> levels;
+	EncodeDdsShaper(shaper, levels);
+
+	std::vector<unsigned char> bytes(4 + DDS_HEADER_SIZE, 0);
+	unsigned char* header = &bytes[0];
+	memcpy(header, "DDS ", 4);
+	WriteUInt(header, DDS_SIZE, DDS_HEADER_SIZE);
+	WriteUInt(header, DDS_FLAGS, DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT);
+	WriteUInt(header, DDS_HEIGHT, 1);
+	WriteUInt(header, DDS_WIDTH, (unsigned)table.size());
+	WriteUInt(header, DDS_PF_SIZE, 32);
+	WriteUInt(header, DDS_PF_FLAGS, DDPF_LUMINANCE);
+	WriteUInt(header, DDS_PF_BITCOUNT, 16);
+	WriteUInt(header, DDS_PF_RMASK, 0xFFFF);
+	WriteUInt(header, DDS_CAPS, DDSCAPS_TEXTURE);
+
+	bytes.insert(bytes.end(), levels.begin(), levels.end());
+	return WriteDdsBytes(path, bytes);
+}
+
+void EncodeDdsShaper(const LutShaper& shaper, std::vector<unsigned char>& levels)
+{
+	const std::vector<float>& table = shaper.GetTable();
+	levels.resize(table.size() * 2);
+	for (size_t i = 0; i < table.size(); ++i)
+	{
+		const float value = table[i] * 65535.0f + 0.5f;
+		const unsigned level = value >= 65535.0f ? 65535 : (value <= 0.0f ? 0 : (unsigned)value);
+		levels[i * 2] = (unsigned char)(level & 0xFF);
+		levels[i * 2 + 1] = (unsigned char)(level >> 8);
+	}
+}
+
+bool DecodeDdsShaper(const unsigned char* levels, size_t count, LutShaper& shaper)
+{
+	std::vector<float> table(count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		table[i] = (float)(levels[i * 2] | (levels[i * 2 + 1] << 8)) / 65535.0f;
+	}
+	return shaper.SetTable(table);
+}
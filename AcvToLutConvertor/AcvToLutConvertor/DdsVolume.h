@@ -0,0 +1,67 @@
+#pragma once
+
+#include "Platform.h"
+
+#include "PlanarLut3D.h"
+#include <vector>
+
+const unsigned long long DDS_VOLUME_TEXEL_OFFSET = 4 + 124;
+
+class Lut3D;
+class LutShaper;
+
+//
+// Portable reading and writing of LUT volume textures, without D3DX.
+//
+// Files are written exactly like D3DXSaveTextureToFile writes the converter's
+// texture: an uncompressed X8R8G8B8 volume with a full mip chain whose lower
+// levels are left zeroed (only the top level is ever sampled). Red runs along
+// the columns, green along the rows and blue along the slices.
+//
+// Reading accepts any uncompressed 32-bit RGB volume with equal dimensions and
+// returns the top mip level. The file is mapped and only the header and the top
+// level are touched. Channel masks must be contiguous and distinct, and every
+// mip level the header announces must be present.
+//
+
+bool ReadDdsVolume(const PathChar* path, Lut3D& lut);
+
+// Same, decoding straight into aligned planes of floats or 16-bit unorms
+bool ReadDdsVolume(const PathChar* path, PlanarLut3D& cube, PlanarLutFormat format);
+bool WriteDdsVolume(const PathChar* path, const Lut3D& lut);
+
+// The file WriteDdsVolume writes, in memory. Its top level starts right after
+// the header, at DDS_VOLUME_TEXEL_OFFSET.
+void EncodeDdsVolume(const Lut3D& lut, std::vector<unsigned char>& bytes);
+
+// Where the top level of a volume starts in its file, and where the channels
+// sit in its 32-bit texels
+struct DdsVolumeLayout
+{
+	size_t Size;
+	unsigned long long TexelOffset;
+	unsigned Masks[3]; // red, green, blue
+};
+
+// Checks a file like ReadDdsVolume does, without decoding it
+bool ReadDdsVolumeLayout(const PathChar* path, DdsVolumeLayout& layout);
+
+// Decodes a top level that is already in memory, such as one kept in a
+// LutPack. False, quietly, for a layout ReadDdsVolume would reject.
+bool DecodeDdsVolume(const unsigned char* texels, const DdsVolumeLayout& layout, Lut3D& lut);
+
+// The shaper of a DDS volume goes next to it, look.dds having its own in
+// look.shaper.dds: a texture one row high holding the shaper table in 16-bit
+// luminance, for the shader to look coordinates up in before the volume
+PathString GetDdsShaperPath(const PathChar* volumePath);
+
+// True for look.shaper.dds, which listings of LUT files skip
+bool IsDdsShaperPath(const PathChar* path);
+
+bool ReadDdsShaper(const PathChar* path, LutShaper& shaper);
+bool WriteDdsShaper(const PathChar* path, const LutShaper& shaper);
+
+// The 16-bit levels of a shaper texture, without its header, as a LutPack
+// keeps them. Decoding is false, quietly, for a table that does not rise.
+void EncodeDdsShaper(const LutShaper& shaper, std::vector<unsigned char>& levels);
+bool DecodeDdsShaper(const unsigned char* levels, size_t count, LutShaper& shaper);
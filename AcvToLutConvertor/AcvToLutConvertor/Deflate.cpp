@@ -0,0 +1,601 @@
+#include "Deflate.h"
+#include <vector>
+#include <cstring>
+
+//
+// Inflate follows RFC 1951. Huffman codes are decoded through a 9-bit
+// lookup table with a canonical-code fallback for the longer codes.
+//
+
+namespace
+{
+
+const int FAST_BITS = 9;
+const int FAST_MASK = (1 << FAST_BITS) - 1;
+const int MAX_SYMBOLS = 288;
+const size_t WINDOW_SIZE = 32768;
+const size_t MAX_MATCH = 258;
+
+const int LENGTH_BASE[31] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258, 0, 0 };
+const int LENGTH_EXTRA[31] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0, 0, 0 };
+const int DIST_BASE[32] = {
+	1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+	257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577, 0, 0 };
+const int DIST_EXTRA[32] = {
+	0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+	7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13, 0, 0 };
+
+int ReverseBits(int value, int bits)
+{
+	int result = 0;
+	for (int i = 0; i < bits; ++i)
+	{
+		result = (result << 1) | (value & 1);
+		value >>= 1;
+	}
+	return result;
+}
+
+struct Huffman
+{
+	unsigned short Fast[1 << FAST_BITS]; // (length << 9) | symbol, 0 if the code is longer
+	unsigned short FirstCode[16];
+	int MaxCode[17];
+	unsigned short FirstSymbol[16];
+	unsigned char Size[MAX_SYMBOLS];
+	unsigned short Value[MAX_SYMBOLS];
+
+	bool Build(const unsigned char* sizeList, int count)
+	{
+		int sizes[17] = {};
+		int nextCode[16] = {};
+		memset(Fast, 0, sizeof(Fast));
+
+		for (int i = 0; i < count; ++i)
+		{
+			++sizes[sizeList[i]];
+		}
+		sizes[0] = 0;
+
+		for (int i = 1; i < 16; ++i)
+		{
+			if (sizes[i] > (1 << i))
+			{
+				return false;
+			}
+		}
+
+		int code = 0;
+		int symbol = 0;
+		for (int i = 1; i < 16; ++i)
+		{
+			nextCode[i] = code;
+			FirstCode[i] = (unsigned short)code;
+			FirstSymbol[i] = (unsigned short)symbol;
+			code += sizes[i];
+			if (sizes[i] && code - 1 >= (1 << i))
+			{
+				return false;
+			}
+			MaxCode[i] = code << (16 - i); // pre-shifted for the slow path compare
+			code <<= 1;
+			symbol += sizes[i];
+		}
+		MaxCode[16] = 0x10000;
+
+		for (int i = 0; i < count; ++i)
+		{
+			int s = sizeList[i];
+			if (!s)
+			{
+				continue;
+			}
+
+			int c = nextCode[s] - FirstCode[s] + FirstSymbol[s];
+			Size[c] = (unsigned char)s;
+			Value[c] = (unsigned short)i;
+
+			if (s <= FAST_BITS)
+			{
+				unsigned short fastValue = (unsigned short)((s << 9) | i);
+				for (int j = ReverseBits(nextCode[s], s); j < (1 << FAST_BITS); j += (1 << s))
+				{
+					Fast[j] = fastValue;
+				}
+			}
+			++nextCode[s];
+		}
+
+		return true;
+	}
+};
+
+class Inflater
+{
+public:
+	Inflater(InflateInput& input, InflateOutput& output)
+		: m_Input(input)
+		, m_Output(output)
+		, m_Data(nullptr)
+		, m_DataEnd(nullptr)
+		, m_Overrun(0)
+		, m_CodeBuffer(0)
+		, m_BitCount(0)
+		, m_Window(WINDOW_SIZE * 3)
+		, m_Pos(0)
+		, m_Flushed(0)
+		, m_Adler(1)
+	{}
+
+	bool Run()
+	{
+		int cmf = GetBits(8);
+		int flg = GetBits(8);
+		if ((cmf * 256 + flg) % 31 != 0 || (cmf & 15) != 8 || (flg & 32) != 0)
+		{
+			return false; // bad header, not deflate, or preset dictionary
+		}
+
+		bool last = false;
+		while (!last)
+		{
+			last = GetBits(1) != 0;
+			int type = GetBits(2);
+
+			bool ok = false;
+			if (type == 0)
+			{
+				ok = StoredBlock();
+			}
+			else if (type == 1)
+			{
+				ok = BuildFixedCodes() && HuffmanBlock();
+			}
+			else if (type == 2)
+			{
+				ok = BuildDynamicCodes() && HuffmanBlock();
+			}
+
+			if (!ok || ReadPastEnd())
+			{
+				return false;
+			}
+		}
+
+		if (!Flush())
+		{
+			return false;
+		}
+
+		// Adler-32 of the uncompressed data follows the last block
+		DropBits(m_BitCount & 7);
+		unsigned int expected = 0;
+		for (int i = 0; i < 4; ++i)
+		{
+			expected = (expected << 8) | (unsigned int)GetBits(8);
+		}
+
+		return !ReadPastEnd() && expected == m_Adler;
+	}
+
+private:
+	// The bit buffer is topped up with zeros once the input runs out. That is
+	// harmless unless some of those padding bits were actually consumed.
+	bool ReadPastEnd() const
+	{
+		return m_Overrun * 8 > m_BitCount;
+	}
+
+	int NextByte()
+	{
+		if (m_Data == m_DataEnd)
+		{
+			size_t size = m_Input.Refill(&m_Data);
+			if (size == 0)
+			{
+				m_Data = m_DataEnd = nullptr;
+				++m_Overrun;
+				return 0;
+			}
+			m_DataEnd = m_Data + size;
+		}
+		return *m_Data++;
+	}
+
+	void FillBits()
+	{
+		while (m_BitCount <= 24)
+		{
+			m_CodeBuffer |= (unsigned int)NextByte() << m_BitCount;
+			m_BitCount += 8;
+		}
+	}
+
+	int GetBits(int count)
+	{
+		if (m_BitCount < count)
+		{
+			FillBits();
+		}
+		int value = (int)(m_CodeBuffer & ((1u << count) - 1));
+		m_CodeBuffer >>= count;
+		m_BitCount -= count;
+		return value;
+	}
+
+	void DropBits(int count)
+	{
+		m_CodeBuffer >>= count;
+		m_BitCount -= count;
+	}
+
+	int Decode(const Huffman& h)
+	{
+		if (m_BitCount < 16)
+		{
+			FillBits();
+		}
+
+		int fast = h.Fast[m_CodeBuffer & FAST_MASK];
+		if (fast)
+		{
+			DropBits(fast >> 9);
+			return fast & 511;
+		}
+
+		// Longer code: canonical decode with the most significant bit first
+		int k = ReverseBits((int)(m_CodeBuffer & 0xFFFF), 16);
+		int s = FAST_BITS + 1;
+		while (k >= h.MaxCode[s])
+		{
+			++s;
+		}
+		if (s >= 16)
+		{
+			return -1;
+		}
+
+		int b = (k >> (16 - s)) - h.FirstCode[s] + h.FirstSymbol[s];
+		if (b >= MAX_SYMBOLS || h.Size[b] != s)
+		{
+			return -1;
+		}
+
+		DropBits(s);
+		return h.Value[b];
+	}
+
+	bool Flush()
+	{
+		if (m_Pos > m_Flushed)
+		{
+			m_Adler = UpdateAdler32(m_Adler, &m_Window[m_Flushed], m_Pos - m_Flushed);
+			if (!m_Output.Write(&m_Window[m_Flushed], m_Pos - m_Flushed))
+			{
+				return false;
+			}
+			m_Flushed = m_Pos;
+		}
+		return true;
+	}
+
+	// Makes room for size more output bytes, keeping the last 32KB as history
+	bool Reserve(size_t size)
+	{
+		if (m_Pos + size <= m_Window.size())
+		{
+			return true;
+		}
+
+		if (!Flush())
+		{
+			return false;
+		}
+
+		memmove(&m_Window[0], &m_Window[m_Pos - WINDOW_SIZE], WINDOW_SIZE);
+		m_Pos = m_Flushed = WINDOW_SIZE;
+		return true;
+	}
+
+	bool StoredBlock()
+	{
+		DropBits(m_BitCount & 7);
+
+		int length = GetBits(16);
+		int inverted = GetBits(16);
+		if ((length ^ 0xFFFF) != inverted)
+		{
+			return false;
+		}
+
+		// Bytes still in the bit buffer come first
+		while (length > 0 && m_BitCount > 0)
+		{
+			if (!Reserve(1))
+			{
+				return false;
+			}
+			m_Window[m_Pos++] = (unsigned char)GetBits(8);
+			--length;
+		}
+
+		while (length > 0)
+		{
+			if (m_Data == m_DataEnd)
+			{
+				size_t size = m_Input.Refill(&m_Data);
+				if (size == 0)
+				{
+					return false;
+				}
+				m_DataEnd = m_Data + size;
+			}
+
+			size_t run = (size_t)length;
+			if (run > (size_t)(m_DataEnd - m_Data))
+			{
+				run = (size_t)(m_DataEnd - m_Data);
+			}
+			if (run > WINDOW_SIZE)
+			{
+				run = WINDOW_SIZE;
+			}
+			if (!Reserve(run))
+			{
+				return false;
+			}
+
+			memcpy(&m_Window[m_Pos], m_Data, run);
+			m_Pos += run;
+			m_Data += run;
+			length -= (int)run;
+		}
+
+		return true;
+	}
+
+	bool BuildFixedCodes()
+	{
+		unsigned char sizes[MAX_SYMBOLS];
+		memset(sizes, 8, 144);
+		memset(sizes + 144, 9, 112);
+		memset(sizes + 256, 7, 24);
+		memset(sizes + 280, 8, 8);
+
+		unsigned char distSizes[32];
+		memset(distSizes, 5, sizeof(distSizes));
+
+		return m_Length.Build(sizes, MAX_SYMBOLS) && m_Distance.Build(distSizes, 32);
+	}
+
+	bool BuildDynamicCodes()
+	{
+		static const unsigned char ORDER[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+		int hlit = GetBits(5) + 257;
+		int hdist = GetBits(5) + 1;
+		int hclen = GetBits(4) + 4;
+		int total = hlit + hdist;
+
+		unsigned char codeLengthSizes[19] = {};
+		for (int i = 0; i < hclen; ++i)
+		{
+			codeLengthSizes[ORDER[i]] = (unsigned char)GetBits(3);
+		}
+
+		Huffman codeLengths;
+		if (!codeLengths.Build(codeLengthSizes, 19))
+		{
+			return false;
+		}
+
+		unsigned char sizes[286 + 32 + 137];
+		int n = 0;
+		while (n < total)
+		{
+			int c = Decode(codeLengths);
+			if (c < 0 || c >= 19)
+			{
+				return false;
+			}
+
+			if (c < 16)
+			{
+				sizes[n++] = (unsigned char)c;
+				continue;
+			}
+
+			unsigned char fill = 0;
+			if (c == 16)
+			{
+				if (n == 0)
+				{
+					return false;
+				}
+				c = GetBits(2) + 3;
+				fill = sizes[n - 1];
+			}
+			else if (c == 17)
+			{
+				c = GetBits(3) + 3;
+			}
+			else
+			{
+				c = GetBits(7) + 11;
+			}
+
+			if (total - n < c)
+			{
+				return false;
+			}
+			memset(sizes + n, fill, c);
+			n += c;
+		}
+
+		return m_Length.Build(sizes, hlit) && m_Distance.Build(sizes + hlit, hdist);
+	}
+
+	bool HuffmanBlock()
+	{
+		for (;;)
+		{
+			int symbol = Decode(m_Length);
+			if (symbol < 0)
+			{
+				return false;
+			}
+
+			if (!Reserve(MAX_MATCH))
+			{
+				return false;
+			}
+
+			if (symbol < 256)
+			{
+				m_Window[m_Pos++] = (unsigned char)symbol;
+				continue;
+			}
+
+			if (symbol == 256)
+			{
+				return true;
+			}
+
+			symbol -= 257;
+			if (symbol >= 29)
+			{
+				return false;
+			}
+			int length = LENGTH_BASE[symbol];
+			if (LENGTH_EXTRA[symbol])
+			{
+				length += GetBits(LENGTH_EXTRA[symbol]);
+			}
+
+			int distSymbol = Decode(m_Distance);
+			if (distSymbol < 0 || distSymbol >= 30)
+			{
+				return false;
+			}
+			size_t distance = (size_t)DIST_BASE[distSymbol];
+			if (DIST_EXTRA[distSymbol])
+			{
+				distance += (size_t)GetBits(DIST_EXTRA[distSymbol]);
+			}
+			if (distance > m_Pos)
+			{
+				return false;
+			}
+
+			unsigned char* dst = &m_Window[m_Pos];
+			const unsigned char* src = dst - distance;
+			for (int i = 0; i < length; ++i)
+			{
+				dst[i] = src[i];
+			}
+			m_Pos += length;
+		}
+	}
+
+private:
+	InflateInput& m_Input;
+	InflateOutput& m_Output;
+	const unsigned char* m_Data;
+	const unsigned char* m_DataEnd;
+	int m_Overrun;
+
+	unsigned int m_CodeBuffer;
+	int m_BitCount;
+
+	Huffman m_Length;
+	Huffman m_Distance;
+
+	std::vector<unsigned char> m_Window;
+	size_t m_Pos;
+	size_t m_Flushed;
+	unsigned int m_Adler;
+};
+
+struct Crc32Table
+{
+	unsigned int Entries[256];
+};
+
+Crc32Table MakeCrc32Table()
+{
+	Crc32Table table;
+	for (unsigned int n = 0; n < 256; ++n)
+	{
+		unsigned int c = n;
+		for (int k = 0; k < 8; ++k)
+		{
+			c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+		}
+		table.Entries[n] = c;
+	}
+	return table;
+}
+
+} // namespace
+
+bool InflateZlib(InflateInput& input, InflateOutput& output)
+{
+	Inflater inflater(input, output);
+	return inflater.Run();
+}
+
+unsigned int UpdateCrc32(unsigned int crc, const void* data, size_t size)
+{
+	// Made once, by whichever thread gets here first
+	static const Crc32Table table = MakeCrc32Table();
+
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	crc = ~crc;
+	for (size_t i = 0; i < size; ++i)
+	{
+		crc = table.Entries[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+	}
+	return ~crc;
+}
+
+unsigned int UpdateAdler32(unsigned int adler, const void* data, size_t size)
+{
+	const unsigned int MOD_ADLER = 65521;
+	const size_t MAX_RUN = 5552; // largest run before the sums can overflow
+
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	unsigned int a = adler & 0xFFFF;
+	unsigned int b = adler >> 16;
+
+	while (size > 0)
+	{
+		size_t run = size < MAX_RUN ? size : MAX_RUN;
+		for (size_t i = 0; i < run; ++i)
+		{
+			a += bytes[i];
+			b += a;
+		}
+		a %= MOD_ADLER;
+		b %= MOD_ADLER;
+		bytes += run;
+		size -= run;
+	}
+
+	return (b << 16) | a;
+}
+
+size_t GetStoredZlibStreamSize(size_t dataSize)
+{
+	size_t blocks = (dataSize + MAX_STORED_BLOCK_SIZE - 1) / MAX_STORED_BLOCK_SIZE;
+	if (blocks == 0)
+	{
+		blocks = 1;
+	}
+
+	// zlib header, a 5-byte header per stored block and the Adler-32 trailer
+	return 2 + blocks * 5 + dataSize + 4;
+}
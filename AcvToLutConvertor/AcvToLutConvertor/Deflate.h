@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+
+// Source of compressed bytes for InflateZlib. Data is pulled in runs so a
+// stream split over several containers (e.g. PNG IDAT chunks) never has to be
+// gathered into one buffer first.
+class InflateInput
+{
+public:
+	virtual ~InflateInput() {}
+
+	// Points data at the next run of bytes and returns its length, 0 at the end
+	virtual size_t Refill(const unsigned char** data) = 0;
+};
+
+// Receives the decompressed bytes in runs of up to 64KB
+class InflateOutput
+{
+public:
+	virtual ~InflateOutput() {}
+
+	virtual bool Write(const unsigned char* data, size_t size) = 0;
+};
+
+// Decompresses a zlib stream (RFC 1950 wrapper around RFC 1951 deflate data)
+bool InflateZlib(InflateInput& input, InflateOutput& output);
+
+// Running checksums - start with a crc of 0 and an adler of 1
+unsigned int UpdateCrc32(unsigned int crc, const void* data, size_t size);
+unsigned int UpdateAdler32(unsigned int adler, const void* data, size_t size);
+
+// Maximum payload of a single stored (uncompressed) deflate block
+const size_t MAX_STORED_BLOCK_SIZE = 65535;
+
+// Size of a zlib stream holding dataSize bytes in stored blocks
+size_t GetStoredZlibStreamSize(size_t dataSize);
@@ -0,0 +1,71 @@
+#include "FrameRing.h"
+#include <iostream>
+#include <cassert>
+
+namespace
+{
+
+// Slots start on page boundaries, the header sits in the first page
+const size_t SLOT_ALIGNMENT = 4096;
+
+size_t AlignSlot(size_t size)
+{
+	return (size + SLOT_ALIGNMENT - 1) / SLOT_ALIGNMENT * SLOT_ALIGNMENT;
+}
+
+} // namespace
+
+FrameRing::FrameRing()
+	: m_SlotCount(0)
+	, m_SlotSize(0)
+{}
+
+bool FrameRing::Create(const std::string& name, unsigned slotCount, size_t slotSize)
+{
+	assert(slotCount > 0 && slotSize > 0);
+
+	const size_t stride = AlignSlot(slotSize);
+	if (!m_Memory.Create(name.c_str(), SLOT_ALIGNMENT + stride * slotCount))
+	{
+		return false;
+	}
+
+	FrameRingHeader* header = reinterpret_cast<FrameRingHeader*>(m_Memory.GetData());
+	header->Magic = FRAME_RING_MAGIC;
+	header->SlotCount = slotCount;
+	header->SlotSize = stride;
+
+	m_Name = name;
+	m_SlotCount = slotCount;
+	m_SlotSize = stride;
+	return true;
+}
+
+bool FrameRing::Attach(const std::string& name, int descriptor)
+{
+	if (!m_Memory.Open(name.c_str(), descriptor))
+	{
+		return false;
+	}
+
+	const FrameRingHeader* header = reinterpret_cast<const FrameRingHeader*>(m_Memory.GetData());
+	if (m_Memory.GetSize() < SLOT_ALIGNMENT || header->Magic != FRAME_RING_MAGIC || header->SlotCount == 0 ||
+		header->SlotSize == 0 || header->SlotSize % SLOT_ALIGNMENT != 0 ||
+		header->SlotSize > (m_Memory.GetSize() - SLOT_ALIGNMENT) / header->SlotCount)
+	{
+		std::cerr << "Not a frame ring: " << name << std::endl;
+		m_Memory.Close();
+		return false;
+	}
+
+	m_Name = name;
+	m_SlotCount = header->SlotCount;
+	m_SlotSize = (size_t)header->SlotSize;
+	return true;
+}
+
+unsigned char* FrameRing::GetSlot(unsigned slot) const
+{
+	assert(slot < m_SlotCount);
+	return m_Memory.GetData() + SLOT_ALIGNMENT + slot * m_SlotSize;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "SharedMemory.h"
+#include <cstddef>
+#include <string>
+
+// Frames handed to the daemon (see LutServer) through shared memory, so that
+// pixels never travel through its socket. A client creates the ring, attaches
+// it to the daemon (by its descriptor on Linux, by name elsewhere, see
+// SharedMemory), then sends only LutFrameDescriptors; the daemon
+// grades the frames in place. The region holds a FrameRingHeader followed by
+// SlotCount slots of SlotSize bytes, each starting on a page boundary.
+struct FrameRingHeader
+{
+	unsigned Magic;
+	unsigned SlotCount;
+	unsigned long long SlotSize;
+};
+
+const unsigned FRAME_RING_MAGIC = 0x474E4952; // "RING"
+
+class FrameRing
+{
+public:
+	FrameRing();
+
+	// Client side: a new region for slotCount frames of up to slotSize bytes
+	bool Create(const std::string& name, unsigned slotCount, size_t slotSize);
+
+	// Daemon side: maps a region a client created, checking its header. The
+	// descriptor, -1 where there is none, is the ring's from then on.
+	bool Attach(const std::string& name, int descriptor);
+
+	const std::string& GetName() const { return m_Name; }
+	unsigned GetSlotCount() const { return m_SlotCount; }
+	size_t GetSlotSize() const { return m_SlotSize; }
+	unsigned char* GetSlot(unsigned slot) const;
+
+	// What the client hands the daemon along with the name, -1 where the name
+	// is enough
+	int GetDescriptor() const { return m_Memory.GetDescriptor(); }
+
+private:
+	FrameRing(const FrameRing&);
+	FrameRing& operator=(const FrameRing&);
+
+	SharedMemory m_Memory;
+	std::string m_Name;
+	unsigned m_SlotCount;
+	size_t m_SlotSize;
+};
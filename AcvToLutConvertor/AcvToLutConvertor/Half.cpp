@@ -0,0 +1,131 @@
+#include "Half.h"
+#include <cstring>
+
+#if defined(__F16C__) || (defined(_MSC_VER) && defined(__AVX2__))
+#define HAS_F16C 1
+#include <immintrin.h>
+#endif
+
+float HalfToFloat(unsigned short value)
+{
+	const unsigned sign = (unsigned)(value & 0x8000) << 16;
+	unsigned exponent = (value >> 10) & 0x1F;
+	unsigned mantissa = value & 0x3FF;
+	unsigned bits;
+
+	if (exponent == 0)
+	{
+		if (mantissa == 0)
+		{
+			bits = sign;
+		}
+		else
+		{
+			// Subnormal: normalize the mantissa
+			exponent = 127 - 15 + 1;
+			while (!(mantissa & 0x400))
+			{
+				mantissa <<= 1;
+				--exponent;
+			}
+			bits = sign | (exponent << 23) | ((mantissa & 0x3FF) << 13);
+		}
+	}
+	else if (exponent == 31)
+	{
+		bits = sign | 0x7F800000 | (mantissa << 13);
+	}
+	else
+	{
+		bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+	}
+
+	float result;
+	memcpy(&result, &bits, sizeof(result));
+	return result;
+}
+
+unsigned short FloatToHalf(float value)
+{
+	unsigned bits;
+	memcpy(&bits, &value, sizeof(bits));
+
+	const unsigned sign = (bits >> 16) & 0x8000;
+	const unsigned magnitude = bits & 0x7FFFFFFF;
+
+	if (magnitude > 0x7F800000)
+	{
+		return (unsigned short)(sign | 0x7E00); // NaN
+	}
+	if (magnitude >= 0x47800000)
+	{
+		return (unsigned short)(sign | 0x7C00); // too large, or infinity
+	}
+
+	if (magnitude < 0x38800000)
+	{
+		// Result is subnormal or zero
+		if (magnitude < 0x33000000)
+		{
+			return (unsigned short)sign;
+		}
+
+		const unsigned exponent = magnitude >> 23;
+		const unsigned mantissa = (magnitude & 0x7FFFFF) | 0x800000;
+		const unsigned shift = 126 - exponent;
+		unsigned result = mantissa >> shift;
+		const unsigned remainder = mantissa & ((1u << shift) - 1);
+		const unsigned halfway = 1u << (shift - 1);
+		if (remainder > halfway || (remainder == halfway && (result & 1)))
+		{
+			++result;
+		}
+		return (unsigned short)(sign | result);
+	}
+
+	// Normal: rebias the exponent and round the mantissa, a carry may roll
+	// over into the exponent and up to infinity, which is the right answer
+	unsigned result = (magnitude - 0x38000000) >> 13;
+	const unsigned remainder = magnitude & 0x1FFF;
+	if (remainder > 0x1000 || (remainder == 0x1000 && (result & 1)))
+	{
+		++result;
+	}
+	return (unsigned short)(sign | result);
+}
+
+void HalfToFloat(const unsigned short* src, float* dst, size_t count)
+{
+	size_t i = 0;
+
+#ifdef HAS_F16C
+	for (; i + 8 <= count; i += 8)
+	{
+		__m128i half = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&src[i]));
+		_mm256_storeu_ps(&dst[i], _mm256_cvtph_ps(half));
+	}
+#endif
+
+	for (; i < count; ++i)
+	{
+		dst[i] = HalfToFloat(src[i]);
+	}
+}
+
+void FloatToHalf(const float* src, unsigned short* dst, size_t count)
+{
+	size_t i = 0;
+
+#ifdef HAS_F16C
+	for (; i + 8 <= count; i += 8)
+	{
+		__m128i half = _mm256_cvtps_ph(_mm256_loadu_ps(&src[i]), _MM_FROUND_TO_NEAREST_INT);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&dst[i]), half);
+	}
+#endif
+
+	for (; i < count; ++i)
+	{
+		dst[i] = FloatToHalf(src[i]);
+	}
+}
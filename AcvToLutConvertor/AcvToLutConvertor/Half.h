@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstddef>
+
+// IEEE 754 binary16 conversions. The array versions use the F16C
+// instructions when the build targets them and fall back to bit twiddling
+// otherwise; both round to nearest even.
+
+float HalfToFloat(unsigned short value);
+unsigned short FloatToHalf(float value);
+
+void HalfToFloat(const unsigned short* src, float* dst, size_t count);
+void FloatToHalf(const float* src, unsigned short* dst, size_t count);
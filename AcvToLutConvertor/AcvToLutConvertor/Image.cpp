@@ -0,0 +1,167 @@
+#include "Image.h"
+#include <cassert>
+#include <cstring>
+
+unsigned GetChannelCount(ImageFormat format)
+{
+	switch (format)
+	{
+	case IMAGE_FORMAT_RGB8:    return 3;
+	case IMAGE_FORMAT_RGBA8:   return 4;
+	case IMAGE_FORMAT_RGB16:   return 3;
+	case IMAGE_FORMAT_RGBA16:  return 4;
+	case IMAGE_FORMAT_RGBA16F: return 4;
+	}
+
+	assert(!"Unknown image format!");
+	return 0;
+}
+
+unsigned GetBytesPerChannel(ImageFormat format)
+{
+	switch (format)
+	{
+	case IMAGE_FORMAT_RGB8:
+	case IMAGE_FORMAT_RGBA8:
+		return 1;
+	case IMAGE_FORMAT_RGB16:
+	case IMAGE_FORMAT_RGBA16:
+	case IMAGE_FORMAT_RGBA16F:
+		return 2;
+	}
+
+	assert(!"Unknown image format!");
+	return 0;
+}
+
+static const char* const FORMAT_NAMES[] = { "rgb8", "rgba8", "rgb16", "rgba16", "rgba16f" };
+
+const char* GetImageFormatName(ImageFormat format)
+{
+	return FORMAT_NAMES[format];
+}
+
+bool ParseImageFormat(const char* name, ImageFormat& format)
+{
+	for (int i = 0; i < (int)(sizeof(FORMAT_NAMES) / sizeof(FORMAT_NAMES[0])); ++i)
+	{
+		if (strcmp(name, FORMAT_NAMES[i]) == 0)
+		{
+			format = (ImageFormat)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+Image::Image()
+	: m_Width(0)
+	, m_Height(0)
+	, m_Format(IMAGE_FORMAT_RGB8)
+	, m_Layout(IMAGE_LAYOUT_INTERLEAVED)
+	, m_RowPitch(0)
+	, m_PlaneSize(0)
+{}
+
+bool Image::Allocate(unsigned width, unsigned height, ImageFormat format, ImageLayout layout)
+{
+	if (width == 0 || height == 0)
+	{
+		assert(!"Image dimensions must be positive!");
+		return false;
+	}
+
+	m_Width = width;
+	m_Height = height;
+	m_Format = format;
+	m_Layout = layout;
+
+	const size_t channelBytes = GetBytesPerChannel(format);
+	const size_t channels = ::GetChannelCount(format);
+
+	if (layout == IMAGE_LAYOUT_INTERLEAVED)
+	{
+		m_RowPitch = width * channels * channelBytes;
+		m_PlaneSize = m_RowPitch * height;
+		m_Pixels.resize(m_PlaneSize);
+	}
+	else
+	{
+		m_RowPitch = width * channelBytes;
+		m_PlaneSize = m_RowPitch * height;
+		m_Pixels.resize(m_PlaneSize * channels);
+	}
+
+	return true;
+}
+
+size_t Image::GetPixelSize() const
+{
+	return GetChannelCount() * GetBytesPerChannel(m_Format);
+}
+
+unsigned char* Image::GetRow(unsigned y)
+{
+	assert(m_Layout == IMAGE_LAYOUT_INTERLEAVED && y < m_Height);
+	return &m_Pixels[y * m_RowPitch];
+}
+
+const unsigned char* Image::GetRow(unsigned y) const
+{
+	assert(m_Layout == IMAGE_LAYOUT_INTERLEAVED && y < m_Height);
+	return &m_Pixels[y * m_RowPitch];
+}
+
+unsigned char* Image::GetPlaneRow(unsigned channel, unsigned y)
+{
+	assert(m_Layout == IMAGE_LAYOUT_PLANAR && channel < GetChannelCount() && y < m_Height);
+	return &m_Pixels[channel * m_PlaneSize + y * m_RowPitch];
+}
+
+const unsigned char* Image::GetPlaneRow(unsigned channel, unsigned y) const
+{
+	assert(m_Layout == IMAGE_LAYOUT_PLANAR && channel < GetChannelCount() && y < m_Height);
+	return &m_Pixels[channel * m_PlaneSize + y * m_RowPitch];
+}
+
+void Image::StoreRow(unsigned y, const unsigned char* scanline)
+{
+	if (m_Layout == IMAGE_LAYOUT_INTERLEAVED)
+	{
+		memcpy(GetRow(y), scanline, m_RowPitch);
+		return;
+	}
+
+	const unsigned channels = GetChannelCount();
+	const size_t channelBytes = GetBytesPerChannel(m_Format);
+	for (unsigned c = 0; c < channels; ++c)
+	{
+		unsigned char* plane = GetPlaneRow(c, y);
+		const unsigned char* src = scanline + c * channelBytes;
+		for (unsigned x = 0; x < m_Width; ++x)
+		{
+			memcpy(&plane[x * channelBytes], &src[x * channels * channelBytes], channelBytes);
+		}
+	}
+}
+
+void Image::LoadRow(unsigned y, unsigned char* scanline) const
+{
+	if (m_Layout == IMAGE_LAYOUT_INTERLEAVED)
+	{
+		memcpy(scanline, GetRow(y), m_RowPitch);
+		return;
+	}
+
+	const unsigned channels = GetChannelCount();
+	const size_t channelBytes = GetBytesPerChannel(m_Format);
+	for (unsigned c = 0; c < channels; ++c)
+	{
+		const unsigned char* plane = GetPlaneRow(c, y);
+		unsigned char* dst = scanline + c * channelBytes;
+		for (unsigned x = 0; x < m_Width; ++x)
+		{
+			memcpy(&dst[x * channels * channelBytes], &plane[x * channelBytes], channelBytes);
+		}
+	}
+}
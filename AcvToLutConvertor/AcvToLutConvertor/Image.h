@@ -0,0 +1,68 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+
+enum ImageFormat
+{
+	IMAGE_FORMAT_RGB8,
+	IMAGE_FORMAT_RGBA8,
+	IMAGE_FORMAT_RGB16,   // 16-bit unorm, native byte order
+	IMAGE_FORMAT_RGBA16,
+	IMAGE_FORMAT_RGBA16F, // IEEE half floats
+};
+
+enum ImageLayout
+{
+	IMAGE_LAYOUT_INTERLEAVED, // RGBRGB... per row
+	IMAGE_LAYOUT_PLANAR,      // one plane per channel
+};
+
+unsigned GetChannelCount(ImageFormat format);
+unsigned GetBytesPerChannel(ImageFormat format);
+
+// Lower-case names as used on the command line ("rgb8", "rgba16f", ...)
+const char* GetImageFormatName(ImageFormat format);
+bool ParseImageFormat(const char* name, ImageFormat& format);
+
+// Pixel storage shared by the image codecs and the LUT apply engine. Decoders
+// write scanlines straight into it and the apply engine works on it in place.
+class Image
+{
+public:
+	Image();
+
+	bool Allocate(unsigned width, unsigned height, ImageFormat format, ImageLayout layout);
+
+	unsigned GetWidth() const { return m_Width; }
+	unsigned GetHeight() const { return m_Height; }
+	ImageFormat GetFormat() const { return m_Format; }
+	ImageLayout GetLayout() const { return m_Layout; }
+	unsigned GetChannelCount() const { return ::GetChannelCount(m_Format); }
+
+	// Bytes in one interleaved pixel
+	size_t GetPixelSize() const;
+	// Bytes between rows of the same plane (or of the image when interleaved)
+	size_t GetRowPitch() const { return m_RowPitch; }
+
+	// Interleaved layout only
+	unsigned char* GetRow(unsigned y);
+	const unsigned char* GetRow(unsigned y) const;
+
+	// Planar layout only
+	unsigned char* GetPlaneRow(unsigned channel, unsigned y);
+	const unsigned char* GetPlaneRow(unsigned channel, unsigned y) const;
+
+	// Copy a row in or out as an interleaved scanline, whatever the layout
+	void StoreRow(unsigned y, const unsigned char* scanline);
+	void LoadRow(unsigned y, unsigned char* scanline) const;
+
+private:
+	unsigned m_Width;
+	unsigned m_Height;
+	ImageFormat m_Format;
+	ImageLayout m_Layout;
+	size_t m_RowPitch;
+	size_t m_PlaneSize;
+	std::vector<unsigned char> m_Pixels;
+};
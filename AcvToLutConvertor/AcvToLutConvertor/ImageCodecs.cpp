@@ -0,0 +1,1786 @@
+#include "ImageCodecs.h"
+#include "Deflate.h"
+#include "PipelineStats.h"
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+
+namespace
+{
+
+//
+// Buffered reading from a FILE*. Large reads bypass the buffer and land
+// directly in the caller's memory (usually an image row).
+//
+
+class FileReader
+{
+public:
+	explicit FileReader(FILE* file)
+		: m_File(file)
+		, m_Buffer(BUFFER_SIZE)
+		, m_Pos(0)
+		, m_End(0)
+	{}
+
+	bool Read(void* dst, size_t size)
+	{
+		unsigned char* out = static_cast<unsigned char*>(dst);
+		while (size > 0)
+		{
+			if (m_Pos == m_End)
+			{
+				if (size >= m_Buffer.size())
+				{
+					return fread(out, 1, size, m_File) == size;
+				}
+				if (!Fill())
+				{
+					return false;
+				}
+			}
+
+			size_t run = std::min(size, m_End - m_Pos);
+			memcpy(out, &m_Buffer[m_Pos], run);
+			m_Pos += run;
+			out += run;
+			size -= run;
+		}
+		return true;
+	}
+
+	int ReadByte()
+	{
+		if (m_Pos == m_End && !Fill())
+		{
+			return -1;
+		}
+		return m_Buffer[m_Pos++];
+	}
+
+	bool Skip(size_t size)
+	{
+		while (size > 0)
+		{
+			if (m_Pos == m_End && !Fill())
+			{
+				return false;
+			}
+			size_t run = std::min(size, m_End - m_Pos);
+			m_Pos += run;
+			size -= run;
+		}
+		return true;
+	}
+
+	// Hands out up to maxSize buffered bytes without copying them
+	size_t Acquire(const unsigned char** data, size_t maxSize)
+	{
+		if (m_Pos == m_End && !Fill())
+		{
+			return 0;
+		}
+		size_t run = std::min(maxSize, m_End - m_Pos);
+		*data = &m_Buffer[m_Pos];
+		m_Pos += run;
+		return run;
+	}
+
+private:
+	bool Fill()
+	{
+		m_Pos = 0;
+		m_End = fread(&m_Buffer[0], 1, m_Buffer.size(), m_File);
+		return m_End > 0;
+	}
+
+	static const size_t BUFFER_SIZE = 1 << 16;
+
+	FILE* m_File;
+	std::vector<unsigned char> m_Buffer;
+	size_t m_Pos;
+	size_t m_End;
+};
+
+// Closes the file when leaving scope
+class FileHandle
+{
+public:
+	explicit FileHandle(FILE* file) : m_File(file) {}
+	~FileHandle() { if (m_File) fclose(m_File); }
+
+	FILE* Get() const { return m_File; }
+
+	bool Close()
+	{
+		bool ok = fclose(m_File) == 0;
+		m_File = nullptr;
+		return ok;
+	}
+
+private:
+	FileHandle(const FileHandle&);
+	FileHandle& operator=(const FileHandle&);
+
+	FILE* m_File;
+};
+
+// Headers are checked against these before anything is allocated, so that a
+// damaged or hostile file cannot ask for gigabytes
+const unsigned MAX_IMAGE_DIMENSION = 65536;
+const unsigned long long MAX_IMAGE_PIXELS = 1ULL << 28;
+
+bool CheckImageDimensions(unsigned width, unsigned height, const char* format)
+{
+	if (width == 0 || height == 0)
+	{
+		std::cerr << "Invalid " << format << " dimensions!" << std::endl;
+		return false;
+	}
+	if (width > MAX_IMAGE_DIMENSION || height > MAX_IMAGE_DIMENSION || (unsigned long long)width * height > MAX_IMAGE_PIXELS)
+	{
+		std::cerr << format << " image is too large (" << width << "x" << height << ")" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+unsigned short ReadLittleEndianUShort(const unsigned char* p)
+{
+	return (unsigned short)(p[0] | (p[1] << 8));
+}
+
+unsigned int ReadLittleEndianUInt(const unsigned char* p)
+{
+	return (unsigned int)p[0] | ((unsigned int)p[1] << 8) | ((unsigned int)p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+unsigned int ReadBigEndianUInt(const unsigned char* p)
+{
+	return ((unsigned int)p[0] << 24) | ((unsigned int)p[1] << 16) | ((unsigned int)p[2] << 8) | (unsigned int)p[3];
+}
+
+void WriteLittleEndianUShort(unsigned char* p, unsigned int value)
+{
+	p[0] = (unsigned char)(value & 0xFF);
+	p[1] = (unsigned char)((value >> 8) & 0xFF);
+}
+
+void WriteLittleEndianUInt(unsigned char* p, unsigned int value)
+{
+	WriteLittleEndianUShort(p, value & 0xFFFF);
+	WriteLittleEndianUShort(p + 2, value >> 16);
+}
+
+void WriteBigEndianUInt(unsigned char* p, unsigned int value)
+{
+	p[0] = (unsigned char)(value >> 24);
+	p[1] = (unsigned char)((value >> 16) & 0xFF);
+	p[2] = (unsigned char)((value >> 8) & 0xFF);
+	p[3] = (unsigned char)(value & 0xFF);
+}
+
+//
+// Scanline plumbing shared by the decoders
+//
+
+enum SourceLayout
+{
+	SOURCE_GRAY,
+	SOURCE_GRAY_ALPHA,
+	SOURCE_RGB,
+	SOURCE_RGBA,
+	SOURCE_BGR,
+	SOURCE_BGRA,
+};
+
+unsigned GetSourceChannelCount(SourceLayout layout)
+{
+	switch (layout)
+	{
+	case SOURCE_GRAY:       return 1;
+	case SOURCE_GRAY_ALPHA: return 2;
+	case SOURCE_RGB:
+	case SOURCE_BGR:        return 3;
+	case SOURCE_RGBA:
+	case SOURCE_BGRA:       return 4;
+	}
+	return 0;
+}
+
+bool SourceHasAlpha(SourceLayout layout)
+{
+	return layout == SOURCE_GRAY_ALPHA || layout == SOURCE_RGBA || layout == SOURCE_BGRA;
+}
+
+ImageFormat GetDestinationFormat(SourceLayout layout, unsigned bytesPerSample)
+{
+	if (bytesPerSample == 2)
+	{
+		return SourceHasAlpha(layout) ? IMAGE_FORMAT_RGBA16 : IMAGE_FORMAT_RGB16;
+	}
+	return SourceHasAlpha(layout) ? IMAGE_FORMAT_RGBA8 : IMAGE_FORMAT_RGB8;
+}
+
+// Expands a source scanline into RGB(A). src and dst may alias when both have
+// the same number of channels (the BGR swizzles).
+void ConvertScanline(const unsigned char* src, SourceLayout layout, unsigned width, unsigned char* dst, unsigned dstChannels)
+{
+	switch (layout)
+	{
+	case SOURCE_GRAY:
+	case SOURCE_GRAY_ALPHA:
+		{
+			const unsigned srcChannels = GetSourceChannelCount(layout);
+			for (unsigned x = 0; x < width; ++x)
+			{
+				unsigned char* d = &dst[x * dstChannels];
+				const unsigned char* s = &src[x * srcChannels];
+				d[0] = d[1] = d[2] = s[0];
+				if (dstChannels == 4)
+				{
+					d[3] = srcChannels == 2 ? s[1] : 255;
+				}
+			}
+		}
+		break;
+
+	case SOURCE_RGB:
+	case SOURCE_RGBA:
+		{
+			const unsigned srcChannels = GetSourceChannelCount(layout);
+			if (src != dst || srcChannels != dstChannels)
+			{
+				for (unsigned x = 0; x < width; ++x)
+				{
+					unsigned char* d = &dst[x * dstChannels];
+					const unsigned char* s = &src[x * srcChannels];
+					d[0] = s[0];
+					d[1] = s[1];
+					d[2] = s[2];
+					if (dstChannels == 4)
+					{
+						d[3] = srcChannels == 4 ? s[3] : 255;
+					}
+				}
+			}
+		}
+		break;
+
+	case SOURCE_BGR:
+	case SOURCE_BGRA:
+		{
+			const unsigned srcChannels = GetSourceChannelCount(layout);
+			for (unsigned x = 0; x < width; ++x)
+			{
+				unsigned char* d = &dst[x * dstChannels];
+				const unsigned char* s = &src[x * srcChannels];
+				unsigned char b = s[0];
+				unsigned char g = s[1];
+				unsigned char r = s[2];
+				unsigned char a = srcChannels == 4 ? s[3] : 255;
+				d[0] = r;
+				d[1] = g;
+				d[2] = b;
+				if (dstChannels == 4)
+				{
+					d[3] = a;
+				}
+			}
+		}
+		break;
+	}
+}
+
+// The 16-bit version for the big-endian samples of PNG and PNM, converted to
+// native unsigned shorts. Only the RGB and gray layouts exist at this depth.
+void ConvertScanline16(const unsigned char* src, SourceLayout layout, unsigned width, unsigned short* dst, unsigned dstChannels)
+{
+	const unsigned srcChannels = GetSourceChannelCount(layout);
+	const bool gray = layout == SOURCE_GRAY || layout == SOURCE_GRAY_ALPHA;
+	const bool alpha = SourceHasAlpha(layout);
+
+	for (unsigned x = 0; x < width; ++x)
+	{
+		// Every sample is read before the ones it overwrites when src and dst alias
+		const unsigned char* s = &src[x * srcChannels * 2];
+		unsigned short samples[4];
+		for (unsigned c = 0; c < srcChannels; ++c)
+		{
+			samples[c] = (unsigned short)((s[c * 2] << 8) | s[c * 2 + 1]);
+		}
+
+		unsigned short* d = &dst[x * dstChannels];
+		d[0] = samples[0];
+		d[1] = samples[gray ? 0 : 1];
+		d[2] = samples[gray ? 0 : 2];
+		if (dstChannels == 4)
+		{
+			d[3] = alpha ? samples[srcChannels - 1] : 65535;
+		}
+	}
+}
+
+// Native 16-bit samples to big-endian bytes, the other way around
+void StoreBigEndianSamples(const unsigned char* src, size_t count, unsigned char* dst)
+{
+	const unsigned short* samples = reinterpret_cast<const unsigned short*>(src);
+	for (size_t i = 0; i < count; ++i)
+	{
+		dst[i * 2] = (unsigned char)(samples[i] >> 8);
+		dst[i * 2 + 1] = (unsigned char)(samples[i] & 0xFF);
+	}
+}
+
+// Hands decoders the memory for one interleaved scanline: the image row itself
+// for interleaved images, a single-row scratch buffer for planar ones.
+class RowWriter
+{
+public:
+	explicit RowWriter(Image& image)
+		: m_Image(image)
+	{
+		if (image.GetLayout() == IMAGE_LAYOUT_PLANAR)
+		{
+			m_Scratch.resize(image.GetWidth() * image.GetPixelSize());
+		}
+	}
+
+	unsigned char* Begin(unsigned y)
+	{
+		return m_Scratch.empty() ? m_Image.GetRow(y) : &m_Scratch[0];
+	}
+
+	void Commit(unsigned y)
+	{
+		if (!m_Scratch.empty())
+		{
+			m_Image.StoreRow(y, &m_Scratch[0]);
+		}
+	}
+
+private:
+	Image& m_Image;
+	std::vector<unsigned char> m_Scratch;
+};
+
+// The read-side counterpart: interleaved scanlines out of any layout
+class RowReader
+{
+public:
+	explicit RowReader(const Image& image)
+		: m_Image(image)
+	{
+		if (image.GetLayout() == IMAGE_LAYOUT_PLANAR)
+		{
+			m_Scratch.resize(image.GetWidth() * image.GetPixelSize());
+		}
+	}
+
+	const unsigned char* Get(unsigned y)
+	{
+		if (m_Scratch.empty())
+		{
+			return m_Image.GetRow(y);
+		}
+		m_Image.LoadRow(y, &m_Scratch[0]);
+		return &m_Scratch[0];
+	}
+
+private:
+	const Image& m_Image;
+	std::vector<unsigned char> m_Scratch;
+};
+
+// Reads rows of a raw source layout and converts them into the image
+class ScanlineDecoder
+{
+public:
+	ScanlineDecoder(Image& image, SourceLayout layout)
+		: m_Rows(image)
+		, m_Layout(layout)
+		, m_Width(image.GetWidth())
+		, m_Channels(image.GetChannelCount())
+		, m_SampleSize(GetBytesPerChannel(image.GetFormat()))
+	{
+		// Sources with fewer bytes per pixel than the destination need a staging row
+		if (GetSourceChannelCount(layout) < m_Channels)
+		{
+			m_Source.resize(GetSourceRowSize());
+		}
+	}
+
+	size_t GetSourceRowSize() const
+	{
+		return m_Width * GetSourceChannelCount(m_Layout) * m_SampleSize;
+	}
+
+	// Where the raw source bytes for row y have to be put
+	unsigned char* BeginRow(unsigned y)
+	{
+		m_Row = m_Rows.Begin(y);
+		return m_Source.empty() ? m_Row : &m_Source[0];
+	}
+
+	void EndRow(unsigned y)
+	{
+		const unsigned char* src = m_Source.empty() ? m_Row : &m_Source[0];
+		if (m_SampleSize == 2)
+		{
+			ConvertScanline16(src, m_Layout, m_Width, reinterpret_cast<unsigned short*>(m_Row), m_Channels);
+		}
+		else
+		{
+			ConvertScanline(src, m_Layout, m_Width, m_Row, m_Channels);
+		}
+		m_Rows.Commit(y);
+	}
+
+private:
+	RowWriter m_Rows;
+	SourceLayout m_Layout;
+	unsigned m_Width;
+	unsigned m_Channels;
+	unsigned m_SampleSize;
+	std::vector<unsigned char> m_Source;
+	unsigned char* m_Row;
+};
+
+//
+// PPM / PGM / PAM
+//
+
+bool ReadPnmToken(FileReader& reader, std::string& token)
+{
+	token.clear();
+
+	int c = reader.ReadByte();
+	for (;;)
+	{
+		if (c == '#')
+		{
+			while (c != '\n' && c != -1)
+			{
+				c = reader.ReadByte();
+			}
+		}
+		else if (c == ' ' || c == '\t' || c == '\r' || c == '\n')
+		{
+			c = reader.ReadByte();
+		}
+		else
+		{
+			break;
+		}
+	}
+
+	while (c != -1 && c != ' ' && c != '\t' && c != '\r' && c != '\n')
+	{
+		token += (char)c;
+		c = reader.ReadByte();
+	}
+
+	// The single whitespace byte after the token is consumed, which is exactly
+	// what the format requires between the header and the raster
+	return !token.empty();
+}
+
+bool ReadPnmNumber(FileReader& reader, unsigned& value)
+{
+	std::string token;
+	if (!ReadPnmToken(reader, token) || token.find_first_not_of("0123456789") != std::string::npos || token.size() > 9)
+	{
+		return false;
+	}
+	value = (unsigned)atoi(token.c_str());
+	return true;
+}
+
+bool ReadPam(FileReader& reader, unsigned& width, unsigned& height, unsigned& maxValue, SourceLayout& layout)
+{
+	unsigned depth = 0;
+	std::string tupleType;
+	std::string token;
+	width = height = maxValue = 0;
+
+	for (;;)
+	{
+		if (!ReadPnmToken(reader, token))
+		{
+			return false;
+		}
+
+		if (token == "ENDHDR")
+		{
+			break;
+		}
+		else if (token == "WIDTH")
+		{
+			if (!ReadPnmNumber(reader, width)) return false;
+		}
+		else if (token == "HEIGHT")
+		{
+			if (!ReadPnmNumber(reader, height)) return false;
+		}
+		else if (token == "DEPTH")
+		{
+			if (!ReadPnmNumber(reader, depth)) return false;
+		}
+		else if (token == "MAXVAL")
+		{
+			if (!ReadPnmNumber(reader, maxValue)) return false;
+		}
+		else if (token == "TUPLTYPE")
+		{
+			if (!ReadPnmToken(reader, tupleType)) return false;
+		}
+	}
+
+	if (tupleType == "GRAYSCALE" && depth == 1)
+	{
+		layout = SOURCE_GRAY;
+	}
+	else if (tupleType == "GRAYSCALE_ALPHA" && depth == 2)
+	{
+		layout = SOURCE_GRAY_ALPHA;
+	}
+	else if (tupleType == "RGB" && depth == 3)
+	{
+		layout = SOURCE_RGB;
+	}
+	else if (tupleType == "RGB_ALPHA" && depth == 4)
+	{
+		layout = SOURCE_RGBA;
+	}
+	else
+	{
+		std::cerr << "Unsupported PAM tuple type: " << tupleType << " (depth " << depth << ")" << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+bool ReadPnm(FileReader& reader, Image& image, ImageLayout imageLayout)
+{
+	unsigned char magic[2];
+	if (!reader.Read(magic, 2))
+	{
+		return false;
+	}
+
+	unsigned width = 0;
+	unsigned height = 0;
+	unsigned maxValue = 0;
+	SourceLayout layout;
+
+	if (magic[1] == '5' || magic[1] == '6')
+	{
+		layout = magic[1] == '5' ? SOURCE_GRAY : SOURCE_RGB;
+		if (!ReadPnmNumber(reader, width) || !ReadPnmNumber(reader, height) || !ReadPnmNumber(reader, maxValue))
+		{
+			std::cerr << "Malformed PNM header!" << std::endl;
+			return false;
+		}
+	}
+	else if (magic[1] == '7')
+	{
+		if (!ReadPam(reader, width, height, maxValue, layout))
+		{
+			std::cerr << "Malformed PAM header!" << std::endl;
+			return false;
+		}
+	}
+	else
+	{
+		std::cerr << "Only binary PNM files (P5, P6, P7) are supported." << std::endl;
+		return false;
+	}
+
+	if (maxValue == 0 || maxValue > 65535)
+	{
+		std::cerr << "Unsupported PNM maximum value (" << maxValue << ")" << std::endl;
+		return false;
+	}
+
+	if (!CheckImageDimensions(width, height, "PNM"))
+	{
+		return false;
+	}
+
+	// Above 255 the samples are two bytes wide, most significant first
+	const unsigned sampleSize = maxValue > 255 ? 2 : 1;
+	if (!image.Allocate(width, height, GetDestinationFormat(layout, sampleSize), imageLayout))
+	{
+		return false;
+	}
+
+	unsigned char rescale[256];
+	for (unsigned i = 0; i < 256; ++i)
+	{
+		rescale[i] = (unsigned char)(std::min(i, maxValue) * 255 / maxValue);
+	}
+
+	ScanlineDecoder decoder(image, layout);
+	for (unsigned y = 0; y < height; ++y)
+	{
+		unsigned char* src = decoder.BeginRow(y);
+		if (!reader.Read(src, decoder.GetSourceRowSize()))
+		{
+			std::cerr << "Unexpected end of PNM data!" << std::endl;
+			return false;
+		}
+
+		if (sampleSize == 2 && maxValue != 65535)
+		{
+			for (size_t i = 0; i < decoder.GetSourceRowSize(); i += 2)
+			{
+				unsigned value = std::min((unsigned)((src[i] << 8) | src[i + 1]), maxValue) * 65535u / maxValue;
+				src[i] = (unsigned char)(value >> 8);
+				src[i + 1] = (unsigned char)(value & 0xFF);
+			}
+		}
+		else if (sampleSize == 1 && maxValue != 255)
+		{
+			for (size_t i = 0; i < decoder.GetSourceRowSize(); ++i)
+			{
+				src[i] = rescale[src[i]];
+			}
+		}
+
+		decoder.EndRow(y);
+	}
+
+	return true;
+}
+
+bool WritePnm(FILE* file, const Image& image, bool pam)
+{
+	const unsigned width = image.GetWidth();
+	const unsigned height = image.GetHeight();
+	const bool alpha = image.GetChannelCount() == 4;
+	const unsigned sampleSize = GetBytesPerChannel(image.GetFormat());
+	const unsigned maxValue = sampleSize == 2 ? 65535 : 255;
+
+	if (pam)
+	{
+		fprintf(file, "P7\nWIDTH %u\nHEIGHT %u\nDEPTH %u\nMAXVAL %u\nTUPLTYPE %s\nENDHDR\n",
+			width, height, image.GetChannelCount(), maxValue, alpha ? "RGB_ALPHA" : "RGB");
+	}
+	else
+	{
+		fprintf(file, "P6\n%u %u\n%u\n", width, height, maxValue);
+	}
+
+	// PPM has no alpha, so RGBA images lose it there
+	const bool dropAlpha = alpha && !pam;
+	const unsigned channels = dropAlpha ? 3 : image.GetChannelCount();
+	std::vector<unsigned char> packed(dropAlpha || sampleSize == 2 ? width * channels * sampleSize : 0);
+
+	RowReader rows(image);
+	for (unsigned y = 0; y < height; ++y)
+	{
+		const unsigned char* row = rows.Get(y);
+		size_t size = width * image.GetPixelSize();
+
+		if (!packed.empty())
+		{
+			const size_t pixelSize = image.GetPixelSize();
+			const size_t packedPixelSize = channels * sampleSize;
+			for (unsigned x = 0; x < width; ++x)
+			{
+				if (sampleSize == 2)
+				{
+					StoreBigEndianSamples(&row[x * pixelSize], channels, &packed[x * packedPixelSize]);
+				}
+				else
+				{
+					memcpy(&packed[x * packedPixelSize], &row[x * pixelSize], packedPixelSize);
+				}
+			}
+			row = &packed[0];
+			size = packed.size();
+		}
+
+		if (fwrite(row, 1, size, file) != size)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+//
+// BMP
+//
+
+const unsigned BI_RGB = 0;
+const unsigned BI_BITFIELDS = 3;
+
+int GetMaskShift(unsigned mask)
+{
+	// Only byte-aligned 8-bit masks are supported
+	for (int shift = 0; shift <= 24; shift += 8)
+	{
+		if (mask == (0xFFu << shift))
+		{
+			return shift;
+		}
+	}
+	return -1;
+}
+
+bool ReadBmp(FileReader& reader, Image& image, ImageLayout imageLayout)
+{
+	unsigned char fileHeader[14];
+	unsigned char infoHeader[124] = {};
+	if (!reader.Read(fileHeader, sizeof(fileHeader)) || !reader.Read(infoHeader, 4))
+	{
+		return false;
+	}
+
+	const unsigned pixelOffset = ReadLittleEndianUInt(&fileHeader[10]);
+	const unsigned infoSize = ReadLittleEndianUInt(&infoHeader[0]);
+	if (infoSize < 40 || infoSize > sizeof(infoHeader) || !reader.Read(&infoHeader[4], infoSize - 4))
+	{
+		std::cerr << "Unsupported BMP header size (" << infoSize << ")" << std::endl;
+		return false;
+	}
+
+	const int width = (int)ReadLittleEndianUInt(&infoHeader[4]);
+	const int signedHeight = (int)ReadLittleEndianUInt(&infoHeader[8]);
+	const unsigned bitCount = ReadLittleEndianUShort(&infoHeader[14]);
+	const unsigned compression = ReadLittleEndianUInt(&infoHeader[16]);
+	size_t consumed = sizeof(fileHeader) + infoSize;
+
+	const bool topDown = signedHeight < 0;
+	const unsigned height = topDown ? 0u - (unsigned)signedHeight : (unsigned)signedHeight;
+	if (!CheckImageDimensions(width > 0 ? (unsigned)width : 0, height, "BMP"))
+	{
+		return false;
+	}
+
+	unsigned masks[4] = { 0x00FF0000, 0x0000FF00, 0x000000FF, 0 };
+	if (compression == BI_BITFIELDS)
+	{
+		if (infoSize == 40)
+		{
+			// Masks follow the short header
+			unsigned char maskBytes[12];
+			if (!reader.Read(maskBytes, sizeof(maskBytes)))
+			{
+				return false;
+			}
+			consumed += sizeof(maskBytes);
+			for (int i = 0; i < 3; ++i)
+			{
+				masks[i] = ReadLittleEndianUInt(&maskBytes[i * 4]);
+			}
+		}
+		else
+		{
+			for (int i = 0; i < 4; ++i)
+			{
+				masks[i] = ReadLittleEndianUInt(&infoHeader[40 + i * 4]);
+			}
+		}
+	}
+	else if (compression != BI_RGB)
+	{
+		std::cerr << "Compressed BMP files are not supported." << std::endl;
+		return false;
+	}
+
+	if (bitCount != 24 && bitCount != 32)
+	{
+		std::cerr << "Only 24-bit and 32-bit BMP files are supported (got " << bitCount << ")" << std::endl;
+		return false;
+	}
+
+	if (pixelOffset < consumed || !reader.Skip(pixelOffset - consumed))
+	{
+		std::cerr << "Invalid BMP pixel data offset!" << std::endl;
+		return false;
+	}
+
+	SourceLayout layout = SOURCE_BGR;
+	bool swizzle = false;
+	int shifts[4] = { 16, 8, 0, -1 };
+	if (bitCount == 32)
+	{
+		layout = SOURCE_BGRA;
+		for (int i = 0; i < 4; ++i)
+		{
+			shifts[i] = masks[i] ? GetMaskShift(masks[i]) : -1;
+		}
+		if (shifts[0] < 0 || shifts[1] < 0 || shifts[2] < 0 || (masks[3] && shifts[3] < 0))
+		{
+			std::cerr << "Unsupported BMP channel masks!" << std::endl;
+			return false;
+		}
+		swizzle = shifts[0] != 16 || shifts[1] != 8 || shifts[2] != 0 || (shifts[3] != 24 && shifts[3] != -1);
+	}
+
+	const bool alpha = bitCount == 32 && masks[3] != 0;
+	if (!image.Allocate((unsigned)width, height, alpha ? IMAGE_FORMAT_RGBA8 : IMAGE_FORMAT_RGB8, imageLayout))
+	{
+		return false;
+	}
+
+	const size_t srcRowSize = (size_t)width * (bitCount / 8);
+	const size_t padding = ((srcRowSize + 3) & ~(size_t)3) - srcRowSize;
+	const unsigned channels = image.GetChannelCount();
+
+	RowWriter rows(image);
+	std::vector<unsigned char> source(channels < bitCount / 8 || swizzle ? srcRowSize : 0);
+
+	for (unsigned i = 0; i < height; ++i)
+	{
+		const unsigned y = topDown ? i : height - 1 - i;
+		unsigned char* row = rows.Begin(y);
+		unsigned char* src = source.empty() ? row : &source[0];
+
+		if (!reader.Read(src, srcRowSize) || !reader.Skip(padding))
+		{
+			std::cerr << "Unexpected end of BMP data!" << std::endl;
+			return false;
+		}
+
+		if (swizzle)
+		{
+			for (int x = 0; x < width; ++x)
+			{
+				unsigned pixel = ReadLittleEndianUInt(&src[x * 4]);
+				unsigned char* d = &row[x * channels];
+				d[0] = (unsigned char)(pixel >> shifts[0]);
+				d[1] = (unsigned char)(pixel >> shifts[1]);
+				d[2] = (unsigned char)(pixel >> shifts[2]);
+				if (channels == 4)
+				{
+					d[3] = (unsigned char)(pixel >> shifts[3]);
+				}
+			}
+		}
+		else
+		{
+			ConvertScanline(src, layout, (unsigned)width, row, channels);
+		}
+
+		rows.Commit(y);
+	}
+
+	return true;
+}
+
+bool WriteBmp(FILE* file, const Image& image)
+{
+	const unsigned width = image.GetWidth();
+	const unsigned height = image.GetHeight();
+	const unsigned channels = image.GetChannelCount();
+	const bool alpha = channels == 4;
+
+	const unsigned infoSize = alpha ? 108 : 40; // BITMAPV4HEADER carries the alpha mask
+	const size_t rowSize = width * channels;
+	const size_t paddedRowSize = (rowSize + 3) & ~(size_t)3;
+	const unsigned pixelOffset = 14 + infoSize;
+
+	unsigned char header[14 + 108] = {};
+	header[0] = 'B';
+	header[1] = 'M';
+	WriteLittleEndianUInt(&header[2], (unsigned)(pixelOffset + paddedRowSize * height));
+	WriteLittleEndianUInt(&header[10], pixelOffset);
+
+	unsigned char* info = &header[14];
+	WriteLittleEndianUInt(&info[0], infoSize);
+	WriteLittleEndianUInt(&info[4], width);
+	WriteLittleEndianUInt(&info[8], height);
+	WriteLittleEndianUShort(&info[12], 1);
+	WriteLittleEndianUShort(&info[14], channels * 8);
+	WriteLittleEndianUInt(&info[16], alpha ? BI_BITFIELDS : BI_RGB);
+	WriteLittleEndianUInt(&info[20], (unsigned)(paddedRowSize * height));
+	WriteLittleEndianUInt(&info[24], 2835); // 72 DPI
+	WriteLittleEndianUInt(&info[28], 2835);
+	if (alpha)
+	{
+		WriteLittleEndianUInt(&info[40], 0x00FF0000);
+		WriteLittleEndianUInt(&info[44], 0x0000FF00);
+		WriteLittleEndianUInt(&info[48], 0x000000FF);
+		WriteLittleEndianUInt(&info[52], 0xFF000000);
+		WriteLittleEndianUInt(&info[56], 0x73524742); // 'sRGB'
+	}
+
+	if (fwrite(header, 1, pixelOffset, file) != pixelOffset)
+	{
+		return false;
+	}
+
+	RowReader rows(image);
+	std::vector<unsigned char> bgr(paddedRowSize, 0);
+
+	// Bottom-up, as most readers expect
+	for (unsigned i = 0; i < height; ++i)
+	{
+		const unsigned char* row = rows.Get(height - 1 - i);
+		for (unsigned x = 0; x < width; ++x)
+		{
+			const unsigned char* s = &row[x * channels];
+			unsigned char* d = &bgr[x * channels];
+			d[0] = s[2];
+			d[1] = s[1];
+			d[2] = s[0];
+			if (alpha)
+			{
+				d[3] = s[3];
+			}
+		}
+
+		if (fwrite(&bgr[0], 1, paddedRowSize, file) != paddedRowSize)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+//
+// TGA
+//
+
+bool ReadTga(FileReader& reader, Image& image, ImageLayout imageLayout)
+{
+	unsigned char header[18];
+	if (!reader.Read(header, sizeof(header)))
+	{
+		return false;
+	}
+
+	const unsigned idLength = header[0];
+	const unsigned colorMapType = header[1];
+	const unsigned imageType = header[2];
+	const unsigned colorMapLength = ReadLittleEndianUShort(&header[5]);
+	const unsigned colorMapDepth = header[7];
+	const unsigned width = ReadLittleEndianUShort(&header[12]);
+	const unsigned height = ReadLittleEndianUShort(&header[14]);
+	const unsigned bitCount = header[16];
+	const unsigned descriptor = header[17];
+
+	const bool rle = imageType == 10 || imageType == 11;
+	const bool gray = imageType == 3 || imageType == 11;
+	if (imageType != 2 && imageType != 3 && !rle)
+	{
+		std::cerr << "Unsupported TGA image type (" << imageType << ")" << std::endl;
+		return false;
+	}
+
+	if ((gray && bitCount != 8) || (!gray && bitCount != 24 && bitCount != 32))
+	{
+		std::cerr << "Unsupported TGA bit depth (" << bitCount << ")" << std::endl;
+		return false;
+	}
+
+	if (descriptor & 0x10)
+	{
+		std::cerr << "Right-to-left TGA files are not supported." << std::endl;
+		return false;
+	}
+
+	if (!CheckImageDimensions(width, height, "TGA"))
+	{
+		return false;
+	}
+
+	size_t skip = idLength;
+	if (colorMapType == 1)
+	{
+		skip += colorMapLength * ((colorMapDepth + 7) / 8);
+	}
+	if (!reader.Skip(skip))
+	{
+		return false;
+	}
+
+	const SourceLayout layout = gray ? SOURCE_GRAY : (bitCount == 32 ? SOURCE_BGRA : SOURCE_BGR);
+	if (!image.Allocate(width, height, GetDestinationFormat(layout, 1), imageLayout))
+	{
+		return false;
+	}
+
+	const bool topDown = (descriptor & 0x20) != 0;
+	const unsigned pixelSize = bitCount / 8;
+
+	ScanlineDecoder decoder(image, layout);
+
+	// RLE packets may span rows, so the packet state lives outside the row loop
+	unsigned packetRemaining = 0;
+	bool packetIsRun = false;
+	unsigned char runPixel[4] = {};
+
+	for (unsigned i = 0; i < height; ++i)
+	{
+		const unsigned y = topDown ? i : height - 1 - i;
+		unsigned char* src = decoder.BeginRow(y);
+
+		if (!rle)
+		{
+			if (!reader.Read(src, decoder.GetSourceRowSize()))
+			{
+				std::cerr << "Unexpected end of TGA data!" << std::endl;
+				return false;
+			}
+		}
+		else
+		{
+			for (unsigned x = 0; x < width; )
+			{
+				if (packetRemaining == 0)
+				{
+					int packetHeader = reader.ReadByte();
+					if (packetHeader < 0)
+					{
+						std::cerr << "Unexpected end of TGA data!" << std::endl;
+						return false;
+					}
+					packetIsRun = (packetHeader & 0x80) != 0;
+					packetRemaining = (packetHeader & 0x7F) + 1;
+					if (packetIsRun && !reader.Read(runPixel, pixelSize))
+					{
+						return false;
+					}
+				}
+
+				unsigned count = std::min(packetRemaining, width - x);
+				if (packetIsRun)
+				{
+					for (unsigned k = 0; k < count; ++k)
+					{
+						memcpy(&src[(x + k) * pixelSize], runPixel, pixelSize);
+					}
+				}
+				else if (!reader.Read(&src[x * pixelSize], count * pixelSize))
+				{
+					std::cerr << "Unexpected end of TGA data!" << std::endl;
+					return false;
+				}
+
+				x += count;
+				packetRemaining -= count;
+			}
+		}
+
+		decoder.EndRow(y);
+	}
+
+	return true;
+}
+
+bool WriteTga(FILE* file, const Image& image)
+{
+	const unsigned width = image.GetWidth();
+	const unsigned height = image.GetHeight();
+	const unsigned channels = image.GetChannelCount();
+
+	if (width > 0xFFFF || height > 0xFFFF)
+	{
+		std::cerr << "Image is too large for TGA!" << std::endl;
+		return false;
+	}
+
+	unsigned char header[18] = {};
+	header[2] = 2; // uncompressed true-colour
+	WriteLittleEndianUShort(&header[12], width);
+	WriteLittleEndianUShort(&header[14], height);
+	header[16] = (unsigned char)(channels * 8);
+	header[17] = (unsigned char)(0x20 | (channels == 4 ? 8 : 0)); // top-left origin, alpha bits
+
+	if (fwrite(header, 1, sizeof(header), file) != sizeof(header))
+	{
+		return false;
+	}
+
+	RowReader rows(image);
+	std::vector<unsigned char> bgr(width * channels);
+
+	for (unsigned y = 0; y < height; ++y)
+	{
+		const unsigned char* row = rows.Get(y);
+		for (unsigned x = 0; x < width; ++x)
+		{
+			const unsigned char* s = &row[x * channels];
+			unsigned char* d = &bgr[x * channels];
+			d[0] = s[2];
+			d[1] = s[1];
+			d[2] = s[0];
+			if (channels == 4)
+			{
+				d[3] = s[3];
+			}
+		}
+
+		if (fwrite(&bgr[0], 1, bgr.size(), file) != bgr.size())
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+//
+// PNG
+//
+
+const unsigned char PNG_SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+enum PngColorType
+{
+	PNG_GRAY = 0,
+	PNG_RGB = 2,
+	PNG_PALETTE = 3,
+	PNG_GRAY_ALPHA = 4,
+	PNG_RGBA = 6,
+};
+
+unsigned char PaethPredictor(int a, int b, int c)
+{
+	int p = a + b - c;
+	int pa = abs(p - a);
+	int pb = abs(p - b);
+	int pc = abs(p - c);
+	if (pa <= pb && pa <= pc)
+	{
+		return (unsigned char)a;
+	}
+	return (unsigned char)(pb <= pc ? b : c);
+}
+
+bool UnfilterScanline(int filter, unsigned char* row, const unsigned char* prior, size_t size, size_t bpp)
+{
+	switch (filter)
+	{
+	case 0:
+		break;
+
+	case 1:
+		for (size_t i = bpp; i < size; ++i)
+		{
+			row[i] = (unsigned char)(row[i] + row[i - bpp]);
+		}
+		break;
+
+	case 2:
+		for (size_t i = 0; i < size; ++i)
+		{
+			row[i] = (unsigned char)(row[i] + prior[i]);
+		}
+		break;
+
+	case 3:
+		for (size_t i = 0; i < bpp; ++i)
+		{
+			row[i] = (unsigned char)(row[i] + (prior[i] >> 1));
+		}
+		for (size_t i = bpp; i < size; ++i)
+		{
+			row[i] = (unsigned char)(row[i] + ((row[i - bpp] + prior[i]) >> 1));
+		}
+		break;
+
+	case 4:
+		for (size_t i = 0; i < bpp; ++i)
+		{
+			row[i] = (unsigned char)(row[i] + prior[i]);
+		}
+		for (size_t i = bpp; i < size; ++i)
+		{
+			row[i] = (unsigned char)(row[i] + PaethPredictor(row[i - bpp], prior[i], prior[i - bpp]));
+		}
+		break;
+
+	default:
+		return false;
+	}
+
+	return true;
+}
+
+// Feeds the inflater with the payload of consecutive IDAT chunks
+class PngIdatInput : public InflateInput
+{
+public:
+	PngIdatInput(FileReader& reader, size_t firstChunkSize)
+		: m_Reader(reader)
+		, m_Remaining(firstChunkSize)
+		, m_Done(false)
+	{}
+
+	virtual size_t Refill(const unsigned char** data)
+	{
+		while (m_Remaining == 0)
+		{
+			unsigned char header[12]; // CRC of the finished chunk, then the next length and type
+			if (m_Done || !m_Reader.Read(header, sizeof(header)) || memcmp(&header[8], "IDAT", 4) != 0)
+			{
+				m_Done = true;
+				return 0;
+			}
+			m_Remaining = ReadBigEndianUInt(&header[4]);
+		}
+
+		size_t size = m_Reader.Acquire(data, m_Remaining);
+		m_Remaining -= size;
+		return size;
+	}
+
+private:
+	FileReader& m_Reader;
+	size_t m_Remaining;
+	bool m_Done;
+};
+
+// Turns the inflated stream into image rows, one scanline at a time
+class PngScanlineOutput : public InflateOutput
+{
+public:
+	PngScanlineOutput(Image& image, int colorType, int bitDepth, const unsigned char (*palette)[4])
+		: m_Image(image)
+		, m_Rows(image)
+		, m_ColorType(colorType)
+		, m_BitDepth(bitDepth)
+		, m_Palette(palette)
+		, m_Y(0)
+		, m_Filled(0)
+		, m_Filter(-1)
+	{
+		static const unsigned SAMPLES[7] = { 1, 0, 3, 1, 2, 0, 4 };
+		const size_t bitsPerPixel = SAMPLES[colorType] * bitDepth;
+
+		m_Bpp = std::max<size_t>(1, bitsPerPixel / 8);
+		m_Stride = (image.GetWidth() * bitsPerPixel + 7) / 8;
+
+		// 8-bit RGB(A) is unfiltered right inside interleaved image rows. 16-bit
+		// rows are always staged, the byte swap must not touch the prior row.
+		m_Direct = image.GetLayout() == IMAGE_LAYOUT_INTERLEAVED && bitDepth == 8 &&
+			(colorType == PNG_RGB || colorType == PNG_RGBA);
+
+		m_Prior.assign(m_Stride, 0);
+		if (!m_Direct)
+		{
+			m_Current.resize(m_Stride);
+		}
+	}
+
+	virtual bool Write(const unsigned char* data, size_t size)
+	{
+		while (size > 0 && m_Y < m_Image.GetHeight())
+		{
+			if (m_Filter < 0)
+			{
+				m_Filter = *data++;
+				--size;
+				m_Target = m_Direct ? m_Image.GetRow(m_Y) : &m_Current[0];
+				continue;
+			}
+
+			size_t run = std::min(size, m_Stride - m_Filled);
+			memcpy(&m_Target[m_Filled], data, run);
+			m_Filled += run;
+			data += run;
+			size -= run;
+
+			if (m_Filled == m_Stride && !FinishRow())
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool IsComplete() const
+	{
+		return m_Y == m_Image.GetHeight();
+	}
+
+private:
+	bool FinishRow()
+	{
+		const unsigned char* prior = m_Direct && m_Y > 0 ? m_Image.GetRow(m_Y - 1) : &m_Prior[0];
+		if (!UnfilterScanline(m_Filter, m_Target, prior, m_Stride, m_Bpp))
+		{
+			std::cerr << "Invalid PNG filter type (" << m_Filter << ")" << std::endl;
+			return false;
+		}
+
+		if (!m_Direct)
+		{
+			Expand(m_Target, m_Rows.Begin(m_Y));
+			m_Rows.Commit(m_Y);
+			m_Prior.swap(m_Current);
+		}
+
+		++m_Y;
+		m_Filled = 0;
+		m_Filter = -1;
+		return true;
+	}
+
+	// Unpacks sub-byte samples and palettes into RGB(A)
+	void Expand(const unsigned char* src, unsigned char* dst) const
+	{
+		const unsigned width = m_Image.GetWidth();
+		const unsigned channels = m_Image.GetChannelCount();
+
+		static const SourceLayout LAYOUTS[7] = { SOURCE_GRAY, SOURCE_GRAY, SOURCE_RGB, SOURCE_GRAY, SOURCE_GRAY_ALPHA, SOURCE_GRAY, SOURCE_RGBA };
+		if (m_BitDepth == 16)
+		{
+			ConvertScanline16(src, LAYOUTS[m_ColorType], width, reinterpret_cast<unsigned short*>(dst), channels);
+			return;
+		}
+		if (m_BitDepth == 8 && m_ColorType != PNG_PALETTE)
+		{
+			ConvertScanline(src, LAYOUTS[m_ColorType], width, dst, channels);
+			return;
+		}
+
+		// Gray or palette at 1, 2, 4 or 8 bits per sample
+		const unsigned mask = (1u << m_BitDepth) - 1;
+		const unsigned scale = m_ColorType == PNG_GRAY ? 255 / mask : 1;
+		for (unsigned x = 0; x < width; ++x)
+		{
+			const unsigned bit = x * m_BitDepth;
+			const unsigned value = (src[bit >> 3] >> (8 - m_BitDepth - (bit & 7))) & mask;
+			unsigned char* d = &dst[x * channels];
+
+			if (m_ColorType == PNG_PALETTE)
+			{
+				memcpy(d, m_Palette[value], channels);
+			}
+			else
+			{
+				d[0] = d[1] = d[2] = (unsigned char)(value * scale);
+				if (channels == 4)
+				{
+					d[3] = 255;
+				}
+			}
+		}
+	}
+
+private:
+	Image& m_Image;
+	RowWriter m_Rows;
+	int m_ColorType;
+	int m_BitDepth;
+	const unsigned char (*m_Palette)[4];
+	size_t m_Bpp;
+	size_t m_Stride;
+	bool m_Direct;
+
+	unsigned m_Y;
+	size_t m_Filled;
+	int m_Filter;
+	unsigned char* m_Target;
+	std::vector<unsigned char> m_Prior;
+	std::vector<unsigned char> m_Current;
+};
+
+bool ReadPng(FileReader& reader, Image& image, ImageLayout imageLayout)
+{
+	unsigned char signature[8];
+	if (!reader.Read(signature, sizeof(signature)) || memcmp(signature, PNG_SIGNATURE, sizeof(signature)) != 0)
+	{
+		return false;
+	}
+
+	unsigned width = 0;
+	unsigned height = 0;
+	int bitDepth = 0;
+	int colorType = -1;
+	unsigned char palette[256][4];
+	memset(palette, 0xFF, sizeof(palette));
+	bool paletteAlpha = false;
+
+	for (;;)
+	{
+		unsigned char chunkHeader[8];
+		if (!reader.Read(chunkHeader, sizeof(chunkHeader)))
+		{
+			std::cerr << "Unexpected end of PNG data!" << std::endl;
+			return false;
+		}
+
+		const unsigned length = ReadBigEndianUInt(&chunkHeader[0]);
+		const unsigned char* type = &chunkHeader[4];
+
+		if (memcmp(type, "IHDR", 4) == 0)
+		{
+			unsigned char ihdr[13];
+			if (length != sizeof(ihdr) || !reader.Read(ihdr, sizeof(ihdr)) || !reader.Skip(4))
+			{
+				return false;
+			}
+
+			width = ReadBigEndianUInt(&ihdr[0]);
+			height = ReadBigEndianUInt(&ihdr[4]);
+			bitDepth = ihdr[8];
+			colorType = ihdr[9];
+
+			if (ihdr[12] != 0)
+			{
+				std::cerr << "Interlaced PNG files are not supported." << std::endl;
+				return false;
+			}
+
+			const bool lowDepthAllowed = colorType == PNG_GRAY || colorType == PNG_PALETTE;
+			const bool validDepth = bitDepth == 8 || (bitDepth == 16 && colorType != PNG_PALETTE) ||
+				(lowDepthAllowed && (bitDepth == 1 || bitDepth == 2 || bitDepth == 4));
+			if (!validDepth || colorType == 1 || colorType == 5 || colorType > PNG_RGBA || ihdr[10] != 0 || ihdr[11] != 0)
+			{
+				std::cerr << "Unsupported PNG format (colour type " << colorType << ", bit depth " << bitDepth << ")" << std::endl;
+				return false;
+			}
+			if (!CheckImageDimensions(width, height, "PNG"))
+			{
+				return false;
+			}
+		}
+		else if (memcmp(type, "PLTE", 4) == 0)
+		{
+			unsigned char entries[768];
+			if (length > sizeof(entries) || length % 3 != 0 || !reader.Read(entries, length) || !reader.Skip(4))
+			{
+				return false;
+			}
+			for (unsigned i = 0; i < length / 3; ++i)
+			{
+				memcpy(palette[i], &entries[i * 3], 3);
+			}
+		}
+		else if (memcmp(type, "tRNS", 4) == 0 && colorType == PNG_PALETTE)
+		{
+			unsigned char alpha[256];
+			if (length > sizeof(alpha) || !reader.Read(alpha, length) || !reader.Skip(4))
+			{
+				return false;
+			}
+			for (unsigned i = 0; i < length; ++i)
+			{
+				palette[i][3] = alpha[i];
+			}
+			paletteAlpha = true;
+		}
+		else if (memcmp(type, "IDAT", 4) == 0)
+		{
+			if (colorType < 0)
+			{
+				std::cerr << "PNG image data before the header!" << std::endl;
+				return false;
+			}
+
+			const bool alpha = colorType == PNG_GRAY_ALPHA || colorType == PNG_RGBA || paletteAlpha;
+			const SourceLayout layout = alpha ? SOURCE_RGBA : SOURCE_RGB;
+			if (!image.Allocate(width, height, GetDestinationFormat(layout, bitDepth == 16 ? 2 : 1), imageLayout))
+			{
+				return false;
+			}
+
+			PngIdatInput input(reader, length);
+			PngScanlineOutput output(image, colorType, bitDepth, palette);
+			if (!InflateZlib(input, output) || !output.IsComplete())
+			{
+				std::cerr << "Corrupt PNG image data!" << std::endl;
+				return false;
+			}
+
+			// Whatever follows the image data is of no interest
+			return true;
+		}
+		else if (memcmp(type, "IEND", 4) == 0)
+		{
+			std::cerr << "PNG file has no image data!" << std::endl;
+			return false;
+		}
+		else if (!reader.Skip(length + 4))
+		{
+			return false;
+		}
+	}
+}
+
+// Streams the body of a single IDAT chunk made of stored deflate blocks
+class PngStoredIdatWriter
+{
+public:
+	PngStoredIdatWriter(FILE* file, size_t dataSize)
+		: m_File(file)
+		, m_Remaining(dataSize)
+		, m_BlockRemaining(0)
+		, m_Crc(0)
+		, m_Adler(1)
+	{}
+
+	bool Begin()
+	{
+		unsigned char header[8];
+		WriteBigEndianUInt(&header[0], (unsigned)GetStoredZlibStreamSize(m_Remaining));
+		memcpy(&header[4], "IDAT", 4);
+
+		const unsigned char zlibHeader[2] = { 0x78, 0x01 };
+		return fwrite(header, 1, sizeof(header), m_File) == sizeof(header) &&
+			Emit(&header[4], 4, false) && Emit(zlibHeader, sizeof(zlibHeader), true);
+	}
+
+	bool Write(const unsigned char* data, size_t size)
+	{
+		m_Adler = UpdateAdler32(m_Adler, data, size);
+
+		while (size > 0)
+		{
+			if (m_BlockRemaining == 0 && !BeginBlock())
+			{
+				return false;
+			}
+
+			size_t run = std::min(size, m_BlockRemaining);
+			if (!Emit(data, run, true))
+			{
+				return false;
+			}
+			data += run;
+			size -= run;
+			m_BlockRemaining -= run;
+			m_Remaining -= run;
+		}
+		return true;
+	}
+
+	bool End()
+	{
+		unsigned char trailer[8];
+		WriteBigEndianUInt(&trailer[0], m_Adler);
+		if (!Emit(trailer, 4, true))
+		{
+			return false;
+		}
+
+		WriteBigEndianUInt(&trailer[4], m_Crc);
+		return fwrite(&trailer[4], 1, 4, m_File) == 4;
+	}
+
+private:
+	bool BeginBlock()
+	{
+		const size_t blockSize = std::min(m_Remaining, MAX_STORED_BLOCK_SIZE);
+		const bool final = blockSize == m_Remaining;
+
+		unsigned char header[5];
+		header[0] = final ? 1 : 0;
+		WriteLittleEndianUShort(&header[1], (unsigned)blockSize);
+		WriteLittleEndianUShort(&header[3], (unsigned)(blockSize ^ 0xFFFF));
+
+		m_BlockRemaining = blockSize;
+		return Emit(header, sizeof(header), true);
+	}
+
+	bool Emit(const void* data, size_t size, bool write)
+	{
+		m_Crc = UpdateCrc32(m_Crc, data, size);
+		return !write || fwrite(data, 1, size, m_File) == size;
+	}
+
+	FILE* m_File;
+	size_t m_Remaining;
+	size_t m_BlockRemaining;
+	unsigned int m_Crc;
+	unsigned int m_Adler;
+};
+
+bool WritePngChunk(FILE* file, const char* type, const unsigned char* data, unsigned length)
+{
+	unsigned char header[8];
+	WriteBigEndianUInt(&header[0], length);
+	memcpy(&header[4], type, 4);
+
+	unsigned char crc[4];
+	WriteBigEndianUInt(crc, UpdateCrc32(UpdateCrc32(0, type, 4), data, length));
+
+	// IEND has no data to write
+	return fwrite(header, 1, sizeof(header), file) == sizeof(header) &&
+		(length == 0 || fwrite(data, 1, length, file) == length) &&
+		fwrite(crc, 1, sizeof(crc), file) == sizeof(crc);
+}
+
+bool WritePng(FILE* file, const Image& image)
+{
+	const unsigned width = image.GetWidth();
+	const unsigned height = image.GetHeight();
+	const size_t rowSize = width * image.GetPixelSize();
+	const bool wide = GetBytesPerChannel(image.GetFormat()) == 2;
+
+	unsigned char ihdr[13] = {};
+	WriteBigEndianUInt(&ihdr[0], width);
+	WriteBigEndianUInt(&ihdr[4], height);
+	ihdr[8] = wide ? 16 : 8;
+	ihdr[9] = (unsigned char)(image.GetChannelCount() == 4 ? PNG_RGBA : PNG_RGB);
+
+	if (fwrite(PNG_SIGNATURE, 1, sizeof(PNG_SIGNATURE), file) != sizeof(PNG_SIGNATURE) ||
+		!WritePngChunk(file, "IHDR", ihdr, sizeof(ihdr)))
+	{
+		return false;
+	}
+
+	PngStoredIdatWriter idat(file, (1 + rowSize) * height);
+	if (!idat.Begin())
+	{
+		return false;
+	}
+
+	RowReader rows(image);
+	std::vector<unsigned char> swapped(wide ? rowSize : 0);
+	const unsigned char filterNone = 0;
+	for (unsigned y = 0; y < height; ++y)
+	{
+		const unsigned char* row = rows.Get(y);
+		if (wide)
+		{
+			StoreBigEndianSamples(row, rowSize / 2, &swapped[0]);
+			row = &swapped[0];
+		}
+
+		if (!idat.Write(&filterNone, 1) || !idat.Write(row, rowSize))
+		{
+			return false;
+		}
+	}
+
+	return idat.End() && WritePngChunk(file, "IEND", nullptr, 0);
+}
+
+} // namespace
+
+ImageFileType GetImageFileTypeFromPath(const PathChar* path)
+{
+	const std::string extension = GetPathExtension(path);
+
+	if (extension == "ppm" || extension == "pgm" || extension == "pnm" || extension == "pam")
+	{
+		return IMAGE_FILE_PNM;
+	}
+	if (extension == "bmp")
+	{
+		return IMAGE_FILE_BMP;
+	}
+	if (extension == "tga")
+	{
+		return IMAGE_FILE_TGA;
+	}
+	if (extension == "png")
+	{
+		return IMAGE_FILE_PNG;
+	}
+	return IMAGE_FILE_UNKNOWN;
+}
+
+bool ReadImage(const PathChar* path, Image& image, ImageLayout layout)
+{
+	StageTimer timer(PIPELINE_STAGE_DECODE);
+	FileHandle file(OpenNativeFile(path, "rb"));
+	if (!file.Get())
+	{
+		std::cerr << "Unable to open file: " << NarrowPath(path) << std::endl;
+		return false;
+	}
+
+	// Sniff the format from the first bytes, then start over
+	unsigned char magic[2] = {};
+	size_t magicSize = fread(magic, 1, sizeof(magic), file.Get());
+	if (fseek(file.Get(), 0, SEEK_SET) != 0)
+	{
+		return false;
+	}
+
+	FileReader reader(file.Get());
+	bool ok = false;
+
+	if (magicSize == 2 && magic[0] == 'P' && magic[1] >= '1' && magic[1] <= '7')
+	{
+		ok = ReadPnm(reader, image, layout);
+	}
+	else if (magicSize == 2 && magic[0] == 'B' && magic[1] == 'M')
+	{
+		ok = ReadBmp(reader, image, layout);
+	}
+	else if (magicSize == 2 && magic[0] == PNG_SIGNATURE[0] && magic[1] == PNG_SIGNATURE[1])
+	{
+		ok = ReadPng(reader, image, layout);
+	}
+	else if (GetImageFileTypeFromPath(path) == IMAGE_FILE_TGA)
+	{
+		// TGA has no magic number
+		ok = ReadTga(reader, image, layout);
+	}
+	else
+	{
+		std::cerr << "Unrecognized image format: " << NarrowPath(path) << std::endl;
+		return false;
+	}
+
+	if (!ok)
+	{
+		std::cerr << "Unable to decode image: " << NarrowPath(path) << std::endl;
+	}
+	AddPipelineCount(PIPELINE_COUNTER_BYTES_READ, (unsigned long long)ftell(file.Get()));
+	return ok;
+}
+
+bool WriteImage(const PathChar* path, const Image& image)
+{
+	const ImageFileType type = GetImageFileTypeFromPath(path);
+	if (type == IMAGE_FILE_UNKNOWN)
+	{
+		std::cerr << "Unknown output image format: " << NarrowPath(path) << std::endl;
+		return false;
+	}
+
+	if (image.GetFormat() == IMAGE_FORMAT_RGBA16F)
+	{
+		std::cerr << "None of the image file formats can store half-float pixels." << std::endl;
+		return false;
+	}
+	if (GetBytesPerChannel(image.GetFormat()) != 1 && (type == IMAGE_FILE_BMP || type == IMAGE_FILE_TGA))
+	{
+		std::cerr << "BMP and TGA files can only store 8-bit images." << std::endl;
+		return false;
+	}
+
+	StageTimer timer(PIPELINE_STAGE_ENCODE);
+	FileHandle file(OpenNativeFile(path, "wb"));
+	if (!file.Get())
+	{
+		std::cerr << "Unable to create file: " << NarrowPath(path) << std::endl;
+		return false;
+	}
+
+	bool ok = false;
+	switch (type)
+	{
+	case IMAGE_FILE_PNM: ok = WritePnm(file.Get(), image, GetPathExtension(path) == "pam"); break;
+	case IMAGE_FILE_BMP: ok = WriteBmp(file.Get(), image); break;
+	case IMAGE_FILE_TGA: ok = WriteTga(file.Get(), image); break;
+	case IMAGE_FILE_PNG: ok = WritePng(file.Get(), image); break;
+	default: break;
+	}
+
+	const long written = ftell(file.Get());
+	if (!file.Close() || !ok)
+	{
+		std::cerr << "Unable to write image: " << NarrowPath(path) << std::endl;
+		return false;
+	}
+	AddPipelineCount(PIPELINE_COUNTER_BYTES_WRITTEN, (unsigned long long)written);
+	return true;
+}
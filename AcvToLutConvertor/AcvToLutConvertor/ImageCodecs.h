@@ -0,0 +1,40 @@
+#pragma once
+
+#include "Platform.h"
+#include "Image.h"
+
+//
+// Dependency-free readers and writers for the image formats used for headless
+// grading. Scanlines are decoded straight into the destination Image, so the
+// only pixel buffer is the one the apply engine works on.
+//
+//  PPM/PGM/PAM   binary P5, P6 and P7 (GRAYSCALE, RGB and their _ALPHA variants),
+//                8 or 16 bits per sample
+//  BMP           24-bit and 32-bit, BI_RGB or BI_BITFIELDS, either row order
+//  TGA           true-colour and greyscale, raw or RLE
+//  PNG           any non-interlaced image, stored or deflate compressed
+//
+// 16-bit files decode to RGB16/RGBA16 images and those are written back at 16
+// bits (PNG and PNM only). Half-float images have no file format here.
+//
+// PNG files are written with stored deflate blocks - the fastest possible
+// encoding, at the cost of file size.
+//
+
+enum ImageFileType
+{
+	IMAGE_FILE_UNKNOWN,
+	IMAGE_FILE_PNM,
+	IMAGE_FILE_BMP,
+	IMAGE_FILE_TGA,
+	IMAGE_FILE_PNG,
+};
+
+// Guesses the file type from the extension (used when writing)
+ImageFileType GetImageFileTypeFromPath(const PathChar* path);
+
+// Reads any of the supported formats, detected from the file contents
+bool ReadImage(const PathChar* path, Image& image, ImageLayout layout);
+
+// Writes in the format implied by the extension
+bool WriteImage(const PathChar* path, const Image& image);
@@ -0,0 +1,176 @@
+#include "LazyLut3D.h"
+#include "Half.h"
+#include "PipelineStats.h"
+#include <cassert>
+
+namespace
+{
+
+float LoadSample(const unsigned char* row, ImageFormat format, size_t index)
+{
+	const unsigned short* row16 = reinterpret_cast<const unsigned short*>(row);
+	if (format == IMAGE_FORMAT_RGBA16F)
+	{
+		return HalfToFloat(row16[index]);
+	}
+	if (GetBytesPerChannel(format) == 1)
+	{
+		return (float)row[index] * (1.0f / 255.0f);
+	}
+	return (float)row16[index] * (1.0f / 65535.0f);
+}
+
+// Rounded and clamped like the apply kernels store samples
+void StoreSample(unsigned char* row, ImageFormat format, size_t index, float value)
+{
+	unsigned short* row16 = reinterpret_cast<unsigned short*>(row);
+	if (format == IMAGE_FORMAT_RGBA16F)
+	{
+		row16[index] = FloatToHalf(value);
+		return;
+	}
+
+	const float maximum = GetBytesPerChannel(format) == 1 ? 255.0f : 65535.0f;
+	const float scaled = value * maximum + 0.5f;
+	const unsigned level = scaled <= 0.0f ? 0 : (scaled >= maximum ? (unsigned)maximum : (unsigned)scaled);
+	if (GetBytesPerChannel(format) == 1)
+	{
+		row[index] = (unsigned char)level;
+	}
+	else
+	{
+		row16[index] = (unsigned short)level;
+	}
+}
+
+} // namespace
+
+LazyLut3D::LazyLut3D(const LutChain& chain, size_t size, const LutShaper* shaper)
+	: m_Chain(chain)
+	, m_Size(size)
+	, m_Separable(chain.IsSeparable())
+	, m_Texels(new LazyTexel[size * size * size])
+	, m_ReadyWords((size * size * size + 63) / 64)
+{
+	assert(size >= 2);
+	if (shaper)
+	{
+		m_Shaper = *shaper;
+	}
+	shaper = &m_Shaper;
+
+	// The same lattice inputs as LutChain::Bake, so that points match it
+	m_Lattice.resize(size);
+	if (m_Separable)
+	{
+		for (size_t i = 0; i < size; ++i)
+		{
+			m_Lattice[i] = shaper->Inverse((float)i / (float)(size - 1));
+		}
+		for (int c = 0; c < 3; ++c)
+		{
+			m_Tables[c].resize(size);
+			chain.EvaluateSeparable(c, &m_Lattice[0], &m_Tables[c][0], size);
+		}
+	}
+	else
+	{
+		const float scale = 1.0f / (float)(size - 1);
+		for (size_t i = 0; i < size; ++i)
+		{
+			m_Lattice[i] = shaper->Inverse(i * scale);
+		}
+	}
+
+	m_Ready.reset(new std::atomic<unsigned long long>[m_ReadyWords]);
+	for (size_t i = 0; i < m_ReadyWords; ++i)
+	{
+		m_Ready[i].store(0, std::memory_order_relaxed);
+	}
+}
+
+const LazyTexel& LazyLut3D::GetTexel(size_t r, size_t g, size_t b) const
+{
+	const size_t index = (b * m_Size + g) * m_Size + r;
+	std::atomic<unsigned long long>& word = m_Ready[index / 64];
+	const unsigned long long bit = 1ull << (index % 64);
+
+	LazyTexel& texel = m_Texels[index];
+	if (!(word.load(std::memory_order_acquire) & bit))
+	{
+		Evaluate(r, g, b, texel);
+		word.fetch_or(bit, std::memory_order_release);
+	}
+	return texel;
+}
+
+void LazyLut3D::Evaluate(size_t r, size_t g, size_t b, LazyTexel& texel) const
+{
+	float out[3];
+	if (m_Separable)
+	{
+		out[0] = m_Tables[0][r];
+		out[1] = m_Tables[1][g];
+		out[2] = m_Tables[2][b];
+	}
+	else
+	{
+		const float in[3] = { m_Lattice[r], m_Lattice[g], m_Lattice[b] };
+		m_Chain.Evaluate(in, out);
+	}
+
+	for (int c = 0; c < 3; ++c)
+	{
+		texel.Rgb[c].store(out[c], std::memory_order_relaxed);
+	}
+}
+
+void LazyLut3D::Apply(Image& image, LutFilter filter) const
+{
+	assert(image.GetLayout() == IMAGE_LAYOUT_INTERLEAVED && "Lazy cubes grade interleaved images only!");
+	StageTimer timer(PIPELINE_STAGE_APPLY);
+
+	const ImageFormat format = image.GetFormat();
+	const unsigned channels = image.GetChannelCount();
+	const bool shaped = !m_Shaper.IsIdentity();
+	for (unsigned y = 0; y < image.GetHeight(); ++y)
+	{
+		unsigned char* row = image.GetRow(y);
+		for (size_t pixel = 0; pixel < (size_t)image.GetWidth() * channels; pixel += channels)
+		{
+			float color[3];
+			for (int c = 0; c < 3; ++c)
+			{
+				const float value = LoadSample(row, format, pixel + c);
+				color[c] = shaped ? m_Shaper.Forward(value) : value;
+			}
+
+			if (filter == LUT_FILTER_D3D11)
+			{
+				SampleD3D11(color[0], color[1], color[2], color);
+			}
+			else
+			{
+				Sample(color[0], color[1], color[2], color);
+			}
+
+			for (int c = 0; c < 3; ++c)
+			{
+				StoreSample(row, format, pixel + c, color[c]);
+			}
+		}
+	}
+}
+
+size_t LazyLut3D::GetEvaluatedCount() const
+{
+	size_t count = 0;
+	for (size_t i = 0; i < m_ReadyWords; ++i)
+	{
+		for (unsigned long long word = m_Ready[i].load(std::memory_order_relaxed); word; word &= word - 1)
+		{
+			++count;
+		}
+	}
+	return count;
+}
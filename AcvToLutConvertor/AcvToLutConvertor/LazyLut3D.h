@@ -0,0 +1,87 @@
+#pragma once
+
+#include "LutChain.h"
+#include "LutShaper.h"
+#include "Image.h"
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <cstddef>
+
+// A lattice point of a LazyLut3D. The channels are atomics so that threads
+// filling in the same point race on nothing but equal values; relaxed loads
+// and stores of them are plain moves.
+struct LazyTexel
+{
+	float operator[](int channel) const { return Rgb[channel].load(std::memory_order_relaxed); }
+
+	std::atomic<float> Rgb[3];
+};
+
+//
+// A cube whose lattice points are worked out the first time they are read,
+// for large cubes sampled at random, where an image touches a small part of
+// the lattice. Points hold what LutChain::Bake would put there, to the bit:
+// separable chains read them from channel tables built up front, the others
+// run their coordinates through the chain.
+//
+// A bitmap tracks the points that are ready. Readers never lock: a point is
+// stored, then its bit is set with release ordering, and a reader that sees
+// the bit with acquire ordering sees the point. Two threads missing the same
+// point both compute it and store the same value.
+//
+// Samples like Lut3D, through SampleCube and SampleCubeD3D11, so a lazy cube
+// gives what the baked one gives.
+//
+// The apply command grades through a lazy cube when the image would reach a
+// small part of the cube (see IsWorthLazyCube), or with --lazy.
+//
+class LazyLut3D
+{
+public:
+	LazyLut3D(const LutChain& chain, size_t size, const LutShaper* shaper = nullptr);
+
+	size_t GetSize() const { return m_Size; }
+
+	const LazyTexel& GetTexel(size_t r, size_t g, size_t b) const;
+
+	void Sample(float r, float g, float b, float out[3]) const { SampleCube(*this, r, g, b, out); }
+	void SampleD3D11(float r, float g, float b, float out[3]) const { SampleCubeD3D11(*this, r, g, b, out); }
+
+	// Grades an interleaved image pixel by pixel, behind the shaper the cube
+	// was made with: trilinear for LUT_FILTER_EXACT, or the viewer's sampler.
+	// Alpha is left alone.
+	void Apply(Image& image, LutFilter filter) const;
+
+	// Lattice points worked out so far
+	size_t GetEvaluatedCount() const;
+
+private:
+	LazyLut3D(const LazyLut3D&);
+	LazyLut3D& operator=(const LazyLut3D&);
+
+	void Evaluate(size_t r, size_t g, size_t b, LazyTexel& texel) const;
+
+	LutChain m_Chain;
+	LutShaper m_Shaper;
+	size_t m_Size;
+	bool m_Separable;
+
+	// Channel tables of separable chains, or the input each lattice index
+	// stands for
+	std::vector<float> m_Tables[3];
+	std::vector<float> m_Lattice;
+
+	std::unique_ptr<LazyTexel[]> m_Texels;
+	std::unique_ptr<std::atomic<unsigned long long>[]> m_Ready;
+	size_t m_ReadyWords;
+};
+
+// True when grading pixelCount pixels would reach too little of a cube of
+// size for baking all of it to pay: it has more than twice as many lattice
+// points as the image has pixels. Sampling a lazy cube costs several times
+// what the apply kernels do per pixel, so it only wins on large cubes.
+inline bool IsWorthLazyCube(size_t size, size_t pixelCount)
+{
+	return size * size * size > 2 * pixelCount;
+}
@@ -0,0 +1,542 @@
+#include "LocalSocket.h"
+#include "Platform.h"
+#include "Stopwatch.h"
+#include <iostream>
+#include <string>
+#include <cstdio>
+#include <cstring>
+#include <cassert>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <winsock2.h>
+#include <io.h>
+#pragma comment(lib, "ws2_32.lib")
+#else
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+namespace
+{
+
+#ifdef _WIN32
+
+// What afunix.h declares, which older SDKs lack
+struct sockaddr_un
+{
+	ADDRESS_FAMILY sun_family;
+	char sun_path[108];
+};
+
+const LocalSocket::Handle INVALID_HANDLE = INVALID_SOCKET;
+
+typedef WSAPOLLFD PollEntry;
+
+bool StartWinsock()
+{
+	WSADATA data;
+	if (WSAStartup(MAKEWORD(2, 2), &data) != 0)
+	{
+		std::cerr << "Unable to start Winsock." << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// Once, whichever thread opens the first socket
+bool StartSockets()
+{
+	static const bool started = StartWinsock();
+	return started;
+}
+
+void CloseSocket(LocalSocket::Handle handle)
+{
+	closesocket(handle);
+}
+
+void RemoveSocketFile(const char* path)
+{
+	_wunlink(WidenPath(path).c_str());
+}
+
+int LastError()
+{
+	return WSAGetLastError();
+}
+
+bool Interrupted()
+{
+	return false;
+}
+
+// A timeout of -1 waits for as long as it takes
+int PollSockets(PollEntry* entries, size_t count, int timeout)
+{
+	return WSAPoll(entries, (ULONG)count, timeout);
+}
+
+#else
+
+const LocalSocket::Handle INVALID_HANDLE = -1;
+
+typedef pollfd PollEntry;
+
+bool StartSockets()
+{
+	return true;
+}
+
+void CloseSocket(LocalSocket::Handle handle)
+{
+	close(handle);
+}
+
+void RemoveSocketFile(const char* path)
+{
+	unlink(path);
+}
+
+int LastError()
+{
+	return errno;
+}
+
+bool Interrupted()
+{
+	return errno == EINTR;
+}
+
+// A timeout of -1 waits for as long as it takes
+int PollSockets(PollEntry* entries, size_t count, int timeout)
+{
+	return poll(entries, (nfds_t)count, timeout);
+}
+
+#endif
+
+#ifdef MSG_NOSIGNAL
+const int SEND_FLAGS = MSG_NOSIGNAL; // a closed peer is an error, not SIGPIPE
+#else
+const int SEND_FLAGS = 0;
+#endif
+
+#ifdef _WIN32
+
+int SendSome(LocalSocket::Handle handle, const char* bytes, int size, int descriptor)
+{
+	assert(descriptor < 0 && "Windows sockets cannot pass descriptors!");
+	(void)descriptor;
+	return send(handle, bytes, size, SEND_FLAGS);
+}
+
+int ReceiveSome(LocalSocket::Handle handle, char* bytes, int size, int&)
+{
+	return recv(handle, bytes, size, 0);
+}
+
+void CloseDescriptor(int)
+{}
+
+#else
+
+#ifdef MSG_CMSG_CLOEXEC
+const int RECEIVE_FLAGS = MSG_CMSG_CLOEXEC;
+#else
+const int RECEIVE_FLAGS = 0;
+#endif
+
+// Room for a few descriptors in one message; the kernel closes any more
+union DescriptorControl
+{
+	cmsghdr Header;
+	char Space[CMSG_SPACE(sizeof(int) * 4)];
+};
+
+int SendSome(LocalSocket::Handle handle, const char* bytes, int size, int descriptor)
+{
+	if (descriptor < 0)
+	{
+		return (int)send(handle, bytes, size, SEND_FLAGS);
+	}
+
+	iovec vector;
+	vector.iov_base = const_cast<char*>(bytes);
+	vector.iov_len = (size_t)size;
+	DescriptorControl control;
+	memset(&control, 0, sizeof(control));
+	msghdr message;
+	memset(&message, 0, sizeof(message));
+	message.msg_iov = &vector;
+	message.msg_iovlen = 1;
+	message.msg_control = control.Space;
+	message.msg_controllen = CMSG_SPACE(sizeof(int));
+
+	cmsghdr* header = CMSG_FIRSTHDR(&message);
+	header->cmsg_level = SOL_SOCKET;
+	header->cmsg_type = SCM_RIGHTS;
+	header->cmsg_len = CMSG_LEN(sizeof(int));
+	memcpy(CMSG_DATA(header), &descriptor, sizeof(int));
+	return (int)sendmsg(handle, &message, SEND_FLAGS);
+}
+
+// Keeps the last descriptor that came with the bytes in descriptor, closing
+// the one it held and any others
+int ReceiveSome(LocalSocket::Handle handle, char* bytes, int size, int& descriptor)
+{
+	iovec vector;
+	vector.iov_base = bytes;
+	vector.iov_len = (size_t)size;
+	DescriptorControl control;
+	msghdr message;
+	memset(&message, 0, sizeof(message));
+	message.msg_iov = &vector;
+	message.msg_iovlen = 1;
+	message.msg_control = control.Space;
+	message.msg_controllen = sizeof(control.Space);
+
+	const int count = (int)recvmsg(handle, &message, RECEIVE_FLAGS);
+	if (count < 0)
+	{
+		return count;
+	}
+
+	for (cmsghdr* header = CMSG_FIRSTHDR(&message); header; header = CMSG_NXTHDR(&message, header))
+	{
+		if (header->cmsg_level != SOL_SOCKET || header->cmsg_type != SCM_RIGHTS)
+		{
+			continue;
+		}
+		const size_t received = (header->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+		for (size_t i = 0; i < received; ++i)
+		{
+			if (descriptor >= 0)
+			{
+				close(descriptor);
+			}
+			memcpy(&descriptor, CMSG_DATA(header) + i * sizeof(int), sizeof(int));
+		}
+	}
+	return count;
+}
+
+void CloseDescriptor(int descriptor)
+{
+	close(descriptor);
+}
+
+#endif
+
+bool MakeAddress(const char* path, sockaddr_un& address)
+{
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(address.sun_path))
+	{
+		std::cerr << "Socket path is too long: " << path << std::endl;
+		return false;
+	}
+	strcpy(address.sun_path, path);
+	return true;
+}
+
+} // namespace
+
+LocalSocket::LocalSocket()
+	: m_Socket(INVALID_HANDLE)
+	, m_Descriptor(-1)
+{
+	m_BoundPath[0] = '\0';
+}
+
+LocalSocket::~LocalSocket()
+{
+	Close();
+}
+
+bool LocalSocket::Listen(const char* path)
+{
+	Close();
+
+	sockaddr_un address;
+	if (!StartSockets() || !MakeAddress(path, address))
+	{
+		return false;
+	}
+
+	m_Socket = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (m_Socket == INVALID_HANDLE)
+	{
+		std::cerr << "Unable to create a socket (error " << LastError() << ")." << std::endl;
+		return false;
+	}
+
+	RemoveSocketFile(path);
+	if (bind(m_Socket, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || listen(m_Socket, 64) != 0)
+	{
+		std::cerr << "Unable to listen at " << path << " (error " << LastError() << ")." << std::endl;
+		Close();
+		return false;
+	}
+
+	strcpy(m_BoundPath, path);
+	return true;
+}
+
+bool LocalSocket::Accept(LocalSocket& connection)
+{
+	connection.Close();
+
+	Handle handle;
+	do
+	{
+		handle = accept(m_Socket, nullptr, nullptr);
+	}
+	while (handle == INVALID_HANDLE && Interrupted());
+
+	if (handle == INVALID_HANDLE)
+	{
+		std::cerr << "Unable to accept a connection (error " << LastError() << ")." << std::endl;
+		return false;
+	}
+
+	connection.m_Socket = handle;
+	return true;
+}
+
+bool LocalSocket::Connect(const char* path)
+{
+	Close();
+
+	sockaddr_un address;
+	if (!StartSockets() || !MakeAddress(path, address))
+	{
+		return false;
+	}
+
+	m_Socket = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (m_Socket == INVALID_HANDLE || connect(m_Socket, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0)
+	{
+		std::cerr << "Unable to connect to " << path << " (error " << LastError() << ")." << std::endl;
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void LocalSocket::Close()
+{
+	if (m_Socket != INVALID_HANDLE)
+	{
+		CloseSocket(m_Socket);
+		m_Socket = INVALID_HANDLE;
+	}
+	if (m_Descriptor >= 0)
+	{
+		CloseDescriptor(m_Descriptor);
+		m_Descriptor = -1;
+	}
+	if (m_BoundPath[0])
+	{
+		RemoveSocketFile(m_BoundPath);
+		m_BoundPath[0] = '\0';
+	}
+}
+
+#ifdef _WIN32
+
+// Windows has no socketpair: the pair meets at a listening socket of its own
+bool LocalSocket::CreatePair(LocalSocket& first, LocalSocket& second)
+{
+	static unsigned counter = 0;
+	wchar_t directory[MAX_PATH];
+	const DWORD length = GetTempPathW(MAX_PATH, directory);
+	if (length == 0 || length >= MAX_PATH)
+	{
+		std::cerr << "Unable to find a directory for a socket pair." << std::endl;
+		return false;
+	}
+
+	char name[64];
+	sprintf(name, "localsocket-%lu-%u", GetCurrentProcessId(), counter++);
+	const std::string path = NarrowPath(directory) + name;
+
+	LocalSocket listener;
+	if (!listener.Listen(path.c_str()) || !first.Connect(path.c_str()) || !listener.Accept(second))
+	{
+		first.Close();
+		second.Close();
+		return false;
+	}
+	return true;
+}
+
+#else
+
+bool LocalSocket::CreatePair(LocalSocket& first, LocalSocket& second)
+{
+	first.Close();
+	second.Close();
+
+	int handles[2];
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, handles) != 0)
+	{
+		std::cerr << "Unable to create a socket pair (error " << LastError() << ")." << std::endl;
+		return false;
+	}
+	first.m_Socket = handles[0];
+	second.m_Socket = handles[1];
+	return true;
+}
+
+#endif
+
+bool LocalSocket::IsOpen() const
+{
+	return m_Socket != INVALID_HANDLE;
+}
+
+bool LocalSocket::Send(const void* data, size_t size)
+{
+	return Send(data, size, -1);
+}
+
+bool LocalSocket::Send(const void* data, size_t size, int descriptor)
+{
+	assert(size > 0 || descriptor < 0);
+	const char* bytes = static_cast<const char*>(data);
+	while (size > 0)
+	{
+		const int chunk = size < (1u << 30) ? (int)size : (1 << 30);
+		const int sent = SendSome(m_Socket, bytes, chunk, descriptor);
+		if (sent < 0 && Interrupted())
+		{
+			continue;
+		}
+		if (sent <= 0)
+		{
+			std::cerr << "Unable to send on a socket (error " << LastError() << ")." << std::endl;
+			return false;
+		}
+		bytes += sent;
+		size -= sent;
+		descriptor = -1; // went with the first bytes
+	}
+	return true;
+}
+
+bool LocalSocket::Receive(void* data, size_t size)
+{
+	return ReceiveWithin(data, size, nullptr);
+}
+
+bool LocalSocket::Receive(void* data, size_t size, unsigned& millisecondsLeft)
+{
+	return ReceiveWithin(data, size, &millisecondsLeft);
+}
+
+bool LocalSocket::ReceiveWithin(void* data, size_t size, unsigned* millisecondsLeft)
+{
+	char* bytes = static_cast<char*>(data);
+	size_t received = 0;
+	while (received < size)
+	{
+		if (millisecondsLeft)
+		{
+			// Only what is already there is read, so no recv outlasts the budget
+			PollEntry entry;
+			entry.fd = m_Socket;
+			entry.events = POLLIN;
+			entry.revents = 0;
+			const Stopwatch stopwatch;
+			const int found = *millisecondsLeft > 0 ? PollSockets(&entry, 1, (int)*millisecondsLeft) : 0;
+			const double elapsed = stopwatch.GetElapsedMilliseconds();
+			*millisecondsLeft = elapsed < *millisecondsLeft ? *millisecondsLeft - (unsigned)elapsed : 0;
+			if (found < 0 && Interrupted())
+			{
+				continue;
+			}
+			if (found == 0)
+			{
+				std::cerr << "Timed out receiving on a socket." << std::endl;
+				return false;
+			}
+			if (found < 0)
+			{
+				std::cerr << "Unable to wait on a socket (error " << LastError() << ")." << std::endl;
+				return false;
+			}
+		}
+
+		const size_t left = size - received;
+		const int chunk = left < (1u << 30) ? (int)left : (1 << 30);
+		const int count = ReceiveSome(m_Socket, bytes + received, chunk, m_Descriptor);
+		if (count < 0 && Interrupted())
+		{
+			continue;
+		}
+		if (count == 0 && received == 0)
+		{
+			return false;
+		}
+		if (count == 0)
+		{
+			std::cerr << "Connection closed in the middle of a receive." << std::endl;
+			return false;
+		}
+		if (count < 0)
+		{
+			std::cerr << "Unable to receive on a socket (error " << LastError() << ")." << std::endl;
+			return false;
+		}
+		received += count;
+	}
+	return true;
+}
+
+int LocalSocket::TakeDescriptor()
+{
+	const int descriptor = m_Descriptor;
+	m_Descriptor = -1;
+	return descriptor;
+}
+
+bool LocalSocket::WaitReadable(LocalSocket* const* sockets, size_t count, std::vector<size_t>& ready)
+{
+	// poll rather than select, which cannot take descriptors past FD_SETSIZE
+	std::vector<PollEntry> entries(count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		entries[i].fd = sockets[i]->m_Socket;
+		entries[i].events = POLLIN;
+		entries[i].revents = 0;
+	}
+
+	ready.clear();
+	for (;;)
+	{
+		const int found = PollSockets(&entries[0], count, -1);
+		if (found < 0 && Interrupted())
+		{
+			continue;
+		}
+		if (found <= 0)
+		{
+			std::cerr << "Unable to wait on sockets (error " << LastError() << ")." << std::endl;
+			return false;
+		}
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			if (entries[i].revents & (POLLIN | POLLHUP | POLLERR | POLLNVAL))
+			{
+				ready.push_back(i);
+			}
+		}
+		return true;
+	}
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// A stream socket in the UNIX domain, addressed by a file system path (UTF-8).
+// Windows 10 has them too, through Winsock. Sends and receives move whole
+// buffers, looping over partial transfers.
+class LocalSocket
+{
+public:
+#ifdef _WIN32
+	typedef size_t Handle; // SOCKET
+#else
+	typedef int Handle;
+#endif
+
+	LocalSocket();
+	~LocalSocket();
+
+	// Listens at path, replacing a socket file left behind by a server that
+	// did not shut down cleanly
+	bool Listen(const char* path);
+	bool Accept(LocalSocket& connection);
+	bool Connect(const char* path);
+	void Close();
+
+	// Two sockets connected to each other, for one thread to wake another
+	// blocked in WaitReadable
+	static bool CreatePair(LocalSocket& first, LocalSocket& second);
+
+	bool IsOpen() const;
+
+	bool Send(const void* data, size_t size);
+	// Same, passing a descriptor to the peer along with the bytes (SCM_RIGHTS).
+	// POSIX only; -1 sends none.
+	bool Send(const void* data, size_t size, int descriptor);
+
+	// False, quietly, when the peer closed the connection before the first byte
+	bool Receive(void* data, size_t size);
+	// Same, failing once millisecondsLeft runs out. The time spent comes off
+	// it, so one budget can cover several receives.
+	bool Receive(void* data, size_t size, unsigned& millisecondsLeft);
+
+	// The descriptor the bytes received so far came with, which the caller
+	// then owns, or -1. Only the latest is kept, others are closed.
+	int TakeDescriptor();
+
+	// Waits until some of the sockets have something to read (a connection to
+	// accept, or a closed peer) and lists their indices, false on errors
+	static bool WaitReadable(LocalSocket* const* sockets, size_t count, std::vector<size_t>& ready);
+
+private:
+	LocalSocket(const LocalSocket&);
+	LocalSocket& operator=(const LocalSocket&);
+
+	// Without a budget when millisecondsLeft is null
+	bool ReceiveWithin(void* data, size_t size, unsigned* millisecondsLeft);
+
+	Handle m_Socket;
+	int m_Descriptor; // received and not taken yet
+	char m_BoundPath[108]; // removed again when a listening socket closes
+};
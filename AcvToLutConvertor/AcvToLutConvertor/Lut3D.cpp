@@ -0,0 +1,225 @@
+#include "Lut3D.h"
+#include <cassert>
+#include <cmath>
+
+Lut3D::Lut3D()
+	: m_Size(0)
+{}
+
+Lut3D::Lut3D(size_t size)
+	: m_Size(0)
+{
+	Resize(size);
+}
+
+void Lut3D::Resize(size_t size)
+{
+	m_Size = size;
+	m_Texels.assign(size * size * size * 3, 0.0f);
+}
+
+Lut3D Lut3D::FromSeparableTables(
+	const std::vector<float>& r,
+	const std::vector<float>& g,
+	const std::vector<float>& b)
+{
+	assert(r.size() == g.size() && g.size() == b.size() && "All channels must be of the same dimension!");
+
+	const size_t cubeSize = r.size();
+	Lut3D lut(cubeSize);
+
+	for (size_t slice = 0; slice < cubeSize; ++slice)
+	{
+		for (size_t row = 0; row < cubeSize; ++row)
+		{
+			for (size_t col = 0; col < cubeSize; ++col)
+			{
+				float* texel = lut.GetTexel(col, row, slice);
+				texel[0] = r[col];
+				texel[1] = g[row];
+				texel[2] = b[slice];
+			}
+		}
+	}
+
+	return lut;
+}
+
+void Lut3D::Sample(float r, float g, float b, float out[3]) const
+{
+	SampleCube(*this, r, g, b, out);
+}
+
+void Lut3D::SampleD3D11(float r, float g, float b, float out[3]) const
+{
+	SampleCubeD3D11(*this, r, g, b, out);
+}
+
+size_t Lut3D::GetBrickedOffset(size_t cell, int axis, size_t size)
+{
+	const size_t bricks = (size + 2) / 4; // per side, covering size - 1 cells
+	const size_t brickStrides[3] = { 125, 125 * bricks, 125 * bricks * bricks };
+	const size_t texelStrides[3] = { 1, 5, 25 };
+	return cell / 4 * brickStrides[axis] + cell % 4 * texelStrides[axis];
+}
+
+size_t Lut3D::GetBrickedTexelCount() const
+{
+	const size_t bricks = (m_Size + 2) / 4;
+	return bricks * bricks * bricks * 125;
+}
+
+void Lut3D::CopyBricked(std::vector<float>& texels) const
+{
+	texels.resize(GetBrickedTexelCount() * 3);
+
+	const size_t bricks = (m_Size + 2) / 4;
+	float* out = &texels[0];
+	for (size_t brick = 0; brick < bricks * bricks * bricks; ++brick)
+	{
+		const size_t first[3] = { brick % bricks * 4, brick / bricks % bricks * 4, brick / (bricks * bricks) * 4 };
+		for (size_t i = 0; i < 125; ++i)
+		{
+			// Bricks hanging over the far edges repeat the last texels
+			size_t coords[3] = { first[0] + i % 5, first[1] + i / 5 % 5, first[2] + i / 25 };
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				coords[axis] = coords[axis] < m_Size ? coords[axis] : m_Size - 1;
+			}
+
+			const float* texel = GetTexel(coords[0], coords[1], coords[2]);
+			*out++ = texel[0];
+			*out++ = texel[1];
+			*out++ = texel[2];
+		}
+	}
+}
+
+bool Lut3D::ExtractSeparableTables(
+	std::vector<float>& r,
+	std::vector<float>& g,
+	std::vector<float>& b,
+	float tolerance) const
+{
+	if (m_Size == 0)
+	{
+		return false;
+	}
+
+	for (size_t slice = 0; slice < m_Size; ++slice)
+	{
+		for (size_t row = 0; row < m_Size; ++row)
+		{
+			for (size_t col = 0; col < m_Size; ++col)
+			{
+				const float* texel = GetTexel(col, row, slice);
+				if (std::fabs(texel[0] - GetTexel(col, 0, 0)[0]) > tolerance ||
+					std::fabs(texel[1] - GetTexel(0, row, 0)[1]) > tolerance ||
+					std::fabs(texel[2] - GetTexel(0, 0, slice)[2]) > tolerance)
+				{
+					return false;
+				}
+			}
+		}
+	}
+
+	r.resize(m_Size);
+	g.resize(m_Size);
+	b.resize(m_Size);
+	for (size_t i = 0; i < m_Size; ++i)
+	{
+		r[i] = GetTexel(i, 0, 0)[0];
+		g[i] = GetTexel(0, i, 0)[1];
+		b[i] = GetTexel(0, 0, i)[2];
+	}
+
+	return true;
+}
+
+bool Lut3D::IsIdentity(float tolerance) const
+{
+	std::vector<float> tables[3];
+	if (!ExtractSeparableTables(tables[0], tables[1], tables[2]))
+	{
+		return false;
+	}
+	return IsIdentityTable(tables[0], tolerance) && IsIdentityTable(tables[1], tolerance) && IsIdentityTable(tables[2], tolerance);
+}
+
+bool IsIdentityTable(const std::vector<float>& table, float tolerance)
+{
+	if (table.size() < 2)
+	{
+		return false;
+	}
+
+	const float last = (float)(table.size() - 1);
+	const float count = (float)table.size();
+	bool spanning = true;
+	bool indexed = table.size() >= 16;
+	for (size_t i = 0; i < table.size(); ++i)
+	{
+		spanning = spanning && std::fabs(table[i] - (float)i / last) <= tolerance;
+		indexed = indexed && std::fabs(table[i] - (float)i / count) <= tolerance;
+	}
+	return spanning || indexed;
+}
+
+float SampleTable(const std::vector<float>& table, float value)
+{
+	const float scale = (float)(table.size() - 1);
+	float coord = value * scale;
+	if (!(coord > 0.0f))
+	{
+		return table.front(); // also catches NaN
+	}
+	if (coord >= scale)
+	{
+		return table.back();
+	}
+
+	size_t cell = (size_t)coord;
+	float frac = coord - (float)cell;
+	return table[cell] + (table[cell + 1] - table[cell]) * frac;
+}
+
+float SampleTableD3D11(const std::vector<float>& table, float value)
+{
+	size_t lo;
+	size_t hi;
+	unsigned weight;
+	AddressD3D11(value, table.size(), lo, hi, weight);
+
+	// The other two axes weigh 256 * 256 in total
+	unsigned sum = ToTextureLevel(table[lo]) * (256 - weight) + ToTextureLevel(table[hi]) * weight;
+	return FromD3D11Sum(sum << 16);
+}
+
+void AddressD3D11(float coord, size_t size, size_t& lo, size_t& hi, unsigned& weight)
+{
+	// Unnormalized, texel centres on whole numbers. Anything past the lattice
+	// clamps to the edge texel, so far away coordinates are pulled in first.
+	float texel = coord * (float)size - 0.5f;
+	if (!(texel > -1.0f))
+	{
+		texel = -1.0f; // also catches NaN
+	}
+	if (texel > (float)size)
+	{
+		texel = (float)size;
+	}
+
+	// 8 bits of sub-texel precision, rounded to nearest
+	long fixed = (long)std::floor(texel * 256.0f + 0.5f);
+	long first = (fixed + 512) / 256 - 2; // floor division, fixed >= -256
+	weight = (unsigned)(fixed - first * 256);
+
+	const long last = (long)size - 1;
+	long second = first + 1;
+	lo = (size_t)(first < 0 ? 0 : (first > last ? last : first));
+	hi = (size_t)(second < 0 ? 0 : (second > last ? last : second));
+	if (lo == hi)
+	{
+		weight = 0; // both taps read the same edge texel
+	}
+}
@@ -0,0 +1,203 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+
+// How the apply engine keeps a cube in memory
+enum LutLayout
+{
+	LUT_LAYOUT_AUTO,    // bricked within the limits below, linear otherwise
+	LUT_LAYOUT_LINEAR,  // Lut3D's own order
+	LUT_LAYOUT_BRICKED, // bricks of 4x4x4 cells, see Lut3D::GetBrickedOffset
+};
+
+// Lattice size the converter bakes curves at, as the viewer's shader expects
+const size_t DEFAULT_CUBE_SIZE = 16;
+
+// Smaller cubes sit in L2 as a whole and gain nothing from bricking
+const size_t BRICKED_LAYOUT_MIN_SIZE = 33;
+
+// Bricking nearly doubles the footprint; past this the bigger copy falls out
+// of the last level cache where the linear cube may still fit, and loses
+const size_t BRICKED_LAYOUT_MAX_BYTES = 16 << 20;
+
+// Volumes hold 8-bit levels, so an identity stored in one is off by up to
+// half a level
+const float IDENTITY_TOLERANCE = 0.5f / 255.0f + 1e-6f;
+
+// How lookups map inputs onto the lattice
+enum LutFilter
+{
+	LUT_FILTER_EXACT, // inputs 0 and 1 land on the first and last texels
+	LUT_FILTER_D3D11, // what the viewer's sampler does, see Lut3D::SampleD3D11
+};
+
+// In-memory 3D LUT used by the CPU apply engine. Texels are stored as RGB
+// float triples in the same order as the DDS volume: red varies fastest
+// (columns), then green (rows), then blue (slices).
+class Lut3D
+{
+public:
+	Lut3D();
+	explicit Lut3D(size_t size);
+
+	void Resize(size_t size);
+	size_t GetSize() const { return m_Size; }
+
+	float* GetTexel(size_t r, size_t g, size_t b)
+	{
+		return &m_Texels[((b * m_Size + g) * m_Size + r) * 3];
+	}
+
+	const float* GetTexel(size_t r, size_t g, size_t b) const
+	{
+		return &m_Texels[((b * m_Size + g) * m_Size + r) * 3];
+	}
+
+	// Builds the cube the converter writes out: every texel takes its red from
+	// the red table at its column, green from its row and blue from its slice
+	static Lut3D FromSeparableTables(
+		const std::vector<float>& r,
+		const std::vector<float>& g,
+		const std::vector<float>& b
+		);
+
+	// Trilinear lookup, inputs in [0, 1] map onto the first and last texels
+	void Sample(float r, float g, float b, float out[3]) const;
+
+	// The lookup PSMain does through samLinear (MIN_MAG_LINEAR_MIP_POINT,
+	// CLAMP). Texel centres sit at (i + 0.5) / size, so inputs 0 and 1 fall half
+	// a texel outside the lattice and clamp. Texels are read as the 8-bit levels
+	// the X8R8G8B8 texture holds, and blended with per-axis weights in 1/256
+	// steps like GPU filter units do, in integers.
+	void SampleD3D11(float r, float g, float b, float out[3]) const;
+
+	// Bricked layout: the cells are grouped in 4x4x4 bricks, and each brick
+	// stores the 5x5x5 texels its cells have for corners, red fastest, then
+	// green, then blue. Every cell lies inside one brick, so its eight corners
+	// sit within a few hundred bytes - usually one page - where the linear
+	// layout spreads them over two slices. The price is close to twice the
+	// memory. The first corner of cell (r, g, b) is texel
+	// GetBrickedOffset(r, 0) + GetBrickedOffset(g, 1) + GetBrickedOffset(b, 2)
+	// and the others follow at strides of 1, 5 and 25 texels.
+	static size_t GetBrickedOffset(size_t cell, int axis, size_t size);
+	size_t GetBrickedTexelCount() const;
+
+	// RGB triples in bricked order
+	void CopyBricked(std::vector<float>& texels) const;
+
+	// A cube is separable when each output channel depends only on the same
+	// input channel, as for every cube baked from curves. The per-channel
+	// tables are returned then, and trilinear sampling of the cube reduces to
+	// linear interpolation in them.
+	bool ExtractSeparableTables(
+		std::vector<float>& r,
+		std::vector<float>& g,
+		std::vector<float>& b,
+		float tolerance = 1e-6f
+		) const;
+
+	// True for a cube that passes colours through: separable, with an
+	// identity table (see IsIdentityTable) for every channel
+	bool IsIdentity(float tolerance = IDENTITY_TOLERANCE) const;
+
+private:
+	size_t m_Size;
+	std::vector<float> m_Texels;
+};
+
+// True when a 1D table spanning [0, 1] maps every value to itself: entry i
+// holds i / (size - 1), within tolerance. From 16 entries up, i / size is
+// taken as an identity too, the spacing hand-made identity volumes such as
+// Media/identity.dds were written with; on smaller tables it is a real look.
+bool IsIdentityTable(const std::vector<float>& table, float tolerance = IDENTITY_TOLERANCE);
+
+// Linear interpolation in a 1D table spanning [0, 1], clamped at both ends.
+// NaN maps to the first entry.
+float SampleTable(const std::vector<float>& table, float value);
+
+// Same, filtered like Lut3D::SampleD3D11. Gives exactly what SampleD3D11
+// gives for the channel of a separable cube.
+float SampleTableD3D11(const std::vector<float>& table, float value);
+
+// The two texels, clamped to the lattice, that the D3D11 sampler blends for a
+// coordinate in [0, 1], and the weight of the second one in 1/256 steps. NaN
+// addresses the first texel.
+void AddressD3D11(float coord, size_t size, size_t& lo, size_t& hi, unsigned& weight);
+
+// The 8-bit level a texel is stored as in the volume texture
+inline unsigned ToTextureLevel(float value)
+{
+	return value >= 1.0f ? 255 : (value <= 0.0f ? 0 : (unsigned)(value * 255.0f + 0.5f));
+}
+
+// Filter result from the sum of texel levels times their weights, the weights
+// of the eight taps adding up to 2^24
+inline float FromD3D11Sum(unsigned sum)
+{
+	return (float)((double)sum / (255.0 * 16777216.0));
+}
+
+// The lookups of Lut3D::Sample and Lut3D::SampleD3D11, for any cube with
+// GetSize() and a GetTexel(r, g, b) whose result indexes by channel, so that
+// cubes kept other ways sample to the same bits
+template <class Cube>
+void SampleCube(const Cube& cube, float r, float g, float b, float out[3])
+{
+	const size_t size = cube.GetSize();
+	const float scale = (float)(size - 1);
+	const float coords[3] = { r * scale, g * scale, b * scale };
+
+	size_t lo[3];
+	size_t hi[3];
+	float frac[3];
+	for (int i = 0; i < 3; ++i)
+	{
+		float c = coords[i] < 0.0f ? 0.0f : (coords[i] > scale ? scale : coords[i]);
+		lo[i] = (size_t)c;
+		hi[i] = lo[i] + 1 < size ? lo[i] + 1 : lo[i];
+		frac[i] = c - (float)lo[i];
+	}
+
+	for (int c = 0; c < 3; ++c)
+	{
+		float c00 = cube.GetTexel(lo[0], lo[1], lo[2])[c] * (1.0f - frac[0]) + cube.GetTexel(hi[0], lo[1], lo[2])[c] * frac[0];
+		float c10 = cube.GetTexel(lo[0], hi[1], lo[2])[c] * (1.0f - frac[0]) + cube.GetTexel(hi[0], hi[1], lo[2])[c] * frac[0];
+		float c01 = cube.GetTexel(lo[0], lo[1], hi[2])[c] * (1.0f - frac[0]) + cube.GetTexel(hi[0], lo[1], hi[2])[c] * frac[0];
+		float c11 = cube.GetTexel(lo[0], hi[1], hi[2])[c] * (1.0f - frac[0]) + cube.GetTexel(hi[0], hi[1], hi[2])[c] * frac[0];
+
+		float c0 = c00 * (1.0f - frac[1]) + c10 * frac[1];
+		float c1 = c01 * (1.0f - frac[1]) + c11 * frac[1];
+
+		out[c] = c0 * (1.0f - frac[2]) + c1 * frac[2];
+	}
+}
+
+template <class Cube>
+void SampleCubeD3D11(const Cube& cube, float r, float g, float b, float out[3])
+{
+	const float coords[3] = { r, g, b };
+
+	size_t lo[3];
+	size_t hi[3];
+	unsigned w[3];
+	for (int i = 0; i < 3; ++i)
+	{
+		AddressD3D11(coords[i], cube.GetSize(), lo[i], hi[i], w[i]);
+	}
+
+	// Each tap's weight is the product of its per-axis weights, so the eight
+	// taps add up to 256^3. Blending one axis at a time keeps that sum exact.
+	for (int c = 0; c < 3; ++c)
+	{
+		unsigned c00 = ToTextureLevel(cube.GetTexel(lo[0], lo[1], lo[2])[c]) * (256 - w[0]) + ToTextureLevel(cube.GetTexel(hi[0], lo[1], lo[2])[c]) * w[0];
+		unsigned c10 = ToTextureLevel(cube.GetTexel(lo[0], hi[1], lo[2])[c]) * (256 - w[0]) + ToTextureLevel(cube.GetTexel(hi[0], hi[1], lo[2])[c]) * w[0];
+		unsigned c01 = ToTextureLevel(cube.GetTexel(lo[0], lo[1], hi[2])[c]) * (256 - w[0]) + ToTextureLevel(cube.GetTexel(hi[0], lo[1], hi[2])[c]) * w[0];
+		unsigned c11 = ToTextureLevel(cube.GetTexel(lo[0], hi[1], hi[2])[c]) * (256 - w[0]) + ToTextureLevel(cube.GetTexel(hi[0], hi[1], hi[2])[c]) * w[0];
+
+		unsigned c0 = c00 * (256 - w[1]) + c10 * w[1];
+		unsigned c1 = c01 * (256 - w[1]) + c11 * w[1];
+
+		out[c] = FromD3D11Sum(c0 * (256 - w[2]) + c1 * w[2]);
+	}
+}
@@ -0,0 +1,632 @@
+#include "LutApplier.h"
+#include "Lut3D.h"
+#include "Image.h"
+#include "Half.h"
+#include "PipelineStats.h"
+#include <iostream>
+#include <cassert>
+#include <cstring>
+
+namespace
+{
+
+// Pixels interleaved per block on the planar paths
+const size_t PLANAR_BLOCK = 256;
+
+// Slots of the colour cache and the colours it takes before it stops taking
+// more. Images go through it a tile of rows at a time, of at least this many
+// pixels, for as long as it finds this share of a tile's pixels.
+const unsigned COLOUR_CACHE_BITS = 13;
+const size_t COLOUR_CACHE_SLOTS = (size_t)1 << COLOUR_CACHE_BITS;
+const size_t COLOUR_CACHE_LIMIT = COLOUR_CACHE_SLOTS / 2;
+const size_t COLOUR_CACHE_TILE = 65536;
+const double COLOUR_CACHE_MIN_HITS = 0.9;
+
+unsigned char ToUnorm8(float value)
+{
+	float scaled = value * 255.0f + 0.5f;
+	if (scaled <= 0.0f)
+	{
+		return 0;
+	}
+	if (scaled >= 255.0f)
+	{
+		return 255;
+	}
+	return (unsigned char)scaled;
+}
+
+unsigned short ToUnorm16(float value)
+{
+	float scaled = value * 65535.0f + 0.5f;
+	if (scaled <= 0.0f)
+	{
+		return 0;
+	}
+	if (scaled >= 65535.0f)
+	{
+		return 65535;
+	}
+	return (unsigned short)scaled;
+}
+
+// The kernel of formats an identity cube passes through
+template <size_t PixelSize>
+void CopyPixels(const LutKernelContext&, const void* src, void* dst, size_t count)
+{
+	if (src != dst)
+	{
+		memmove(dst, src, count * PixelSize);
+	}
+}
+
+const LutKernel COPY_KERNELS[] = { &CopyPixels<3>, &CopyPixels<4>, &CopyPixels<6>, &CopyPixels<8> };
+
+// The colour channels of a pixel, with the top bit set so that no key is 0
+template <class Code>
+unsigned long long MakeColourKey(const Code* pixel)
+{
+	const unsigned bits = sizeof(Code) * 8;
+	return (1ull << 63) | pixel[0] | ((unsigned long long)pixel[1] << bits) | ((unsigned long long)pixel[2] << 2 * bits);
+}
+
+} // namespace
+
+// Graded colours by their input colour, open addressing with linear probing
+class LutApplier::ColourCache
+{
+public:
+	ColourCache()
+		: m_Keys(COLOUR_CACHE_SLOTS, 0)
+		, m_Colours(3 * COLOUR_CACHE_SLOTS)
+		, m_Count(0)
+	{}
+
+	// The graded colour of the key, or null
+	const unsigned short* Find(unsigned long long key) const
+	{
+		for (size_t slot = GetSlot(key);; slot = (slot + 1) & (COLOUR_CACHE_SLOTS - 1))
+		{
+			if (m_Keys[slot] == key)
+			{
+				return &m_Colours[3 * slot];
+			}
+			if (!m_Keys[slot])
+			{
+				return nullptr;
+			}
+		}
+	}
+
+	// Colours past the limit are left out, which keeps probes short
+	void Insert(unsigned long long key, const unsigned short colour[3])
+	{
+		if (m_Count >= COLOUR_CACHE_LIMIT)
+		{
+			return;
+		}
+
+		size_t slot = GetSlot(key);
+		while (m_Keys[slot] && m_Keys[slot] != key)
+		{
+			slot = (slot + 1) & (COLOUR_CACHE_SLOTS - 1);
+		}
+		m_Count += !m_Keys[slot];
+		m_Keys[slot] = key;
+		memcpy(&m_Colours[3 * slot], colour, 3 * sizeof(unsigned short));
+	}
+
+private:
+	static size_t GetSlot(unsigned long long key)
+	{
+		return (size_t)((key * 0x9E3779B97F4A7C15ull) >> (64 - COLOUR_CACHE_BITS));
+	}
+
+	std::vector<unsigned long long> m_Keys;
+	std::vector<unsigned short> m_Colours;
+	size_t m_Count;
+};
+
+LutApplier::LutApplier(const Lut3D& lut, LutFilter filter, LutLayout layout, const LutShaper* shaper)
+	: m_Lut(lut)
+	, m_Filter(filter)
+	, m_Interpolation(LUT_INTERPOLATION_TRILINEAR)
+	, m_Transfer(LUT_TRANSFER_NONE)
+	, m_ColourCache(false)
+	, m_Context()
+	, m_Bricked(false)
+	, m_Separable(false)
+	, m_Identity(false)
+	, m_Shaped(false)
+{
+	assert(lut.GetSize() >= 2);
+	StageTimer timer(PIPELINE_STAGE_FILL);
+
+	const size_t size = lut.GetSize();
+	const size_t lastCell = size - 2;
+	const bool emulated = filter == LUT_FILTER_D3D11;
+	const bool shaped = shaper && !shaper->IsIdentity();
+	assert(!(shaped && emulated) && "The viewer's sampler has no shaper!");
+
+	m_Separable = lut.ExtractSeparableTables(m_Tables[0], m_Tables[1], m_Tables[2]);
+	m_Bricked = !m_Separable && !emulated && (layout == LUT_LAYOUT_BRICKED || (layout == LUT_LAYOUT_AUTO &&
+		size >= BRICKED_LAYOUT_MIN_SIZE && lut.GetBrickedTexelCount() * 3 * sizeof(float) <= BRICKED_LAYOUT_MAX_BYTES));
+
+	// The lattice, with its corner strides and cell starts along each axis
+	m_Context.Size = size;
+	if (m_Bricked)
+	{
+		lut.CopyBricked(m_BrickedTexels);
+		m_Context.Texels = &m_BrickedTexels[0];
+		m_Context.Strides[0] = 3;
+		m_Context.Strides[1] = 5 * 3;
+		m_Context.Strides[2] = 25 * 3;
+	}
+	else
+	{
+		m_Context.Texels = lut.GetTexel(0, 0, 0);
+		m_Context.Strides[0] = 3;
+		m_Context.Strides[1] = size * 3;
+		m_Context.Strides[2] = size * size * 3;
+	}
+
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		m_CellOffset[axis].resize(size - 1);
+		for (size_t cell = 0; cell <= lastCell; ++cell)
+		{
+			m_CellOffset[axis][cell] = (unsigned)(m_Bricked ? Lut3D::GetBrickedOffset(cell, axis, size) * 3 : cell * m_Context.Strides[axis]);
+		}
+		m_Context.CellOffsets[axis] = &m_CellOffset[axis][0];
+		m_Context.Offsets8[axis] = m_Offset[axis];
+	}
+
+	for (unsigned i = 0; i < 256; ++i)
+	{
+		const float input = (float)i / 255.0f;
+		float coord = (shaped ? shaper->Forward(input) : input) * (float)(size - 1);
+		size_t cell = (size_t)coord;
+		if (cell > lastCell)
+		{
+			cell = lastCell;
+		}
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			m_Offset[axis][i] = m_CellOffset[axis][cell];
+		}
+		m_Fraction[i] = coord - (float)cell;
+	}
+	m_Context.Fractions8 = m_Fraction;
+
+	if (emulated)
+	{
+		m_Interpolation = LUT_INTERPOLATION_D3D11;
+
+		m_Levels.resize(size * size * size * 3);
+		const float* texels = lut.GetTexel(0, 0, 0);
+		for (size_t i = 0; i < m_Levels.size(); ++i)
+		{
+			m_Levels[i] = (unsigned char)ToTextureLevel(texels[i]);
+		}
+
+		const size_t levelStrides[3] = { 3, size * 3, size * size * 3 };
+		for (unsigned i = 0; i < 256; ++i)
+		{
+			// Both taps clamped to the same edge texel become a cell with all
+			// the weight on its near or far corner
+			size_t lo;
+			size_t hi;
+			AddressD3D11((float)i / 255.0f, size, lo, hi, m_Weight[i]);
+			const size_t cell = lo <= lastCell ? lo : lastCell;
+			if (lo == hi && lo != 0)
+			{
+				m_Weight[i] = 256;
+			}
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				m_LevelOffset[axis][i] = (unsigned)(cell * levelStrides[axis]);
+			}
+		}
+
+		m_Context.Levels = &m_Levels[0];
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			m_Context.LevelStrides[axis] = levelStrides[axis];
+			m_Context.LevelOffsets8[axis] = m_LevelOffset[axis];
+		}
+		m_Context.Weights8 = m_Weight;
+	}
+
+	if (m_Separable)
+	{
+		if (!emulated)
+		{
+			m_Interpolation = LUT_INTERPOLATION_SEPARABLE;
+
+			// Untouched channels pass through exactly, not off by the 8-bit
+			// rounding of the volume
+			m_Identity = true;
+			for (int c = 0; c < 3; ++c)
+			{
+				if (!IsIdentityTable(m_Tables[c]))
+				{
+					m_Identity = false;
+					continue;
+				}
+				for (size_t i = 0; i < size; ++i)
+				{
+					m_Tables[c][i] = (float)i / (float)(size - 1);
+				}
+			}
+		}
+
+		// Composed with the shaper, the tables take inputs as they come
+		if (shaped)
+		{
+			m_Identity = false;
+			for (int c = 0; c < 3; ++c)
+			{
+				std::vector<float> composed(SHAPER_TABLE_SIZE);
+				for (size_t i = 0; i < SHAPER_TABLE_SIZE; ++i)
+				{
+					composed[i] = SampleTable(m_Tables[c], shaper->Forward((float)i / (float)(SHAPER_TABLE_SIZE - 1)));
+				}
+				m_Tables[c].swap(composed);
+			}
+		}
+
+		m_Table8.resize(3 * 256);
+		m_Table16.resize(3 * 65536);
+		m_TableHalf.resize(3 * 65536);
+
+		float (*sample)(const std::vector<float>&, float) = emulated ? SampleTableD3D11 : SampleTable;
+
+		for (int c = 0; c < 3; ++c)
+		{
+			for (unsigned i = 0; i < 256; ++i)
+			{
+				m_Table8[c * 256 + i] = ToUnorm8(sample(m_Tables[c], (float)i / 255.0f));
+			}
+
+			for (unsigned i = 0; i < 65536; ++i)
+			{
+				m_Table16[c * 65536 + i] = ToUnorm16(sample(m_Tables[c], (float)i / 65535.0f));
+				m_TableHalf[c * 65536 + i] = FloatToHalf(sample(m_Tables[c], HalfToFloat((unsigned short)i)));
+			}
+		}
+
+		m_Context.Tables = m_Tables;
+		m_Context.Codes8 = &m_Table8[0];
+		m_Context.Codes16 = &m_Table16[0];
+		m_Context.CodesHalf = &m_TableHalf[0];
+	}
+	else if (shaped)
+	{
+		m_Shaped = true;
+		m_ShapedCodes16.resize(65536);
+		m_ShapedCodesHalf.resize(65536);
+		for (unsigned i = 0; i < 65536; ++i)
+		{
+			m_ShapedCodes16[i] = ToUnorm16(shaper->Forward((float)i / 65535.0f));
+			m_ShapedCodesHalf[i] = FloatToHalf(shaper->Forward(HalfToFloat((unsigned short)i)));
+		}
+	}
+
+	SelectKernels();
+}
+
+bool LutApplier::SetInterpolation(LutInterpolation interpolation)
+{
+	if (m_Filter == LUT_FILTER_D3D11 && interpolation != LUT_INTERPOLATION_D3D11)
+	{
+		std::cerr << "The d3d11 filter has an interpolation of its own." << std::endl;
+		return false;
+	}
+	if (interpolation == LUT_INTERPOLATION_D3D11 && m_Filter != LUT_FILTER_D3D11)
+	{
+		std::cerr << "The d3d11 interpolation needs the d3d11 filter." << std::endl;
+		return false;
+	}
+	if (interpolation == LUT_INTERPOLATION_SEPARABLE && !m_Separable)
+	{
+		std::cerr << "Separable interpolation needs a separable LUT." << std::endl;
+		return false;
+	}
+
+	m_Interpolation = interpolation;
+	SelectKernels();
+	return true;
+}
+
+void LutApplier::SetTransfer(LutTransfer transfer)
+{
+	m_Transfer = transfer;
+	SelectKernels();
+}
+
+void LutApplier::SelectKernels()
+{
+	// The code tables of separable cubes hold what the d3d11 filter gives as
+	// well, and a format graded into itself reads nothing else
+	const LutInterpolation interpolation = m_Separable && m_Interpolation == LUT_INTERPOLATION_D3D11 && m_Transfer == LUT_TRANSFER_NONE ?
+		LUT_INTERPOLATION_SEPARABLE : m_Interpolation;
+
+	for (int format = IMAGE_FORMAT_RGB8; format <= IMAGE_FORMAT_RGBA16F; ++format)
+	{
+		m_Kernels[format] = PassesThrough((ImageFormat)format) ?
+			COPY_KERNELS[format] : GetLutKernel((ImageFormat)format, (ImageFormat)format, interpolation, m_Transfer);
+	}
+}
+
+bool LutApplier::PassesThrough(ImageFormat format) const
+{
+	return m_Identity && m_Interpolation == LUT_INTERPOLATION_SEPARABLE && m_Transfer == LUT_TRANSFER_NONE &&
+		format != IMAGE_FORMAT_RGBA16F;
+}
+
+void LutApplier::Apply(const void* src, ImageFormat srcFormat, void* dst, ImageFormat dstFormat, size_t count) const
+{
+	const LutKernel kernel = srcFormat == dstFormat ? m_Kernels[srcFormat] : GetLutKernel(srcFormat, dstFormat, m_Interpolation, m_Transfer);
+	RunKernel(kernel, src, srcFormat, dst, dstFormat, count);
+}
+
+void LutApplier::RunKernel(LutKernel kernel, const void* src, ImageFormat srcFormat, void* dst, ImageFormat dstFormat, size_t count) const
+{
+	if (!m_Shaped || GetBytesPerChannel(srcFormat) == 1)
+	{
+		kernel(m_Context, src, dst, count);
+		return;
+	}
+
+	// Colour codes to their shaped coordinates, alpha as it is
+	const unsigned short* codes = srcFormat == IMAGE_FORMAT_RGBA16F ? &m_ShapedCodesHalf[0] : &m_ShapedCodes16[0];
+	const size_t channels = GetChannelCount(srcFormat);
+	const size_t dstPixelSize = GetChannelCount(dstFormat) * GetBytesPerChannel(dstFormat);
+	const unsigned short* source = static_cast<const unsigned short*>(src);
+	unsigned char* target = static_cast<unsigned char*>(dst);
+
+	unsigned short block[PLANAR_BLOCK * 4];
+	for (size_t done = 0; done < count; done += PLANAR_BLOCK)
+	{
+		const size_t run = count - done < PLANAR_BLOCK ? count - done : PLANAR_BLOCK;
+		const unsigned short* pixels = source + done * channels;
+		for (size_t i = 0; i < run; ++i)
+		{
+			const unsigned short* pixel = pixels + i * channels;
+			unsigned short* shaped = block + i * channels;
+			shaped[0] = codes[pixel[0]];
+			shaped[1] = codes[pixel[1]];
+			shaped[2] = codes[pixel[2]];
+			if (channels == 4)
+			{
+				shaped[3] = pixel[3];
+			}
+		}
+
+		kernel(m_Context, block, target + done * dstPixelSize, run);
+	}
+}
+
+void LutApplier::ApplyInterleaved(unsigned char* pixels, size_t count, unsigned channels) const
+{
+	ApplyInterleaved(pixels, pixels, count, channels);
+}
+
+void LutApplier::ApplyInterleaved(const unsigned char* src, unsigned char* dst, size_t count, unsigned channels) const
+{
+	m_Kernels[channels == 4 ? IMAGE_FORMAT_RGBA8 : IMAGE_FORMAT_RGB8](m_Context, src, dst, count);
+}
+
+void LutApplier::ApplyPlanar(unsigned char* r, unsigned char* g, unsigned char* b, size_t count) const
+{
+	if (PassesThrough(IMAGE_FORMAT_RGB8))
+	{
+		return;
+	}
+
+	// Through the interleaved kernel a block at a time
+	unsigned char block[PLANAR_BLOCK * 3];
+	for (size_t done = 0; done < count; done += PLANAR_BLOCK)
+	{
+		const size_t run = count - done < PLANAR_BLOCK ? count - done : PLANAR_BLOCK;
+		for (size_t i = 0; i < run; ++i)
+		{
+			block[i * 3] = r[done + i];
+			block[i * 3 + 1] = g[done + i];
+			block[i * 3 + 2] = b[done + i];
+		}
+
+		m_Kernels[IMAGE_FORMAT_RGB8](m_Context, block, block, run);
+
+		for (size_t i = 0; i < run; ++i)
+		{
+			r[done + i] = block[i * 3];
+			g[done + i] = block[i * 3 + 1];
+			b[done + i] = block[i * 3 + 2];
+		}
+	}
+}
+
+void LutApplier::ApplyInterleaved16(const unsigned short* src, unsigned short* dst, size_t count, unsigned channels) const
+{
+	const ImageFormat format = channels == 4 ? IMAGE_FORMAT_RGBA16 : IMAGE_FORMAT_RGB16;
+	RunKernel(m_Kernels[format], src, format, dst, format, count);
+}
+
+void LutApplier::ApplyInterleavedHalf(const unsigned short* src, unsigned short* dst, size_t count) const
+{
+	RunKernel(m_Kernels[IMAGE_FORMAT_RGBA16F], src, IMAGE_FORMAT_RGBA16F, dst, IMAGE_FORMAT_RGBA16F, count);
+}
+
+void LutApplier::ApplyPlanar16(unsigned short* r, unsigned short* g, unsigned short* b, size_t count, bool half) const
+{
+	// Half planes have no format of their own; they go through RGBA16F with
+	// an alpha that is thrown away
+	const ImageFormat format = half ? IMAGE_FORMAT_RGBA16F : IMAGE_FORMAT_RGB16;
+	const size_t channels = half ? 4 : 3;
+	if (PassesThrough(format))
+	{
+		return;
+	}
+
+	unsigned short block[PLANAR_BLOCK * 4];
+	for (size_t done = 0; done < count; done += PLANAR_BLOCK)
+	{
+		const size_t run = count - done < PLANAR_BLOCK ? count - done : PLANAR_BLOCK;
+		for (size_t i = 0; i < run; ++i)
+		{
+			block[i * channels] = r[done + i];
+			block[i * channels + 1] = g[done + i];
+			block[i * channels + 2] = b[done + i];
+			if (half)
+			{
+				block[i * channels + 3] = 0x3C00;
+			}
+		}
+
+		RunKernel(m_Kernels[format], block, format, block, format, run);
+
+		for (size_t i = 0; i < run; ++i)
+		{
+			r[done + i] = block[i * channels];
+			g[done + i] = block[i * channels + 1];
+			b[done + i] = block[i * channels + 2];
+		}
+	}
+}
+
+bool LutApplier::IsWorthColourCache() const
+{
+	// Kernels that only map codes through tables are quicker than a probe
+	return !(m_Transfer == LUT_TRANSFER_NONE && m_Separable &&
+		(m_Interpolation == LUT_INTERPOLATION_SEPARABLE || m_Interpolation == LUT_INTERPOLATION_D3D11));
+}
+
+size_t LutApplier::ApplyCachedRow(unsigned char* row, ImageFormat format, size_t count, ColourCache& cache) const
+{
+	return GetBytesPerChannel(format) == 1 ?
+		ApplyCached(row, format, count, cache) : ApplyCached(reinterpret_cast<unsigned short*>(row), format, count, cache);
+}
+
+template <class Code>
+size_t LutApplier::ApplyCached(Code* pixels, ImageFormat format, size_t count, ColourCache& cache) const
+{
+	const size_t channels = GetChannelCount(format);
+	size_t hits = 0;
+
+	// Colours the cache does not have yet are graded together, a block at a
+	// time; alpha stays as it is, as grading a format into itself leaves it
+	Code block[PLANAR_BLOCK * 4];
+	size_t missed[PLANAR_BLOCK];
+	for (size_t done = 0; done < count; done += PLANAR_BLOCK)
+	{
+		const size_t run = count - done < PLANAR_BLOCK ? count - done : PLANAR_BLOCK;
+		size_t misses = 0;
+		for (size_t i = 0; i < run; ++i)
+		{
+			Code* pixel = pixels + (done + i) * channels;
+			const unsigned short* colour = cache.Find(MakeColourKey(pixel));
+			if (colour)
+			{
+				pixel[0] = (Code)colour[0];
+				pixel[1] = (Code)colour[1];
+				pixel[2] = (Code)colour[2];
+				++hits;
+				continue;
+			}
+			memcpy(block + misses * channels, pixel, channels * sizeof(Code));
+			missed[misses++] = done + i;
+		}
+		if (!misses)
+		{
+			continue;
+		}
+
+		RunKernel(m_Kernels[format], block, format, block, format, misses);
+		for (size_t i = 0; i < misses; ++i)
+		{
+			Code* pixel = pixels + missed[i] * channels;
+			const Code* graded = block + i * channels;
+			const unsigned short colour[3] = { graded[0], graded[1], graded[2] };
+			cache.Insert(MakeColourKey(pixel), colour);
+			memcpy(pixel, graded, channels * sizeof(Code));
+		}
+	}
+	return hits;
+}
+
+void LutApplier::Apply(Image& image) const
+{
+	const unsigned width = image.GetWidth();
+	const unsigned height = image.GetHeight();
+	const unsigned channels = image.GetChannelCount();
+	const ImageFormat format = image.GetFormat();
+
+	if (PassesThrough(format))
+	{
+		return;
+	}
+	StageTimer timer(PIPELINE_STAGE_APPLY);
+
+	// The first tile tries the colour cache out, and the next ones keep
+	// using it while it finds enough of their pixels. Colours an image runs
+	// into later can fill it up, so the rows left are graded without it.
+	unsigned y = 0;
+	if (m_ColourCache && image.GetLayout() == IMAGE_LAYOUT_INTERLEAVED && IsWorthColourCache())
+	{
+		ColourCache cache;
+		size_t hits = 0;
+		size_t tileHits = 0;
+		size_t tilePixels = 0;
+		while (y < height && tileHits >= tilePixels * COLOUR_CACHE_MIN_HITS)
+		{
+			tileHits = 0;
+			tilePixels = 0;
+			for (; y < height && tilePixels < COLOUR_CACHE_TILE; ++y)
+			{
+				tileHits += ApplyCachedRow(image.GetRow(y), format, width, cache);
+				tilePixels += width;
+			}
+			hits += tileHits;
+		}
+		AddPipelineCount(PIPELINE_COUNTER_COLOUR_CACHE_HITS, hits);
+		AddPipelineCount(PIPELINE_COUNTER_COLOUR_CACHE_MISSES, (size_t)y * width - hits);
+	}
+
+	for (; y < height; ++y)
+	{
+		if (image.GetLayout() == IMAGE_LAYOUT_INTERLEAVED)
+		{
+			unsigned char* row = image.GetRow(y);
+			unsigned short* row16 = reinterpret_cast<unsigned short*>(row);
+
+			switch (format)
+			{
+			case IMAGE_FORMAT_RGB8:
+			case IMAGE_FORMAT_RGBA8:
+				ApplyInterleaved(row, width, channels);
+				break;
+			case IMAGE_FORMAT_RGB16:
+			case IMAGE_FORMAT_RGBA16:
+				ApplyInterleaved16(row16, row16, width, channels);
+				break;
+			case IMAGE_FORMAT_RGBA16F:
+				ApplyInterleavedHalf(row16, row16, width);
+				break;
+			}
+		}
+		else if (GetBytesPerChannel(format) == 1)
+		{
+			ApplyPlanar(image.GetPlaneRow(0, y), image.GetPlaneRow(1, y), image.GetPlaneRow(2, y), width);
+		}
+		else
+		{
+			ApplyPlanar16(
+				reinterpret_cast<unsigned short*>(image.GetPlaneRow(0, y)),
+				reinterpret_cast<unsigned short*>(image.GetPlaneRow(1, y)),
+				reinterpret_cast<unsigned short*>(image.GetPlaneRow(2, y)),
+				width,
+				format == IMAGE_FORMAT_RGBA16F);
+		}
+	}
+}
@@ -0,0 +1,156 @@
+#pragma once
+
+#include "Lut3D.h"
+#include "LutShaper.h"
+#include "LutKernels.h"
+#include "Image.h"
+#include <vector>
+#include <cstddef>
+
+// CPU apply engine. Works on runs of pixels so callers can feed it whatever
+// tiles they have at hand - image rows, planes or mapped file windows. Every
+// run goes through one of the kernels in LutKernels.h, picked for the pixel
+// formats, the interpolation and the transfer function before the run starts.
+//
+// Separable cubes (see Lut3D::ExtractSeparableTables) skip the 3D lookup
+// altogether: every input code maps through a per-channel table, 256 entries
+// for 8-bit data and 65536 for 16-bit unorm and half-float data.
+//
+// LUT_FILTER_D3D11 reproduces what the viewer renders, sampling like
+// Lut3D::SampleD3D11 on every path, from a copy of the cube in 8-bit levels.
+//
+// Identity tables are snapped to exact ramps, and an identity cube (see
+// Lut3D::IsIdentity) leaves 8 and 16-bit unorm pixels alone: they are copied,
+// or not touched at all in place.
+//
+// Large cubes are copied into the bricked layout (see Lut3D::GetBrickedOffset)
+// for the exact filter, so the corners of a cell share a page and touch fewer
+// cache lines. Results are the same in both layouts, to the bit.
+//
+// A shaper in front of the cube (exact filter only) costs nothing on 8-bit
+// inputs, whose cell tables take it in, nor on separable cubes, whose tables
+// are composed with it. Wider inputs of other cubes map through it a block at
+// a time before the kernel runs, by way of a table per input code.
+//
+// With the colour cache on, Apply(Image&) keeps the results of colours it has
+// graded in a small hash table and copies them for pixels that repeat one,
+// which pays on screenshots, graphics and posterized images with few colours.
+// The first rows of the image decide whether it stays on for the rest.
+class LutApplier
+{
+public:
+	explicit LutApplier(const Lut3D& lut, LutFilter filter = LUT_FILTER_EXACT, LutLayout layout = LUT_LAYOUT_AUTO,
+		const LutShaper* shaper = nullptr);
+
+	bool IsSeparable() const { return m_Separable; }
+	bool IsIdentity() const { return m_Identity; }
+
+	// True when grading pixels of this format would change nothing: the cube
+	// is an identity, with the exact filter, separable interpolation and no
+	// transfer. Half floats still go through the tables, which clamp.
+	bool PassesThrough(ImageFormat format) const;
+
+	// LUT_LAYOUT_LINEAR or LUT_LAYOUT_BRICKED, as actually used
+	LutLayout GetLayout() const { return m_Bricked ? LUT_LAYOUT_BRICKED : LUT_LAYOUT_LINEAR; }
+
+	// LUT_INTERPOLATION_SEPARABLE for separable cubes, LUT_INTERPOLATION_D3D11
+	// for LUT_FILTER_D3D11 and trilinear otherwise, to start with. The exact
+	// filter can switch to nearest or tetrahedral; false for interpolations
+	// the cube or the filter does not allow.
+	bool SetInterpolation(LutInterpolation interpolation);
+	LutInterpolation GetInterpolation() const { return m_Interpolation; }
+
+	void SetTransfer(LutTransfer transfer);
+	LutTransfer GetTransfer() const { return m_Transfer; }
+
+	// Off to start with. Only interleaved images whose kernel does more than
+	// a table lookup per channel use it; results are the same to the bit.
+	void SetColourCache(bool enabled) { m_ColourCache = enabled; }
+	bool GetColourCache() const { return m_ColourCache; }
+
+	// Interleaved pixels of any format into any other, alpha carried over.
+	// src and dst may alias when the formats are the same.
+	void Apply(const void* src, ImageFormat srcFormat, void* dst, ImageFormat dstFormat, size_t count) const;
+
+	// Interleaved 8-bit pixels with 3 or 4 channels, alpha is left untouched
+	void ApplyInterleaved(unsigned char* pixels, size_t count, unsigned channels) const;
+
+	// Same, reading from src and writing to dst (which may alias), alpha is copied
+	void ApplyInterleaved(const unsigned char* src, unsigned char* dst, size_t count, unsigned channels) const;
+
+	// Separate 8-bit red, green and blue planes
+	void ApplyPlanar(unsigned char* r, unsigned char* g, unsigned char* b, size_t count) const;
+
+	// Interleaved 16-bit unorm pixels with 3 or 4 channels, src and dst may alias
+	void ApplyInterleaved16(const unsigned short* src, unsigned short* dst, size_t count, unsigned channels) const;
+
+	// Interleaved half-float RGBA pixels, src and dst may alias
+	void ApplyInterleavedHalf(const unsigned short* src, unsigned short* dst, size_t count) const;
+
+	// The whole image, in place, row by row
+	void Apply(Image& image) const;
+
+private:
+	class ColourCache;
+
+	// The kernel context points into the members
+	LutApplier(const LutApplier&);
+	LutApplier& operator=(const LutApplier&);
+
+	void SelectKernels();
+
+	// Runs a kernel, through the shaper tables first where the kernel cannot
+	// take the shaper in
+	void RunKernel(LutKernel kernel, const void* src, ImageFormat srcFormat, void* dst, ImageFormat dstFormat, size_t count) const;
+	void ApplyPlanar16(unsigned short* r, unsigned short* g, unsigned short* b, size_t count, bool half) const;
+
+	// Interleaved pixels graded in place through the colour cache, returning
+	// how many were found in it
+	size_t ApplyCachedRow(unsigned char* row, ImageFormat format, size_t count, ColourCache& cache) const;
+	template <class Code>
+	size_t ApplyCached(Code* pixels, ImageFormat format, size_t count, ColourCache& cache) const;
+	bool IsWorthColourCache() const;
+
+	const Lut3D& m_Lut;
+	LutFilter m_Filter;
+	LutInterpolation m_Interpolation;
+	LutTransfer m_Transfer;
+	bool m_ColourCache;
+
+	LutKernelContext m_Context;
+
+	// The kernel for each format graded into itself
+	LutKernel m_Kernels[IMAGE_FORMAT_RGBA16F + 1];
+
+	// Cell starts along each axis, in floats, for float inputs and for every
+	// 8-bit input value, and the position inside the cell of the latter
+	std::vector<unsigned> m_CellOffset[3];
+	unsigned m_Offset[3][256];
+	float m_Fraction[256];
+
+	// The cube in bricked order, when used
+	bool m_Bricked;
+	std::vector<float> m_BrickedTexels;
+
+	// The cube as the viewer's texture holds it, and for every 8-bit input
+	// value the cell start in it and the weight of the far cell corner in
+	// 1/256 steps, for LUT_FILTER_D3D11
+	std::vector<unsigned char> m_Levels;
+	unsigned m_LevelOffset[3][256];
+	unsigned m_Weight[256];
+
+	// Per-channel tables of separable cubes, and the same resolved for every
+	// input code, channel-major
+	bool m_Separable;
+	bool m_Identity;
+	std::vector<float> m_Tables[3];
+	std::vector<unsigned char> m_Table8;
+	std::vector<unsigned short> m_Table16;
+	std::vector<unsigned short> m_TableHalf;
+
+	// The shaped cube coordinate of every 16-bit unorm and half input code,
+	// for shaped cubes that are not separable
+	bool m_Shaped;
+	std::vector<unsigned short> m_ShapedCodes16;
+	std::vector<unsigned short> m_ShapedCodesHalf;
+};
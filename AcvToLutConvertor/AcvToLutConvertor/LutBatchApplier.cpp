@@ -0,0 +1,255 @@
+#include "LutBatchApplier.h"
+#include "LutApplier.h"
+#include "Lut3D.h"
+#include "Image.h"
+#include "Trace.h"
+#include <cassert>
+
+namespace
+{
+
+// Pixels whose cells and weights are worked out in one go
+const size_t TILE_PIXELS = 256;
+
+unsigned char ToUnorm8(float value)
+{
+	float scaled = value * 255.0f + 0.5f;
+	if (scaled <= 0.0f)
+	{
+		return 0;
+	}
+	if (scaled >= 255.0f)
+	{
+		return 255;
+	}
+	return (unsigned char)scaled;
+}
+
+// Trilinear interpolation inside the cell starting at p000, in the same order
+// as LutApplier so that the results match it exactly
+void InterpolateCell(const float* p000, size_t strideG, size_t strideB, const float fractions[3], unsigned char out[3])
+{
+	const float* p010 = p000 + strideG;
+	const float* p001 = p000 + strideB;
+	const float* p011 = p001 + strideG;
+	const float fr = fractions[0];
+	const float fg = fractions[1];
+	const float fb = fractions[2];
+
+	for (int c = 0; c < 3; ++c)
+	{
+		float c00 = p000[c] + (p000[c + 3] - p000[c]) * fr;
+		float c10 = p010[c] + (p010[c + 3] - p010[c]) * fr;
+		float c01 = p001[c] + (p001[c + 3] - p001[c]) * fr;
+		float c11 = p011[c] + (p011[c + 3] - p011[c]) * fr;
+
+		float c0 = c00 + (c10 - c00) * fg;
+		float c1 = c01 + (c11 - c01) * fg;
+
+		out[c] = ToUnorm8(c0 + (c1 - c0) * fb);
+	}
+}
+
+} // namespace
+
+LutBatchApplier::LutBatchApplier(const std::vector<const Lut3D*>& luts)
+	: m_Luts(luts)
+	, m_Tables(luts.size())
+{
+	for (size_t k = 0; k < luts.size(); ++k)
+	{
+		const Lut3D& lut = *luts[k];
+		assert(lut.GetSize() >= 2);
+
+		std::vector<float> tables[3];
+		if (lut.ExtractSeparableTables(tables[0], tables[1], tables[2]))
+		{
+			// Identity channels pass through, as in LutApplier
+			m_Tables[k].resize(3 * 256);
+			for (int c = 0; c < 3; ++c)
+			{
+				const bool identity = IsIdentityTable(tables[c]);
+				for (unsigned i = 0; i < 256; ++i)
+				{
+					m_Tables[k][c * 256 + i] = identity ? (unsigned char)i : ToUnorm8(SampleTable(tables[c], (float)i / 255.0f));
+				}
+			}
+			continue;
+		}
+
+		size_t group = 0;
+		while (group < m_Groups.size() && m_Groups[group].Size != lut.GetSize())
+		{
+			++group;
+		}
+
+		if (group == m_Groups.size())
+		{
+			SizeGroup newGroup;
+			newGroup.Size = lut.GetSize();
+
+			const size_t lastCell = newGroup.Size - 2;
+			for (unsigned i = 0; i < 256; ++i)
+			{
+				float coord = (float)i / 255.0f * (float)(newGroup.Size - 1);
+				size_t cell = (size_t)coord;
+				if (cell > lastCell)
+				{
+					cell = lastCell;
+				}
+				newGroup.Offset[i] = (unsigned)cell;
+				newGroup.Fraction[i] = coord - (float)cell;
+			}
+			m_Groups.push_back(newGroup);
+		}
+
+		m_Groups[group].Luts.push_back(k);
+	}
+}
+
+void LutBatchApplier::ApplyInterleaved(const unsigned char* src, size_t count, unsigned channels, unsigned char* const* dst) const
+{
+	TraceSpan separable("separable-luts", "batch");
+	for (size_t k = 0; k < m_Luts.size(); ++k)
+	{
+		if (m_Tables[k].empty())
+		{
+			continue;
+		}
+
+		const unsigned char* tableR = &m_Tables[k][0];
+		const unsigned char* tableG = &m_Tables[k][256];
+		const unsigned char* tableB = &m_Tables[k][512];
+		unsigned char* out = dst[k];
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			const unsigned char* s = &src[i * channels];
+			unsigned char* d = &out[i * channels];
+			d[0] = tableR[s[0]];
+			d[1] = tableG[s[1]];
+			d[2] = tableB[s[2]];
+			if (channels == 4)
+			{
+				d[3] = s[3];
+			}
+		}
+	}
+	separable.End();
+
+	for (size_t g = 0; g < m_Groups.size(); ++g)
+	{
+		TraceSpan group("size-group", "batch");
+		ApplyGroup(m_Groups[g], src, count, channels, dst);
+	}
+}
+
+void LutBatchApplier::ApplyGroup(const SizeGroup& group, const unsigned char* src, size_t count, unsigned channels, unsigned char* const* dst) const
+{
+	const size_t size = group.Size;
+	const size_t strideG = size * 3;
+	const size_t strideB = size * size * 3;
+
+	size_t cells[TILE_PIXELS];
+	float fractions[TILE_PIXELS][3];
+
+	for (size_t done = 0; done < count; done += TILE_PIXELS)
+	{
+		const size_t run = count - done < TILE_PIXELS ? count - done : TILE_PIXELS;
+
+		// Shared by every cube in the group
+		for (size_t i = 0; i < run; ++i)
+		{
+			const unsigned char* s = &src[(done + i) * channels];
+			cells[i] = ((group.Offset[s[2]] * size + group.Offset[s[1]]) * size + group.Offset[s[0]]) * 3;
+			fractions[i][0] = group.Fraction[s[0]];
+			fractions[i][1] = group.Fraction[s[1]];
+			fractions[i][2] = group.Fraction[s[2]];
+		}
+
+		for (size_t l = 0; l < group.Luts.size(); ++l)
+		{
+			const size_t k = group.Luts[l];
+			const float* texels = m_Luts[k]->GetTexel(0, 0, 0);
+			unsigned char* out = dst[k] + done * channels;
+
+			for (size_t i = 0; i < run; ++i)
+			{
+				unsigned char* d = &out[i * channels];
+				InterpolateCell(texels + cells[i], strideG, strideB, fractions[i], d);
+
+				if (channels == 4)
+				{
+					d[3] = src[(done + i) * channels + 3];
+				}
+			}
+		}
+	}
+}
+
+void LutBatchApplier::Apply(const Image& source, std::vector<Image>& outputs) const
+{
+	TraceSpan span("batch-apply", "batch");
+	const size_t lutCount = m_Luts.size();
+	outputs.resize(lutCount);
+	if (lutCount == 0)
+	{
+		return;
+	}
+
+	if (GetBytesPerChannel(source.GetFormat()) != 1)
+	{
+		// Wide formats go one LUT at a time through the regular engine
+		for (size_t k = 0; k < lutCount; ++k)
+		{
+			outputs[k] = source;
+			LutApplier(*m_Luts[k]).Apply(outputs[k]);
+		}
+		return;
+	}
+
+	const unsigned width = source.GetWidth();
+	const unsigned channels = source.GetChannelCount();
+	const bool planar = source.GetLayout() == IMAGE_LAYOUT_PLANAR;
+
+	for (size_t k = 0; k < lutCount; ++k)
+	{
+		outputs[k].Allocate(width, source.GetHeight(), source.GetFormat(), source.GetLayout());
+	}
+
+	// Planar images are graded one interleaved scanline at a time
+	std::vector<unsigned char> scratch(planar ? width * channels * (lutCount + 1) : 0);
+	std::vector<unsigned char*> rows(lutCount);
+
+	for (unsigned y = 0; y < source.GetHeight(); ++y)
+	{
+		const unsigned char* src;
+		if (planar)
+		{
+			source.LoadRow(y, &scratch[0]);
+			src = &scratch[0];
+			for (size_t k = 0; k < lutCount; ++k)
+			{
+				rows[k] = &scratch[(k + 1) * width * channels];
+			}
+		}
+		else
+		{
+			src = source.GetRow(y);
+			for (size_t k = 0; k < lutCount; ++k)
+			{
+				rows[k] = outputs[k].GetRow(y);
+			}
+		}
+
+		ApplyInterleaved(src, width, channels, &rows[0]);
+
+		if (planar)
+		{
+			for (size_t k = 0; k < lutCount; ++k)
+			{
+				outputs[k].StoreRow(y, rows[k]);
+			}
+		}
+	}
+}
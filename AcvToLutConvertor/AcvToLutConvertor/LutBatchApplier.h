@@ -0,0 +1,46 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+
+class Lut3D;
+class Image;
+
+// Grades the same pixels with many LUTs at once, e.g. to preview every look on
+// one image. Which lattice cell a pixel falls in and its trilinear weights only
+// depend on the pixel and the cube size, so they are worked out once per tile
+// and shared by every cube of that size. Separable LUTs need no weights at all
+// and go through per-channel tables.
+class LutBatchApplier
+{
+public:
+	explicit LutBatchApplier(const std::vector<const Lut3D*>& luts);
+
+	size_t GetLutCount() const { return m_Luts.size(); }
+
+	// Interleaved 8-bit pixels with 3 or 4 channels. dst[k] receives the pixels
+	// graded by LUT k, alpha copied.
+	void ApplyInterleaved(const unsigned char* src, size_t count, unsigned channels, unsigned char* const* dst) const;
+
+	// One output per LUT, each allocated like the source
+	void Apply(const Image& source, std::vector<Image>& outputs) const;
+
+private:
+	// Non-separable cubes sharing a lattice size, and the lattice cell and
+	// position inside it for every 8-bit input value at that size
+	struct SizeGroup
+	{
+		size_t Size;
+		std::vector<size_t> Luts;
+		unsigned Offset[256];
+		float Fraction[256];
+	};
+
+	void ApplyGroup(const SizeGroup& group, const unsigned char* src, size_t count, unsigned channels, unsigned char* const* dst) const;
+
+	std::vector<const Lut3D*> m_Luts;
+	std::vector<SizeGroup> m_Groups;
+
+	// 3 x 256 entry tables for each separable LUT, empty for the others
+	std::vector<std::vector<unsigned char>> m_Tables;
+};
@@ -0,0 +1,388 @@
+#include "LutBenchmark.h"
+#include "LutApplier.h"
+#include "LutChain.h"
+#include "Lut3D.h"
+#include "Image.h"
+#include "Half.h"
+#include "Stopwatch.h"
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <algorithm>
+#include <functional>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cstring>
+#endif
+
+namespace
+{
+
+const int BENCHMARK_RUNS = 5;
+
+// Pixels sampled when working out lines and pages per lookup
+const size_t FOOTPRINT_SAMPLES = 1 << 16;
+
+// Counts the cache misses of this thread through perf events, where the
+// kernel and the machine (or hypervisor) expose them
+class CacheMissCounter
+{
+public:
+	CacheMissCounter()
+		: m_File(-1)
+	{
+#ifdef __linux__
+		perf_event_attr attributes;
+		memset(&attributes, 0, sizeof(attributes));
+		attributes.size = sizeof(attributes);
+		attributes.type = PERF_TYPE_HARDWARE;
+		attributes.config = PERF_COUNT_HW_CACHE_MISSES;
+		attributes.disabled = 1;
+		attributes.exclude_kernel = 1;
+		attributes.exclude_hv = 1;
+		m_File = (int)syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0);
+#endif
+	}
+
+	~CacheMissCounter()
+	{
+#ifdef __linux__
+		if (m_File >= 0)
+		{
+			close(m_File);
+		}
+#endif
+	}
+
+	void Start()
+	{
+#ifdef __linux__
+		if (m_File >= 0)
+		{
+			ioctl(m_File, PERF_EVENT_IOC_RESET, 0);
+			ioctl(m_File, PERF_EVENT_IOC_ENABLE, 0);
+		}
+#endif
+	}
+
+	long long Stop()
+	{
+#ifdef __linux__
+		long long count = 0;
+		if (m_File >= 0)
+		{
+			ioctl(m_File, PERF_EVENT_IOC_DISABLE, 0);
+			if (read(m_File, &count, sizeof(count)) == sizeof(count))
+			{
+				return count;
+			}
+		}
+#endif
+		return -1;
+	}
+
+private:
+	CacheMissCounter(const CacheMissCounter&);
+	CacheMissCounter& operator=(const CacheMissCounter&);
+
+	int m_File;
+};
+
+BenchmarkResult TimeCase(const std::string& name, size_t pixelCount, const std::function<void()>& run, CacheMissCounter& counter)
+{
+	BenchmarkResult result = {};
+	result.Name = name;
+	result.Milliseconds = 1e30;
+
+	for (int i = 0; i < BENCHMARK_RUNS; ++i)
+	{
+		Stopwatch stopwatch;
+		counter.Start();
+		run();
+		long long misses = counter.Stop();
+		double elapsed = stopwatch.GetElapsedMilliseconds();
+
+		if (elapsed < result.Milliseconds)
+		{
+			result.Milliseconds = elapsed;
+			result.CacheMisses = misses;
+		}
+	}
+
+	result.MegapixelsPerSecond = (double)pixelCount / (result.Milliseconds * 1000.0);
+	return result;
+}
+
+// Average lines and pages covered by the eight corners of each pixel's cell,
+// for texel data starting on a page boundary. Cells are picked the way
+// LutApplier picks them for 8-bit inputs.
+void MeasureFootprint(const Image& image, size_t size, LutLayout layout, BenchmarkResult& result)
+{
+	const size_t pixelCount = (size_t)image.GetWidth() * image.GetHeight();
+	const size_t step = pixelCount / FOOTPRINT_SAMPLES + 1;
+	const size_t texelBytes = 3 * sizeof(float);
+
+	size_t cells[256];
+	for (unsigned i = 0; i < 256; ++i)
+	{
+		size_t cell = (size_t)((float)i / 255.0f * (float)(size - 1));
+		cells[i] = cell < size - 2 ? cell : size - 2;
+	}
+
+	size_t totalLines = 0;
+	size_t totalPages = 0;
+	size_t samples = 0;
+	for (size_t p = 0; p < pixelCount; p += step)
+	{
+		const unsigned channels = image.GetChannelCount();
+		const unsigned char* pixel = image.GetRow((unsigned)(p / image.GetWidth())) + p % image.GetWidth() * channels;
+		const size_t r = cells[pixel[0]];
+		const size_t g = cells[pixel[1]];
+		const size_t b = cells[pixel[2]];
+
+		size_t first;
+		size_t strides[3];
+		if (layout == LUT_LAYOUT_BRICKED)
+		{
+			first = Lut3D::GetBrickedOffset(r, 0, size) + Lut3D::GetBrickedOffset(g, 1, size) + Lut3D::GetBrickedOffset(b, 2, size);
+			strides[0] = 1;
+			strides[1] = 5;
+			strides[2] = 25;
+		}
+		else
+		{
+			first = (b * size + g) * size + r;
+			strides[0] = 1;
+			strides[1] = size;
+			strides[2] = size * size;
+		}
+
+		size_t lines[16];
+		size_t pages[16];
+		for (int k = 0; k < 8; ++k)
+		{
+			const size_t texel = first + (k & 1) * strides[0] + ((k >> 1) & 1) * strides[1] + (k >> 2) * strides[2];
+			const size_t start = texel * texelBytes;
+			const size_t end = start + texelBytes - 1;
+			lines[k * 2] = start / 64;
+			lines[k * 2 + 1] = end / 64;
+			pages[k * 2] = start / 4096;
+			pages[k * 2 + 1] = end / 4096;
+		}
+
+		std::sort(lines, lines + 16);
+		std::sort(pages, pages + 16);
+		totalLines += std::unique(lines, lines + 16) - lines;
+		totalPages += std::unique(pages, pages + 16) - pages;
+		++samples;
+	}
+
+	result.LinesPerLookup = (double)totalLines / (double)samples;
+	result.PagesPerLookup = (double)totalPages / (double)samples;
+}
+
+// Pushes colours away from their luma, so every output channel depends on
+// all three inputs
+Lut3D MakeSaturationCube(size_t size)
+{
+	Lut3D cube(size);
+	for (size_t b = 0; b < size; ++b)
+	{
+		for (size_t g = 0; g < size; ++g)
+		{
+			for (size_t r = 0; r < size; ++r)
+			{
+				const float in[3] = { (float)r / (float)(size - 1), (float)g / (float)(size - 1), (float)b / (float)(size - 1) };
+				const float luma = 0.2126f * in[0] + 0.7152f * in[1] + 0.0722f * in[2];
+
+				float* texel = cube.GetTexel(r, g, b);
+				for (int c = 0; c < 3; ++c)
+				{
+					texel[c] = std::min(std::max(luma + (in[c] - luma) * 1.25f, 0.0f), 1.0f);
+				}
+			}
+		}
+	}
+	return cube;
+}
+
+} // namespace
+
+bool RunLayoutBenchmarks(const Lut3D& lut, const std::vector<size_t>& sizes, const Image& image, std::vector<BenchmarkResult>& results)
+{
+	if (image.GetLayout() != IMAGE_LAYOUT_INTERLEAVED || GetBytesPerChannel(image.GetFormat()) != 1)
+	{
+		std::cerr << "The layout benchmark needs an 8-bit image." << std::endl;
+		return false;
+	}
+
+	const unsigned width = image.GetWidth();
+	const unsigned height = image.GetHeight();
+	const unsigned channels = image.GetChannelCount();
+
+	// The worst case: every pixel lands somewhere else in the cube
+	Image noise;
+	noise.Allocate(width, height, image.GetFormat(), IMAGE_LAYOUT_INTERLEAVED);
+	unsigned seed = 12345;
+	for (unsigned y = 0; y < height; ++y)
+	{
+		unsigned char* row = noise.GetRow(y);
+		for (size_t i = 0; i < (size_t)width * channels; ++i)
+		{
+			seed = seed * 1664525 + 1013904223;
+			row[i] = (unsigned char)(seed >> 24);
+		}
+	}
+
+	Image output;
+	output.Allocate(width, height, image.GetFormat(), IMAGE_LAYOUT_INTERLEAVED);
+
+	CacheMissCounter counter;
+	const Image* inputs[2] = { &image, &noise };
+	const char* inputNames[2] = { "image", "random" };
+	const LutLayout layouts[2] = { LUT_LAYOUT_LINEAR, LUT_LAYOUT_BRICKED };
+	const char* layoutNames[2] = { "linear", "bricked" };
+
+	for (size_t s = 0; s < sizes.size(); ++s)
+	{
+		LutChain chain;
+		chain.AddCube(lut);
+		if (chain.IsSeparable())
+		{
+			chain.AddCube(MakeSaturationCube(sizes[s]));
+		}
+		const Lut3D cube = chain.Bake(sizes[s]);
+
+		for (int l = 0; l < 2; ++l)
+		{
+			const LutApplier applier(cube, LUT_FILTER_EXACT, layouts[l]);
+
+			for (int i = 0; i < 2; ++i)
+			{
+				const Image& input = *inputs[i];
+				std::ostringstream name;
+				name << "layout/" << layoutNames[l] << "/" << sizes[s] << "/" << inputNames[i];
+
+				BenchmarkResult result = TimeCase(name.str(), (size_t)width * height, [&]()
+				{
+					for (unsigned y = 0; y < height; ++y)
+					{
+						applier.ApplyInterleaved(input.GetRow(y), output.GetRow(y), width, channels);
+					}
+				}, counter);
+
+				MeasureFootprint(input, sizes[s], layouts[l], result);
+				results.push_back(result);
+			}
+		}
+	}
+
+	return true;
+}
+
+void RunKernelBenchmarks(const Lut3D& lut, size_t pixelCount, std::vector<BenchmarkResult>& results)
+{
+	const ImageFormat formats[] = { IMAGE_FORMAT_RGB8, IMAGE_FORMAT_RGBA8, IMAGE_FORMAT_RGB16, IMAGE_FORMAT_RGBA16, IMAGE_FORMAT_RGBA16F };
+	const LutInterpolation interpolations[] = { LUT_INTERPOLATION_NEAREST, LUT_INTERPOLATION_TRILINEAR, LUT_INTERPOLATION_TETRAHEDRAL,
+		LUT_INTERPOLATION_SEPARABLE, LUT_INTERPOLATION_D3D11 };
+	const LutTransfer transfers[] = { LUT_TRANSFER_NONE, LUT_TRANSFER_GAMMA22 };
+
+	// Random pixels in every format, half floats within [0, 1]
+	std::vector<unsigned char> inputs[5];
+	unsigned seed = 12345;
+	for (int f = 0; f < 5; ++f)
+	{
+		const size_t samples = pixelCount * GetChannelCount(formats[f]);
+		inputs[f].resize(samples * GetBytesPerChannel(formats[f]));
+		unsigned short* samples16 = reinterpret_cast<unsigned short*>(&inputs[f][0]);
+
+		for (size_t i = 0; i < samples; ++i)
+		{
+			seed = seed * 1664525 + 1013904223;
+			switch (formats[f])
+			{
+			case IMAGE_FORMAT_RGB8:
+			case IMAGE_FORMAT_RGBA8:
+				inputs[f][i] = (unsigned char)(seed >> 24);
+				break;
+			case IMAGE_FORMAT_RGB16:
+			case IMAGE_FORMAT_RGBA16:
+				samples16[i] = (unsigned short)(seed >> 16);
+				break;
+			case IMAGE_FORMAT_RGBA16F:
+				samples16[i] = FloatToHalf((float)(seed >> 16) / 65535.0f);
+				break;
+			}
+		}
+	}
+
+	std::vector<unsigned char> output(pixelCount * 4 * sizeof(unsigned short));
+
+	LutApplier exact(lut);
+	LutApplier emulated(lut, LUT_FILTER_D3D11);
+	CacheMissCounter counter;
+
+	for (int i = 0; i < 5; ++i)
+	{
+		LutApplier& applier = interpolations[i] == LUT_INTERPOLATION_D3D11 ? emulated : exact;
+		if (interpolations[i] == LUT_INTERPOLATION_SEPARABLE && !applier.IsSeparable())
+		{
+			continue;
+		}
+		if (interpolations[i] != LUT_INTERPOLATION_D3D11)
+		{
+			applier.SetInterpolation(interpolations[i]);
+		}
+
+		for (int t = 0; t < 2; ++t)
+		{
+			applier.SetTransfer(transfers[t]);
+
+			for (int in = 0; in < 5; ++in)
+			{
+				for (int out = 0; out < 5; ++out)
+				{
+					std::ostringstream name;
+					name << "kernel/" << GetImageFormatName(formats[in]) << ">" << GetImageFormatName(formats[out])
+						<< "/" << GetInterpolationName(interpolations[i]) << "/" << GetTransferName(transfers[t]);
+
+					results.push_back(TimeCase(name.str(), pixelCount, [&]()
+					{
+						applier.Apply(&inputs[in][0], formats[in], &output[0], formats[out], pixelCount);
+					}, counter));
+				}
+			}
+		}
+	}
+}
+
+void PrintBenchmarkResults(const std::vector<BenchmarkResult>& results)
+{
+	std::cout << std::left << std::setw(44) << "case" << std::right
+		<< std::setw(10) << "ms" << std::setw(10) << "MP/s"
+		<< std::setw(8) << "lines" << std::setw(8) << "pages"
+		<< std::setw(14) << "misses" << std::endl;
+
+	for (size_t i = 0; i < results.size(); ++i)
+	{
+		const BenchmarkResult& result = results[i];
+		std::cout << std::left << std::setw(44) << result.Name << std::right << std::fixed
+			<< std::setw(10) << std::setprecision(2) << result.Milliseconds
+			<< std::setw(10) << std::setprecision(1) << result.MegapixelsPerSecond
+			<< std::setw(8) << std::setprecision(2) << result.LinesPerLookup
+			<< std::setw(8) << std::setprecision(2) << result.PagesPerLookup;
+
+		if (result.CacheMisses >= 0)
+		{
+			std::cout << std::setw(14) << result.CacheMisses << std::endl;
+		}
+		else
+		{
+			std::cout << std::setw(14) << "n/a" << std::endl;
+		}
+	}
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+class Lut3D;
+class Image;
+
+// One timed case. Every case runs a few times and keeps its best time.
+struct BenchmarkResult
+{
+	std::string Name;
+	double Milliseconds;
+	double MegapixelsPerSecond;
+
+	// Distinct 64-byte lines and 4 KiB pages the lattice reads of one pixel
+	// touch on average, i.e. what the layout costs whatever the machine. Zero
+	// for cases that do not work them out.
+	double LinesPerLookup;
+	double PagesPerLookup;
+
+	// Cache misses the CPU counted over the best run, -1 where hardware
+	// counters are not available
+	long long CacheMisses;
+};
+
+// Linear against bricked layout, for the LUT resampled to each size, on the
+// image (8-bit, interleaved) and on random colours of the same dimensions.
+// Separable LUTs get a saturation boost composed on top, as they would never
+// reach the lattice otherwise.
+bool RunLayoutBenchmarks(const Lut3D& lut, const std::vector<size_t>& sizes, const Image& image, std::vector<BenchmarkResult>& results);
+
+// One case per kernel (see LutKernels.h): every input format into every output
+// format, for each interpolation and transfer function, on random pixels.
+// Separable interpolation is only timed for separable LUTs.
+void RunKernelBenchmarks(const Lut3D& lut, size_t pixelCount, std::vector<BenchmarkResult>& results);
+
+void PrintBenchmarkResults(const std::vector<BenchmarkResult>& results);
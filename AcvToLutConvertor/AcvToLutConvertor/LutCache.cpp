@@ -0,0 +1,317 @@
+#include "LutCache.h"
+#include "LutChain.h"
+#include "DdsVolume.h"
+#include "MappedFile.h"
+#include "PipelineStats.h"
+#include <iostream>
+
+namespace
+{
+
+// Expired bakes are dropped from the content index once it holds this many
+const size_t MIN_CONTENT_SWEEP = 64;
+
+// The stamp of a shaper sidecar that is not there, which no file has
+const FileStamp NO_SHAPER_STAMP = { 0, -1 };
+
+// The sidecar LutChain::AddFile bakes in front of a DDS volume, if any
+FileStamp GetShaperStamp(const PathChar* path)
+{
+	FileStamp stamp;
+	if (GetPathExtension(path) != "dds" || !GetFileStamp(GetDdsShaperPath(path).c_str(), stamp))
+	{
+		return NO_SHAPER_STAMP;
+	}
+	return stamp;
+}
+
+void AppendContent(const void* data, size_t size, std::vector<unsigned char>& content)
+{
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	content.insert(content.end(), bytes, bytes + size);
+}
+
+// Volumes are told apart by their top level and channel masks, so that a DDS
+// file and the same volume inside a pack share a bake
+void AppendVolume(const unsigned char* texels, size_t size, const unsigned masks[3], std::vector<unsigned char>& content)
+{
+	const unsigned edge = (unsigned)size;
+	AppendContent("volume", 6, content);
+	AppendContent(&edge, sizeof(edge), content);
+	AppendContent(masks, 3 * sizeof(unsigned), content);
+	AppendContent(texels, size * size * size * 4, content);
+}
+
+// The same volume with another shaper, or none, bakes differently. Shapers
+// go by their 16-bit levels, which a sidecar and a pack entry share.
+void AppendShaper(const unsigned char* levels, size_t size, std::vector<unsigned char>& content)
+{
+	AppendContent(size ? "shaper" : "unshaped", size ? 6 : 8, content);
+	AppendContent(levels, size, content);
+}
+
+// What a file bakes from, for telling whether another path holds the same
+bool ReadContent(const PathChar* path, std::vector<unsigned char>& content)
+{
+	MappedFile file;
+	if (GetPathExtension(path) == "dds")
+	{
+		DdsVolumeLayout layout;
+		const unsigned char* texels = ReadDdsVolumeLayout(path, layout) && file.Open(path, false) ?
+			file.MapWindow(layout.TexelOffset, layout.Size * layout.Size * layout.Size * 4) : nullptr;
+		if (!texels)
+		{
+			return false;
+		}
+		AppendVolume(texels, layout.Size, layout.Masks, content);
+
+		const PathString shaperPath = GetDdsShaperPath(path);
+		FileStamp shaperStamp;
+		LutShaper shaper;
+		if (GetFileStamp(shaperPath.c_str(), shaperStamp) && !ReadDdsShaper(shaperPath.c_str(), shaper))
+		{
+			return false;
+		}
+		std::vector<unsigned char> levels;
+		EncodeDdsShaper(shaper, levels);
+		AppendShaper(levels.empty() ? nullptr : &levels[0], levels.size(), content);
+		return true;
+	}
+
+	const unsigned char* bytes = file.Open(path, false) ? file.MapWindow(0, (size_t)file.GetSize()) : nullptr;
+	if (!bytes)
+	{
+		return false;
+	}
+	AppendContent("acv", 3, content);
+	AppendContent(bytes, (size_t)file.GetSize(), content);
+	return true;
+}
+
+size_t GetBakedSize(const BakedLut& lut)
+{
+	const size_t size = lut.Lut.GetSize();
+	return sizeof(BakedLut) + size * size * size * 3 * sizeof(float) + lut.Content.size() +
+		lut.Curves.size() * sizeof(CubicSpline);
+}
+
+} // namespace
+
+LutCache::LutCache(size_t budget)
+	: m_ShardBudget(budget / SHARD_COUNT)
+	, m_ContentSweep(MIN_CONTENT_SWEEP)
+	, m_Hits(0)
+	, m_Misses(0)
+	, m_Shared(0)
+	, m_Evictions(0)
+{}
+
+std::shared_ptr<const BakedLut> LutCache::Get(const PathChar* path)
+{
+	// LUTs in a pack change with the pack
+	PathString packPath;
+	std::string packedName;
+	if (!SplitLutPackPath(path, packPath, packedName))
+	{
+		packPath.clear();
+	}
+
+	FileStamp stamp;
+	if (!GetFileStamp(packPath.empty() ? path : packPath.c_str(), stamp))
+	{
+		std::cerr << "Unable to open file: " << NarrowPath(packPath.empty() ? path : packPath.c_str()) << std::endl;
+		return nullptr;
+	}
+	const FileStamp shaperStamp = packPath.empty() ? GetShaperStamp(path) : NO_SHAPER_STAMP;
+
+	const PathString key(path);
+	Shard& shard = m_Shards[HashBytes(key.data(), key.size() * sizeof(PathChar)) % SHARD_COUNT];
+	{
+		std::lock_guard<std::mutex> lock(shard.Mutex);
+		std::map<PathString, Slot>::iterator cached = shard.Slots.find(key);
+		if (cached != shard.Slots.end() && cached->second.Stamp == stamp && cached->second.ShaperStamp == shaperStamp)
+		{
+			shard.Recent.splice(shard.Recent.begin(), shard.Recent, cached->second.Recent);
+			++m_Hits;
+			AddPipelineCount(PIPELINE_COUNTER_CACHE_HITS, 1);
+			return cached->second.Lut;
+		}
+	}
+
+	std::shared_ptr<const BakedLut> lut = Load(path, packPath, packedName, stamp);
+	if (lut)
+	{
+		Insert(shard, key, stamp, shaperStamp, lut);
+	}
+	return lut;
+}
+
+std::shared_ptr<const BakedLut> LutCache::Load(const PathChar* path, const PathString& packPath, const std::string& packedName, const FileStamp& stamp)
+{
+	std::shared_ptr<const OpenPack> pack;
+	const LutPackEntry* entry = nullptr;
+	std::vector<unsigned char> content;
+	if (!packPath.empty())
+	{
+		pack = GetPack(packPath, stamp);
+		entry = pack ? pack->Pack.Find(packedName) : nullptr;
+		if (!entry)
+		{
+			if (pack)
+			{
+				std::cerr << "No LUT named " << packedName << " in pack: " << NarrowPath(packPath.c_str()) << std::endl;
+			}
+			return nullptr;
+		}
+		const unsigned char* payload = pack->Pack.GetPayload(*entry);
+		AppendVolume(payload + entry->TexelOffset, entry->Size, entry->Masks, content);
+		AppendShaper(payload + entry->DataSize - entry->ShaperSize, entry->ShaperSize, content);
+	}
+	else if (!ReadContent(path, content))
+	{
+		return nullptr;
+	}
+
+	// Equal hashes only share a bake when the bytes are equal too
+	const unsigned long long hash = HashBytes(&content[0], content.size());
+
+	{
+		std::lock_guard<std::mutex> lock(m_ContentMutex);
+		std::map<unsigned long long, std::weak_ptr<const BakedLut>>::iterator baked = m_Contents.find(hash);
+		std::shared_ptr<const BakedLut> lut = baked != m_Contents.end() ? baked->second.lock() : nullptr;
+		if (lut && lut->Content == content)
+		{
+			++m_Shared;
+			AddPipelineCount(PIPELINE_COUNTER_CACHE_HITS, 1);
+			return lut;
+		}
+	}
+
+	std::shared_ptr<BakedLut> lut(new BakedLut());
+	LutChain chain;
+	if (pack)
+	{
+		Lut3D cube;
+		LutShaper shaper;
+		if (!pack->Pack.ReadLut(*entry, cube) || !pack->Pack.ReadShaper(*entry, shaper))
+		{
+			return nullptr;
+		}
+		chain.AddCube(cube, shaper);
+	}
+	else if (GetPathExtension(path) == "acv")
+	{
+		if (!ReadCurves(path, lut->Curves))
+		{
+			return nullptr;
+		}
+		chain.AddCurves(lut->Curves);
+	}
+	else if (!chain.AddFile(path))
+	{
+		return nullptr;
+	}
+
+	lut->Lut = chain.Bake(chain.GetNativeSize() ? chain.GetNativeSize() : DEFAULT_CUBE_SIZE);
+	lut->Content.swap(content);
+	lut->Bytes = GetBakedSize(*lut);
+	++m_Misses;
+	AddPipelineCount(PIPELINE_COUNTER_CACHE_MISSES, 1);
+
+	std::lock_guard<std::mutex> lock(m_ContentMutex);
+	if (m_Contents.size() >= m_ContentSweep)
+	{
+		for (std::map<unsigned long long, std::weak_ptr<const BakedLut>>::iterator i = m_Contents.begin(); i != m_Contents.end();)
+		{
+			i = i->second.expired() ? m_Contents.erase(i) : ++i;
+		}
+		m_ContentSweep = 2 * m_Contents.size() > MIN_CONTENT_SWEEP ? 2 * m_Contents.size() : MIN_CONTENT_SWEEP;
+	}
+	m_Contents[hash] = lut;
+	return lut;
+}
+
+std::shared_ptr<const LutCache::OpenPack> LutCache::GetPack(const PathString& path, const FileStamp& stamp)
+{
+	std::lock_guard<std::mutex> lock(m_PackMutex);
+	std::map<PathString, std::shared_ptr<const OpenPack>>::iterator cached = m_Packs.find(path);
+	if (cached != m_Packs.end() && cached->second->Stamp == stamp)
+	{
+		return cached->second;
+	}
+
+	std::shared_ptr<OpenPack> pack(new OpenPack());
+	pack->Stamp = stamp;
+	if (!pack->Pack.Open(path.c_str()))
+	{
+		return nullptr;
+	}
+	m_Packs[path] = pack;
+	return pack;
+}
+
+void LutCache::Insert(Shard& shard, const PathString& path, const FileStamp& stamp, const FileStamp& shaperStamp, const std::shared_ptr<const BakedLut>& lut)
+{
+	std::lock_guard<std::mutex> lock(shard.Mutex);
+
+	std::map<PathString, Slot>::iterator cached = shard.Slots.find(path);
+	if (cached != shard.Slots.end())
+	{
+		shard.Bytes -= cached->second.Lut->Bytes;
+		shard.Recent.erase(cached->second.Recent);
+		shard.Slots.erase(cached);
+	}
+
+	shard.Recent.push_front(path);
+	Slot& slot = shard.Slots[path];
+	slot.Stamp = stamp;
+	slot.ShaperStamp = shaperStamp;
+	slot.Lut = lut;
+	slot.Recent = shard.Recent.begin();
+	shard.Bytes += lut->Bytes;
+
+	// Least recently used first, keeping the one just added even when it is
+	// larger than the whole budget
+	while (shard.Bytes > m_ShardBudget && shard.Recent.size() > 1)
+	{
+		std::map<PathString, Slot>::iterator oldest = shard.Slots.find(shard.Recent.back());
+		shard.Bytes -= oldest->second.Lut->Bytes;
+		shard.Slots.erase(oldest);
+		shard.Recent.pop_back();
+		++m_Evictions;
+	}
+}
+
+LutCacheStats LutCache::GetStats() const
+{
+	LutCacheStats stats;
+	stats.Hits = m_Hits;
+	stats.Misses = m_Misses;
+	stats.Shared = m_Shared;
+	stats.Evictions = m_Evictions;
+	stats.Entries = 0;
+	stats.Bytes = 0;
+
+	for (size_t i = 0; i < SHARD_COUNT; ++i)
+	{
+		const Shard& shard = m_Shards[i];
+		std::lock_guard<std::mutex> lock(shard.Mutex);
+		stats.Entries += shard.Slots.size();
+		stats.Bytes += shard.Bytes;
+	}
+	return stats;
+}
+
+void LutCache::Clear()
+{
+	for (size_t i = 0; i < SHARD_COUNT; ++i)
+	{
+		std::lock_guard<std::mutex> lock(m_Shards[i].Mutex);
+		m_Shards[i].Slots.clear();
+		m_Shards[i].Recent.clear();
+		m_Shards[i].Bytes = 0;
+	}
+
+	std::lock_guard<std::mutex> packLock(m_PackMutex);
+	m_Packs.clear();
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "Platform.h"
+#include "AcvCurves.h"
+#include "Lut3D.h"
+#include "LutPack.h"
+#include <atomic>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// A LUT file decoded and baked once, then shared read-only by everything that
+// applies it
+struct BakedLut
+{
+	Lut3D Lut; // as the apply command bakes it
+	std::vector<CubicSpline> Curves; // ACV files only
+	std::vector<unsigned char> Content; // what was baked, see LutCache
+	size_t Bytes; // what it costs the cache
+};
+
+struct LutCacheStats
+{
+	unsigned long long Hits; // file unchanged since it was baked
+	unsigned long long Misses; // read and baked
+	unsigned long long Shared; // read, but the same bytes were baked for another path
+	unsigned long long Evictions;
+	size_t Entries;
+	size_t Bytes;
+};
+
+// Caches 256 MB of baked LUTs unless told otherwise
+const size_t DEFAULT_LUT_CACHE_BUDGET = 256 << 20;
+
+//
+// Baked LUTs by path, for processes that apply many looks and switch between
+// them. An entry stays valid while its file keeps its size and modification
+// time (for a LUT in a LutPack, while the pack does), and for DDS volumes
+// while their .shaper.dds sidecar does, or stays away. Files that changed or
+// were never seen are read and hashed first: when the same bytes are already
+// baked for some other path, or were until recently, that bake is shared. The
+// bytes are kept with the bake and compared, a matching hash is not enough.
+//
+// Entries are spread over shards by path, each with its own lock and its own
+// share of the byte budget, and evicted least recently used first. Callers
+// hold on to what Get returns, so eviction never pulls a LUT from under a
+// worker. Any number of threads may call Get at once; loading happens outside
+// the locks.
+//
+class LutCache
+{
+public:
+	explicit LutCache(size_t budget = DEFAULT_LUT_CACHE_BUDGET);
+
+	// Null after reporting the problem when the file cannot be loaded
+	std::shared_ptr<const BakedLut> Get(const PathChar* path);
+
+	LutCacheStats GetStats() const;
+	void Clear();
+
+private:
+	struct Slot
+	{
+		FileStamp Stamp;
+		FileStamp ShaperStamp; // of the .shaper.dds sidecar, if there is one
+		std::shared_ptr<const BakedLut> Lut;
+		std::list<PathString>::iterator Recent;
+	};
+
+	struct Shard
+	{
+		Shard() : Bytes(0) {}
+
+		mutable std::mutex Mutex;
+		std::map<PathString, Slot> Slots;
+		std::list<PathString> Recent; // most recently used first
+		size_t Bytes;
+	};
+
+	struct OpenPack
+	{
+		FileStamp Stamp;
+		LutPack Pack;
+	};
+
+	static const size_t SHARD_COUNT = 16;
+
+	LutCache(const LutCache&);
+	LutCache& operator=(const LutCache&);
+
+	// packPath is empty for files outside packs
+	std::shared_ptr<const BakedLut> Load(const PathChar* path, const PathString& packPath, const std::string& packedName, const FileStamp& stamp);
+	std::shared_ptr<const OpenPack> GetPack(const PathString& path, const FileStamp& stamp);
+	void Insert(Shard& shard, const PathString& path, const FileStamp& stamp, const FileStamp& shaperStamp, const std::shared_ptr<const BakedLut>& lut);
+
+	Shard m_Shards[SHARD_COUNT];
+	size_t m_ShardBudget;
+
+	// Bakes by content hash, as long as anyone holds them
+	std::mutex m_ContentMutex;
+	std::map<unsigned long long, std::weak_ptr<const BakedLut>> m_Contents;
+	size_t m_ContentSweep; // size at which expired ones are dropped
+
+	// Packs stay mapped until they are rewritten
+	std::mutex m_PackMutex;
+	std::map<PathString, std::shared_ptr<const OpenPack>> m_Packs;
+
+	std::atomic<unsigned long long> m_Hits;
+	std::atomic<unsigned long long> m_Misses;
+	std::atomic<unsigned long long> m_Shared;
+	std::atomic<unsigned long long> m_Evictions;
+};
@@ -0,0 +1,242 @@
+#include "LutChain.h"
+#include "DdsVolume.h"
+#include "LutPack.h"
+#include "PipelineStats.h"
+#include <iostream>
+#include <algorithm>
+#include <cassert>
+
+bool LutChain::AddFile(const PathChar* path)
+{
+	PathString packPath;
+	std::string name;
+	if (SplitLutPackPath(path, packPath, name))
+	{
+		LutPack pack;
+		Lut3D lut;
+		LutShaper shaper;
+		if (!pack.Open(packPath.c_str()) || !pack.ReadLut(name, lut, shaper))
+		{
+			return false;
+		}
+		AddCube(lut, shaper);
+		return true;
+	}
+
+	const std::string extension = GetPathExtension(path);
+
+	if (extension == "acv")
+	{
+		std::vector<CubicSpline> cubicSplines;
+		if (!ReadCurves(path, cubicSplines))
+		{
+			return false;
+		}
+		AddCurves(cubicSplines);
+		return true;
+	}
+
+	if (extension == "dds")
+	{
+		Lut3D lut;
+		if (!ReadDdsVolume(path, lut))
+		{
+			return false;
+		}
+
+		LutShaper shaper;
+		const PathString shaperPath = GetDdsShaperPath(path);
+		FileStamp stamp;
+		if (GetFileStamp(shaperPath.c_str(), stamp) && !ReadDdsShaper(shaperPath.c_str(), shaper))
+		{
+			return false;
+		}
+		AddCube(lut, shaper);
+		return true;
+	}
+
+	std::cerr << "Unknown LUT file type (expected .acv or .dds): " << NarrowPath(path) << std::endl;
+	return false;
+}
+
+void LutChain::AddCurves(const std::vector<CubicSpline>& cubicSplines)
+{
+	assert(cubicSplines.size() == 5 && "Curve stages need the five ACV curves!");
+
+	Stage stage;
+	stage.Curves = cubicSplines;
+	stage.Separable = true;
+	for (int c = 0; c < 3; ++c)
+	{
+		stage.Identity[c] = IsIdentityChannel(cubicSplines, c);
+	}
+	m_Stages.push_back(stage);
+}
+
+void LutChain::AddCube(const Lut3D& lut, const LutShaper& shaper)
+{
+	Stage stage;
+	stage.Cube = lut;
+	stage.Shaper = shaper;
+	stage.Separable = lut.ExtractSeparableTables(stage.Tables[0], stage.Tables[1], stage.Tables[2]);
+	for (int c = 0; c < 3; ++c)
+	{
+		stage.Identity[c] = stage.Separable && shaper.IsIdentity() && IsIdentityTable(stage.Tables[c]);
+	}
+	m_Stages.push_back(stage);
+}
+
+bool LutChain::IsSeparable() const
+{
+	for (size_t i = 0; i < m_Stages.size(); ++i)
+	{
+		if (!m_Stages[i].Separable)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+size_t LutChain::GetNativeSize() const
+{
+	size_t size = 0;
+	for (size_t i = 0; i < m_Stages.size(); ++i)
+	{
+		if (m_Stages[i].Cube.GetSize() > size)
+		{
+			size = m_Stages[i].Cube.GetSize();
+		}
+	}
+	return size;
+}
+
+float LutChain::EvaluateChannel(const Stage& stage, int channel, float value)
+{
+	if (stage.Identity[channel])
+	{
+		return value;
+	}
+	if (!stage.Curves.empty())
+	{
+		return EvaluateCurves(stage.Curves, channel, value);
+	}
+	return SampleTable(stage.Tables[channel], stage.Shaper.Forward(value));
+}
+
+void LutChain::Evaluate(const float in[3], float out[3]) const
+{
+	float color[3] = { in[0], in[1], in[2] };
+
+	for (size_t i = 0; i < m_Stages.size(); ++i)
+	{
+		const Stage& stage = m_Stages[i];
+		if (stage.Separable)
+		{
+			for (int c = 0; c < 3; ++c)
+			{
+				color[c] = EvaluateChannel(stage, c, color[c]);
+			}
+		}
+		else
+		{
+			stage.Cube.Sample(stage.Shaper.Forward(color[0]), stage.Shaper.Forward(color[1]), stage.Shaper.Forward(color[2]), color);
+		}
+	}
+
+	out[0] = color[0];
+	out[1] = color[1];
+	out[2] = color[2];
+}
+
+void LutChain::EvaluateSeparable(int channel, const float* inputs, float* outputs, size_t count) const
+{
+	assert(IsSeparable() && "Only separable chains evaluate channel by channel!");
+
+	if (inputs != outputs)
+	{
+		std::copy(inputs, inputs + count, outputs);
+	}
+	for (size_t s = 0; s < m_Stages.size(); ++s)
+	{
+		const Stage& stage = m_Stages[s];
+		if (stage.Identity[channel])
+		{
+			continue;
+		}
+		if (!stage.Curves.empty())
+		{
+			EvaluateCurves(stage.Curves, channel, outputs, outputs, count);
+		}
+		else
+		{
+			for (size_t i = 0; i < count; ++i)
+			{
+				outputs[i] = SampleTable(stage.Tables[channel], stage.Shaper.Forward(outputs[i]));
+			}
+		}
+	}
+}
+
+Lut3D LutChain::Bake(size_t cubeSize, const LutShaper* shaper) const
+{
+	assert(cubeSize >= 2);
+	StageTimer timer(PIPELINE_STAGE_BAKE);
+
+	const LutShaper identity;
+	if (!shaper)
+	{
+		shaper = &identity;
+	}
+
+	if (IsSeparable())
+	{
+		std::vector<float> lattice(cubeSize);
+		for (size_t i = 0; i < cubeSize; ++i)
+		{
+			lattice[i] = shaper->Inverse((float)i / (float)(cubeSize - 1));
+		}
+
+		std::vector<float> tables[3];
+		for (int c = 0; c < 3; ++c)
+		{
+			tables[c].resize(cubeSize);
+			EvaluateSeparable(c, &lattice[0], &tables[c][0], cubeSize);
+		}
+		return Lut3D::FromSeparableTables(tables[0], tables[1], tables[2]);
+	}
+
+	// Curve stages run every value of their channels that are not identities,
+	// once per texel
+	unsigned long long curveChannels = 0;
+	for (size_t s = 0; s < m_Stages.size(); ++s)
+	{
+		for (int c = 0; c < 3; ++c)
+		{
+			curveChannels += !m_Stages[s].Curves.empty() && !m_Stages[s].Identity[c];
+		}
+	}
+	AddPipelineCount(PIPELINE_COUNTER_SPLINE_EVALUATIONS, curveChannels * cubeSize * cubeSize * cubeSize);
+
+	// The inputs the lattice points stand for
+	std::vector<float> lattice(cubeSize);
+	const float scale = 1.0f / (float)(cubeSize - 1);
+	for (size_t i = 0; i < cubeSize; ++i)
+	{
+		lattice[i] = shaper->Inverse(i * scale);
+	}
+
+	Lut3D lut(cubeSize);
+	for (size_t slice = 0; slice < cubeSize; ++slice)
+	{
+		for (size_t row = 0; row < cubeSize; ++row)
+		{
+			for (size_t col = 0; col < cubeSize; ++col)
+			{
+				const float in[3] = { lattice[col], lattice[row], lattice[slice] };
+				Evaluate(in, lut.GetTexel(col, row, slice));
+			}
+		}
+	}
+	return lut;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "Platform.h"
+#include "AcvCurves.h"
+#include "Lut3D.h"
+#include "LutShaper.h"
+#include <vector>
+
+// An ordered list of looks - curve files and LUT volumes - each applied to the
+// output of the one before. Baking the chain gives a single cube, so stacked
+// looks cost one pass over the image instead of one pass per look.
+class LutChain
+{
+public:
+	// ACV files become curve stages, DDS files and LUTs in a LutPack cube
+	// stages, behind the shaper a DDS file has next to it (see GetDdsShaperPath)
+	bool AddFile(const PathChar* path);
+
+	void AddCurves(const std::vector<CubicSpline>& cubicSplines);
+	void AddCube(const Lut3D& lut, const LutShaper& shaper = LutShaper());
+
+	size_t GetStageCount() const { return m_Stages.size(); }
+
+	// True when every stage is separable, i.e. curves or a per-channel cube
+	bool IsSeparable() const;
+
+	// Size of the largest cube stage, 0 for a chain of curves only
+	size_t GetNativeSize() const;
+
+	// Runs a colour through every stage
+	void Evaluate(const float in[3], float out[3]) const;
+
+	// Runs values of one channel through every stage of a separable chain,
+	// curves in a batch. inputs and outputs may be the same.
+	void EvaluateSeparable(int channel, const float* inputs, float* outputs, size_t count) const;
+
+	// Separable chains compose exactly, channel by channel: every lattice value
+	// goes through the curves themselves and the 1D tables of separable cubes,
+	// skipping the channels a stage passes through.
+	// Anything else is resampled, every texel going through the whole chain.
+	// Behind a shaper, lattice points stand for the inputs it maps there.
+	Lut3D Bake(size_t cubeSize, const LutShaper* shaper = nullptr) const;
+
+private:
+	struct Stage
+	{
+		std::vector<CubicSpline> Curves; // empty for cube stages
+		Lut3D Cube;
+		LutShaper Shaper; // in front of the cube
+		std::vector<float> Tables[3]; // of separable cubes
+		bool Separable;
+		bool Identity[3]; // channels the stage passes through
+	};
+
+	static float EvaluateChannel(const Stage& stage, int channel, float value);
+
+	std::vector<Stage> m_Stages;
+};
@@ -0,0 +1,640 @@
+#include "LutKernels.h"
+#include "LutKernelsSimd.h"
+#include "CpuFeatures.h"
+#include "Lut3D.h"
+#include "Half.h"
+#include <cmath>
+#include <cstring>
+#include <cassert>
+#include <type_traits>
+
+namespace
+{
+
+// Pixels staged per block on the half-float paths
+const size_t KERNEL_BLOCK = 256;
+
+const int FORMAT_COUNT = IMAGE_FORMAT_RGBA16F + 1;
+const int INTERPOLATION_COUNT = LUT_INTERPOLATION_D3D11 + 1;
+const int TRANSFER_COUNT = LUT_TRANSFER_GAMMA22 + 1;
+const int LEVEL_COUNT = CPU_LEVEL_AVX512 + 1;
+
+unsigned char ToUnorm8(float value)
+{
+	float scaled = value * 255.0f + 0.5f;
+	if (scaled <= 0.0f)
+	{
+		return 0;
+	}
+	if (scaled >= 255.0f)
+	{
+		return 255;
+	}
+	return (unsigned char)scaled;
+}
+
+unsigned short ToUnorm16(float value)
+{
+	float scaled = value * 65535.0f + 0.5f;
+	if (scaled <= 0.0f)
+	{
+		return 0;
+	}
+	if (scaled >= 65535.0f)
+	{
+		return 65535;
+	}
+	return (unsigned short)scaled;
+}
+
+// Both taps clamped to the same edge texel become a cell with all the weight
+// on its near or far corner
+void LocateD3D11Float(const LutKernelContext& context, float value, int axis, size_t& offset, unsigned& weight)
+{
+	size_t lo;
+	size_t hi;
+	AddressD3D11(value, context.Size, lo, hi, weight);
+	if (lo == hi && lo != 0)
+	{
+		weight = 256;
+	}
+	offset = (lo <= context.Size - 2 ? lo : context.Size - 2) * context.LevelStrides[axis];
+}
+
+// Sample encodings. Kernels read staged samples and write staged samples;
+// Stage and Commit convert runs of them from and to what is stored, and are
+// no-ops where the two are the same.
+struct Unorm8Encoding
+{
+	typedef unsigned char Stored;
+	typedef unsigned char Staged;
+	static const size_t CODES = 256;
+
+	// The 8-bit paths have always interpolated with lerps from table fractions
+	static const bool LERP = true;
+
+	static float ToFloat(Staged value) { return (float)value * (1.0f / 255.0f); }
+	static Staged FromFloat(float value) { return ToUnorm8(value); }
+	static Staged Opaque() { return 255; }
+	static Stored OpaqueCode() { return 255; }
+
+	static const Staged* Stage(const Stored* src, size_t, Staged*) { return src; }
+	static Staged* Target(Stored* dst, Staged*) { return dst; }
+	static void Commit(const Staged*, Stored*, size_t) {}
+
+	static const Stored* Codes(const LutKernelContext& context) { return context.Codes8; }
+
+	static void Locate(const LutKernelContext& context, Staged value, int axis, size_t& offset, float& frac)
+	{
+		offset = context.Offsets8[axis][value];
+		frac = context.Fractions8[value];
+	}
+
+	static void LocateD3D11(const LutKernelContext& context, Staged value, int axis, size_t& offset, unsigned& weight)
+	{
+		offset = context.LevelOffsets8[axis][value];
+		weight = context.Weights8[value];
+	}
+};
+
+struct Unorm16Encoding
+{
+	typedef unsigned short Stored;
+	typedef unsigned short Staged;
+	static const size_t CODES = 65536;
+
+	// Wider inputs interpolate like Lut3D::Sample
+	static const bool LERP = false;
+
+	static float ToFloat(Staged value) { return (float)value * (1.0f / 65535.0f); }
+	static Staged FromFloat(float value) { return ToUnorm16(value); }
+	static Staged Opaque() { return 65535; }
+	static Stored OpaqueCode() { return 65535; }
+
+	static const Staged* Stage(const Stored* src, size_t, Staged*) { return src; }
+	static Staged* Target(Stored* dst, Staged*) { return dst; }
+	static void Commit(const Staged*, Stored*, size_t) {}
+
+	static const Stored* Codes(const LutKernelContext& context) { return context.Codes16; }
+
+	static void Locate(const LutKernelContext& context, Staged value, int axis, size_t& offset, float& frac)
+	{
+		LocateFloat(context, ToFloat(value), axis, offset, frac);
+	}
+
+	static void LocateD3D11(const LutKernelContext& context, Staged value, int axis, size_t& offset, unsigned& weight)
+	{
+		LocateD3D11Float(context, ToFloat(value), axis, offset, weight);
+	}
+};
+
+// Blocks go through float with the wide conversion kernels; alpha
+// round-trips exactly
+struct HalfEncoding
+{
+	typedef unsigned short Stored;
+	typedef float Staged;
+	static const size_t CODES = 65536;
+	static const bool LERP = false;
+
+	static float ToFloat(Staged value) { return value; }
+	static Staged FromFloat(float value) { return value; }
+	static Staged Opaque() { return 1.0f; }
+	static Stored OpaqueCode() { return 0x3C00; }
+
+	static const Staged* Stage(const Stored* src, size_t count, Staged* buffer)
+	{
+		HalfToFloat(src, buffer, count);
+		return buffer;
+	}
+	static Staged* Target(Stored*, Staged* buffer) { return buffer; }
+	static void Commit(const Staged* staged, Stored* dst, size_t count) { FloatToHalf(staged, dst, count); }
+
+	static const Stored* Codes(const LutKernelContext& context) { return context.CodesHalf; }
+
+	static void Locate(const LutKernelContext& context, Staged value, int axis, size_t& offset, float& frac)
+	{
+		LocateFloat(context, value, axis, offset, frac);
+	}
+
+	static void LocateD3D11(const LutKernelContext& context, Staged value, int axis, size_t& offset, unsigned& weight)
+	{
+		LocateD3D11Float(context, value, axis, offset, weight);
+	}
+};
+
+template <ImageFormat Format> struct PixelTraits;
+template <> struct PixelTraits<IMAGE_FORMAT_RGB8>    { typedef Unorm8Encoding Encoding;  static const size_t CHANNELS = 3; };
+template <> struct PixelTraits<IMAGE_FORMAT_RGBA8>   { typedef Unorm8Encoding Encoding;  static const size_t CHANNELS = 4; };
+template <> struct PixelTraits<IMAGE_FORMAT_RGB16>   { typedef Unorm16Encoding Encoding; static const size_t CHANNELS = 3; };
+template <> struct PixelTraits<IMAGE_FORMAT_RGBA16>  { typedef Unorm16Encoding Encoding; static const size_t CHANNELS = 4; };
+template <> struct PixelTraits<IMAGE_FORMAT_RGBA16F> { typedef HalfEncoding Encoding;    static const size_t CHANNELS = 4; };
+
+// Output alpha: copied within an encoding, converted across, opaque when the
+// input has none
+template <class In, class Out, bool HasAlpha>
+struct Alpha
+{
+	static typename Out::Staged Get(const typename In::Staged* pixel) { return Out::FromFloat(In::ToFloat(pixel[3])); }
+};
+
+template <class Encoding>
+struct Alpha<Encoding, Encoding, true>
+{
+	static typename Encoding::Staged Get(const typename Encoding::Staged* pixel) { return pixel[3]; }
+};
+
+template <class In, class Out>
+struct Alpha<In, Out, false>
+{
+	static typename Out::Staged Get(const typename In::Staged*) { return Out::Opaque(); }
+};
+
+template <bool Lerp>
+float Blend(float a, float b, float frac)
+{
+	return a + (b - a) * frac;
+}
+
+template <>
+float Blend<false>(float a, float b, float frac)
+{
+	return a * (1.0f - frac) + b * frac;
+}
+
+template <LutInterpolation Interpolation> struct Interpolator;
+
+template <>
+struct Interpolator<LUT_INTERPOLATION_NEAREST>
+{
+	template <class Encoding>
+	static void Run(const LutKernelContext& context, const typename Encoding::Stored*, const typename Encoding::Staged* pixel, float out[3])
+	{
+		size_t offset = 0;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			size_t start;
+			float frac;
+			Encoding::Locate(context, pixel[axis], axis, start, frac);
+			offset += start + (size_t)(frac >= 0.5f) * context.Strides[axis];
+		}
+
+		const float* texel = context.Texels + offset;
+		out[0] = texel[0];
+		out[1] = texel[1];
+		out[2] = texel[2];
+	}
+};
+
+template <>
+struct Interpolator<LUT_INTERPOLATION_TRILINEAR>
+{
+	template <class Encoding>
+	static void Run(const LutKernelContext& context, const typename Encoding::Stored*, const typename Encoding::Staged* pixel, float out[3])
+	{
+		size_t offset[3];
+		float frac[3];
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			Encoding::Locate(context, pixel[axis], axis, offset[axis], frac[axis]);
+		}
+
+		// The eight cell corners are reached from the first one by fixed strides
+		const size_t strideR = context.Strides[0];
+		const float* p000 = context.Texels + offset[0] + offset[1] + offset[2];
+		const float* p010 = p000 + context.Strides[1];
+		const float* p001 = p000 + context.Strides[2];
+		const float* p011 = p001 + context.Strides[1];
+
+		for (int c = 0; c < 3; ++c)
+		{
+			float c00 = Blend<Encoding::LERP>(p000[c], p000[c + strideR], frac[0]);
+			float c10 = Blend<Encoding::LERP>(p010[c], p010[c + strideR], frac[0]);
+			float c01 = Blend<Encoding::LERP>(p001[c], p001[c + strideR], frac[0]);
+			float c11 = Blend<Encoding::LERP>(p011[c], p011[c + strideR], frac[0]);
+
+			float c0 = Blend<Encoding::LERP>(c00, c10, frac[1]);
+			float c1 = Blend<Encoding::LERP>(c01, c11, frac[1]);
+
+			out[c] = Blend<Encoding::LERP>(c0, c1, frac[2]);
+		}
+	}
+};
+
+template <>
+struct Interpolator<LUT_INTERPOLATION_TETRAHEDRAL>
+{
+	template <class Encoding>
+	static void Run(const LutKernelContext& context, const typename Encoding::Stored*, const typename Encoding::Staged* pixel, float out[3])
+	{
+		size_t offset[3];
+		float frac[3];
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			Encoding::Locate(context, pixel[axis], axis, offset[axis], frac[axis]);
+		}
+
+		// The cell splits into six tetrahedra along its main diagonal; the
+		// order of the fractions picks one, and the walk from the first to
+		// the last corner along its edges steps one axis at a time. The order
+		// comes from a table indexed by the comparisons, as branching on them
+		// mispredicts half the time on noisy images.
+		static const int ORDERS[8][3] =
+		{
+			{ 2, 1, 0 }, { 2, 0, 1 }, { 1, 2, 0 }, { 0, 1, 2 },
+			{ 2, 1, 0 }, { 0, 2, 1 }, { 1, 0, 2 }, { 0, 1, 2 },
+		};
+		const int* order = ORDERS[(frac[0] >= frac[1]) | (frac[1] >= frac[2]) << 1 | (frac[0] >= frac[2]) << 2];
+		const int first = order[0];
+		const int second = order[1];
+		const int third = order[2];
+
+		const float* p0 = context.Texels + offset[0] + offset[1] + offset[2];
+		const float* p1 = p0 + context.Strides[first];
+		const float* p2 = p1 + context.Strides[second];
+		const float* p3 = p2 + context.Strides[third];
+
+		for (int c = 0; c < 3; ++c)
+		{
+			out[c] = p0[c]
+				+ (p1[c] - p0[c]) * frac[first]
+				+ (p2[c] - p1[c]) * frac[second]
+				+ (p3[c] - p2[c]) * frac[third];
+		}
+	}
+};
+
+template <>
+struct Interpolator<LUT_INTERPOLATION_SEPARABLE>
+{
+	template <class Encoding>
+	static void Run(const LutKernelContext& context, const typename Encoding::Stored*, const typename Encoding::Staged* pixel, float out[3])
+	{
+		for (int c = 0; c < 3; ++c)
+		{
+			out[c] = SampleTable(context.Tables[c], Encoding::ToFloat(pixel[c]));
+		}
+	}
+};
+
+template <>
+struct Interpolator<LUT_INTERPOLATION_D3D11>
+{
+	template <class Encoding>
+	static void Run(const LutKernelContext& context, const typename Encoding::Stored*, const typename Encoding::Staged* pixel, float out[3])
+	{
+		size_t offset[3];
+		unsigned w[3];
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			Encoding::LocateD3D11(context, pixel[axis], axis, offset[axis], w[axis]);
+		}
+
+		const size_t strideR = context.LevelStrides[0];
+		const unsigned char* p000 = context.Levels + offset[0] + offset[1] + offset[2];
+		const unsigned char* p010 = p000 + context.LevelStrides[1];
+		const unsigned char* p001 = p000 + context.LevelStrides[2];
+		const unsigned char* p011 = p001 + context.LevelStrides[1];
+
+		// The same integer sums as Lut3D::SampleD3D11, from the 8-bit copy
+		for (int c = 0; c < 3; ++c)
+		{
+			unsigned c00 = p000[c] * (256 - w[0]) + p000[c + strideR] * w[0];
+			unsigned c10 = p010[c] * (256 - w[0]) + p010[c + strideR] * w[0];
+			unsigned c01 = p001[c] * (256 - w[0]) + p001[c + strideR] * w[0];
+			unsigned c11 = p011[c] * (256 - w[0]) + p011[c + strideR] * w[0];
+
+			unsigned c0 = c00 * (256 - w[1]) + c10 * w[1];
+			unsigned c1 = c01 * (256 - w[1]) + c11 * w[1];
+
+			out[c] = FromD3D11Sum(c0 * (256 - w[2]) + c1 * w[2]);
+		}
+	}
+};
+
+template <LutTransfer Transfer> struct TransferFunction;
+
+template <>
+struct TransferFunction<LUT_TRANSFER_NONE>
+{
+	static void Apply(float[3]) {}
+};
+
+template <>
+struct TransferFunction<LUT_TRANSFER_GAMMA22>
+{
+	static void Apply(float rgb[3])
+	{
+		for (int c = 0; c < 3; ++c)
+		{
+			rgb[c] = rgb[c] > 0.0f ? std::pow(rgb[c], 2.2f) : 0.0f;
+		}
+	}
+};
+
+template <ImageFormat InputFormat, ImageFormat OutputFormat, LutInterpolation Interpolation, LutTransfer Transfer>
+void RunKernel(const LutKernelContext& context, const void* src, void* dst, size_t count)
+{
+	typedef PixelTraits<InputFormat> Input;
+	typedef PixelTraits<OutputFormat> Output;
+	typedef typename Input::Encoding In;
+	typedef typename Output::Encoding Out;
+
+	const typename In::Stored* source = static_cast<const typename In::Stored*>(src);
+	typename Out::Stored* target = static_cast<typename Out::Stored*>(dst);
+
+	typename In::Staged inputBlock[KERNEL_BLOCK * 4];
+	typename Out::Staged outputBlock[KERNEL_BLOCK * 4];
+
+	for (size_t done = 0; done < count; done += KERNEL_BLOCK)
+	{
+		const size_t run = count - done < KERNEL_BLOCK ? count - done : KERNEL_BLOCK;
+		const typename In::Stored* codes = source + done * Input::CHANNELS;
+		const typename In::Staged* pixels = In::Stage(codes, run * Input::CHANNELS, inputBlock);
+		typename Out::Staged* results = Out::Target(target + done * Output::CHANNELS, outputBlock);
+
+		for (size_t i = 0; i < run; ++i)
+		{
+			const typename In::Staged* s = pixels + i * Input::CHANNELS;
+			typename Out::Staged* d = results + i * Output::CHANNELS;
+
+			// Everything is read before anything is written, for in-place runs
+			float rgb[3];
+			Interpolator<Interpolation>::template Run<In>(context, codes + i * Input::CHANNELS, s, rgb);
+			TransferFunction<Transfer>::Apply(rgb);
+			const typename Out::Staged alpha = Alpha<In, Out, Input::CHANNELS == 4>::Get(s);
+
+			d[0] = Out::FromFloat(rgb[0]);
+			d[1] = Out::FromFloat(rgb[1]);
+			d[2] = Out::FromFloat(rgb[2]);
+			if (Output::CHANNELS == 4)
+			{
+				d[Output::CHANNELS - 1] = alpha;
+			}
+		}
+
+		Out::Commit(results, target + done * Output::CHANNELS, run * Output::CHANNELS);
+	}
+}
+
+// Separable cubes graded into the input's own encoding: every code maps
+// straight through its channel's table
+template <ImageFormat InputFormat, ImageFormat OutputFormat>
+void RunCodeKernel(const LutKernelContext& context, const void* src, void* dst, size_t count)
+{
+	typedef PixelTraits<InputFormat> Input;
+	typedef PixelTraits<OutputFormat> Output;
+	typedef typename Input::Encoding Encoding;
+
+	const typename Encoding::Stored* source = static_cast<const typename Encoding::Stored*>(src);
+	typename Encoding::Stored* target = static_cast<typename Encoding::Stored*>(dst);
+
+	const typename Encoding::Stored* tableR = Encoding::Codes(context);
+	const typename Encoding::Stored* tableG = tableR + Encoding::CODES;
+	const typename Encoding::Stored* tableB = tableG + Encoding::CODES;
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		const typename Encoding::Stored* s = source + i * Input::CHANNELS;
+		typename Encoding::Stored* d = target + i * Output::CHANNELS;
+
+		const typename Encoding::Stored alpha = Input::CHANNELS == 4 ? s[Input::CHANNELS - 1] : Encoding::OpaqueCode();
+		const typename Encoding::Stored r = tableR[s[0]];
+		const typename Encoding::Stored g = tableG[s[1]];
+		const typename Encoding::Stored b = tableB[s[2]];
+		d[0] = r;
+		d[1] = g;
+		d[2] = b;
+		if (Output::CHANNELS == 4)
+		{
+			d[Output::CHANNELS - 1] = alpha;
+		}
+	}
+}
+
+// The SIMD kernels of every CpuLevel, none for the scalar one
+struct SimdKernelTable
+{
+	LutSimdKernels Levels[LEVEL_COUNT];
+
+	SimdKernelTable()
+	{
+		memset(Levels, 0, sizeof(Levels));
+#ifdef LUT_KERNELS_X86
+		GetLutSimdKernelsSse2(Levels[CPU_LEVEL_SSE2]);
+		GetLutSimdKernelsSse41(Levels[CPU_LEVEL_SSE41]);
+		GetLutSimdKernelsAvx2(Levels[CPU_LEVEL_AVX2]);
+		GetLutSimdKernelsAvx512(Levels[CPU_LEVEL_AVX512]);
+#endif
+	}
+};
+
+// Made before the kernel table below, whose kernels read it
+const SimdKernelTable g_SimdKernelTable;
+
+template <LutInterpolation Interpolation>
+LutSimdKernel GetSimdKernel(CpuLevel level, ImageFormat format)
+{
+	const LutSimdKernels& kernels = g_SimdKernelTable.Levels[level];
+	return Interpolation == LUT_INTERPOLATION_TETRAHEDRAL ? kernels.Tetrahedral[format] : kernels.Trilinear[format];
+}
+
+// A SIMD build over whole vectors of pixels and the scalar kernel over the
+// rest
+template <ImageFormat Format, LutInterpolation Interpolation, CpuLevel Level>
+void RunSimdKernel(const LutKernelContext& context, const void* src, void* dst, size_t count)
+{
+	typedef typename PixelTraits<Format>::Encoding::Stored Stored;
+	const size_t channels = PixelTraits<Format>::CHANNELS;
+	const Stored* source = static_cast<const Stored*>(src);
+	Stored* target = static_cast<Stored*>(dst);
+
+	const size_t done = GetSimdKernel<Interpolation>(Level, Format)(context, source, target, count);
+	RunKernel<Format, Format, Interpolation, LUT_TRANSFER_NONE>(context, source + done * channels, target + done * channels, count - done);
+}
+
+// Half floats are staged a block at a time, as RunKernel stages them
+template <LutInterpolation Interpolation, CpuLevel Level>
+void RunSimdHalfKernel(const LutKernelContext& context, const void* src, void* dst, size_t count)
+{
+	const unsigned short* source = static_cast<const unsigned short*>(src);
+	unsigned short* target = static_cast<unsigned short*>(dst);
+	const LutSimdKernel simd = GetSimdKernel<Interpolation>(Level, IMAGE_FORMAT_RGBA16F);
+
+	float block[KERNEL_BLOCK * 4];
+	for (size_t start = 0; start < count; start += KERNEL_BLOCK)
+	{
+		const size_t run = count - start < KERNEL_BLOCK ? count - start : KERNEL_BLOCK;
+		HalfToFloat(source + start * 4, block, run * 4);
+		const size_t done = simd(context, block, block, run);
+		FloatToHalf(block, target + start * 4, done * 4);
+		RunKernel<IMAGE_FORMAT_RGBA16F, IMAGE_FORMAT_RGBA16F, Interpolation, LUT_TRANSFER_NONE>(
+			context, source + (start + done) * 4, target + (start + done) * 4, run - done);
+	}
+}
+
+template <ImageFormat InputFormat, ImageFormat OutputFormat, LutInterpolation Interpolation, LutTransfer Transfer,
+	bool Codes = Interpolation == LUT_INTERPOLATION_SEPARABLE && Transfer == LUT_TRANSFER_NONE &&
+		std::is_same<typename PixelTraits<InputFormat>::Encoding, typename PixelTraits<OutputFormat>::Encoding>::value>
+struct KernelSelector
+{
+	static LutKernel Get() { return &RunKernel<InputFormat, OutputFormat, Interpolation, Transfer>; }
+};
+
+template <ImageFormat InputFormat, ImageFormat OutputFormat, LutInterpolation Interpolation, LutTransfer Transfer>
+struct KernelSelector<InputFormat, OutputFormat, Interpolation, Transfer, true>
+{
+	static LutKernel Get() { return &RunCodeKernel<InputFormat, OutputFormat>; }
+};
+
+// The table every job picks its kernel from, filled in one combination at a
+// time by the templates below
+struct KernelTable
+{
+	LutKernel Kernels[FORMAT_COUNT][FORMAT_COUNT][INTERPOLATION_COUNT][TRANSFER_COUNT];
+
+	// Trilinear and tetrahedral jobs grading a format into itself, per
+	// CpuLevel; the scalar level takes the kernels above
+	LutKernel Simd[LEVEL_COUNT][FORMAT_COUNT][2];
+
+	template <ImageFormat In, ImageFormat Out, LutInterpolation Interpolation>
+	void AddTransfers()
+	{
+		Kernels[In][Out][Interpolation][LUT_TRANSFER_NONE] = KernelSelector<In, Out, Interpolation, LUT_TRANSFER_NONE>::Get();
+		Kernels[In][Out][Interpolation][LUT_TRANSFER_GAMMA22] = KernelSelector<In, Out, Interpolation, LUT_TRANSFER_GAMMA22>::Get();
+	}
+
+	template <ImageFormat In, ImageFormat Out>
+	void AddInterpolations()
+	{
+		AddTransfers<In, Out, LUT_INTERPOLATION_NEAREST>();
+		AddTransfers<In, Out, LUT_INTERPOLATION_TRILINEAR>();
+		AddTransfers<In, Out, LUT_INTERPOLATION_TETRAHEDRAL>();
+		AddTransfers<In, Out, LUT_INTERPOLATION_SEPARABLE>();
+		AddTransfers<In, Out, LUT_INTERPOLATION_D3D11>();
+	}
+
+	template <CpuLevel Level, LutInterpolation Interpolation>
+	void AddSimdInterpolation()
+	{
+		const int slot = Interpolation == LUT_INTERPOLATION_TETRAHEDRAL;
+		Simd[Level][IMAGE_FORMAT_RGB8][slot] = &RunSimdKernel<IMAGE_FORMAT_RGB8, Interpolation, Level>;
+		Simd[Level][IMAGE_FORMAT_RGBA8][slot] = &RunSimdKernel<IMAGE_FORMAT_RGBA8, Interpolation, Level>;
+		Simd[Level][IMAGE_FORMAT_RGB16][slot] = &RunSimdKernel<IMAGE_FORMAT_RGB16, Interpolation, Level>;
+		Simd[Level][IMAGE_FORMAT_RGBA16][slot] = &RunSimdKernel<IMAGE_FORMAT_RGBA16, Interpolation, Level>;
+		Simd[Level][IMAGE_FORMAT_RGBA16F][slot] = &RunSimdHalfKernel<Interpolation, Level>;
+	}
+
+	template <CpuLevel Level>
+	void AddSimdLevel()
+	{
+		AddSimdInterpolation<Level, LUT_INTERPOLATION_TRILINEAR>();
+		AddSimdInterpolation<Level, LUT_INTERPOLATION_TETRAHEDRAL>();
+	}
+
+	template <ImageFormat In>
+	void AddOutputs()
+	{
+		AddInterpolations<In, IMAGE_FORMAT_RGB8>();
+		AddInterpolations<In, IMAGE_FORMAT_RGBA8>();
+		AddInterpolations<In, IMAGE_FORMAT_RGB16>();
+		AddInterpolations<In, IMAGE_FORMAT_RGBA16>();
+		AddInterpolations<In, IMAGE_FORMAT_RGBA16F>();
+	}
+
+	KernelTable()
+	{
+		AddOutputs<IMAGE_FORMAT_RGB8>();
+		AddOutputs<IMAGE_FORMAT_RGBA8>();
+		AddOutputs<IMAGE_FORMAT_RGB16>();
+		AddOutputs<IMAGE_FORMAT_RGBA16>();
+		AddOutputs<IMAGE_FORMAT_RGBA16F>();
+
+		for (int format = 0; format < FORMAT_COUNT; ++format)
+		{
+			Simd[CPU_LEVEL_SCALAR][format][0] = Kernels[format][format][LUT_INTERPOLATION_TRILINEAR][LUT_TRANSFER_NONE];
+			Simd[CPU_LEVEL_SCALAR][format][1] = Kernels[format][format][LUT_INTERPOLATION_TETRAHEDRAL][LUT_TRANSFER_NONE];
+		}
+#ifdef LUT_KERNELS_X86
+		AddSimdLevel<CPU_LEVEL_SSE2>();
+		AddSimdLevel<CPU_LEVEL_SSE41>();
+		AddSimdLevel<CPU_LEVEL_AVX2>();
+		AddSimdLevel<CPU_LEVEL_AVX512>();
+#else
+		for (int level = CPU_LEVEL_SCALAR + 1; level < LEVEL_COUNT; ++level)
+		{
+			memcpy(Simd[level], Simd[CPU_LEVEL_SCALAR], sizeof(Simd[level]));
+		}
+#endif
+	}
+};
+
+const KernelTable g_KernelTable;
+
+const char* const INTERPOLATION_NAMES[] = { "nearest", "trilinear", "tetrahedral", "separable", "d3d11" };
+const char* const TRANSFER_NAMES[] = { "none", "gamma2.2" };
+
+} // namespace
+
+LutKernel GetLutKernel(ImageFormat input, ImageFormat output, LutInterpolation interpolation, LutTransfer transfer)
+{
+	assert(input < FORMAT_COUNT && output < FORMAT_COUNT);
+	assert(interpolation < INTERPOLATION_COUNT && transfer < TRANSFER_COUNT);
+
+	if (input == output && transfer == LUT_TRANSFER_NONE &&
+		(interpolation == LUT_INTERPOLATION_TRILINEAR || interpolation == LUT_INTERPOLATION_TETRAHEDRAL))
+	{
+		return g_KernelTable.Simd[GetCpuLevel()][input][interpolation == LUT_INTERPOLATION_TETRAHEDRAL];
+	}
+	return g_KernelTable.Kernels[input][output][interpolation][transfer];
+}
+
+const char* GetInterpolationName(LutInterpolation interpolation)
+{
+	return INTERPOLATION_NAMES[interpolation];
+}
+
+const char* GetTransferName(LutTransfer transfer)
+{
+	return TRANSFER_NAMES[transfer];
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "Image.h"
+#include <vector>
+#include <cstddef>
+
+// How a kernel turns the lattice around an input into an output colour
+enum LutInterpolation
+{
+	LUT_INTERPOLATION_NEAREST,     // the closest texel
+	LUT_INTERPOLATION_TRILINEAR,   // the eight corners of the cell
+	LUT_INTERPOLATION_TETRAHEDRAL, // the four corners of the tetrahedron around the input
+	LUT_INTERPOLATION_SEPARABLE,   // per-channel 1D tables, separable cubes only
+	LUT_INTERPOLATION_D3D11,       // the viewer's sampler, see Lut3D::SampleD3D11
+};
+
+// Applied to the interpolated colour before it is stored
+enum LutTransfer
+{
+	LUT_TRANSFER_NONE,
+	LUT_TRANSFER_GAMMA22, // raised to 2.2, as PSMain does after its lookup
+};
+
+// Everything the kernels read, set up once per cube by LutApplier. Only the
+// members the chosen interpolation uses need to be filled in.
+struct LutKernelContext
+{
+	// Lattice as RGB float triples, in linear or bricked order. The corners of
+	// a cell follow its first one at these strides, in floats.
+	const float* Texels;
+	size_t Strides[3];
+	size_t Size;
+
+	// Where each cell starts along each axis, in floats (Size - 1 entries)
+	const unsigned* CellOffsets[3];
+
+	// Cell start along each axis and position inside the cell, for every
+	// 8-bit input value
+	const unsigned* Offsets8[3];
+	const float* Fractions8;
+
+	// Per-channel tables of separable cubes, spanning [0, 1]
+	const std::vector<float>* Tables;
+
+	// The same tables resolved for every input code, channel-major: 256
+	// entries per channel for 8-bit, 65536 for 16-bit unorm and for half bit
+	// patterns. Kernels whose output format matches the input's read these.
+	const unsigned char* Codes8;
+	const unsigned short* Codes16;
+	const unsigned short* CodesHalf;
+
+	// The cube in 8-bit levels, linear order, with its strides and, for every
+	// 8-bit input value, the cell start along each axis and the weight of the
+	// far corner in 1/256 steps
+	const unsigned char* Levels;
+	size_t LevelStrides[3];
+	const unsigned* LevelOffsets8[3];
+	const unsigned* Weights8;
+};
+
+// Grades count interleaved pixels from src into dst. Alpha is carried over,
+// converted if the formats differ, and opaque if the input has none. src and
+// dst may alias when the formats are the same.
+typedef void (*LutKernel)(const LutKernelContext& context, const void* src, void* dst, size_t count);
+
+// One kernel per combination, each compiled for it: the per-pixel loops have
+// no branches on formats, modes or layouts and make no indirect calls.
+// Trilinear and tetrahedral jobs grading a format into itself without a
+// transfer get the SIMD build for GetCpuLevel(), see LutKernelsSimd.h.
+LutKernel GetLutKernel(ImageFormat input, ImageFormat output, LutInterpolation interpolation, LutTransfer transfer);
+
+const char* GetInterpolationName(LutInterpolation interpolation);
+const char* GetTransferName(LutTransfer transfer);
@@ -0,0 +1,50 @@
+#include "LutKernelsSimd.h"
+
+#ifdef LUT_KERNELS_X86
+
+LUT_KERNELS_TARGET_BEGIN("avx2")
+
+#include <immintrin.h>
+
+namespace
+{
+
+struct Avx2Vector
+{
+	typedef __m256 Float;
+	typedef __m256i Int;
+	static const size_t WIDTH = 8;
+
+	static Float Load(const float* p) { return _mm256_loadu_ps(p); }
+	static void Store(float* p, Float value) { _mm256_storeu_ps(p, value); }
+	static Int LoadInt(const int* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+	static void StoreInt(int* p, Int value) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), value); }
+	static Float Set(float value) { return _mm256_set1_ps(value); }
+	static Int SetInt(int value) { return _mm256_set1_epi32(value); }
+	static Int AddInt(Int a, Int b) { return _mm256_add_epi32(a, b); }
+	static Float Add(Float a, Float b) { return _mm256_add_ps(a, b); }
+	static Float Sub(Float a, Float b) { return _mm256_sub_ps(a, b); }
+	static Float Mul(Float a, Float b) { return _mm256_mul_ps(a, b); }
+	static Float Gather(const float* base, Int index) { return _mm256_i32gather_ps(base, index, 4); }
+
+	// Clamped like the scalar ToUnorm8 and ToUnorm16, NaN going to zero
+	static Int ToUnorm(Float value, float scale)
+	{
+		Float scaled = _mm256_add_ps(_mm256_mul_ps(value, _mm256_set1_ps(scale)), _mm256_set1_ps(0.5f));
+		scaled = _mm256_min_ps(_mm256_max_ps(scaled, _mm256_setzero_ps()), _mm256_set1_ps(scale));
+		return _mm256_cvttps_epi32(scaled);
+	}
+};
+
+} // namespace
+
+#include "LutKernelsSimdBody.h"
+
+void GetLutSimdKernelsAvx2(LutSimdKernels& kernels)
+{
+	GetSimdKernels<Avx2Vector>(kernels);
+}
+
+LUT_KERNELS_TARGET_END()
+
+#endif
@@ -0,0 +1,55 @@
+#include "LutKernelsSimd.h"
+
+#ifdef LUT_KERNELS_X86
+
+LUT_KERNELS_TARGET_BEGIN("avx512f")
+
+// GCC's AVX-512 headers start some intrinsics from undefined registers
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+#include <immintrin.h>
+
+namespace
+{
+
+struct Avx512Vector
+{
+	typedef __m512 Float;
+	typedef __m512i Int;
+	static const size_t WIDTH = 16;
+
+	static Float Load(const float* p) { return _mm512_loadu_ps(p); }
+	static void Store(float* p, Float value) { _mm512_storeu_ps(p, value); }
+	static Int LoadInt(const int* p) { return _mm512_loadu_si512(p); }
+	static void StoreInt(int* p, Int value) { _mm512_storeu_si512(p, value); }
+	static Float Set(float value) { return _mm512_set1_ps(value); }
+	static Int SetInt(int value) { return _mm512_set1_epi32(value); }
+	static Int AddInt(Int a, Int b) { return _mm512_add_epi32(a, b); }
+	static Float Add(Float a, Float b) { return _mm512_add_ps(a, b); }
+	static Float Sub(Float a, Float b) { return _mm512_sub_ps(a, b); }
+	static Float Mul(Float a, Float b) { return _mm512_mul_ps(a, b); }
+	static Float Gather(const float* base, Int index) { return _mm512_i32gather_ps(index, base, 4); }
+
+	// Clamped like the scalar ToUnorm8 and ToUnorm16, NaN going to zero
+	static Int ToUnorm(Float value, float scale)
+	{
+		Float scaled = _mm512_add_ps(_mm512_mul_ps(value, _mm512_set1_ps(scale)), _mm512_set1_ps(0.5f));
+		scaled = _mm512_min_ps(_mm512_max_ps(scaled, _mm512_setzero_ps()), _mm512_set1_ps(scale));
+		return _mm512_cvttps_epi32(scaled);
+	}
+};
+
+} // namespace
+
+#include "LutKernelsSimdBody.h"
+
+void GetLutSimdKernelsAvx512(LutSimdKernels& kernels)
+{
+	GetSimdKernels<Avx512Vector>(kernels);
+}
+
+LUT_KERNELS_TARGET_END()
+
+#endif
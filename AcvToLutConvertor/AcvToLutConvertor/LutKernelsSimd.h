@@ -0,0 +1,79 @@
+#pragma once
+
+#include "LutKernels.h"
+#include <cstddef>
+
+namespace
+{
+
+// Cell and position inside it for an input in [0, 1], clamped, NaN going to
+// zero. The last texel takes the last cell with all the weight on its far
+// corner, which blends to the same value as Lut3D::Sample's clamped taps.
+// Shared by the scalar and SIMD kernels, so that both locate alike; it is
+// compiled before any kernel file switches instruction sets.
+inline void LocateFloat(const LutKernelContext& context, float value, int axis, size_t& offset, float& frac)
+{
+	const float scale = (float)(context.Size - 1);
+	float coord = value * scale;
+	coord = coord > 0.0f ? (coord < scale ? coord : scale) : 0.0f;
+
+	size_t cell = (size_t)coord;
+	frac = coord - (float)cell;
+	if (cell > context.Size - 2)
+	{
+		cell = context.Size - 2;
+		frac = 1.0f;
+	}
+	offset = context.CellOffsets[axis][cell];
+}
+
+} // namespace
+
+// Grades whole vectors of pixels into their own format and returns how many
+// it did, leaving the rest to the scalar kernel, whose results it gives to
+// the bit. src and dst may alias. Half-float kernels read and write the
+// pixels staged as floats.
+typedef size_t (*LutSimdKernel)(const LutKernelContext& context, const void* src, void* dst, size_t count);
+
+// The SIMD kernels of one instruction set, by pixel format. Only trilinear
+// and tetrahedral jobs without a transfer have them. Nearest and separable
+// kernels do a load or a table lookup per channel and nothing else, which
+// gathers do not speed up; the D3D11 kernel blends 8-bit levels in integers
+// and is only used to preview what the viewer shows; the gamma transfer
+// costs a pow per channel that dwarfs the lookup.
+struct LutSimdKernels
+{
+	LutSimdKernel Trilinear[IMAGE_FORMAT_RGBA16F + 1];
+	LutSimdKernel Tetrahedral[IMAGE_FORMAT_RGBA16F + 1];
+};
+
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+#define LUT_KERNELS_X86 1
+#endif
+
+#ifdef LUT_KERNELS_X86
+
+// One build per instruction set (see CpuLevel)
+void GetLutSimdKernelsSse2(LutSimdKernels& kernels);
+void GetLutSimdKernelsSse41(LutSimdKernels& kernels);
+void GetLutSimdKernelsAvx2(LutSimdKernels& kernels);
+void GetLutSimdKernelsAvx512(LutSimdKernels& kernels);
+
+// Switches the rest of a kernel file to one instruction set whatever the
+// compiler targets; the kernels are only called on CPUs that have it. GCC
+// must not contract the multiplies and adds into FMAs, which would round
+// differently from the scalar kernel; Clang only contracts within one
+// expression. MSVC takes any intrinsic as it is.
+#define LUT_KERNELS_PRAGMA(text) _Pragma(#text)
+#if defined(__clang__)
+#define LUT_KERNELS_TARGET_BEGIN(isa) LUT_KERNELS_PRAGMA(clang attribute push(__attribute__((target(isa))), apply_to = function))
+#define LUT_KERNELS_TARGET_END() _Pragma("clang attribute pop")
+#elif defined(__GNUC__)
+#define LUT_KERNELS_TARGET_BEGIN(isa) LUT_KERNELS_PRAGMA(GCC target(isa)) _Pragma("GCC optimize(\"fp-contract=off\")")
+#define LUT_KERNELS_TARGET_END()
+#else
+#define LUT_KERNELS_TARGET_BEGIN(isa)
+#define LUT_KERNELS_TARGET_END()
+#endif
+
+#endif
@@ -0,0 +1,274 @@
+#pragma once
+
+// The SIMD kernels, written once against a Vector type that each
+// LutKernels<instruction set>.cpp defines before including this, with the
+// compiler already switched to that instruction set by
+// LUT_KERNELS_TARGET_BEGIN. One lane per pixel:
+// cells are located lane by lane, as the scalar kernel locates them, then the
+// corners of a whole vector of pixels are gathered and blended together.
+// Multiplies and adds stay separate, as in the scalar kernel, so no lane
+// rounds differently.
+
+namespace
+{
+
+// How the pixels of one encoding reach the lanes: where a code's cell starts
+// and how far into it it lies, how the corners blend (see Blend in
+// LutKernels.cpp), and how blended values are stored
+struct Unorm8Lanes
+{
+	typedef unsigned char Code;
+	typedef int Result;
+	static const bool LERP = true;
+
+	static void Locate(const LutKernelContext& context, Code value, int axis, int& offset, float& frac)
+	{
+		offset = (int)context.Offsets8[axis][value];
+		frac = context.Fractions8[value];
+	}
+
+	template <class Vector>
+	static void Store(typename Vector::Float value, Result* results)
+	{
+		Vector::StoreInt(results, Vector::ToUnorm(value, 255.0f));
+	}
+};
+
+struct Unorm16Lanes
+{
+	typedef unsigned short Code;
+	typedef int Result;
+	static const bool LERP = false;
+
+	static void Locate(const LutKernelContext& context, Code value, int axis, int& offset, float& frac)
+	{
+		size_t start;
+		LocateFloat(context, (float)value * (1.0f / 65535.0f), axis, start, frac);
+		offset = (int)start;
+	}
+
+	template <class Vector>
+	static void Store(typename Vector::Float value, Result* results)
+	{
+		Vector::StoreInt(results, Vector::ToUnorm(value, 65535.0f));
+	}
+};
+
+// Half floats, staged as floats by the caller
+struct FloatLanes
+{
+	typedef float Code;
+	typedef float Result;
+	static const bool LERP = false;
+
+	static void Locate(const LutKernelContext& context, Code value, int axis, int& offset, float& frac)
+	{
+		size_t start;
+		LocateFloat(context, value, axis, start, frac);
+		offset = (int)start;
+	}
+
+	template <class Vector>
+	static void Store(typename Vector::Float value, Result* results)
+	{
+		Vector::Store(results, value);
+	}
+};
+
+template <class Vector, bool Lerp>
+typename Vector::Float Blend(typename Vector::Float a, typename Vector::Float b, typename Vector::Float frac)
+{
+	if (Lerp)
+	{
+		return Vector::Add(a, Vector::Mul(Vector::Sub(b, a), frac));
+	}
+	return Vector::Add(Vector::Mul(a, Vector::Sub(Vector::Set(1.0f), frac)), Vector::Mul(b, frac));
+}
+
+// The corners of each lane's cell, blended like Interpolator<...>::Run
+template <class Vector, class Lanes, LutInterpolation Interpolation>
+struct SimdInterpolator;
+
+template <class Vector, class Lanes>
+struct SimdInterpolator<Vector, Lanes, LUT_INTERPOLATION_TRILINEAR>
+{
+	typedef typename Vector::Float Float;
+	typedef typename Vector::Int Int;
+	static const size_t WIDTH = Vector::WIDTH;
+
+	explicit SimdInterpolator(const LutKernelContext& context)
+		: m_Context(context)
+		, m_StrideR(Vector::SetInt((int)context.Strides[0]))
+		, m_StrideG(Vector::SetInt((int)context.Strides[1]))
+		, m_StrideB(Vector::SetInt((int)context.Strides[2]))
+	{}
+
+	void Locate(size_t lane, const typename Lanes::Code* pixel)
+	{
+		int offsets[3];
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			Lanes::Locate(m_Context, pixel[axis], axis, offsets[axis], m_Fractions[axis][lane]);
+		}
+		m_Offsets[lane] = offsets[0] + offsets[1] + offsets[2];
+	}
+
+	void Run(typename Lanes::Result results[3][WIDTH]) const
+	{
+		const Int i000 = Vector::LoadInt(m_Offsets);
+		const Int i010 = Vector::AddInt(i000, m_StrideG);
+		const Int i001 = Vector::AddInt(i000, m_StrideB);
+		const Int i011 = Vector::AddInt(i001, m_StrideG);
+		const Float fr = Vector::Load(m_Fractions[0]);
+		const Float fg = Vector::Load(m_Fractions[1]);
+		const Float fb = Vector::Load(m_Fractions[2]);
+
+		for (int c = 0; c < 3; ++c)
+		{
+			const float* texels = m_Context.Texels + c;
+
+			Float c00 = Blend<Vector, Lanes::LERP>(Vector::Gather(texels, i000), Vector::Gather(texels, Vector::AddInt(i000, m_StrideR)), fr);
+			Float c10 = Blend<Vector, Lanes::LERP>(Vector::Gather(texels, i010), Vector::Gather(texels, Vector::AddInt(i010, m_StrideR)), fr);
+			Float c01 = Blend<Vector, Lanes::LERP>(Vector::Gather(texels, i001), Vector::Gather(texels, Vector::AddInt(i001, m_StrideR)), fr);
+			Float c11 = Blend<Vector, Lanes::LERP>(Vector::Gather(texels, i011), Vector::Gather(texels, Vector::AddInt(i011, m_StrideR)), fr);
+
+			Float c0 = Blend<Vector, Lanes::LERP>(c00, c10, fg);
+			Float c1 = Blend<Vector, Lanes::LERP>(c01, c11, fg);
+
+			Lanes::template Store<Vector>(Blend<Vector, Lanes::LERP>(c0, c1, fb), results[c]);
+		}
+	}
+
+	const LutKernelContext& m_Context;
+	const Int m_StrideR;
+	const Int m_StrideG;
+	const Int m_StrideB;
+	int m_Offsets[WIDTH];
+	float m_Fractions[3][WIDTH];
+};
+
+template <class Vector, class Lanes>
+struct SimdInterpolator<Vector, Lanes, LUT_INTERPOLATION_TETRAHEDRAL>
+{
+	typedef typename Vector::Float Float;
+	typedef typename Vector::Int Int;
+	static const size_t WIDTH = Vector::WIDTH;
+
+	explicit SimdInterpolator(const LutKernelContext& context)
+		: m_Context(context)
+		, m_Diagonal(Vector::SetInt((int)(context.Strides[0] + context.Strides[1] + context.Strides[2])))
+	{}
+
+	// Each lane walks its own tetrahedron, so the order of the fractions is
+	// resolved here and the vectors only see the corners and weights in
+	// walking order
+	void Locate(size_t lane, const typename Lanes::Code* pixel)
+	{
+		static const int ORDERS[8][3] =
+		{
+			{ 2, 1, 0 }, { 2, 0, 1 }, { 1, 2, 0 }, { 0, 1, 2 },
+			{ 2, 1, 0 }, { 0, 2, 1 }, { 1, 0, 2 }, { 0, 1, 2 },
+		};
+
+		int offsets[3];
+		float frac[3];
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			Lanes::Locate(m_Context, pixel[axis], axis, offsets[axis], frac[axis]);
+		}
+		const int* order = ORDERS[(frac[0] >= frac[1]) | (frac[1] >= frac[2]) << 1 | (frac[0] >= frac[2]) << 2];
+
+		m_Corners[0][lane] = offsets[0] + offsets[1] + offsets[2];
+		m_Corners[1][lane] = m_Corners[0][lane] + (int)m_Context.Strides[order[0]];
+		m_Corners[2][lane] = m_Corners[1][lane] + (int)m_Context.Strides[order[1]];
+		m_Fractions[0][lane] = frac[order[0]];
+		m_Fractions[1][lane] = frac[order[1]];
+		m_Fractions[2][lane] = frac[order[2]];
+	}
+
+	void Run(typename Lanes::Result results[3][WIDTH]) const
+	{
+		const Int i0 = Vector::LoadInt(m_Corners[0]);
+		const Int i1 = Vector::LoadInt(m_Corners[1]);
+		const Int i2 = Vector::LoadInt(m_Corners[2]);
+		const Int i3 = Vector::AddInt(i0, m_Diagonal);
+		const Float f0 = Vector::Load(m_Fractions[0]);
+		const Float f1 = Vector::Load(m_Fractions[1]);
+		const Float f2 = Vector::Load(m_Fractions[2]);
+
+		for (int c = 0; c < 3; ++c)
+		{
+			const float* texels = m_Context.Texels + c;
+			const Float p0 = Vector::Gather(texels, i0);
+			const Float p1 = Vector::Gather(texels, i1);
+			const Float p2 = Vector::Gather(texels, i2);
+			const Float p3 = Vector::Gather(texels, i3);
+
+			Float value = Vector::Add(p0, Vector::Mul(Vector::Sub(p1, p0), f0));
+			value = Vector::Add(value, Vector::Mul(Vector::Sub(p2, p1), f1));
+			value = Vector::Add(value, Vector::Mul(Vector::Sub(p3, p2), f2));
+			Lanes::template Store<Vector>(value, results[c]);
+		}
+	}
+
+	const LutKernelContext& m_Context;
+	const Int m_Diagonal;
+	int m_Corners[3][WIDTH];
+	float m_Fractions[3][WIDTH];
+};
+
+template <class Vector, class Lanes, LutInterpolation Interpolation, size_t Channels>
+size_t ApplySimd(const LutKernelContext& context, const void* src, void* dst, size_t count)
+{
+	typedef typename Lanes::Code Code;
+	const size_t WIDTH = Vector::WIDTH;
+
+	SimdInterpolator<Vector, Lanes, Interpolation> interpolator(context);
+	typename Lanes::Result results[3][WIDTH];
+
+	size_t done = 0;
+	for (; done + WIDTH <= count; done += WIDTH)
+	{
+		const Code* s = static_cast<const Code*>(src) + done * Channels;
+		Code* d = static_cast<Code*>(dst) + done * Channels;
+
+		for (size_t i = 0; i < WIDTH; ++i)
+		{
+			interpolator.Locate(i, s + i * Channels);
+		}
+		interpolator.Run(results);
+
+		// Every source pixel of the vector has been read by now
+		for (size_t i = 0; i < WIDTH; ++i)
+		{
+			Code* pixel = d + i * Channels;
+			if (Channels == 4)
+			{
+				pixel[Channels - 1] = s[i * Channels + Channels - 1];
+			}
+			pixel[0] = (Code)results[0][i];
+			pixel[1] = (Code)results[1][i];
+			pixel[2] = (Code)results[2][i];
+		}
+	}
+	return done;
+}
+
+template <class Vector, LutInterpolation Interpolation>
+void AddSimdKernels(LutSimdKernel kernels[IMAGE_FORMAT_RGBA16F + 1])
+{
+	kernels[IMAGE_FORMAT_RGB8] = &ApplySimd<Vector, Unorm8Lanes, Interpolation, 3>;
+	kernels[IMAGE_FORMAT_RGBA8] = &ApplySimd<Vector, Unorm8Lanes, Interpolation, 4>;
+	kernels[IMAGE_FORMAT_RGB16] = &ApplySimd<Vector, Unorm16Lanes, Interpolation, 3>;
+	kernels[IMAGE_FORMAT_RGBA16] = &ApplySimd<Vector, Unorm16Lanes, Interpolation, 4>;
+	kernels[IMAGE_FORMAT_RGBA16F] = &ApplySimd<Vector, FloatLanes, Interpolation, 4>;
+}
+
+template <class Vector>
+void GetSimdKernels(LutSimdKernels& kernels)
+{
+	AddSimdKernels<Vector, LUT_INTERPOLATION_TRILINEAR>(kernels.Trilinear);
+	AddSimdKernels<Vector, LUT_INTERPOLATION_TETRAHEDRAL>(kernels.Tetrahedral);
+}
+
+} // namespace
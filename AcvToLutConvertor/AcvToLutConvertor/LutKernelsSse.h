@@ -0,0 +1,46 @@
+#pragma once
+
+// The 128-bit Vector shared by the SSE2 and SSE4.1 kernels, included once
+// the file has switched to its instruction set. SSE2 has no gathers nor
+// lane extracts, so the indices go through memory; the SSE4.1 kernel
+// replaces Gather.
+
+#include <emmintrin.h>
+
+namespace
+{
+
+struct SseVector
+{
+	typedef __m128 Float;
+	typedef __m128i Int;
+	static const size_t WIDTH = 4;
+
+	static Float Load(const float* p) { return _mm_loadu_ps(p); }
+	static void Store(float* p, Float value) { _mm_storeu_ps(p, value); }
+	static Int LoadInt(const int* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+	static void StoreInt(int* p, Int value) { _mm_storeu_si128(reinterpret_cast<__m128i*>(p), value); }
+	static Float Set(float value) { return _mm_set1_ps(value); }
+	static Int SetInt(int value) { return _mm_set1_epi32(value); }
+	static Int AddInt(Int a, Int b) { return _mm_add_epi32(a, b); }
+	static Float Add(Float a, Float b) { return _mm_add_ps(a, b); }
+	static Float Sub(Float a, Float b) { return _mm_sub_ps(a, b); }
+	static Float Mul(Float a, Float b) { return _mm_mul_ps(a, b); }
+
+	static Float Gather(const float* base, Int index)
+	{
+		int lanes[4];
+		StoreInt(lanes, index);
+		return _mm_setr_ps(base[lanes[0]], base[lanes[1]], base[lanes[2]], base[lanes[3]]);
+	}
+
+	// Clamped like the scalar ToUnorm8 and ToUnorm16, NaN going to zero
+	static Int ToUnorm(Float value, float scale)
+	{
+		Float scaled = _mm_add_ps(_mm_mul_ps(value, _mm_set1_ps(scale)), _mm_set1_ps(0.5f));
+		scaled = _mm_min_ps(_mm_max_ps(scaled, _mm_setzero_ps()), _mm_set1_ps(scale));
+		return _mm_cvttps_epi32(scaled);
+	}
+};
+
+} // namespace
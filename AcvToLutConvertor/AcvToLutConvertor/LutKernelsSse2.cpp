@@ -0,0 +1,17 @@
+#include "LutKernelsSimd.h"
+
+#ifdef LUT_KERNELS_X86
+
+LUT_KERNELS_TARGET_BEGIN("sse2")
+
+#include "LutKernelsSse.h"
+#include "LutKernelsSimdBody.h"
+
+void GetLutSimdKernelsSse2(LutSimdKernels& kernels)
+{
+	GetSimdKernels<SseVector>(kernels);
+}
+
+LUT_KERNELS_TARGET_END()
+
+#endif
@@ -0,0 +1,36 @@
+#include "LutKernelsSimd.h"
+
+#ifdef LUT_KERNELS_X86
+
+LUT_KERNELS_TARGET_BEGIN("sse4.1")
+
+#include "LutKernelsSse.h"
+#include <smmintrin.h>
+
+namespace
+{
+
+struct Sse41Vector : SseVector
+{
+	// The indices are extracted and the loads inserted in registers
+	static Float Gather(const float* base, Int index)
+	{
+		Float value = _mm_load_ss(base + _mm_cvtsi128_si32(index));
+		value = _mm_insert_ps(value, _mm_load_ss(base + _mm_extract_epi32(index, 1)), 0x10);
+		value = _mm_insert_ps(value, _mm_load_ss(base + _mm_extract_epi32(index, 2)), 0x20);
+		return _mm_insert_ps(value, _mm_load_ss(base + _mm_extract_epi32(index, 3)), 0x30);
+	}
+};
+
+} // namespace
+
+#include "LutKernelsSimdBody.h"
+
+void GetLutSimdKernelsSse41(LutSimdKernels& kernels)
+{
+	GetSimdKernels<Sse41Vector>(kernels);
+}
+
+LUT_KERNELS_TARGET_END()
+
+#endif
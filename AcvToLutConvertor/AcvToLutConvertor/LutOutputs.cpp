@@ -0,0 +1,123 @@
+#include "LutOutputs.h"
+#include "DdsVolume.h"
+#include "CubeFile.h"
+#include "PipelineStats.h"
+#include "Trace.h"
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+namespace
+{
+
+bool WriteLutFile(const PathChar* path, const Lut3D& lut, const LutShaper& shaper)
+{
+	const std::string extension = GetPathExtension(path);
+	if (extension == "dds")
+	{
+		return WriteDdsVolume(path, lut) && (shaper.IsIdentity() || WriteDdsShaper(GetDdsShaperPath(path).c_str(), shaper));
+	}
+	if (extension == "cube")
+	{
+		return WriteCubeFile(path, lut, &shaper);
+	}
+
+	std::cerr << "Unknown LUT output format: " << NarrowPath(path) << std::endl;
+	return false;
+}
+
+} // namespace
+
+bool IsLutOutputFormat(const std::string& extension)
+{
+	return extension == "dds" || extension == "cube";
+}
+
+bool WriteLutOutputs(const LutChain& chain, const std::vector<LutOutputFile>& outputs, LutShaperKind shaperKind)
+{
+	std::vector<size_t> sizes;
+	for (size_t i = 0; i < outputs.size(); ++i)
+	{
+		sizes.push_back(outputs[i].Size);
+	}
+	std::sort(sizes.begin(), sizes.end());
+	sizes.erase(std::unique(sizes.begin(), sizes.end()), sizes.end());
+
+	std::vector<LutShaper> shapers(sizes.size());
+	for (size_t s = 0; s < sizes.size(); ++s)
+	{
+		shapers[s] = LutShaper::Create(shaperKind, chain, sizes[s]);
+	}
+
+	// The lattices of all sizes back to back, through the chain in one go
+	const bool separable = chain.IsSeparable();
+	std::vector<size_t> starts(sizes.size());
+	std::vector<float> tables[3];
+	if (separable)
+	{
+		StageTimer timer(PIPELINE_STAGE_BAKE);
+		std::vector<float> lattices;
+		for (size_t s = 0; s < sizes.size(); ++s)
+		{
+			starts[s] = lattices.size();
+			for (size_t i = 0; i < sizes[s]; ++i)
+			{
+				const float coord = (float)i / (float)(sizes[s] - 1);
+				lattices.push_back(shapers[s].Inverse(coord));
+			}
+		}
+		for (int c = 0; c < 3; ++c)
+		{
+			tables[c].resize(lattices.size());
+			chain.EvaluateSeparable(c, &lattices[0], &tables[c][0], lattices.size());
+		}
+	}
+
+	std::vector<char> written(sizes.size(), 0);
+	std::vector<std::thread> threads;
+	for (size_t s = 0; s < sizes.size(); ++s)
+	{
+		threads.push_back(std::thread([&, s]()
+		{
+			const size_t size = sizes[s];
+			std::ostringstream name;
+			name << "size " << size;
+			SetTraceThreadName(name.str().c_str());
+
+			Lut3D lut;
+			if (separable)
+			{
+				std::vector<float> channels[3];
+				for (int c = 0; c < 3; ++c)
+				{
+					channels[c].assign(tables[c].begin() + starts[s], tables[c].begin() + starts[s] + size);
+				}
+				StageTimer timer(PIPELINE_STAGE_FILL);
+				lut = Lut3D::FromSeparableTables(channels[0], channels[1], channels[2]);
+			}
+			else
+			{
+				lut = chain.Bake(size, &shapers[s]);
+			}
+
+			bool ok = true;
+			for (size_t i = 0; i < outputs.size(); ++i)
+			{
+				if (outputs[i].Size == size && !WriteLutFile(outputs[i].Path.c_str(), lut, shapers[s]))
+				{
+					ok = false;
+				}
+			}
+			written[s] = ok;
+		}));
+	}
+
+	bool ok = true;
+	for (size_t s = 0; s < threads.size(); ++s)
+	{
+		threads[s].join();
+		ok = ok && written[s];
+	}
+	return ok;
+}
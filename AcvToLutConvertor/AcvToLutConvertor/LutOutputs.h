@@ -0,0 +1,32 @@
+#pragma once
+
+#include "Platform.h"
+#include "LutChain.h"
+#include "LutShaper.h"
+#include <string>
+#include <vector>
+
+// One file to write: the look baked at Size, in the format the extension of
+// Path names
+struct LutOutputFile
+{
+	size_t Size;
+	PathString Path;
+};
+
+// Extensions WriteLutOutputs can write: dds and cube
+bool IsLutOutputFormat(const std::string& extension);
+
+//
+// Writes a look at several cube sizes and in several formats from one bake.
+// Separable chains run the lattice values of every size through their curves
+// and tables in a single pass per channel; other chains are resampled once per
+// size. Each size is then filled, encoded and written on a thread of its own,
+// every format of a size sharing one cube. False when any output failed, after
+// reporting it.
+//
+// With a shaper every size is baked behind one of its own (fitted shapers
+// differ from size to size); DDS volumes get it in a sidecar (see
+// GetDdsShaperPath) and .cube files as their 1D table.
+//
+bool WriteLutOutputs(const LutChain& chain, const std::vector<LutOutputFile>& outputs, LutShaperKind shaperKind = LUT_SHAPER_NONE);
@@ -0,0 +1,399 @@
+#include "LutPack.h"
+#include "DdsVolume.h"
+#include "LutChain.h"
+#include "Lut3D.h"
+#include "LutShaper.h"
+#include <algorithm>
+#include <iostream>
+#include <vector>
+#include <cassert>
+#include <cctype>
+#include <cstring>
+
+namespace
+{
+
+bool EntryBefore(const LutPackEntry& entry, unsigned long long hash)
+{
+	return entry.NameHash < hash;
+}
+
+// A LUT on its way into a pack
+struct PackedLut
+{
+	std::string Name;
+	PathString Source;
+	unsigned long long SourceOffset; // of the payload, when read from Source
+	std::vector<unsigned char> Baked; // the payload itself for ACV files
+	std::vector<unsigned char> Shaper; // levels to append, for shaped volumes
+	LutPackEntry Entry;
+};
+
+bool PackedBefore(const PackedLut& a, const PackedLut& b)
+{
+	return a.Entry.NameHash != b.Entry.NameHash ? a.Entry.NameHash < b.Entry.NameHash : a.Name < b.Name;
+}
+
+bool PrepareLut(const PathString& path, bool topLevelOnly, PackedLut& packed)
+{
+	LutPackEntry& entry = packed.Entry;
+	const size_t headerSize = (size_t)DDS_VOLUME_TEXEL_OFFSET;
+
+	if (GetPathExtension(path.c_str()) == "acv")
+	{
+		LutChain chain;
+		if (!chain.AddFile(path.c_str()))
+		{
+			return false;
+		}
+		const Lut3D lut = chain.Bake(DEFAULT_CUBE_SIZE);
+		EncodeDdsVolume(lut, packed.Baked);
+
+		const size_t size = lut.GetSize();
+		if (topLevelOnly)
+		{
+			packed.Baked.erase(packed.Baked.begin() + headerSize + size * size * size * 4, packed.Baked.end());
+			packed.Baked.erase(packed.Baked.begin(), packed.Baked.begin() + headerSize);
+		}
+		entry.Size = (unsigned)size;
+		entry.Masks[0] = 0x00FF0000;
+		entry.Masks[1] = 0x0000FF00;
+		entry.Masks[2] = 0x000000FF;
+		entry.TexelOffset = topLevelOnly ? 0 : headerSize;
+		entry.DataSize = packed.Baked.size();
+		packed.SourceOffset = 0;
+	}
+	else
+	{
+		DdsVolumeLayout layout;
+		FileStamp stamp;
+		if (!ReadDdsVolumeLayout(path.c_str(), layout) || !GetFileStamp(path.c_str(), stamp))
+		{
+			return false;
+		}
+
+		const PathString shaperPath = GetDdsShaperPath(path.c_str());
+		FileStamp shaperStamp;
+		LutShaper shaper;
+		if (GetFileStamp(shaperPath.c_str(), shaperStamp) && !ReadDdsShaper(shaperPath.c_str(), shaper))
+		{
+			return false;
+		}
+		EncodeDdsShaper(shaper, packed.Shaper);
+
+		entry.Size = (unsigned)layout.Size;
+		memcpy(entry.Masks, layout.Masks, sizeof(entry.Masks));
+		if (topLevelOnly)
+		{
+			entry.TexelOffset = 0;
+			entry.DataSize = (unsigned long long)layout.Size * layout.Size * layout.Size * 4;
+			packed.SourceOffset = layout.TexelOffset;
+		}
+		else
+		{
+			entry.TexelOffset = layout.TexelOffset;
+			entry.DataSize = stamp.Size;
+			packed.SourceOffset = 0;
+		}
+		entry.ShaperSize = (unsigned)packed.Shaper.size();
+		entry.DataSize += entry.ShaperSize;
+	}
+
+	entry.Flags = topLevelOnly ? LUT_PACK_TOP_LEVEL : 0;
+	packed.Source = path;
+	return true;
+}
+
+bool WritePadding(FILE* file, unsigned long long from, unsigned long long to)
+{
+	static const unsigned char zeros[LUT_PACK_ALIGNMENT] = {};
+	assert(to - from <= LUT_PACK_ALIGNMENT);
+	return fwrite(zeros, 1, (size_t)(to - from), file) == (size_t)(to - from);
+}
+
+bool WritePayload(FILE* file, const PackedLut& packed, std::vector<unsigned char>& buffer)
+{
+	if (!packed.Baked.empty())
+	{
+		return fwrite(&packed.Baked[0], 1, packed.Baked.size(), file) == packed.Baked.size();
+	}
+
+	FILE* source = OpenNativeFile(packed.Source.c_str(), "rb");
+	if (!source)
+	{
+		std::cerr << "Unable to open file: " << NarrowPath(packed.Source.c_str()) << std::endl;
+		return false;
+	}
+
+	buffer.resize((size_t)(packed.Entry.DataSize - packed.Entry.ShaperSize));
+	const bool ok = fseek(source, (long)packed.SourceOffset, SEEK_SET) == 0 &&
+		fread(&buffer[0], 1, buffer.size(), source) == buffer.size();
+	fclose(source);
+	if (!ok)
+	{
+		std::cerr << "File changed while packing: " << NarrowPath(packed.Source.c_str()) << std::endl;
+		return false;
+	}
+	return fwrite(&buffer[0], 1, buffer.size(), file) == buffer.size() &&
+		(packed.Shaper.empty() || fwrite(&packed.Shaper[0], 1, packed.Shaper.size(), file) == packed.Shaper.size());
+}
+
+} // namespace
+
+unsigned long long HashLutName(const char* name, size_t length)
+{
+	return HashBytes(name, length);
+}
+
+LutPack::LutPack()
+	: m_Data(nullptr)
+	, m_Entries(nullptr)
+	, m_EntryCount(0)
+	, m_Names(nullptr)
+{}
+
+bool LutPack::Open(const PathChar* path)
+{
+	Close();
+	m_Path = NarrowPath(path);
+
+	if (!m_File.Open(path, false))
+	{
+		return false;
+	}
+
+	const unsigned long long fileSize = m_File.GetSize();
+	m_Data = fileSize >= sizeof(LutPackHeader) && fileSize == (size_t)fileSize ? m_File.MapWindow(0, (size_t)fileSize) : nullptr;
+	const LutPackHeader* header = reinterpret_cast<const LutPackHeader*>(m_Data);
+	if (!header || header->Magic != LUT_PACK_MAGIC || header->Version == 0 || header->Version > LUT_PACK_VERSION)
+	{
+		std::cerr << "Not a LUT pack: " << m_Path << std::endl;
+		Close();
+		return false;
+	}
+
+	const unsigned long long indexEnd = sizeof(LutPackHeader) + (unsigned long long)header->EntryCount * sizeof(LutPackEntry);
+	bool ok = indexEnd <= fileSize && header->NamesOffset >= indexEnd && header->NamesOffset <= fileSize &&
+		header->NamesSize <= fileSize - header->NamesOffset;
+
+	const LutPackEntry* entries = reinterpret_cast<const LutPackEntry*>(m_Data + sizeof(LutPackHeader));
+	for (unsigned i = 0; ok && i < header->EntryCount; ++i)
+	{
+		const LutPackEntry& entry = entries[i];
+		const unsigned long long texelSize = (unsigned long long)entry.Size * entry.Size * entry.Size * 4;
+		const unsigned long long volumeSize = entry.DataSize - entry.ShaperSize;
+		ok = (unsigned long long)entry.NameOffset + entry.NameLength <= header->NamesSize &&
+			entry.DataOffset % LUT_PACK_ALIGNMENT == 0 && entry.DataOffset <= fileSize && entry.DataSize <= fileSize - entry.DataOffset &&
+			entry.ShaperSize <= entry.DataSize && entry.ShaperSize % 2 == 0 && entry.ShaperSize != 2 && entry.ShaperSize <= 65536 * 2 &&
+			entry.Size >= 2 && entry.Size <= 256 && entry.TexelOffset <= volumeSize && texelSize <= volumeSize - entry.TexelOffset &&
+			(i == 0 || entries[i - 1].NameHash <= entry.NameHash);
+	}
+	if (!ok)
+	{
+		std::cerr << "LUT pack is truncated or its index is damaged: " << m_Path << std::endl;
+		Close();
+		return false;
+	}
+
+	m_Entries = entries;
+	m_EntryCount = header->EntryCount;
+	m_Names = reinterpret_cast<const char*>(m_Data + header->NamesOffset);
+	return true;
+}
+
+void LutPack::Close()
+{
+	m_File.Close();
+	m_Data = nullptr;
+	m_Entries = nullptr;
+	m_EntryCount = 0;
+	m_Names = nullptr;
+}
+
+std::string LutPack::GetName(const LutPackEntry& entry) const
+{
+	return std::string(m_Names + entry.NameOffset, entry.NameLength);
+}
+
+const LutPackEntry* LutPack::Find(const std::string& name) const
+{
+	const unsigned long long hash = HashLutName(name.data(), name.size());
+	const LutPackEntry* end = m_Entries + m_EntryCount;
+	for (const LutPackEntry* entry = std::lower_bound(m_Entries, end, hash, EntryBefore);
+		entry != end && entry->NameHash == hash; ++entry)
+	{
+		if (entry->NameLength == name.size() && memcmp(m_Names + entry->NameOffset, name.data(), name.size()) == 0)
+		{
+			return entry;
+		}
+	}
+	return nullptr;
+}
+
+const unsigned char* LutPack::GetPayload(const LutPackEntry& entry) const
+{
+	return m_Data + entry.DataOffset;
+}
+
+bool LutPack::ReadLut(const LutPackEntry& entry, Lut3D& lut) const
+{
+	DdsVolumeLayout layout;
+	layout.Size = entry.Size;
+	layout.TexelOffset = entry.TexelOffset;
+	memcpy(layout.Masks, entry.Masks, sizeof(layout.Masks));
+
+	if (!DecodeDdsVolume(GetPayload(entry) + entry.TexelOffset, layout, lut))
+	{
+		std::cerr << "Unsupported channel masks for " << GetName(entry) << " in LUT pack: " << m_Path << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool LutPack::ReadShaper(const LutPackEntry& entry, LutShaper& shaper) const
+{
+	shaper = LutShaper();
+	if (entry.ShaperSize == 0)
+	{
+		return true;
+	}
+
+	const unsigned char* levels = GetPayload(entry) + entry.DataSize - entry.ShaperSize;
+	if (!DecodeDdsShaper(levels, entry.ShaperSize / 2, shaper))
+	{
+		std::cerr << "Shaper does not rise from 0 to 1 for " << GetName(entry) << " in LUT pack: " << m_Path << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool LutPack::ReadLut(const std::string& name, Lut3D& lut, LutShaper& shaper) const
+{
+	const LutPackEntry* entry = Find(name);
+	if (!entry)
+	{
+		std::cerr << "No LUT named " << name << " in pack: " << m_Path << std::endl;
+		return false;
+	}
+	return ReadLut(*entry, lut) && ReadShaper(*entry, shaper);
+}
+
+bool WriteLutPack(const PathChar* path, const PathChar* directory, bool topLevelOnly)
+{
+	std::vector<PathString> files;
+	if (!ListFiles(directory, files))
+	{
+		std::cerr << "Unable to open directory: " << NarrowPath(directory) << std::endl;
+		return false;
+	}
+
+	std::vector<PackedLut> luts;
+	for (size_t i = 0; i < files.size(); ++i)
+	{
+		const std::string extension = GetPathExtension(files[i].c_str());
+		if ((extension != "acv" && extension != "dds") || IsDdsShaperPath(files[i].c_str()))
+		{
+			continue;
+		}
+
+		luts.push_back(PackedLut());
+		PackedLut& packed = luts.back();
+		memset(&packed.Entry, 0, sizeof(packed.Entry));
+		if (!PrepareLut(PathString(directory) + PATH_LITERAL("/") + files[i], topLevelOnly, packed))
+		{
+			return false;
+		}
+		packed.Name = NarrowPath(files[i].c_str());
+		packed.Entry.NameHash = HashLutName(packed.Name.data(), packed.Name.size());
+	}
+
+	if (luts.empty())
+	{
+		std::cerr << "No .acv or .dds files under: " << NarrowPath(directory) << std::endl;
+		return false;
+	}
+	std::sort(luts.begin(), luts.end(), PackedBefore);
+
+	// Index, names, then the payloads on page boundaries
+	LutPackHeader header = {};
+	header.Magic = LUT_PACK_MAGIC;
+	header.Version = LUT_PACK_VERSION;
+	header.EntryCount = (unsigned)luts.size();
+	header.NamesOffset = sizeof(LutPackHeader) + luts.size() * sizeof(LutPackEntry);
+
+	std::string names;
+	for (size_t i = 0; i < luts.size(); ++i)
+	{
+		luts[i].Entry.NameOffset = (unsigned)names.size();
+		luts[i].Entry.NameLength = (unsigned)luts[i].Name.size();
+		names += luts[i].Name;
+	}
+	header.NamesSize = names.size();
+
+	unsigned long long offset = header.NamesOffset + header.NamesSize;
+	for (size_t i = 0; i < luts.size(); ++i)
+	{
+		offset = (offset + LUT_PACK_ALIGNMENT - 1) / LUT_PACK_ALIGNMENT * LUT_PACK_ALIGNMENT;
+		luts[i].Entry.DataOffset = offset;
+		offset += luts[i].Entry.DataSize;
+	}
+
+	FILE* file = OpenNativeFile(path, "wb");
+	if (!file)
+	{
+		std::cerr << "Unable to create file: " << NarrowPath(path) << std::endl;
+		return false;
+	}
+
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+	for (size_t i = 0; ok && i < luts.size(); ++i)
+	{
+		ok = fwrite(&luts[i].Entry, sizeof(LutPackEntry), 1, file) == 1;
+	}
+	ok = ok && fwrite(names.data(), 1, names.size(), file) == names.size();
+
+	offset = header.NamesOffset + header.NamesSize;
+	std::vector<unsigned char> buffer;
+	for (size_t i = 0; ok && i < luts.size(); ++i)
+	{
+		ok = WritePadding(file, offset, luts[i].Entry.DataOffset) && WritePayload(file, luts[i], buffer);
+		offset = luts[i].Entry.DataOffset + luts[i].Entry.DataSize;
+	}
+
+	if (fclose(file) != 0 || !ok)
+	{
+		std::cerr << "Unable to write file: " << NarrowPath(path) << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool SplitLutPackPath(const PathChar* path, PathString& packPath, std::string& name)
+{
+	static const char extension[] = ".lutpack";
+	const size_t extensionLength = sizeof(extension) - 1;
+
+	const PathString full(path);
+	for (size_t end = extensionLength; end < full.size(); ++end)
+	{
+		if (full[end] != '/' && full[end] != '\\')
+		{
+			continue;
+		}
+
+		bool matches = true;
+		for (size_t i = 0; matches && i < extensionLength; ++i)
+		{
+			const PathChar c = full[end - extensionLength + i];
+			matches = (unsigned)c < 128 && tolower((int)c) == extension[i];
+		}
+		if (matches)
+		{
+			packPath = full.substr(0, end);
+			name = NarrowPath(full.c_str() + end + 1);
+			std::replace(name.begin(), name.end(), '\\', '/');
+			return true;
+		}
+	}
+	return false;
+}
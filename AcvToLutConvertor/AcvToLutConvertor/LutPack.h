@@ -0,0 +1,101 @@
+#pragma once
+
+#include "Platform.h"
+#include "MappedFile.h"
+#include <string>
+
+class Lut3D;
+class LutShaper;
+
+//
+// Many LUTs in one file, for preset libraries too large to keep as thousands
+// of small files. A pack is mapped once; finding a LUT is a binary search of
+// its index and reading it decodes straight from the mapping.
+//
+// The file starts with a LutPackHeader and the index: one LutPackEntry per
+// LUT, sorted by the hash of its name and then by the name. The names follow
+// as UTF-8 without terminators, then the payloads, each on a page boundary.
+// A payload is a whole DDS volume as WriteDdsVolume writes it, or only the
+// top level of one (LUT_PACK_TOP_LEVEL), which is all the apply engine reads.
+// A volume with a shaper (look.dds next to look.shaper.dds) has the shaper's
+// 16-bit levels appended to its payload. ACV files are packed baked, as the
+// converter would write them. Integers are little-endian.
+//
+// Commands that take LUT files accept a LUT in a pack as the pack's path
+// followed by the name, such as "presets.lutpack/film/Vintage.acv".
+//
+
+const unsigned LUT_PACK_MAGIC = 0x5054554C; // "LUTP"
+const unsigned LUT_PACK_VERSION = 2; // 1 had no shapers
+const unsigned LUT_PACK_ALIGNMENT = 4096;
+
+// Payload holds only the top level texels
+const unsigned LUT_PACK_TOP_LEVEL = 0x1;
+
+struct LutPackHeader
+{
+	unsigned Magic;
+	unsigned Version;
+	unsigned EntryCount;
+	unsigned Reserved;
+	unsigned long long NamesOffset;
+	unsigned long long NamesSize;
+};
+
+struct LutPackEntry
+{
+	unsigned long long NameHash; // see HashLutName
+	unsigned NameOffset; // from the start of the names
+	unsigned NameLength;
+	unsigned long long DataOffset; // from the start of the file
+	unsigned long long DataSize;
+	unsigned long long TexelOffset; // of the top level, within the payload
+	unsigned Size;
+	unsigned Flags;
+	unsigned Masks[3]; // red, green and blue in each 32-bit texel
+	unsigned ShaperSize; // bytes of shaper levels ending the payload, or 0
+};
+
+// HashBytes of the UTF-8 name
+unsigned long long HashLutName(const char* name, size_t length);
+
+class LutPack
+{
+public:
+	LutPack();
+
+	// Maps the pack and checks its index
+	bool Open(const PathChar* path);
+	void Close();
+
+	size_t GetEntryCount() const { return m_EntryCount; }
+	const LutPackEntry& GetEntry(size_t index) const { return m_Entries[index]; }
+	std::string GetName(const LutPackEntry& entry) const;
+
+	// Null, quietly, for names the pack does not hold
+	const LutPackEntry* Find(const std::string& name) const;
+
+	const unsigned char* GetPayload(const LutPackEntry& entry) const;
+	bool ReadLut(const LutPackEntry& entry, Lut3D& lut) const;
+	// The identity for volumes packed without one
+	bool ReadShaper(const LutPackEntry& entry, LutShaper& shaper) const;
+	// Both, by name, reporting missing LUTs
+	bool ReadLut(const std::string& name, Lut3D& lut, LutShaper& shaper) const;
+
+private:
+	MappedFile m_File;
+	std::string m_Path; // for messages
+	const unsigned char* m_Data;
+	const LutPackEntry* m_Entries;
+	size_t m_EntryCount;
+	const char* m_Names;
+};
+
+// Packs every .acv and .dds file under directory, named by their paths
+// relative to it, each volume with its shaper. With topLevelOnly, volumes
+// keep only their top level.
+bool WriteLutPack(const PathChar* path, const PathChar* directory, bool topLevelOnly);
+
+// Splits "library.lutpack/name" into the pack's path and the name, with
+// backslashes in the name turned into slashes. False for other paths.
+bool SplitLutPackPath(const PathChar* path, PathString& packPath, std::string& name);
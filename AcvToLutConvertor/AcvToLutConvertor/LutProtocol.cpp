@@ -0,0 +1,113 @@
+#include "LutProtocol.h"
+#include "LocalSocket.h"
+#include <iostream>
+#include <cstring>
+
+namespace
+{
+
+const char* const REQUEST_NAMES[] = { "ping", "convert", "apply", "grade", "shutdown", "attach", "detach", "frame", "reply" };
+
+bool ReceiveWithin(LocalSocket& socket, void* data, size_t size, unsigned* millisecondsLeft)
+{
+	return millisecondsLeft ? socket.Receive(data, size, *millisecondsLeft) : socket.Receive(data, size);
+}
+
+} // namespace
+
+const char* GetRequestName(LutRequest request)
+{
+	return REQUEST_NAMES[request];
+}
+
+bool ParseRequest(const char* name, LutRequest& request)
+{
+	for (int i = LUT_REQUEST_PING; i < LUT_REQUEST_REPLY; ++i)
+	{
+		if (strcmp(name, REQUEST_NAMES[i]) == 0)
+		{
+			request = (LutRequest)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+void PackStrings(const std::vector<std::string>& strings, std::vector<char>& payload)
+{
+	payload.clear();
+	for (size_t i = 0; i < strings.size(); ++i)
+	{
+		payload.insert(payload.end(), strings[i].begin(), strings[i].end());
+		payload.push_back('\0');
+	}
+}
+
+bool UnpackStrings(const std::vector<char>& payload, std::vector<std::string>& strings)
+{
+	strings.clear();
+	if (!payload.empty() && payload.back() != '\0')
+	{
+		std::cerr << "Message strings must be NUL-terminated." << std::endl;
+		return false;
+	}
+
+	for (size_t start = 0; start < payload.size(); )
+	{
+		const size_t length = strlen(&payload[start]);
+		strings.push_back(std::string(&payload[start], length));
+		start += length + 1;
+	}
+	return true;
+}
+
+bool SendLutMessage(LocalSocket& socket, LutRequest type, int status, const std::vector<char>& payload,
+	int descriptor)
+{
+	if (payload.size() > LUT_PROTOCOL_MAX_PAYLOAD)
+	{
+		std::cerr << "Message payload of " << payload.size() << " bytes is too large." << std::endl;
+		return false;
+	}
+
+	// Header and payload leave in one send
+	std::vector<char> message(sizeof(LutMessageHeader) + payload.size());
+	LutMessageHeader header;
+	header.Magic = LUT_PROTOCOL_MAGIC;
+	header.Type = (unsigned short)type;
+	header.Status = (short)status;
+	header.Size = (unsigned)payload.size();
+	memcpy(&message[0], &header, sizeof(header));
+	if (!payload.empty())
+	{
+		memcpy(&message[sizeof(header)], &payload[0], payload.size());
+	}
+	return socket.Send(&message[0], message.size(), descriptor);
+}
+
+bool ReceiveLutMessage(LocalSocket& socket, LutMessageHeader& header, std::vector<char>& payload,
+	unsigned timeoutMilliseconds)
+{
+	// One deadline for the message, not one per receive, so that a peer
+	// trickling bytes in cannot stretch it
+	unsigned millisecondsLeft = timeoutMilliseconds;
+	unsigned* deadline = timeoutMilliseconds > 0 ? &millisecondsLeft : nullptr;
+	if (!ReceiveWithin(socket, &header, sizeof(header), deadline))
+	{
+		return false;
+	}
+
+	if (header.Magic != LUT_PROTOCOL_MAGIC || header.Type > LUT_REQUEST_REPLY || header.Size > LUT_PROTOCOL_MAX_PAYLOAD)
+	{
+		std::cerr << "Received a malformed message." << std::endl;
+		return false;
+	}
+
+	payload.resize(header.Size);
+	if (header.Size > 0 && !ReceiveWithin(socket, &payload[0], header.Size, deadline))
+	{
+		std::cerr << "Received an incomplete message." << std::endl;
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <vector>
+#include <string>
+
+class LocalSocket;
+
+//
+// Messages between the conversion daemon (see LutServer) and its clients. Both
+// ends run on the same machine, so fields are in native byte order.
+//
+// Every message is a 12-byte header followed by Size bytes of payload. The
+// payload of a request is its arguments as NUL-terminated UTF-8 strings, the
+// same arguments the command takes on the command line, with absolute paths.
+// A reply carries the command's exit code in Status and, as two strings, what
+// it wrote to standard output and to standard error.
+//
+// Frame requests grade pixels a client keeps in shared memory (see
+// FrameRing.h). Their payload is a LutFrameDescriptor followed by the apply
+// command's arguments without the image files: the LUT and the options.
+//
+
+const unsigned LUT_PROTOCOL_MAGIC = 0x54554C41; // "ALUT"
+
+// Longest payload either side accepts
+const unsigned LUT_PROTOCOL_MAX_PAYLOAD = 1 << 20;
+
+enum LutRequest
+{
+	LUT_REQUEST_PING,     // no arguments, replies at once
+	LUT_REQUEST_CONVERT,  // acv_filename output_dds
+	LUT_REQUEST_APPLY,    // lut_filename input_image output_image [options]
+	LUT_REQUEST_GRADE,    // acv_filename input_image output_image
+	LUT_REQUEST_SHUTDOWN, // no arguments, the daemon exits after replying
+	LUT_REQUEST_ATTACH,   // ring_name, Status is the ring's number for this connection
+	LUT_REQUEST_DETACH,   // ring number
+	LUT_REQUEST_FRAME,    // LutFrameDescriptor, lut_filename [options]
+	LUT_REQUEST_REPLY,    // what the daemon answers with
+};
+
+// Status of a request that threw instead of returning, out of memory or on
+// input nothing checked for
+const int LUT_STATUS_FAILED = -100;
+
+struct LutMessageHeader
+{
+	unsigned Magic;
+	unsigned short Type;
+	short Status;
+	unsigned Size;
+};
+
+// A frame in an attached ring, graded in place
+struct LutFrameDescriptor
+{
+	unsigned Ring;
+	unsigned Slot;
+	unsigned Width;
+	unsigned Height;
+	unsigned RowPitch; // bytes between rows
+	unsigned Format;   // ImageFormat
+};
+
+// The request names clients use on the command line
+const char* GetRequestName(LutRequest request);
+bool ParseRequest(const char* name, LutRequest& request);
+
+void PackStrings(const std::vector<std::string>& strings, std::vector<char>& payload);
+bool UnpackStrings(const std::vector<char>& payload, std::vector<std::string>& strings);
+
+// A descriptor of -1 sends none; see LocalSocket::Send
+bool SendLutMessage(LocalSocket& socket, LutRequest type, int status, const std::vector<char>& payload,
+	int descriptor = -1);
+
+// False, quietly, when the peer closed the connection between messages. With
+// a timeout the whole message has to arrive within it; 0 waits for as long as
+// it takes.
+bool ReceiveLutMessage(LocalSocket& socket, LutMessageHeader& header, std::vector<char>& payload,
+	unsigned timeoutMilliseconds = 0);
@@ -0,0 +1,710 @@
+#include "LutServer.h"
+#include "DdsVolume.h"
+#include "Image.h"
+#include "ImageCodecs.h"
+#include "Stopwatch.h"
+#include "Trace.h"
+#include <iostream>
+#include <sstream>
+#include <streambuf>
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+#include <cstdlib>
+
+namespace
+{
+
+bool ParseFilterName(const std::string& name, LutFilter& filter)
+{
+	if (name == "exact")
+	{
+		filter = LUT_FILTER_EXACT;
+	}
+	else if (name == "d3d11")
+	{
+		filter = LUT_FILTER_D3D11;
+	}
+	else
+	{
+		std::cerr << "Filter must be exact or d3d11." << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool ParseInterpolationName(const std::string& name, LutInterpolation& interpolation)
+{
+	for (int i = LUT_INTERPOLATION_NEAREST; i <= LUT_INTERPOLATION_TETRAHEDRAL; ++i)
+	{
+		if (name == GetInterpolationName((LutInterpolation)i))
+		{
+			interpolation = (LutInterpolation)i;
+			return true;
+		}
+	}
+	std::cerr << "Interpolation must be nearest, trilinear or tetrahedral." << std::endl;
+	return false;
+}
+
+// --filter= and --interpolation=, from arguments[first] on
+bool ParseApplyOptions(const std::vector<std::string>& arguments, size_t first, LutFilter& filter, LutInterpolation& interpolation, bool& interpolate)
+{
+	for (size_t i = first; i < arguments.size(); ++i)
+	{
+		const std::string& option = arguments[i];
+		if (option.compare(0, 9, "--filter=") == 0)
+		{
+			if (!ParseFilterName(option.substr(9), filter))
+			{
+				return false;
+			}
+		}
+		else if (option.compare(0, 16, "--interpolation=") == 0)
+		{
+			if (!ParseInterpolationName(option.substr(16), interpolation))
+			{
+				return false;
+			}
+			interpolate = true;
+		}
+		else
+		{
+			std::cerr << "Unknown option: " << option << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+// Where the tables of an image format sit in Preset::Graders
+size_t GetGraderIndex(ImageFormat format)
+{
+	if (format == IMAGE_FORMAT_RGBA16F)
+	{
+		return 2;
+	}
+	return GetBytesPerChannel(format) == 1 ? 0 : 1;
+}
+
+// Where std::cout and std::cerr write on each worker while it answers a
+// request, null elsewhere
+thread_local std::streambuf* t_RequestOutput[2];
+
+// Stands in for the buffer of std::cout or std::cerr while the daemon runs,
+// passing what each thread writes on to its request's output, or to the
+// stream's own buffer outside requests. It keeps nothing itself, so threads
+// never share it.
+class RoutedBuffer : public std::streambuf
+{
+public:
+	RoutedBuffer(std::ostream& stream, int route)
+		: m_Stream(stream)
+		, m_Original(stream.rdbuf())
+		, m_Route(route)
+	{
+		m_Stream.rdbuf(this);
+	}
+
+	~RoutedBuffer()
+	{
+		m_Stream.rdbuf(m_Original);
+	}
+
+protected:
+	int_type overflow(int_type c) override
+	{
+		return traits_type::eq_int_type(c, traits_type::eof()) ? traits_type::not_eof(c) : GetTarget()->sputc(traits_type::to_char_type(c));
+	}
+
+	std::streamsize xsputn(const char* data, std::streamsize count) override
+	{
+		return GetTarget()->sputn(data, count);
+	}
+
+	int sync() override
+	{
+		return GetTarget()->pubsync();
+	}
+
+private:
+	RoutedBuffer(const RoutedBuffer&);
+	RoutedBuffer& operator=(const RoutedBuffer&);
+
+	std::streambuf* GetTarget() const
+	{
+		return t_RequestOutput[m_Route] ? t_RequestOutput[m_Route] : m_Original;
+	}
+
+	std::ostream& m_Stream;
+	std::streambuf* m_Original;
+	int m_Route;
+};
+
+} // namespace
+
+LutServer::LutServer(size_t cacheBudget, unsigned workerCount)
+	: m_WakePending(false)
+	, m_ShuttingDown(false)
+	, m_WorkerCount(workerCount ? workerCount : std::max(std::thread::hardware_concurrency(), 1u))
+	, m_Stopping(false)
+	, m_Cache(cacheBudget)
+{}
+
+bool LutServer::Listen(const char* socketPath)
+{
+	return LocalSocket::CreatePair(m_WakeSender, m_WakeReceiver) && m_Listener.Listen(socketPath);
+}
+
+bool LutServer::Run()
+{
+	RoutedBuffer output(std::cout, 0);
+	RoutedBuffer errors(std::cerr, 1);
+
+	m_Stopping = false;
+	for (unsigned i = 0; i < m_WorkerCount; ++i)
+	{
+		m_Workers.push_back(std::thread(&LutServer::Work, this));
+	}
+
+	bool ok = true;
+	std::vector<LocalSocket*> sockets;
+	std::vector<Client*> waiting;
+	std::vector<size_t> ready;
+	while (!m_ShuttingDown)
+	{
+		// Clients a worker has are left out until it gives them back
+		sockets.assign(1, &m_Listener);
+		sockets.push_back(&m_WakeReceiver);
+		waiting.clear();
+		{
+			std::lock_guard<std::mutex> lock(m_QueueMutex);
+			for (size_t i = 0; i < m_Clients.size();)
+			{
+				Client& client = *m_Clients[i];
+				if (client.Closed)
+				{
+					m_Clients.erase(m_Clients.begin() + i);
+					continue;
+				}
+				if (!client.Busy)
+				{
+					sockets.push_back(&client.Socket);
+					waiting.push_back(&client);
+				}
+				++i;
+			}
+		}
+
+		// Time spent here is time the daemon had nothing to do
+		TraceCounter("clients", (double)m_Clients.size());
+		TraceSpan wait("wait", "daemon");
+		ok = LocalSocket::WaitReadable(&sockets[0], sockets.size(), ready);
+		wait.End();
+		if (!ok)
+		{
+			break;
+		}
+
+		// Every client with a request waiting goes to the workers, none is
+		// passed over for one that comes before it
+		std::lock_guard<std::mutex> lock(m_QueueMutex);
+		for (size_t i = 0; i < ready.size(); ++i)
+		{
+			if (ready[i] == 0)
+			{
+				Accept();
+			}
+			else if (ready[i] == 1)
+			{
+				char wake;
+				m_WakePending = false;
+				m_WakeReceiver.Receive(&wake, 1);
+			}
+			else
+			{
+				Client* client = waiting[ready[i] - 2];
+				client->Busy = true;
+				m_Queue.push_back(client);
+				m_QueueReady.notify_one();
+			}
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_QueueMutex);
+		m_Stopping = true;
+		m_Queue.clear();
+	}
+	m_QueueReady.notify_all();
+	for (size_t i = 0; i < m_Workers.size(); ++i)
+	{
+		m_Workers[i].join();
+	}
+	m_Workers.clear();
+	return ok;
+}
+
+void LutServer::Accept()
+{
+	std::unique_ptr<Client> client(new Client());
+	if (!m_Listener.Accept(client->Socket))
+	{
+		return;
+	}
+	if (m_Clients.size() >= MAX_CLIENTS)
+	{
+		std::cerr << "Turned a client away, " << m_Clients.size() << " are connected already." << std::endl;
+		return;
+	}
+	m_Clients.push_back(std::move(client));
+}
+
+void LutServer::Work()
+{
+	SetTraceThreadName("worker");
+	for (;;)
+	{
+		Client* client;
+		{
+			std::unique_lock<std::mutex> lock(m_QueueMutex);
+			while (!m_Stopping && m_Queue.empty())
+			{
+				m_QueueReady.wait(lock);
+			}
+			if (m_Stopping)
+			{
+				return;
+			}
+			client = m_Queue.front();
+			m_Queue.pop_front();
+		}
+
+		const bool keep = Serve(*client);
+		{
+			std::lock_guard<std::mutex> lock(m_QueueMutex);
+			client->Busy = false;
+			client->Closed = !keep;
+		}
+		Wake();
+	}
+}
+
+void LutServer::Wake()
+{
+	// One byte on its way is enough, the waiting thread looks at every client
+	if (!m_WakePending.exchange(true))
+	{
+		const char wake = 0;
+		m_WakeSender.Send(&wake, 1);
+	}
+}
+
+bool LutServer::Serve(Client& client)
+{
+	LutMessageHeader header;
+	std::vector<char> payload;
+	TraceSpan receive("receive", "daemon");
+	if (!ReceiveLutMessage(client.Socket, header, payload, RECEIVE_TIMEOUT_MS))
+	{
+		return false;
+	}
+	receive.End();
+
+	// What the request would print goes back to the client
+	std::ostringstream out;
+	std::ostringstream err;
+	t_RequestOutput[0] = out.rdbuf();
+	t_RequestOutput[1] = err.rdbuf();
+
+	// A request that fails on bad input fails alone, the daemon carries on
+	// serving everyone else
+	TraceSpan handle(header.Type <= LUT_REQUEST_REPLY ? GetRequestName((LutRequest)header.Type) : "unknown", "daemon");
+	int status;
+	try
+	{
+		status = Handle(client, (LutRequest)header.Type, payload);
+	}
+	catch (const std::exception& exception)
+	{
+		std::cerr << "Request failed: " << exception.what() << std::endl;
+		status = LUT_STATUS_FAILED;
+	}
+	catch (const char* message)
+	{
+		std::cerr << "Request failed: " << message << std::endl;
+		status = LUT_STATUS_FAILED;
+	}
+	catch (...)
+	{
+		std::cerr << "Request failed." << std::endl;
+		status = LUT_STATUS_FAILED;
+	}
+	handle.End();
+
+	t_RequestOutput[0] = nullptr;
+	t_RequestOutput[1] = nullptr;
+
+	std::vector<std::string> output(2);
+	output[0] = out.str();
+	output[1] = err.str();
+	PackStrings(output, payload);
+	TraceSpan reply("reply", "daemon");
+	return SendLutMessage(client.Socket, LUT_REQUEST_REPLY, status, payload);
+}
+
+int LutServer::Handle(Client& client, LutRequest request, const std::vector<char>& payload)
+{
+	if (request == LUT_REQUEST_REPLY)
+	{
+		std::cerr << "Replies are not requests." << std::endl;
+		return -1;
+	}
+
+	// Frames lead with their descriptor, the strings follow
+	LutFrameDescriptor frame;
+	size_t skipped = 0;
+	if (request == LUT_REQUEST_FRAME)
+	{
+		if (payload.size() < sizeof(frame))
+		{
+			std::cerr << "Frame requests start with a frame descriptor." << std::endl;
+			return -1;
+		}
+		memcpy(&frame, &payload[0], sizeof(frame));
+		skipped = sizeof(frame);
+	}
+
+	std::vector<std::string> arguments;
+	if (!UnpackStrings(std::vector<char>(payload.begin() + skipped, payload.end()), arguments))
+	{
+		return -1;
+	}
+
+	switch (request)
+	{
+	case LUT_REQUEST_PING:
+		return 0;
+	case LUT_REQUEST_CONVERT:
+		return Convert(arguments);
+	case LUT_REQUEST_APPLY:
+		return Apply(arguments);
+	case LUT_REQUEST_GRADE:
+		return Grade(arguments);
+	case LUT_REQUEST_SHUTDOWN:
+		m_ShuttingDown = true;
+		return 0;
+	case LUT_REQUEST_ATTACH:
+		return Attach(client, arguments);
+	case LUT_REQUEST_DETACH:
+		return Detach(client, arguments);
+	case LUT_REQUEST_FRAME:
+		return ApplyFrame(client, frame, arguments);
+	default:
+		return -1;
+	}
+}
+
+int LutServer::Convert(const std::vector<std::string>& arguments)
+{
+	if (arguments.size() != 2)
+	{
+		std::cerr << "convert takes an ACV file and an output DDS file." << std::endl;
+		return -1;
+	}
+
+	std::shared_ptr<Preset> preset = GetPreset(arguments[0]);
+	if (!preset)
+	{
+		return -2;
+	}
+	if (preset->Baked->Curves.empty())
+	{
+		std::cerr << "Only ACV files are converted: " << arguments[0] << std::endl;
+		return -3;
+	}
+
+	// The cube holds the converter's tables, and WriteDdsVolume writes what
+	// D3DXVolumeTextureSaver does
+	if (!WriteDdsVolume(WidenPath(arguments[1]).c_str(), preset->Baked->Lut))
+	{
+		return -4;
+	}
+	return 0;
+}
+
+int LutServer::Apply(const std::vector<std::string>& arguments)
+{
+	if (arguments.size() < 3)
+	{
+		std::cerr << "apply takes a LUT file, an input image and an output image." << std::endl;
+		return -1;
+	}
+
+	LutFilter filter = LUT_FILTER_EXACT;
+	LutInterpolation interpolation = LUT_INTERPOLATION_TRILINEAR;
+	bool interpolate = false;
+	if (!ParseApplyOptions(arguments, 3, filter, interpolation, interpolate))
+	{
+		return -1;
+	}
+
+	std::shared_ptr<Preset> preset = GetPreset(arguments[0]);
+	if (!preset)
+	{
+		return -2;
+	}
+
+	const LutApplier* applier = GetApplier(*preset, filter, interpolate ? &interpolation : nullptr);
+	if (!applier)
+	{
+		return -1;
+	}
+
+	Image image;
+	Stopwatch stopwatch;
+	if (!ReadImage(WidenPath(arguments[1]).c_str(), image, IMAGE_LAYOUT_INTERLEAVED))
+	{
+		return -4;
+	}
+	double decodeTime = stopwatch.GetElapsedMilliseconds();
+
+	stopwatch.Restart();
+	applier->Apply(image);
+	double applyTime = stopwatch.GetElapsedMilliseconds();
+
+	stopwatch.Restart();
+	if (!WriteImage(WidenPath(arguments[2]).c_str(), image))
+	{
+		return -5;
+	}
+	double encodeTime = stopwatch.GetElapsedMilliseconds();
+
+	std::cout << image.GetWidth() << "x" << image.GetHeight()
+		<< " - decode: " << decodeTime << " ms, apply: " << applyTime << " ms, encode: " << encodeTime << " ms" << std::endl;
+	return 0;
+}
+
+int LutServer::Grade(const std::vector<std::string>& arguments)
+{
+	if (arguments.size() != 3)
+	{
+		std::cerr << "grade takes an ACV file, an input image and an output image." << std::endl;
+		return -1;
+	}
+
+	std::shared_ptr<Preset> preset = GetPreset(arguments[0]);
+	if (!preset)
+	{
+		return -2;
+	}
+	if (preset->Baked->Curves.empty())
+	{
+		std::cerr << "Only ACV files are graded with: " << arguments[0] << std::endl;
+		return -3;
+	}
+
+	Image image;
+	Stopwatch stopwatch;
+	if (!ReadImage(WidenPath(arguments[1]).c_str(), image, IMAGE_LAYOUT_INTERLEAVED))
+	{
+		return -4;
+	}
+	double decodeTime = stopwatch.GetElapsedMilliseconds();
+
+	stopwatch.Restart();
+	GetGrader(*preset, image.GetFormat()).Apply(image);
+	double gradeTime = stopwatch.GetElapsedMilliseconds();
+
+	stopwatch.Restart();
+	if (!WriteImage(WidenPath(arguments[2]).c_str(), image))
+	{
+		return -5;
+	}
+	double encodeTime = stopwatch.GetElapsedMilliseconds();
+
+	std::cout << image.GetWidth() << "x" << image.GetHeight()
+		<< " - decode: " << decodeTime << " ms, grade: " << gradeTime << " ms, encode: " << encodeTime << " ms" << std::endl;
+	return 0;
+}
+
+int LutServer::Attach(Client& client, const std::vector<std::string>& arguments)
+{
+	if (arguments.size() != 1)
+	{
+		std::cerr << "attach takes the name of a frame ring." << std::endl;
+		return -1;
+	}
+
+	std::unique_ptr<FrameRing> ring(new FrameRing());
+	if (!ring->Attach(arguments[0], client.Socket.TakeDescriptor()))
+	{
+		return -2;
+	}
+
+	client.Rings.push_back(std::move(ring));
+	return (int)client.Rings.size() - 1;
+}
+
+int LutServer::Detach(Client& client, const std::vector<std::string>& arguments)
+{
+	const size_t ring = arguments.size() == 1 ? strtoul(arguments[0].c_str(), nullptr, 10) : client.Rings.size();
+	if (ring >= client.Rings.size() || !client.Rings[ring])
+	{
+		std::cerr << "detach takes the number of an attached frame ring." << std::endl;
+		return -1;
+	}
+
+	client.Rings[ring].reset();
+	return 0;
+}
+
+int LutServer::ApplyFrame(Client& client, const LutFrameDescriptor& frame, const std::vector<std::string>& arguments)
+{
+	if (arguments.empty())
+	{
+		std::cerr << "Frames need a LUT file." << std::endl;
+		return -1;
+	}
+
+	LutFilter filter = LUT_FILTER_EXACT;
+	LutInterpolation interpolation = LUT_INTERPOLATION_TRILINEAR;
+	bool interpolate = false;
+	if (!ParseApplyOptions(arguments, 1, filter, interpolation, interpolate))
+	{
+		return -1;
+	}
+
+	if (frame.Ring >= client.Rings.size() || !client.Rings[frame.Ring])
+	{
+		std::cerr << "Frame ring " << frame.Ring << " is not attached." << std::endl;
+		return -1;
+	}
+
+	// The frame has to lie within its slot
+	const FrameRing& ring = *client.Rings[frame.Ring];
+	const ImageFormat format = (ImageFormat)frame.Format;
+	const unsigned long long rowSize = frame.Format <= IMAGE_FORMAT_RGBA16F ?
+		(unsigned long long)frame.Width * GetChannelCount(format) * GetBytesPerChannel(format) : 0;
+	if (frame.Slot >= ring.GetSlotCount() || rowSize == 0 || rowSize > frame.RowPitch || frame.Height == 0 ||
+		(unsigned long long)(frame.Height - 1) * frame.RowPitch + rowSize > ring.GetSlotSize())
+	{
+		std::cerr << "Frame does not fit in slot " << frame.Slot << " of ring " << frame.Ring << "." << std::endl;
+		return -1;
+	}
+
+	std::shared_ptr<Preset> preset = GetPreset(arguments[0]);
+	if (!preset)
+	{
+		return -2;
+	}
+
+	const LutApplier* applier = GetApplier(*preset, filter, interpolate ? &interpolation : nullptr);
+	if (!applier)
+	{
+		return -1;
+	}
+
+	unsigned char* pixels = ring.GetSlot(frame.Slot);
+	if (rowSize == frame.RowPitch)
+	{
+		applier->Apply(pixels, format, pixels, format, (size_t)frame.Width * frame.Height);
+	}
+	else
+	{
+		for (unsigned y = 0; y < frame.Height; ++y)
+		{
+			unsigned char* row = pixels + (size_t)y * frame.RowPitch;
+			applier->Apply(row, format, row, format, frame.Width);
+		}
+	}
+	return 0;
+}
+
+std::shared_ptr<LutServer::Preset> LutServer::GetPreset(const std::string& path)
+{
+	std::shared_ptr<const BakedLut> baked = m_Cache.Get(WidenPath(path).c_str());
+	if (!baked)
+	{
+		return nullptr;
+	}
+
+	// Workers hold on to the presets they use, dropping one here only stops
+	// it being handed out
+	std::lock_guard<std::mutex> lock(m_PresetMutex);
+	std::map<std::string, std::shared_ptr<Preset>>::iterator cached = m_Presets.find(path);
+	if (cached != m_Presets.end() && cached->second->Baked == baked)
+	{
+		return cached->second;
+	}
+
+	if (cached != m_Presets.end())
+	{
+		m_Presets.erase(cached);
+	}
+	else if (m_Presets.size() >= MAX_PRESETS)
+	{
+		// Presets whose bake the cache has let go of go first
+		for (std::map<std::string, std::shared_ptr<Preset>>::iterator i = m_Presets.begin(); i != m_Presets.end();)
+		{
+			i = i->second->Baked.use_count() == 1 ? m_Presets.erase(i) : ++i;
+		}
+		if (m_Presets.size() >= MAX_PRESETS)
+		{
+			m_Presets.clear();
+		}
+	}
+
+	// Paths the cache gave the same bake share its appliers too
+	for (std::map<std::string, std::shared_ptr<Preset>>::iterator i = m_Presets.begin(); i != m_Presets.end(); ++i)
+	{
+		if (i->second->Baked == baked)
+		{
+			m_Presets[path] = i->second;
+			return i->second;
+		}
+	}
+
+	std::shared_ptr<Preset> preset(new Preset());
+	preset->Baked = baked;
+	m_Presets[path] = preset;
+	return preset;
+}
+
+const LutApplier* LutServer::GetApplier(Preset& preset, LutFilter filter, const LutInterpolation* interpolation)
+{
+	std::lock_guard<std::mutex> lock(preset.Mutex);
+	if (!preset.Defaults[filter])
+	{
+		std::unique_ptr<LutApplier> applier(new LutApplier(preset.Baked->Lut, filter));
+		preset.Defaults[filter] = applier.get();
+		preset.Appliers[filter][applier->GetInterpolation()] = std::move(applier);
+	}
+	if (!interpolation)
+	{
+		return preset.Defaults[filter];
+	}
+
+	std::unique_ptr<LutApplier>& applier = preset.Appliers[filter][*interpolation];
+	if (!applier)
+	{
+		std::unique_ptr<LutApplier> made(new LutApplier(preset.Baked->Lut, filter));
+		if (!made->SetInterpolation(*interpolation))
+		{
+			return nullptr;
+		}
+		applier = std::move(made);
+	}
+	return applier.get();
+}
+
+const CurveGrader& LutServer::GetGrader(Preset& preset, ImageFormat format)
+{
+	std::lock_guard<std::mutex> lock(preset.Mutex);
+	const size_t index = GetGraderIndex(format);
+	if (!preset.Graders[index])
+	{
+		preset.Graders[index].reset(new CurveGrader(preset.Baked->Curves, format));
+	}
+	return *preset.Graders[index];
+}
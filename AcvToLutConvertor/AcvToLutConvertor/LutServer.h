@@ -0,0 +1,124 @@
+#pragma once
+
+#include "Platform.h"
+#include "AcvCurves.h"
+#include "Lut3D.h"
+#include "LutApplier.h"
+#include "CurveGrader.h"
+#include "LocalSocket.h"
+#include "LutProtocol.h"
+#include "FrameRing.h"
+#include "LutCache.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <map>
+#include <memory>
+#include <string>
+
+// The converter as a long-running daemon, answering the requests of
+// LutProtocol.h on a UNIX domain socket. What each request needs is kept warm
+// between requests: files are parsed and baked once, and the appliers and
+// curve tables built for them stay around, so repeated requests only pay for
+// the pixels. Baked LUTs come from a LutCache, which reloads files when their
+// size or modification time changes.
+//
+// One thread waits on the sockets and hands each connection with a request
+// waiting to a pool of workers, which answer it; a connection is with one
+// worker at a time, so its requests are answered in order while other
+// clients' run alongside. What a request prints goes back to its client.
+//
+// Frame rings a client attaches are mapped for as long as its connection
+// stays open, and frame requests grade their slots in place.
+class LutServer
+{
+public:
+	// No workers means one per CPU
+	explicit LutServer(size_t cacheBudget = DEFAULT_LUT_CACHE_BUDGET, unsigned workerCount = 0);
+
+	bool Listen(const char* socketPath);
+
+	// Serves clients until one asks for a shutdown, false on socket errors
+	bool Run();
+
+	LutCacheStats GetCacheStats() const { return m_Cache.GetStats(); }
+
+private:
+	// A LUT file as the requests use it. Appliers and curve tables are made on
+	// first use, and made again when the cache bakes the file anew. Once made
+	// they do not change, so workers share them, as do paths whose files the
+	// cache shares a bake between.
+	struct Preset
+	{
+		std::shared_ptr<const BakedLut> Baked;
+		std::mutex Mutex; // held while appliers and graders are made
+		std::unique_ptr<LutApplier> Appliers[2][LUT_INTERPOLATION_D3D11 + 1]; // per LutFilter and interpolation
+		const LutApplier* Defaults[2]; // with the interpolation each filter starts with
+		std::unique_ptr<CurveGrader> Graders[3]; // 8-bit, 16-bit unorm, half
+	};
+
+	// A connection and the frame rings attached through it. Busy while a
+	// worker has it, Closed once a worker dropped it.
+	struct Client
+	{
+		LocalSocket Socket;
+		std::vector<std::unique_ptr<FrameRing>> Rings; // null once detached
+		bool Busy;
+		bool Closed;
+	};
+
+	// Presets kept before those whose bakes were evicted are dropped
+	static const size_t MAX_PRESETS = 256;
+
+	// Connections past this are closed as soon as they are accepted
+	static const size_t MAX_CLIENTS = 256;
+
+	// How long a client may take over a message, from when its first bytes
+	// are there to read
+	static const unsigned RECEIVE_TIMEOUT_MS = 2000;
+
+	LutServer(const LutServer&);
+	LutServer& operator=(const LutServer&);
+
+	void Accept();
+	void Work();
+	void Wake();
+
+	// Answers one request, false to drop the connection
+	bool Serve(Client& client);
+	int Handle(Client& client, LutRequest request, const std::vector<char>& payload);
+
+	int Convert(const std::vector<std::string>& arguments);
+	int Apply(const std::vector<std::string>& arguments);
+	int Grade(const std::vector<std::string>& arguments);
+	int Attach(Client& client, const std::vector<std::string>& arguments);
+	int Detach(Client& client, const std::vector<std::string>& arguments);
+	int ApplyFrame(Client& client, const LutFrameDescriptor& frame, const std::vector<std::string>& arguments);
+
+	std::shared_ptr<Preset> GetPreset(const std::string& path);
+	// With the filter's own interpolation when none is given; null, with a
+	// message, for one the cube or the filter does not allow
+	const LutApplier* GetApplier(Preset& preset, LutFilter filter, const LutInterpolation* interpolation);
+	const CurveGrader& GetGrader(Preset& preset, ImageFormat format);
+
+	LocalSocket m_Listener;
+	LocalSocket m_WakeSender; // workers write here when they give a client back
+	LocalSocket m_WakeReceiver;
+	std::atomic<bool> m_WakePending;
+	std::vector<std::unique_ptr<Client>> m_Clients; // the waiting thread's alone
+	std::atomic<bool> m_ShuttingDown;
+
+	unsigned m_WorkerCount;
+	std::vector<std::thread> m_Workers;
+	std::mutex m_QueueMutex; // guards the queue and the clients' flags
+	std::condition_variable m_QueueReady;
+	std::deque<Client*> m_Queue;
+	bool m_Stopping;
+
+	LutCache m_Cache;
+	std::mutex m_PresetMutex;
+	std::map<std::string, std::shared_ptr<Preset>> m_Presets;
+};
@@ -0,0 +1,223 @@
+#include "LutShaper.h"
+#include "LutChain.h"
+#include "Lut3D.h"
+#include <cmath>
+#include <cstring>
+#include <cassert>
+
+namespace
+{
+
+const char* const SHAPER_NAMES[] = { "none", "log", "pq", "fitted" };
+
+// Inputs 1 / LOG_SHAPER_GAIN apart near black get as much of the lattice as
+// the whole top half
+const double LOG_SHAPER_GAIN = 64.0;
+
+// SMPTE ST 2084 constants
+const double PQ_M1 = 2610.0 / 16384.0;
+const double PQ_M2 = 2523.0 / 4096.0 * 128.0;
+const double PQ_C1 = 3424.0 / 4096.0;
+const double PQ_C2 = 2413.0 / 4096.0 * 32.0;
+const double PQ_C3 = 2392.0 / 4096.0 * 32.0;
+
+// Share of the lattice spread evenly whatever the curvature, so that
+// straight stretches keep some points
+const double FITTED_FLOOR = 0.2;
+
+// Grey ramp entries the curvature is averaged over on each side
+const size_t FITTED_SMOOTHING = 16;
+
+double EncodePQ(double value)
+{
+	const double y = std::pow(value, PQ_M1);
+	return std::pow((PQ_C1 + PQ_C2 * y) / (1.0 + PQ_C3 * y), PQ_M2);
+}
+
+// The error of linear interpolation goes with the curvature times the square
+// of the spacing, so spacing points by the square root of the curvature makes
+// every interval err alike
+void BuildFittedDensity(const LutChain& chain, std::vector<double>& density)
+{
+	const size_t count = SHAPER_TABLE_SIZE;
+	std::vector<float> ramp(count * 3);
+	for (size_t i = 0; i < count; ++i)
+	{
+		const float value = (float)i / (float)(count - 1);
+		const float in[3] = { value, value, value };
+		chain.Evaluate(in, &ramp[i * 3]);
+	}
+
+	std::vector<double> curvature(count, 0.0);
+	for (size_t i = 1; i + 1 < count; ++i)
+	{
+		for (int c = 0; c < 3; ++c)
+		{
+			curvature[i] += std::fabs((double)ramp[(i - 1) * 3 + c] - 2.0 * ramp[i * 3 + c] + ramp[(i + 1) * 3 + c]);
+		}
+	}
+
+	density.assign(count, 0.0);
+	double sum = 0.0;
+	for (size_t i = 0; i < count; ++i)
+	{
+		const size_t first = i > FITTED_SMOOTHING ? i - FITTED_SMOOTHING : 0;
+		const size_t last = i + FITTED_SMOOTHING < count - 1 ? i + FITTED_SMOOTHING : count - 1;
+		double average = 0.0;
+		for (size_t j = first; j <= last; ++j)
+		{
+			average += curvature[j];
+		}
+		density[i] = std::sqrt(average / (double)(last - first + 1));
+		sum += density[i];
+	}
+
+	const double floor = sum > 0.0 ? FITTED_FLOOR * sum / (double)count : 1.0;
+	for (size_t i = 0; i < count; ++i)
+	{
+		density[i] += floor;
+	}
+}
+
+} // namespace
+
+LutShaper LutShaper::Create(LutShaperKind kind, const LutChain& chain, size_t cubeSize)
+{
+	assert(cubeSize >= 2);
+	LutShaper shaper;
+	if (kind == LUT_SHAPER_NONE)
+	{
+		return shaper;
+	}
+
+	const size_t count = SHAPER_TABLE_SIZE;
+	std::vector<double> values(count);
+	if (kind == LUT_SHAPER_FITTED)
+	{
+		// The running sum of the density, between the ramp entries
+		std::vector<double> density;
+		BuildFittedDensity(chain, density);
+		values[0] = 0.0;
+		for (size_t i = 1; i < count; ++i)
+		{
+			values[i] = values[i - 1] + 0.5 * (density[i - 1] + density[i]);
+		}
+	}
+	else
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			const double value = (double)i / (double)(count - 1);
+			values[i] = kind == LUT_SHAPER_LOG ? std::log(1.0 + LOG_SHAPER_GAIN * value) : EncodePQ(value);
+		}
+	}
+
+	shaper.m_Table.resize(count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		shaper.m_Table[i] = (float)((values[i] - values[0]) / (values[count - 1] - values[0]));
+	}
+
+	// Fitted shapers run straight between the inputs of the lattice points, so
+	// that the cells interpolate linearly in the input as well; a bend inside
+	// a cell would cost more than the better spacing gains
+	if (kind == LUT_SHAPER_FITTED)
+	{
+		std::vector<float> nodes(cubeSize);
+		for (size_t i = 0; i < cubeSize; ++i)
+		{
+			nodes[i] = shaper.Inverse((float)i / (float)(cubeSize - 1));
+		}
+		nodes[cubeSize - 1] = 1.0f;
+		size_t cell = 0;
+		for (size_t i = 0; i < count; ++i)
+		{
+			const float value = (float)i / (float)(count - 1);
+			while (cell + 2 < cubeSize && value >= nodes[cell + 1])
+			{
+				++cell;
+			}
+			const float span = nodes[cell + 1] - nodes[cell];
+			const float frac = span > 0.0f ? (value - nodes[cell]) / span : 0.0f;
+			shaper.m_Table[i] = ((float)cell + (frac < 1.0f ? frac : 1.0f)) / (float)(cubeSize - 1);
+		}
+	}
+	return shaper;
+}
+
+bool LutShaper::SetTable(const std::vector<float>& table)
+{
+	if (table.size() < 2 || table.front() != 0.0f || table.back() != 1.0f)
+	{
+		return false;
+	}
+	for (size_t i = 1; i < table.size(); ++i)
+	{
+		if (!(table[i] >= table[i - 1]))
+		{
+			return false;
+		}
+	}
+
+	m_Table = table;
+	return true;
+}
+
+float LutShaper::Forward(float value) const
+{
+	return m_Table.empty() ? value : SampleTable(m_Table, value);
+}
+
+float LutShaper::Inverse(float coord) const
+{
+	if (m_Table.empty())
+	{
+		return coord;
+	}
+	if (!(coord > 0.0f))
+	{
+		return 0.0f;
+	}
+	if (coord >= 1.0f)
+	{
+		return 1.0f;
+	}
+
+	// The first entry past the coordinate, and the segment leading to it
+	size_t lo = 0;
+	size_t hi = m_Table.size() - 1;
+	while (hi - lo > 1)
+	{
+		const size_t middle = (lo + hi) / 2;
+		if (m_Table[middle] > coord)
+		{
+			hi = middle;
+		}
+		else
+		{
+			lo = middle;
+		}
+	}
+
+	const float span = m_Table[hi] - m_Table[lo];
+	const float frac = span > 0.0f ? (coord - m_Table[lo]) / span : 0.0f;
+	return ((float)lo + frac) / (float)(m_Table.size() - 1);
+}
+
+bool ParseShaperKind(const char* name, LutShaperKind& kind)
+{
+	for (int i = 0; i < (int)(sizeof(SHAPER_NAMES) / sizeof(SHAPER_NAMES[0])); ++i)
+	{
+		if (strcmp(name, SHAPER_NAMES[i]) == 0)
+		{
+			kind = (LutShaperKind)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+const char* GetShaperKindName(LutShaperKind kind)
+{
+	return SHAPER_NAMES[kind];
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+
+class LutChain;
+
+// How a shaper spreads the lattice of the cube behind it over the inputs
+enum LutShaperKind
+{
+	LUT_SHAPER_NONE,   // evenly, as a cube on its own
+	LUT_SHAPER_LOG,    // logarithmically, the shadows getting most of it
+	LUT_SHAPER_PQ,     // along the SMPTE ST 2084 curve, [0, 1] taken as 0 to 10000 nits
+	LUT_SHAPER_FITTED, // densest where the looks bend the most
+};
+
+// Entries of the shaper table, as files store it
+const size_t SHAPER_TABLE_SIZE = 4096;
+
+//
+// A 1D stage every channel goes through before the cube: it maps inputs in
+// [0, 1] to cube coordinates in [0, 1], so that the lattice is dense where
+// the look needs it and sparse where it does not. A cube baked behind a
+// shaper holds at each lattice point what the look gives for the input the
+// shaper maps there.
+//
+// The shaper is a table of SHAPER_TABLE_SIZE entries spanning the inputs,
+// increasing from 0 to 1, and sampled linearly. The empty shaper passes every
+// value through untouched.
+//
+class LutShaper
+{
+public:
+	LutShaper() {}
+
+	// LUT_SHAPER_FITTED is made for one cube size: it puts the lattice points
+	// where the curvature of the chain along the grey axis asks for them,
+	// which evens out the interpolation error. The others ignore the chain and
+	// the size.
+	static LutShaper Create(LutShaperKind kind, const LutChain& chain, size_t cubeSize);
+
+	// Takes a table read back from a file. False when it does not increase
+	// from 0 to 1.
+	bool SetTable(const std::vector<float>& table);
+
+	bool IsIdentity() const { return m_Table.empty(); }
+	const std::vector<float>& GetTable() const { return m_Table; }
+
+	// Cube coordinate of an input, clamped to [0, 1]
+	float Forward(float value) const;
+
+	// The input a cube coordinate stands for
+	float Inverse(float coord) const;
+
+private:
+	std::vector<float> m_Table;
+};
+
+bool ParseShaperKind(const char* name, LutShaperKind& kind);
+const char* GetShaperKindName(LutShaperKind kind);
+
@@ -0,0 +1,602 @@
+#include "MappedApply.h"
+#include "MappedFile.h"
+#include "LutApplier.h"
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+
+namespace
+{
+
+// A run of interleaved pixels inside the file
+struct PixelSpan
+{
+	unsigned long long Offset;
+	unsigned long long Size;
+};
+
+struct MappedLayout
+{
+	ImageFormat Format;
+	bool ByteSwapped; // samples are stored in the other byte order
+	std::vector<PixelSpan> Spans;
+};
+
+// Pixels per trip through the bounce buffer
+const size_t BOUNCE_PIXELS = 4096;
+
+bool IsBigEndianHost()
+{
+	const unsigned short probe = 1;
+	return *reinterpret_cast<const unsigned char*>(&probe) == 0;
+}
+
+// Copies a few header bytes out of the file, through a short-lived window
+bool ReadFileBytes(MappedFile& file, unsigned long long offset, size_t size, void* dst)
+{
+	if (offset > file.GetSize() || size > file.GetSize() - offset)
+	{
+		return false;
+	}
+
+	const unsigned char* window = file.MapWindow(offset, size);
+	if (!window)
+	{
+		return false;
+	}
+	memcpy(dst, window, size);
+	file.UnmapWindow();
+	return true;
+}
+
+//
+// PPM / PAM
+//
+
+class HeaderTokenizer
+{
+public:
+	HeaderTokenizer(const unsigned char* data, size_t size)
+		: m_Data(data)
+		, m_Size(size)
+		, m_Pos(0)
+	{}
+
+	bool Next(std::string& token)
+	{
+		token.clear();
+		while (m_Pos < m_Size)
+		{
+			char c = (char)m_Data[m_Pos];
+			if (c == '#')
+			{
+				while (m_Pos < m_Size && m_Data[m_Pos] != '\n')
+				{
+					++m_Pos;
+				}
+			}
+			else if (c == ' ' || c == '\t' || c == '\r' || c == '\n')
+			{
+				++m_Pos;
+			}
+			else
+			{
+				break;
+			}
+		}
+
+		while (m_Pos < m_Size)
+		{
+			char c = (char)m_Data[m_Pos];
+			if (c == ' ' || c == '\t' || c == '\r' || c == '\n')
+			{
+				break;
+			}
+			token += c;
+			++m_Pos;
+		}
+
+		// Exactly one whitespace byte separates the header from the raster
+		if (m_Pos < m_Size)
+		{
+			++m_Pos;
+		}
+		return !token.empty();
+	}
+
+	bool NextNumber(unsigned& value)
+	{
+		std::string token;
+		if (!Next(token) || token.size() > 9 || token.find_first_not_of("0123456789") != std::string::npos)
+		{
+			return false;
+		}
+		value = (unsigned)atoi(token.c_str());
+		return true;
+	}
+
+	size_t GetPosition() const { return m_Pos; }
+
+private:
+	const unsigned char* m_Data;
+	size_t m_Size;
+	size_t m_Pos;
+};
+
+bool ParsePnmLayout(MappedFile& file, MappedLayout& layout)
+{
+	unsigned char header[1024];
+	const size_t headerSize = (size_t)std::min<unsigned long long>(sizeof(header), file.GetSize());
+	if (!ReadFileBytes(file, 0, headerSize, header))
+	{
+		return false;
+	}
+
+	HeaderTokenizer tokens(header, headerSize);
+	std::string magic;
+	tokens.Next(magic);
+
+	unsigned width = 0;
+	unsigned height = 0;
+	unsigned maxValue = 0;
+
+	unsigned channels = 3;
+	if (magic == "P6")
+	{
+		if (!tokens.NextNumber(width) || !tokens.NextNumber(height) || !tokens.NextNumber(maxValue))
+		{
+			return false;
+		}
+	}
+	else if (magic == "P7")
+	{
+		std::string token;
+		std::string tupleType;
+		unsigned depth = 0;
+		for (;;)
+		{
+			if (!tokens.Next(token))
+			{
+				return false;
+			}
+			if (token == "ENDHDR")
+			{
+				break;
+			}
+
+			bool ok = true;
+			if (token == "WIDTH") ok = tokens.NextNumber(width);
+			else if (token == "HEIGHT") ok = tokens.NextNumber(height);
+			else if (token == "DEPTH") ok = tokens.NextNumber(depth);
+			else if (token == "MAXVAL") ok = tokens.NextNumber(maxValue);
+			else if (token == "TUPLTYPE") ok = tokens.Next(tupleType);
+			if (!ok)
+			{
+				return false;
+			}
+		}
+
+		if (!((tupleType == "RGB" && depth == 3) || (tupleType == "RGB_ALPHA" && depth == 4)))
+		{
+			std::cerr << "Only RGB and RGB_ALPHA PAM files can be graded in place." << std::endl;
+			return false;
+		}
+		channels = depth;
+	}
+	else
+	{
+		return false;
+	}
+
+	if (maxValue != 255 && maxValue != 65535)
+	{
+		std::cerr << "Only full range 8-bit and 16-bit PNM files can be graded in place." << std::endl;
+		return false;
+	}
+
+	// 16-bit samples are big-endian
+	const bool wide = maxValue == 65535;
+	if (wide)
+	{
+		layout.Format = channels == 4 ? IMAGE_FORMAT_RGBA16 : IMAGE_FORMAT_RGB16;
+		layout.ByteSwapped = !IsBigEndianHost();
+	}
+	else
+	{
+		layout.Format = channels == 4 ? IMAGE_FORMAT_RGBA8 : IMAGE_FORMAT_RGB8;
+	}
+
+	PixelSpan span;
+	span.Offset = tokens.GetPosition();
+	span.Size = (unsigned long long)width * height * channels * (wide ? 2 : 1);
+	layout.Spans.push_back(span);
+	return true;
+}
+
+//
+// Baseline TIFF, uncompressed and chunky (interleaved)
+//
+
+class TiffReader
+{
+public:
+	TiffReader(MappedFile& file, bool bigEndian)
+		: m_File(file)
+		, m_BigEndian(bigEndian)
+	{}
+
+	unsigned Get16(const unsigned char* p) const
+	{
+		return m_BigEndian ? (p[0] << 8) | p[1] : p[0] | (p[1] << 8);
+	}
+
+	unsigned Get32(const unsigned char* p) const
+	{
+		return m_BigEndian
+			? ((unsigned)p[0] << 24) | ((unsigned)p[1] << 16) | ((unsigned)p[2] << 8) | p[3]
+			: p[0] | ((unsigned)p[1] << 8) | ((unsigned)p[2] << 16) | ((unsigned)p[3] << 24);
+	}
+
+	// Reads the SHORT or LONG values of an IFD entry, inline or out of line
+	bool ReadValues(const unsigned char* entry, std::vector<unsigned>& values) const
+	{
+		const unsigned type = Get16(&entry[2]);
+		const unsigned count = Get32(&entry[4]);
+		const unsigned size = type == 3 ? 2 : (type == 4 ? 4 : 0);
+		if (size == 0 || count == 0 || count > (1 << 24))
+		{
+			return false;
+		}
+
+		std::vector<unsigned char> bytes(size * count);
+		if (bytes.size() <= 4)
+		{
+			memcpy(&bytes[0], &entry[8], bytes.size());
+		}
+		else if (!ReadFileBytes(m_File, Get32(&entry[8]), bytes.size(), &bytes[0]))
+		{
+			return false;
+		}
+
+		values.resize(count);
+		for (unsigned i = 0; i < count; ++i)
+		{
+			values[i] = size == 2 ? Get16(&bytes[i * 2]) : Get32(&bytes[i * 4]);
+		}
+		return true;
+	}
+
+private:
+	MappedFile& m_File;
+	bool m_BigEndian;
+};
+
+bool ParseTiffLayout(MappedFile& file, MappedLayout& layout)
+{
+	unsigned char header[8];
+	if (!ReadFileBytes(file, 0, sizeof(header), header))
+	{
+		return false;
+	}
+
+	const bool bigEndian = header[0] == 'M';
+	TiffReader tiff(file, bigEndian);
+	if (tiff.Get16(&header[2]) != 42)
+	{
+		return false;
+	}
+
+	const unsigned ifdOffset = tiff.Get32(&header[4]);
+	unsigned char countBytes[2];
+	if (!ReadFileBytes(file, ifdOffset, 2, countBytes))
+	{
+		return false;
+	}
+
+	const unsigned entryCount = tiff.Get16(countBytes);
+	std::vector<unsigned char> entries(entryCount * 12);
+	if (entryCount == 0 || !ReadFileBytes(file, ifdOffset + 2, entries.size(), &entries[0]))
+	{
+		return false;
+	}
+
+	unsigned width = 0;
+	unsigned height = 0;
+	unsigned samplesPerPixel = 1;
+	unsigned compression = 1;
+	unsigned photometric = 0;
+	unsigned planarConfig = 1;
+	unsigned sampleFormat = 1;
+	std::vector<unsigned> bitsPerSample;
+	std::vector<unsigned> stripOffsets;
+	std::vector<unsigned> stripByteCounts;
+
+	for (unsigned i = 0; i < entryCount; ++i)
+	{
+		const unsigned char* entry = &entries[i * 12];
+		std::vector<unsigned> values;
+		if (!tiff.ReadValues(entry, values))
+		{
+			continue; // tags of other types are of no interest here
+		}
+
+		switch (tiff.Get16(entry))
+		{
+		case 256: width = values[0]; break;
+		case 257: height = values[0]; break;
+		case 258: bitsPerSample = values; break;
+		case 259: compression = values[0]; break;
+		case 262: photometric = values[0]; break;
+		case 273: stripOffsets = values; break;
+		case 277: samplesPerPixel = values[0]; break;
+		case 279: stripByteCounts = values; break;
+		case 284: planarConfig = values[0]; break;
+		case 339: sampleFormat = values[0]; break;
+		}
+	}
+
+	const unsigned bits = bitsPerSample.empty() ? 0 : bitsPerSample[0];
+	const bool uniformBits = bits != 0 &&
+		std::count(bitsPerSample.begin(), bitsPerSample.end(), bits) == (std::ptrdiff_t)bitsPerSample.size();
+	const bool rgba = samplesPerPixel == 4;
+
+	// Unsigned 8 or 16-bit integers, or half-float RGBA
+	bool supported = compression == 1 && photometric == 2 && planarConfig == 1 && uniformBits &&
+		(samplesPerPixel == 3 || rgba);
+	if (sampleFormat == 1 && bits == 8)
+	{
+		layout.Format = rgba ? IMAGE_FORMAT_RGBA8 : IMAGE_FORMAT_RGB8;
+	}
+	else if (sampleFormat == 1 && bits == 16)
+	{
+		layout.Format = rgba ? IMAGE_FORMAT_RGBA16 : IMAGE_FORMAT_RGB16;
+	}
+	else if (sampleFormat == 3 && bits == 16 && rgba)
+	{
+		layout.Format = IMAGE_FORMAT_RGBA16F;
+	}
+	else
+	{
+		supported = false;
+	}
+
+	if (!supported)
+	{
+		std::cerr << "Only uncompressed, interleaved 8 or 16-bit RGB(A) and half-float RGBA TIFF files can be graded in place." << std::endl;
+		return false;
+	}
+	layout.ByteSwapped = bits == 16 && bigEndian != IsBigEndianHost();
+
+	if (stripOffsets.empty() || stripOffsets.size() != stripByteCounts.size())
+	{
+		std::cerr << "TIFF strip layout is missing or inconsistent!" << std::endl;
+		return false;
+	}
+
+	unsigned long long remaining = (unsigned long long)width * height * samplesPerPixel * (bits / 8);
+	for (size_t i = 0; i < stripOffsets.size() && remaining > 0; ++i)
+	{
+		PixelSpan span;
+		span.Offset = stripOffsets[i];
+		span.Size = std::min<unsigned long long>(stripByteCounts[i], remaining);
+		layout.Spans.push_back(span);
+		remaining -= span.Size;
+	}
+
+	return remaining == 0;
+}
+
+bool ParseLayout(MappedFile& file, const RawImageDesc* raw, MappedLayout& layout)
+{
+	if (raw)
+	{
+		PixelSpan span;
+		span.Offset = raw->Offset;
+		span.Size = (unsigned long long)raw->Width * raw->Height * GetChannelCount(raw->Format) * GetBytesPerChannel(raw->Format);
+		layout.Format = raw->Format;
+		layout.Spans.push_back(span);
+		return true;
+	}
+
+	unsigned char magic[4] = {};
+	if (!ReadFileBytes(file, 0, std::min<unsigned long long>(sizeof(magic), file.GetSize()), magic))
+	{
+		return false;
+	}
+
+	if (magic[0] == 'P')
+	{
+		return ParsePnmLayout(file, layout);
+	}
+	if ((magic[0] == 'I' && magic[1] == 'I') || (magic[0] == 'M' && magic[1] == 'M'))
+	{
+		return ParseTiffLayout(file, layout);
+	}
+
+	std::cerr << "Only PPM/PAM, uncompressed TIFF and raw files can be graded in place." << std::endl;
+	return false;
+}
+
+// Copies the bytes between pixel spans (headers, IFDs) into the output file
+bool CopyGaps(MappedFile& input, MappedFile& output, std::vector<PixelSpan> spans, size_t windowSize)
+{
+	std::sort(spans.begin(), spans.end(), [](const PixelSpan& a, const PixelSpan& b) { return a.Offset < b.Offset; });
+
+	unsigned long long position = 0;
+	for (size_t i = 0; i <= spans.size(); ++i)
+	{
+		const unsigned long long gapEnd = i < spans.size() ? spans[i].Offset : input.GetSize();
+		while (position < gapEnd)
+		{
+			const size_t size = (size_t)std::min<unsigned long long>(gapEnd - position, windowSize);
+			const unsigned char* src = input.MapWindow(position, size);
+			unsigned char* dst = output.MapWindow(position, size);
+			if (!src || !dst)
+			{
+				return false;
+			}
+			memcpy(dst, src, size);
+			position += size;
+		}
+
+		if (i < spans.size())
+		{
+			position = std::max(position, spans[i].Offset + spans[i].Size);
+		}
+	}
+
+	input.UnmapWindow();
+	output.UnmapWindow();
+	return true;
+}
+
+void Apply16(const LutApplier& applier, ImageFormat format, const unsigned short* src, unsigned short* dst, size_t count)
+{
+	if (format == IMAGE_FORMAT_RGBA16F)
+	{
+		applier.ApplyInterleavedHalf(src, dst, count);
+	}
+	else
+	{
+		applier.ApplyInterleaved16(src, dst, count, GetChannelCount(format));
+	}
+}
+
+void SwapBytes16(unsigned short* samples, size_t count)
+{
+	for (size_t i = 0; i < count; ++i)
+	{
+		samples[i] = (unsigned short)((samples[i] >> 8) | (samples[i] << 8));
+	}
+}
+
+// Grades one window of whole pixels, src and dst may alias
+void ApplyWindow(const LutApplier& applier, const MappedLayout& layout, const unsigned char* src, unsigned char* dst, size_t count, std::vector<unsigned short>& bounce)
+{
+	const ImageFormat format = layout.Format;
+	const unsigned channels = GetChannelCount(format);
+
+	if (GetBytesPerChannel(format) == 1)
+	{
+		applier.ApplyInterleaved(src, dst, count, channels);
+		return;
+	}
+
+	const bool aligned = (reinterpret_cast<size_t>(src) | reinterpret_cast<size_t>(dst)) % sizeof(unsigned short) == 0;
+	if (aligned && !layout.ByteSwapped)
+	{
+		Apply16(applier, format, reinterpret_cast<const unsigned short*>(src), reinterpret_cast<unsigned short*>(dst), count);
+		return;
+	}
+
+	bounce.resize(BOUNCE_PIXELS * channels);
+	const size_t pixelSize = channels * sizeof(unsigned short);
+	for (size_t done = 0; done < count; done += BOUNCE_PIXELS)
+	{
+		const size_t run = std::min(count - done, BOUNCE_PIXELS);
+		memcpy(&bounce[0], &src[done * pixelSize], run * pixelSize);
+		if (layout.ByteSwapped)
+		{
+			SwapBytes16(&bounce[0], run * channels);
+		}
+
+		Apply16(applier, format, &bounce[0], &bounce[0], run);
+
+		if (layout.ByteSwapped)
+		{
+			SwapBytes16(&bounce[0], run * channels);
+		}
+		memcpy(&dst[done * pixelSize], &bounce[0], run * pixelSize);
+	}
+}
+
+} // namespace
+
+bool ApplyLutToMappedFile(
+	const LutApplier& applier,
+	const PathChar* inputFile,
+	const PathChar* outputFile,
+	const RawImageDesc* raw,
+	size_t windowSize)
+{
+	MappedFile input;
+	if (!input.Open(inputFile, outputFile == nullptr))
+	{
+		return false;
+	}
+
+	MappedLayout layout;
+	layout.ByteSwapped = false;
+	if (!ParseLayout(input, raw, layout))
+	{
+		std::cerr << "Unable to locate the pixel data of: " << NarrowPath(inputFile) << std::endl;
+		return false;
+	}
+
+	for (size_t i = 0; i < layout.Spans.size(); ++i)
+	{
+		const PixelSpan& span = layout.Spans[i];
+		if (span.Offset > input.GetSize() || span.Size > input.GetSize() - span.Offset)
+		{
+			std::cerr << "Pixel data runs past the end of: " << NarrowPath(inputFile) << std::endl;
+			return false;
+		}
+	}
+
+	// Nothing to write back
+	if (!outputFile && applier.PassesThrough(layout.Format))
+	{
+		return true;
+	}
+
+	MappedFile output;
+	if (outputFile)
+	{
+		if (!output.Create(outputFile, input.GetSize()) || !CopyGaps(input, output, layout.Spans, windowSize))
+		{
+			std::cerr << "Unable to write: " << NarrowPath(outputFile) << std::endl;
+			return false;
+		}
+	}
+
+	// Windows hold whole pixels only
+	const size_t pixelSize = GetChannelCount(layout.Format) * GetBytesPerChannel(layout.Format);
+	std::vector<unsigned short> bounce;
+	const size_t chunk = std::max<size_t>(windowSize / pixelSize, 1) * pixelSize;
+
+	for (size_t i = 0; i < layout.Spans.size(); ++i)
+	{
+		const PixelSpan& span = layout.Spans[i];
+		const unsigned long long usable = span.Size - span.Size % pixelSize;
+
+		for (unsigned long long done = 0; done < usable; done += chunk)
+		{
+			const unsigned long long offset = span.Offset + done;
+			const size_t size = (size_t)std::min<unsigned long long>(chunk, usable - done);
+
+			// Ask for the next window while this one is being graded
+			input.WillNeed(offset + size, chunk);
+
+			unsigned char* src = input.MapWindow(offset, size);
+			unsigned char* dst = outputFile ? output.MapWindow(offset, size) : src;
+			if (!src || !dst)
+			{
+				std::cerr << "Unable to map " << size << " bytes at offset " << offset << std::endl;
+				return false;
+			}
+
+			ApplyWindow(applier, layout, src, dst, size / pixelSize, bounce);
+
+			input.DoneWithWindow();
+			if (outputFile)
+			{
+				output.DoneWithWindow();
+			}
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "Platform.h"
+#include "Image.h"
+#include <cstddef>
+
+class LutApplier;
+
+// Layout of a headerless raw file, which carries no description of its own
+struct RawImageDesc
+{
+	unsigned Width;
+	unsigned Height;
+	ImageFormat Format; // samples in native byte order
+	unsigned long long Offset; // bytes to skip before the first pixel
+};
+
+const size_t DEFAULT_MAPPED_WINDOW_SIZE = 64 << 20;
+
+//
+// Grades 8 or 16-bit PPM/PAM, uncompressed chunky TIFF (including half-float
+// RGBA) or raw files without copying pixels into heap buffers. The pixel data
+// is walked through in mapped windows of windowSize bytes with readahead for
+// the next window, so files larger than RAM work too. 16-bit samples stored in
+// the other byte order (or at odd offsets) pass through a small bounce buffer.
+//
+// With a null outputFile the input is modified in place, or left alone when
+// the LUT passes its format through. Otherwise a mapped output file of the
+// same size is written, header bytes copied verbatim.
+// Pass raw to treat the input as a headerless raw file.
+//
+bool ApplyLutToMappedFile(
+	const LutApplier& applier,
+	const PathChar* inputFile,
+	const PathChar* outputFile,
+	const RawImageDesc* raw,
+	size_t windowSize = DEFAULT_MAPPED_WINDOW_SIZE
+	);
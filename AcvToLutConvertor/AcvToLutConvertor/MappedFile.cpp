@@ -0,0 +1,294 @@
+#include "MappedFile.h"
+#include <iostream>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+	: m_Size(0)
+	, m_Writable(false)
+	, m_View(nullptr)
+	, m_ViewSize(0)
+#ifdef _WIN32
+	, m_File(INVALID_HANDLE_VALUE)
+	, m_Mapping(nullptr)
+#else
+	, m_File(-1)
+#endif
+{}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+size_t MappedFile::GetAllocationGranularity()
+{
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwAllocationGranularity;
+#else
+	return (size_t)sysconf(_SC_PAGESIZE);
+#endif
+}
+
+#ifdef _WIN32
+
+bool MappedFile::Open(const PathChar* path, bool writable)
+{
+	Close();
+
+	m_File = CreateFileW(path, writable ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (m_File == INVALID_HANDLE_VALUE)
+	{
+		std::cerr << "Unable to open file: " << NarrowPath(path) << std::endl;
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(m_File, &size) || size.QuadPart == 0)
+	{
+		std::cerr << "Unable to map an empty file: " << NarrowPath(path) << std::endl;
+		Close();
+		return false;
+	}
+	m_Size = (unsigned long long)size.QuadPart;
+	m_Writable = writable;
+
+	m_Mapping = CreateFileMappingW(m_File, nullptr, writable ? PAGE_READWRITE : PAGE_READONLY, 0, 0, nullptr);
+	if (!m_Mapping)
+	{
+		std::cerr << "Unable to map file: " << NarrowPath(path) << std::endl;
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+bool MappedFile::Create(const PathChar* path, unsigned long long size)
+{
+	Close();
+
+	m_File = CreateFileW(path, GENERIC_READ | GENERIC_WRITE, 0, nullptr,
+		CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (m_File == INVALID_HANDLE_VALUE)
+	{
+		std::cerr << "Unable to create file: " << NarrowPath(path) << std::endl;
+		return false;
+	}
+
+	m_Size = size;
+	m_Writable = true;
+
+	m_Mapping = CreateFileMappingW(m_File, nullptr, PAGE_READWRITE, (DWORD)(size >> 32), (DWORD)(size & 0xFFFFFFFF), nullptr);
+	if (!m_Mapping)
+	{
+		std::cerr << "Unable to map file: " << NarrowPath(path) << std::endl;
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+void MappedFile::Close()
+{
+	UnmapWindow();
+
+	if (m_Mapping)
+	{
+		CloseHandle(m_Mapping);
+		m_Mapping = nullptr;
+	}
+	if (m_File != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(m_File);
+		m_File = INVALID_HANDLE_VALUE;
+	}
+	m_Size = 0;
+}
+
+bool MappedFile::IsOpen() const
+{
+	return m_Mapping != nullptr;
+}
+
+unsigned char* MappedFile::MapWindow(unsigned long long offset, size_t size)
+{
+	UnmapWindow();
+
+	const unsigned long long granularity = GetAllocationGranularity();
+	const unsigned long long start = offset - offset % granularity;
+	const size_t lead = (size_t)(offset - start);
+
+	m_ViewSize = lead + size;
+	m_View = (unsigned char*)MapViewOfFile(m_Mapping, m_Writable ? FILE_MAP_WRITE : FILE_MAP_READ,
+		(DWORD)(start >> 32), (DWORD)(start & 0xFFFFFFFF), m_ViewSize);
+	if (!m_View)
+	{
+		m_ViewSize = 0;
+		return nullptr;
+	}
+
+	return m_View + lead;
+}
+
+void MappedFile::UnmapWindow()
+{
+	if (m_View)
+	{
+		UnmapViewOfFile(m_View);
+		m_View = nullptr;
+		m_ViewSize = 0;
+	}
+}
+
+void MappedFile::WillNeed(unsigned long long, size_t)
+{
+	// The cache manager already reads ahead for FILE_FLAG_SEQUENTIAL_SCAN handles
+}
+
+void MappedFile::DoneWithWindow()
+{
+	if (m_View && m_Writable)
+	{
+		FlushViewOfFile(m_View, m_ViewSize);
+	}
+}
+
+#else
+
+bool MappedFile::Open(const PathChar* path, bool writable)
+{
+	Close();
+
+	m_File = open(path, writable ? O_RDWR : O_RDONLY);
+	if (m_File < 0)
+	{
+		std::cerr << "Unable to open file: " << path << std::endl;
+		return false;
+	}
+
+	struct stat info;
+	if (fstat(m_File, &info) != 0 || info.st_size == 0)
+	{
+		std::cerr << "Unable to map an empty file: " << path << std::endl;
+		Close();
+		return false;
+	}
+
+	m_Size = (unsigned long long)info.st_size;
+	m_Writable = writable;
+	return true;
+}
+
+bool MappedFile::Create(const PathChar* path, unsigned long long size)
+{
+	Close();
+
+	m_File = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (m_File < 0 || ftruncate(m_File, (off_t)size) != 0)
+	{
+		std::cerr << "Unable to create file: " << path << std::endl;
+		Close();
+		return false;
+	}
+
+	m_Size = size;
+	m_Writable = true;
+	return true;
+}
+
+void MappedFile::Close()
+{
+	UnmapWindow();
+
+	if (m_File >= 0)
+	{
+		close(m_File);
+		m_File = -1;
+	}
+	m_Size = 0;
+}
+
+bool MappedFile::IsOpen() const
+{
+	return m_File >= 0;
+}
+
+unsigned char* MappedFile::MapWindow(unsigned long long offset, size_t size)
+{
+	UnmapWindow();
+
+	const unsigned long long granularity = GetAllocationGranularity();
+	const unsigned long long start = offset - offset % granularity;
+	const size_t lead = (size_t)(offset - start);
+
+	m_ViewSize = lead + size;
+	void* view = mmap(nullptr, m_ViewSize, m_Writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, m_File, (off_t)start);
+	if (view == MAP_FAILED)
+	{
+		m_ViewSize = 0;
+		return nullptr;
+	}
+
+	m_View = static_cast<unsigned char*>(view);
+	posix_madvise(m_View, m_ViewSize, POSIX_MADV_SEQUENTIAL);
+	return m_View + lead;
+}
+
+void MappedFile::UnmapWindow()
+{
+	if (m_View)
+	{
+		munmap(m_View, m_ViewSize);
+		m_View = nullptr;
+		m_ViewSize = 0;
+	}
+}
+
+void MappedFile::WillNeed(unsigned long long offset, size_t size)
+{
+	if (offset >= m_Size)
+	{
+		return;
+	}
+	if (size > m_Size - offset)
+	{
+		size = (size_t)(m_Size - offset);
+	}
+
+#ifdef POSIX_FADV_WILLNEED
+	posix_fadvise(m_File, (off_t)offset, (off_t)size, POSIX_FADV_WILLNEED);
+#endif
+}
+
+void MappedFile::DoneWithWindow()
+{
+	if (!m_View)
+	{
+		return;
+	}
+
+	if (m_Writable)
+	{
+		// Start write-back now so dirty pages do not pile up across windows
+		msync(m_View, m_ViewSize, MS_ASYNC);
+	}
+	else
+	{
+		posix_madvise(m_View, m_ViewSize, POSIX_MADV_DONTNEED);
+	}
+}
+
+#endif
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "Platform.h"
+#include <cstddef>
+
+// A file accessed through one mapped window at a time, so files far larger
+// than the address space (or RAM) can be walked through sequentially.
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	bool Open(const PathChar* path, bool writable);
+	// Creates (or truncates) a writable file of the given size
+	bool Create(const PathChar* path, unsigned long long size);
+	void Close();
+
+	bool IsOpen() const;
+	unsigned long long GetSize() const { return m_Size; }
+
+	// Maps [offset, offset + size) and returns a pointer to offset. The window
+	// is rounded out to the allocation granularity internally. Any previously
+	// mapped window is released first.
+	unsigned char* MapWindow(unsigned long long offset, size_t size);
+	void UnmapWindow();
+
+	// Readahead hint for a range that is about to be mapped
+	void WillNeed(unsigned long long offset, size_t size);
+	// Tells the OS the current window will not be touched again, so its pages
+	// can be dropped (read-only) or written back early (writable)
+	void DoneWithWindow();
+
+	static size_t GetAllocationGranularity();
+
+private:
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+
+	unsigned long long m_Size;
+	bool m_Writable;
+
+	unsigned char* m_View;
+	size_t m_ViewSize;
+
+#ifdef _WIN32
+	void* m_File;
+	void* m_Mapping;
+#else
+	int m_File;
+#endif
+};
@@ -0,0 +1,650 @@
+#include "PipelineBenchmark.h"
+#include "AcvCurves.h"
+#include "CurveSet.h"
+#include "LutChain.h"
+#include "Lut3D.h"
+#include "LazyLut3D.h"
+#include "LutApplier.h"
+#include "DdsVolume.h"
+#include "Image.h"
+#include "ImageCodecs.h"
+#include "CpuFeatures.h"
+#include "Stopwatch.h"
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+
+// Calls are repeated until one run takes at least this long
+const double MIN_RUN_MILLISECONDS = 5.0;
+const unsigned MAX_CALLS_PER_RUN = 1 << 20;
+
+const size_t CUBE_SIZES[] = { 16, 33, 64, 128 };
+
+// Inputs per channel for the evaluation stages, as many as a 16-bit table has
+const size_t EVALUATION_COUNT = 65536;
+
+// Colours sampled at random from the large cube of the random access stages
+const size_t RANDOM_SAMPLE_COUNT = 4096;
+const size_t RANDOM_CUBE_SIZE = 128;
+
+// Preview cubes of the curve editing stages
+const size_t EDIT_CUBE_SIZE = 65;
+
+// Stand-in when the corpus has no image the codecs read
+const unsigned SYNTHETIC_WIDTH = 1920;
+const unsigned SYNTHETIC_HEIGHT = 1080;
+
+// Timed work leaves a value here so the optimizer cannot drop it
+volatile float g_Sink;
+
+PipelineBenchmarkResult TimeStage(
+	const std::string& name,
+	double operations,
+	double bytes,
+	double pixels,
+	const std::function<void()>& call,
+	const PipelineBenchmarkOptions& options)
+{
+	// One call calibrates how many make a run long enough to time
+	Stopwatch stopwatch;
+	call();
+	const double once = stopwatch.GetElapsedMilliseconds();
+	unsigned calls = 1;
+	if (once < MIN_RUN_MILLISECONDS)
+	{
+		const double needed = MIN_RUN_MILLISECONDS / (once > 1e-6 ? once : 1e-6);
+		calls = needed < MAX_CALLS_PER_RUN ? (unsigned)needed + 1 : MAX_CALLS_PER_RUN;
+	}
+
+	std::vector<double> times;
+	for (unsigned run = 0; run < options.WarmupRuns + options.Runs; ++run)
+	{
+		stopwatch.Restart();
+		for (unsigned i = 0; i < calls; ++i)
+		{
+			call();
+		}
+		const double elapsed = stopwatch.GetElapsedMilliseconds() / calls;
+		if (run >= options.WarmupRuns)
+		{
+			times.push_back(elapsed);
+		}
+	}
+	std::sort(times.begin(), times.end());
+
+	PipelineBenchmarkResult result;
+	result.Name = name;
+	result.OperationsPerCall = operations;
+	result.CallsPerRun = calls;
+	result.BestMilliseconds = times[0];
+	result.MedianMilliseconds = times[times.size() / 2];
+	result.NanosecondsPerOperation = times[0] * 1e6 / operations;
+	result.MegabytesPerSecond = bytes / (times[0] * 1000.0);
+	result.MegapixelsPerSecond = pixels / (times[0] * 1000.0);
+	return result;
+}
+
+std::string GetFileName(const PathString& path)
+{
+	const std::string narrow = NarrowPath(path.c_str());
+	return narrow.substr(narrow.find_last_of("/\\") + 1);
+}
+
+void MakeSyntheticFrame(Image& image)
+{
+	image.Allocate(SYNTHETIC_WIDTH, SYNTHETIC_HEIGHT, IMAGE_FORMAT_RGB8, IMAGE_LAYOUT_INTERLEAVED);
+	for (unsigned y = 0; y < SYNTHETIC_HEIGHT; ++y)
+	{
+		unsigned char* row = image.GetRow(y);
+		for (unsigned x = 0; x < SYNTHETIC_WIDTH; ++x)
+		{
+			row[x * 3] = (unsigned char)(x * 255 / (SYNTHETIC_WIDTH - 1));
+			row[x * 3 + 1] = (unsigned char)(y * 255 / (SYNTHETIC_HEIGHT - 1));
+			row[x * 3 + 2] = (unsigned char)((x + y) & 0xFF);
+		}
+	}
+}
+
+void AppendJsonString(std::ostringstream& json, const std::string& text)
+{
+	json << '"';
+	for (size_t i = 0; i < text.size(); ++i)
+	{
+		const unsigned char c = (unsigned char)text[i];
+		if (c == '"' || c == '\\')
+		{
+			json << '\\' << (char)c;
+		}
+		else if (c < 0x20)
+		{
+			char escaped[8];
+			sprintf(escaped, "\\u%04x", c);
+			json << escaped;
+		}
+		else
+		{
+			json << (char)c;
+		}
+	}
+	json << '"';
+}
+
+const char* GetCompilerName()
+{
+#if defined(_MSC_VER)
+	return "msvc";
+#elif defined(__clang__)
+	return "clang " __clang_version__;
+#elif defined(__GNUC__)
+	return "gcc " __VERSION__;
+#else
+	return "unknown";
+#endif
+}
+
+// Corpus entries are ACV files, images, or directories holding either
+void AddToCorpus(const PathChar* path, std::vector<PathString>& acvFiles, std::vector<PathString>& imageFiles, size_t& skipped)
+{
+	const std::string extension = GetPathExtension(path);
+	if (extension == "acv")
+	{
+		acvFiles.push_back(path);
+		return;
+	}
+	if (GetImageFileTypeFromPath(path) != IMAGE_FILE_UNKNOWN)
+	{
+		imageFiles.push_back(path);
+		return;
+	}
+
+	std::vector<PathString> files;
+	if (!extension.empty() || !ListFiles(path, files))
+	{
+		++skipped;
+		return;
+	}
+	for (size_t i = 0; i < files.size(); ++i)
+	{
+		const PathString file = PathString(path) + PATH_LITERAL("/") + files[i];
+		const std::string fileExtension = GetPathExtension(file.c_str());
+		if (fileExtension == "acv")
+		{
+			acvFiles.push_back(file);
+		}
+		else if (GetImageFileTypeFromPath(file.c_str()) != IMAGE_FILE_UNKNOWN)
+		{
+			imageFiles.push_back(file);
+		}
+		else if (fileExtension == "jpg" || fileExtension == "jpeg" || fileExtension == "tif" || fileExtension == "tiff")
+		{
+			++skipped;
+		}
+	}
+}
+
+} // namespace
+
+bool RunPipelineBenchmarks(
+	const std::vector<PathString>& acvFiles,
+	const std::vector<PathString>& imageFiles,
+	const PipelineBenchmarkOptions& options,
+	std::vector<PipelineBenchmarkResult>& results)
+{
+	if (acvFiles.empty())
+	{
+		std::cerr << "The corpus holds no ACV files." << std::endl;
+		return false;
+	}
+	if (options.PinnedCpu >= 0 && !PinThreadToCpu((unsigned)options.PinnedCpu))
+	{
+		std::cerr << "Unable to pin the benchmark to CPU " << options.PinnedCpu << ", running unpinned." << std::endl;
+	}
+
+	// Every file read once up front, for the stages after parsing
+	std::vector<std::vector<CurvePoints>> points(acvFiles.size());
+	std::vector<std::vector<CubicSpline>> splines(acvFiles.size());
+	for (size_t i = 0; i < acvFiles.size(); ++i)
+	{
+		if (!ReadACVCurvePoints(acvFiles[i].c_str(), points[i]) || !ReadCurves(acvFiles[i].c_str(), splines[i]))
+		{
+			return false;
+		}
+	}
+
+	// Parsing: per file, MB/s of file
+	for (size_t i = 0; i < acvFiles.size(); ++i)
+	{
+		FileStamp stamp;
+		GetFileStamp(acvFiles[i].c_str(), stamp);
+		const PathChar* path = acvFiles[i].c_str();
+		results.push_back(TimeStage("acv-parse/" + GetFileName(acvFiles[i]), 1.0, (double)stamp.Size, 0.0, [&]()
+		{
+			std::vector<CurvePoints> curves;
+			ReadACVCurvePoints(path, curves);
+			g_Sink = curves.empty() ? 0.0f : (float)curves.size();
+		}, options));
+	}
+
+	// Spline building: per curve, MB/s of points
+	for (size_t i = 0; i < acvFiles.size(); ++i)
+	{
+		const std::vector<CurvePoints>& curves = points[i];
+		size_t pointCount = 0;
+		for (size_t c = 0; c < curves.size(); ++c)
+		{
+			pointCount += curves[c].size();
+		}
+		results.push_back(TimeStage("spline-build/" + GetFileName(acvFiles[i]), (double)curves.size(),
+			(double)(pointCount * sizeof(CurvePoints::value_type)), 0.0, [&]()
+		{
+			for (size_t c = 0; c < curves.size(); ++c)
+			{
+				g_Sink = CubicSpline::InterpolateCubicSplineFromCurvePoints(curves[c]).IsIdentity() ? 1.0f : 0.0f;
+			}
+		}, options));
+	}
+
+	// Evaluation of ascending inputs, as tables are filled: per evaluation of
+	// one channel, MB/s of results
+	std::vector<float> inputs(EVALUATION_COUNT);
+	std::vector<float> outputs(EVALUATION_COUNT);
+	for (size_t i = 0; i < EVALUATION_COUNT; ++i)
+	{
+		inputs[i] = (float)i / (float)(EVALUATION_COUNT - 1);
+	}
+	const double evaluations = 3.0 * EVALUATION_COUNT;
+	for (size_t i = 0; i < acvFiles.size(); ++i)
+	{
+		const std::vector<CubicSpline>& curves = splines[i];
+		results.push_back(TimeStage("compute-at-point/" + GetFileName(acvFiles[i]), evaluations, evaluations * sizeof(float), 0.0, [&]()
+		{
+			for (int c = 0; c < 3; ++c)
+			{
+				for (size_t j = 0; j < EVALUATION_COUNT; ++j)
+				{
+					outputs[j] = EvaluateCurves(curves, c, inputs[j]);
+				}
+			}
+			g_Sink = outputs[EVALUATION_COUNT / 2];
+		}, options));
+		results.push_back(TimeStage("batch-evaluate/" + GetFileName(acvFiles[i]), evaluations, evaluations * sizeof(float), 0.0, [&]()
+		{
+			for (int c = 0; c < 3; ++c)
+			{
+				EvaluateCurves(curves, c, &inputs[0], &outputs[0], EVALUATION_COUNT);
+			}
+			g_Sink = outputs[EVALUATION_COUNT / 2];
+		}, options));
+	}
+
+	// Cube fill, every file baked at each size: per texel, MB/s of cube
+	std::vector<Lut3D> cubes;
+	for (size_t s = 0; s < sizeof(CUBE_SIZES) / sizeof(CUBE_SIZES[0]); ++s)
+	{
+		const size_t size = CUBE_SIZES[s];
+		const double texels = (double)acvFiles.size() * size * size * size;
+		std::ostringstream name;
+		name << "cube-fill/" << size;
+		results.push_back(TimeStage(name.str(), texels, texels * 3 * sizeof(float), 0.0, [&]()
+		{
+			for (size_t i = 0; i < splines.size(); ++i)
+			{
+				LutChain chain;
+				chain.AddCurves(splines[i]);
+				g_Sink = chain.Bake(size).GetTexel(0, 0, 0)[0];
+			}
+		}, options));
+
+		LutChain chain;
+		chain.AddCurves(splines[0]);
+		cubes.push_back(chain.Bake(size));
+	}
+
+	// Random access to a large cube of the first file, baked whole against
+	// worked out one lattice point at a time as samples reach them: per sample
+	std::vector<float> samples(3 * RANDOM_SAMPLE_COUNT);
+	unsigned seed = 1;
+	for (size_t i = 0; i < samples.size(); ++i)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		samples[i] = (float)(seed >> 8) / (float)(1 << 24);
+	}
+	LutChain randomChain;
+	randomChain.AddCurves(splines[0]);
+	for (int lazy = 0; lazy < 2; ++lazy)
+	{
+		std::ostringstream name;
+		name << "random-access/" << RANDOM_CUBE_SIZE << "/" << (lazy ? "lazy" : "baked");
+		results.push_back(TimeStage(name.str(), (double)RANDOM_SAMPLE_COUNT, (double)samples.size() * sizeof(float), 0.0, [&]()
+		{
+			float out[3] = {};
+			if (lazy)
+			{
+				const LazyLut3D cube(randomChain, RANDOM_CUBE_SIZE);
+				for (size_t i = 0; i < RANDOM_SAMPLE_COUNT; ++i)
+				{
+					cube.Sample(samples[3 * i], samples[3 * i + 1], samples[3 * i + 2], out);
+				}
+			}
+			else
+			{
+				const Lut3D cube = randomChain.Bake(RANDOM_CUBE_SIZE);
+				for (size_t i = 0; i < RANDOM_SAMPLE_COUNT; ++i)
+				{
+					cube.Sample(samples[3 * i], samples[3 * i + 1], samples[3 * i + 2], out);
+				}
+			}
+			g_Sink = out[0];
+		}, options));
+	}
+
+	// A knot in the middle of each file's busiest curve dragged a step up and
+	// back, the preview cube brought up to date after every step: per update,
+	// MB/s of cube
+	for (size_t i = 0; i < acvFiles.size(); ++i)
+	{
+		size_t curve = 0;
+		for (size_t c = 1; c < 4; ++c)
+		{
+			if (points[i][c].size() > points[i][curve].size())
+			{
+				curve = c;
+			}
+		}
+		const size_t knot = points[i][curve].size() / 2;
+		const std::pair<float, float> point = points[i][curve][knot];
+		const float knotOutputs[2] = { point.second < 255.0f ? point.second + 1.0f : point.second - 1.0f, point.second };
+
+		CurveSet curves(points[i], EDIT_CUBE_SIZE);
+		size_t step = 0;
+		std::ostringstream name;
+		name << "curve-edit/" << GetFileName(acvFiles[i]) << "/" << EDIT_CUBE_SIZE;
+		const double cubeBytes = (double)EDIT_CUBE_SIZE * EDIT_CUBE_SIZE * EDIT_CUBE_SIZE * 3 * sizeof(float);
+		results.push_back(TimeStage(name.str(), 1.0, cubeBytes, 0.0, [&]()
+		{
+			curves.MoveKnot(curve, knot, point.first, knotOutputs[step++ % 2]);
+			g_Sink = (float)curves.Update();
+		}, options));
+	}
+
+	// DDS encoding of the first file's cube: per volume, MB/s of file
+	std::vector<unsigned char> encoded;
+	for (size_t s = 0; s < cubes.size(); ++s)
+	{
+		EncodeDdsVolume(cubes[s], encoded);
+		std::ostringstream name;
+		name << "dds-encode/" << cubes[s].GetSize();
+		const Lut3D& cube = cubes[s];
+		results.push_back(TimeStage(name.str(), 1.0, (double)encoded.size(), 0.0, [&]()
+		{
+			EncodeDdsVolume(cube, encoded);
+			g_Sink = encoded[encoded.size() / 2];
+		}, options));
+	}
+
+	// Applying the first file's cube, as the apply command bakes it, to every
+	// image: per pixel, MB/s of input pixels
+	std::vector<Image> images;
+	std::vector<std::string> imageNames;
+	for (size_t i = 0; i < imageFiles.size(); ++i)
+	{
+		images.push_back(Image());
+		if (ReadImage(imageFiles[i].c_str(), images.back(), IMAGE_LAYOUT_INTERLEAVED))
+		{
+			imageNames.push_back(GetFileName(imageFiles[i]));
+		}
+		else
+		{
+			images.pop_back();
+		}
+	}
+	if (images.empty())
+	{
+		images.push_back(Image());
+		MakeSyntheticFrame(images.back());
+		imageNames.push_back("synthetic");
+	}
+
+	LutChain chain;
+	chain.AddCurves(splines[0]);
+	const Lut3D lut = chain.Bake(DEFAULT_CUBE_SIZE);
+	const LutInterpolation interpolations[] = { LUT_INTERPOLATION_SEPARABLE, LUT_INTERPOLATION_TRILINEAR, LUT_INTERPOLATION_TETRAHEDRAL };
+
+	for (size_t i = 0; i < images.size(); ++i)
+	{
+		const Image& source = images[i];
+		Image target;
+		target.Allocate(source.GetWidth(), source.GetHeight(), source.GetFormat(), IMAGE_LAYOUT_INTERLEAVED);
+		const double pixels = (double)source.GetWidth() * source.GetHeight();
+
+		for (size_t m = 0; m < sizeof(interpolations) / sizeof(interpolations[0]); ++m)
+		{
+			LutApplier applier(lut);
+			if (!applier.SetInterpolation(interpolations[m]))
+			{
+				continue;
+			}
+
+			std::ostringstream name;
+			name << "apply/" << imageNames[i] << "/" << GetImageFormatName(source.GetFormat()) << "/" << GetInterpolationName(interpolations[m]);
+			results.push_back(TimeStage(name.str(), pixels, pixels * source.GetPixelSize(), pixels, [&]()
+			{
+				for (unsigned y = 0; y < source.GetHeight(); ++y)
+				{
+					applier.Apply(source.GetRow(y), source.GetFormat(), target.GetRow(y), target.GetFormat(), source.GetWidth());
+				}
+				g_Sink = target.GetRow(0)[0];
+			}, options));
+		}
+	}
+
+	// The colour cache, off and on under the trilinear and tetrahedral
+	// kernels, on the first image posterized to eight levels per channel as
+	// screenshots and graphics could be. Graded in place from a fresh copy
+	// every call: per pixel, MB/s of input pixels
+	const Image& source = images[0];
+	Image posterized;
+	Image target;
+	posterized.Allocate(source.GetWidth(), source.GetHeight(), source.GetFormat(), IMAGE_LAYOUT_INTERLEAVED);
+	target.Allocate(source.GetWidth(), source.GetHeight(), source.GetFormat(), IMAGE_LAYOUT_INTERLEAVED);
+	const size_t rowBytes = source.GetWidth() * source.GetPixelSize();
+	for (unsigned y = 0; y < source.GetHeight(); ++y)
+	{
+		const unsigned char* row = source.GetRow(y);
+		unsigned char* levels = posterized.GetRow(y);
+		for (size_t i = 0; i < rowBytes; ++i)
+		{
+			// The top three bits of every channel, the high byte of 16-bit ones
+			levels[i] = GetBytesPerChannel(source.GetFormat()) == 1 || i % 2 ? row[i] & 0xE0 : 0;
+		}
+	}
+
+	const double pixels = (double)source.GetWidth() * source.GetHeight();
+	for (size_t m = 1; m < sizeof(interpolations) / sizeof(interpolations[0]); ++m)
+	{
+		for (int cached = 0; cached < 2; ++cached)
+		{
+			LutApplier applier(lut);
+			applier.SetInterpolation(interpolations[m]);
+			applier.SetColourCache(cached != 0);
+
+			std::ostringstream name;
+			name << "colour-cache/" << imageNames[0] << "/" << GetImageFormatName(source.GetFormat()) << "/"
+				<< GetInterpolationName(interpolations[m]) << "/" << (cached ? "on" : "off");
+			results.push_back(TimeStage(name.str(), pixels, pixels * source.GetPixelSize(), pixels, [&]()
+			{
+				for (unsigned y = 0; y < source.GetHeight(); ++y)
+				{
+					memcpy(target.GetRow(y), posterized.GetRow(y), rowBytes);
+				}
+				applier.Apply(target);
+				g_Sink = target.GetRow(0)[0];
+			}, options));
+		}
+	}
+
+	return true;
+}
+
+void PrintPipelineBenchmarkResults(const std::vector<PipelineBenchmarkResult>& results)
+{
+	std::cout << std::left << std::setw(48) << "stage" << std::right
+		<< std::setw(12) << "best ms" << std::setw(12) << "median ms"
+		<< std::setw(12) << "ns/op" << std::setw(10) << "MB/s" << std::setw(10) << "MP/s" << std::endl;
+
+	for (size_t i = 0; i < results.size(); ++i)
+	{
+		const PipelineBenchmarkResult& result = results[i];
+		std::cout << std::left << std::setw(48) << result.Name << std::right << std::fixed
+			<< std::setw(12) << std::setprecision(4) << result.BestMilliseconds
+			<< std::setw(12) << std::setprecision(4) << result.MedianMilliseconds
+			<< std::setw(12) << std::setprecision(2) << result.NanosecondsPerOperation
+			<< std::setw(10) << std::setprecision(1) << result.MegabytesPerSecond;
+
+		if (result.MegapixelsPerSecond > 0.0)
+		{
+			std::cout << std::setw(10) << std::setprecision(1) << result.MegapixelsPerSecond << std::endl;
+		}
+		else
+		{
+			std::cout << std::setw(10) << "-" << std::endl;
+		}
+	}
+}
+
+bool WritePipelineBenchmarkJson(const PathChar* path, const PipelineBenchmarkOptions& options, const std::vector<PipelineBenchmarkResult>& results)
+{
+	std::ostringstream json;
+	json << std::setprecision(9);
+	json << "{\n  \"benchmark\": \"pipeline\",\n  \"cpu_level\": ";
+	AppendJsonString(json, GetCpuLevelName(GetCpuLevel()));
+	json << ",\n  \"compiler\": ";
+	AppendJsonString(json, GetCompilerName());
+	json << ",\n  \"warmup_runs\": " << options.WarmupRuns
+		<< ",\n  \"runs\": " << options.Runs
+		<< ",\n  \"pinned_cpu\": " << options.PinnedCpu
+		<< ",\n  \"results\": [";
+
+	for (size_t i = 0; i < results.size(); ++i)
+	{
+		const PipelineBenchmarkResult& result = results[i];
+		json << (i ? ",\n    {" : "\n    {") << "\"name\": ";
+		AppendJsonString(json, result.Name);
+		json << ", \"operations_per_call\": " << result.OperationsPerCall
+			<< ", \"calls_per_run\": " << result.CallsPerRun
+			<< ", \"best_ms\": " << result.BestMilliseconds
+			<< ", \"median_ms\": " << result.MedianMilliseconds
+			<< ", \"ns_per_op\": " << result.NanosecondsPerOperation
+			<< ", \"mb_per_s\": " << result.MegabytesPerSecond
+			<< ", \"mpix_per_s\": " << result.MegapixelsPerSecond << "}";
+	}
+	json << "\n  ]\n}\n";
+
+	FILE* file = OpenNativeFile(path, "wb");
+	if (!file)
+	{
+		std::cerr << "Unable to create file: " << NarrowPath(path) << std::endl;
+		return false;
+	}
+	const std::string text = json.str();
+	const bool ok = fwrite(text.data(), 1, text.size(), file) == text.size();
+	if (fclose(file) != 0 || !ok)
+	{
+		std::cerr << "Unable to write file: " << NarrowPath(path) << std::endl;
+		return false;
+	}
+	return true;
+}
+
+int RunPipelineBenchmarkCommand(int argc, PathChar* argv[])
+{
+	PipelineBenchmarkOptions options;
+	options.WarmupRuns = 2;
+	options.Runs = 10;
+	options.PinnedCpu = 0;
+
+	const PathChar* jsonPath = nullptr;
+	std::vector<PathString> acvFiles;
+	std::vector<PathString> imageFiles;
+	size_t skipped = 0;
+
+	for (int i = 0; i < argc; ++i)
+	{
+		const std::string argument = NarrowPath(argv[i]);
+		if (argument.compare(0, 7, "--json=") == 0)
+		{
+			jsonPath = argv[i] + 7;
+		}
+		else if (argument.compare(0, 9, "--warmup=") == 0)
+		{
+			if (sscanf(argument.c_str() + 9, "%u", &options.WarmupRuns) != 1)
+			{
+				std::cerr << "Warm-up runs must be a number." << std::endl;
+				return -1;
+			}
+		}
+		else if (argument.compare(0, 7, "--runs=") == 0)
+		{
+			if (sscanf(argument.c_str() + 7, "%u", &options.Runs) != 1 || options.Runs == 0)
+			{
+				std::cerr << "Runs must be a positive number." << std::endl;
+				return -1;
+			}
+		}
+		else if (argument == "--pin=none")
+		{
+			options.PinnedCpu = -1;
+		}
+		else if (argument.compare(0, 6, "--pin=") == 0)
+		{
+			if (sscanf(argument.c_str() + 6, "%d", &options.PinnedCpu) != 1 || options.PinnedCpu < 0)
+			{
+				std::cerr << "The CPU to pin to must be a number, or none." << std::endl;
+				return -1;
+			}
+		}
+		else if (argument.compare(0, 2, "--") == 0)
+		{
+			std::cerr << "Unknown option: " << argument << std::endl;
+			return -1;
+		}
+		else
+		{
+			AddToCorpus(argv[i], acvFiles, imageFiles, skipped);
+		}
+	}
+
+	if (acvFiles.empty())
+	{
+		std::cerr << "Usage: bench corpus_directory_or_file... [--json=results.json] [--warmup=2] [--runs=10] [--pin=0|none]" << std::endl;
+		std::cerr << "The corpus needs at least one ACV file; images are read if ImageCodecs supports them." << std::endl;
+		return -1;
+	}
+
+	std::cout << "Corpus: " << acvFiles.size() << " ACV files, " << imageFiles.size() << " images";
+	if (skipped)
+	{
+		std::cout << " (" << skipped << " skipped, in formats the codecs do not read)";
+	}
+	std::cout << "; kernels for " << GetCpuLevelName(GetCpuLevel()) << std::endl;
+
+	std::vector<PipelineBenchmarkResult> results;
+	if (!RunPipelineBenchmarks(acvFiles, imageFiles, options, results))
+	{
+		return -2;
+	}
+
+	PrintPipelineBenchmarkResults(results);
+	if (jsonPath && !WritePipelineBenchmarkJson(jsonPath, options, results))
+	{
+		return -4;
+	}
+	return 0;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "Platform.h"
+#include <string>
+#include <vector>
+
+//
+// Timings of every stage from an ACV file to graded pixels, on a corpus of
+// real files: parsing ACVs, building their splines, evaluating them point by
+// point and in batches, filling cubes, encoding DDS volumes and applying LUTs
+// to images. Nothing here needs Direct3D or a GPU.
+//
+// Every stage is calibrated to run long enough for the clock, warmed up, then
+// timed over several runs. The best run gives the per-operation figures, the
+// median shows how noisy the machine was. Results can be written as JSON, to
+// compare builds and releases.
+//
+
+struct PipelineBenchmarkOptions
+{
+	unsigned WarmupRuns;
+	unsigned Runs;
+	int PinnedCpu; // -1 leaves the thread where the OS puts it
+};
+
+struct PipelineBenchmarkResult
+{
+	std::string Name;
+	double OperationsPerCall; // files, splines, evaluations, texels, volumes or pixels
+	unsigned CallsPerRun;
+	double BestMilliseconds; // per call
+	double MedianMilliseconds;
+	double NanosecondsPerOperation;
+	double MegabytesPerSecond; // of the data each call reads or writes
+	double MegapixelsPerSecond; // applies only, 0 elsewhere
+};
+
+// Corpus files are ACV curves and images in formats ImageCodecs reads. With no
+// readable image a synthetic 1920x1080 frame stands in.
+bool RunPipelineBenchmarks(
+	const std::vector<PathString>& acvFiles,
+	const std::vector<PathString>& imageFiles,
+	const PipelineBenchmarkOptions& options,
+	std::vector<PipelineBenchmarkResult>& results
+	);
+
+void PrintPipelineBenchmarkResults(const std::vector<PipelineBenchmarkResult>& results);
+
+bool WritePipelineBenchmarkJson(const PathChar* path, const PipelineBenchmarkOptions& options, const std::vector<PipelineBenchmarkResult>& results);
+
+// The bench command: corpus directories and files, then --json=FILE,
+// --warmup=N, --runs=N and --pin=CPU|none
+int RunPipelineBenchmarkCommand(int argc, PathChar* argv[]);
@@ -0,0 +1,182 @@
+#include "PipelineStats.h"
+#include "Platform.h"
+#include <atomic>
+#include <iomanip>
+#include <mutex>
+
+namespace
+{
+
+std::atomic<bool> g_Enabled(false);
+
+// Started with the process, for the totals
+const Stopwatch g_Started;
+
+std::mutex g_StageMutex;
+PipelineStageStats g_Stages[PIPELINE_STAGE_COUNT];
+
+std::atomic<unsigned long long> g_Counters[PIPELINE_COUNTER_COUNT];
+
+// Innermost stage being timed on this thread
+thread_local StageTimer* t_Current = nullptr;
+
+const char* const STAGE_NAMES[PIPELINE_STAGE_COUNT] =
+{
+	"parse", "spline-solve", "bake", "fill", "decode", "apply", "encode", "write"
+};
+
+const char* const COUNTER_NAMES[PIPELINE_COUNTER_COUNT] =
+{
+	"bytes_read", "bytes_written", "spline_evaluations", "cache_hits", "cache_misses", "colour_cache_hits", "colour_cache_misses"
+};
+
+} // namespace
+
+void EnablePipelineStats()
+{
+	g_Enabled = true;
+}
+
+bool IsPipelineStatsEnabled()
+{
+	return g_Enabled;
+}
+
+const char* GetPipelineStageName(PipelineStage stage)
+{
+	return stage < PIPELINE_STAGE_COUNT ? STAGE_NAMES[stage] : "unknown";
+}
+
+const char* GetPipelineCounterName(PipelineCounter counter)
+{
+	return counter < PIPELINE_COUNTER_COUNT ? COUNTER_NAMES[counter] : "unknown";
+}
+
+void AddPipelineCount(PipelineCounter counter, unsigned long long amount)
+{
+	if (g_Enabled)
+	{
+		g_Counters[counter].fetch_add(amount, std::memory_order_relaxed);
+	}
+}
+
+void GetPipelineStats(PipelineStats& stats)
+{
+	{
+		std::lock_guard<std::mutex> lock(g_StageMutex);
+		for (int i = 0; i < PIPELINE_STAGE_COUNT; ++i)
+		{
+			stats.Stages[i] = g_Stages[i];
+		}
+	}
+	for (int i = 0; i < PIPELINE_COUNTER_COUNT; ++i)
+	{
+		stats.Counters[i] = g_Counters[i];
+	}
+	stats.WallMilliseconds = g_Started.GetElapsedMilliseconds();
+	stats.CpuMilliseconds = GetProcessCpuMilliseconds();
+	stats.PeakResidentBytes = GetPeakResidentBytes();
+}
+
+void PrintPipelineStats(std::ostream& out, const PipelineStats& stats)
+{
+	out << std::left << std::setw(14) << "stage" << std::right
+		<< std::setw(12) << "wall ms" << std::setw(12) << "cpu ms" << std::setw(8) << "calls" << std::endl;
+
+	for (int i = 0; i < PIPELINE_STAGE_COUNT; ++i)
+	{
+		const PipelineStageStats& stage = stats.Stages[i];
+		if (stage.Calls == 0)
+		{
+			continue;
+		}
+		out << std::left << std::setw(14) << STAGE_NAMES[i] << std::right << std::fixed << std::setprecision(3)
+			<< std::setw(12) << stage.WallMilliseconds << std::setw(12) << stage.CpuMilliseconds
+			<< std::setw(8) << stage.Calls << std::endl;
+	}
+	out << std::left << std::setw(14) << "total" << std::right
+		<< std::setw(12) << stats.WallMilliseconds << std::setw(12) << stats.CpuMilliseconds << std::endl;
+
+	for (int i = 0; i < PIPELINE_COUNTER_COUNT; ++i)
+	{
+		out << COUNTER_NAMES[i] << ": " << stats.Counters[i] << std::endl;
+	}
+	out << "peak_rss: " << std::setprecision(1) << stats.PeakResidentBytes / (1024.0 * 1024.0) << " MB" << std::endl;
+	out.unsetf(std::ios::fixed);
+}
+
+void WritePipelineStatsJson(std::ostream& out, const PipelineStats& stats)
+{
+	const std::streamsize precision = out.precision(9);
+
+	out << "{\"stages\": {";
+	bool first = true;
+	for (int i = 0; i < PIPELINE_STAGE_COUNT; ++i)
+	{
+		const PipelineStageStats& stage = stats.Stages[i];
+		if (stage.Calls == 0)
+		{
+			continue;
+		}
+		out << (first ? "" : ", ") << "\"" << STAGE_NAMES[i] << "\": {\"wall_ms\": " << stage.WallMilliseconds
+			<< ", \"cpu_ms\": " << stage.CpuMilliseconds << ", \"calls\": " << stage.Calls << "}";
+		first = false;
+	}
+	out << "}, \"total_wall_ms\": " << stats.WallMilliseconds << ", \"total_cpu_ms\": " << stats.CpuMilliseconds;
+
+	for (int i = 0; i < PIPELINE_COUNTER_COUNT; ++i)
+	{
+		out << ", \"" << COUNTER_NAMES[i] << "\": " << stats.Counters[i];
+	}
+	out << ", \"peak_rss_bytes\": " << stats.PeakResidentBytes << "}" << std::endl;
+
+	out.precision(precision);
+}
+
+StageTimer::StageTimer(PipelineStage stage)
+	: m_Stage(stage)
+	, m_Span(GetPipelineStageName(stage))
+	, m_Enabled(g_Enabled)
+	, m_Parent(nullptr)
+	, m_CpuStart(0.0)
+	, m_ChildWall(0.0)
+	, m_ChildCpu(0.0)
+{
+	if (m_Enabled)
+	{
+		m_Parent = t_Current;
+		t_Current = this;
+		m_CpuStart = GetProcessCpuMilliseconds();
+		m_Wall.Restart();
+	}
+}
+
+StageTimer::~StageTimer()
+{
+	Stop();
+}
+
+void StageTimer::Stop()
+{
+	m_Span.End();
+	if (!m_Enabled)
+	{
+		return;
+	}
+	m_Enabled = false;
+
+	const double wall = m_Wall.GetElapsedMilliseconds();
+	const double cpu = GetProcessCpuMilliseconds() - m_CpuStart;
+	t_Current = m_Parent;
+	if (m_Parent)
+	{
+		m_Parent->m_ChildWall += wall;
+		m_Parent->m_ChildCpu += cpu;
+	}
+
+	std::lock_guard<std::mutex> lock(g_StageMutex);
+	PipelineStageStats& stats = g_Stages[m_Stage];
+	stats.WallMilliseconds += wall - m_ChildWall;
+	stats.CpuMilliseconds += cpu - m_ChildCpu;
+	++stats.Calls;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "Stopwatch.h"
+#include "Trace.h"
+#include <ostream>
+
+//
+// Where a run of the converter spends its time, for --stats. Stages are timed
+// where the work happens, in the parsers, bakers, codecs and appliers, so any
+// command that goes through them is covered. Nothing is recorded until
+// EnablePipelineStats is called, and then only coarse steps are timed: a file
+// read, a cube baked, an image applied, never single texels or pixels.
+//
+
+enum PipelineStage
+{
+	PIPELINE_STAGE_PARSE, // ACV curves and DDS volumes read from disk
+	PIPELINE_STAGE_SPLINE_SOLVE,
+	PIPELINE_STAGE_BAKE, // curve tables and cubes
+	PIPELINE_STAGE_FILL, // texels packed into the layout that writes or applies them
+	PIPELINE_STAGE_DECODE, // input images
+	PIPELINE_STAGE_APPLY,
+	PIPELINE_STAGE_ENCODE, // image codecs and D3DX encode as they write, so their writes land here
+	PIPELINE_STAGE_WRITE,
+	PIPELINE_STAGE_COUNT
+};
+
+enum PipelineCounter
+{
+	PIPELINE_COUNTER_BYTES_READ,
+	PIPELINE_COUNTER_BYTES_WRITTEN,
+	PIPELINE_COUNTER_SPLINE_EVALUATIONS, // inputs run through ACV curves for tables and cubes
+	PIPELINE_COUNTER_CACHE_HITS, // LutCache by path or content, so the daemon and what runs in it
+	PIPELINE_COUNTER_CACHE_MISSES,
+	PIPELINE_COUNTER_COLOUR_CACHE_HITS, // pixels LutApplier copied a graded colour for
+	PIPELINE_COUNTER_COLOUR_CACHE_MISSES,
+	PIPELINE_COUNTER_COUNT
+};
+
+struct PipelineStageStats
+{
+	double WallMilliseconds; // not counting stages timed inside it
+	double CpuMilliseconds; // of the whole process, worker threads included
+	unsigned long long Calls;
+};
+
+struct PipelineStats
+{
+	PipelineStageStats Stages[PIPELINE_STAGE_COUNT];
+	unsigned long long Counters[PIPELINE_COUNTER_COUNT];
+	double WallMilliseconds; // since the process started
+	double CpuMilliseconds;
+	unsigned long long PeakResidentBytes;
+};
+
+void EnablePipelineStats();
+bool IsPipelineStatsEnabled();
+
+const char* GetPipelineStageName(PipelineStage stage);
+const char* GetPipelineCounterName(PipelineCounter counter);
+
+void AddPipelineCount(PipelineCounter counter, unsigned long long amount);
+
+void GetPipelineStats(PipelineStats& stats);
+void PrintPipelineStats(std::ostream& out, const PipelineStats& stats);
+void WritePipelineStatsJson(std::ostream& out, const PipelineStats& stats);
+
+// Times one stage for as long as it lives. Stages timed inside it on the same
+// thread are taken out of its time, so nested stages are not counted twice.
+// While tracing, the stage also shows up as a span on the timeline.
+class StageTimer
+{
+public:
+	explicit StageTimer(PipelineStage stage);
+	~StageTimer();
+
+	// Ends the stage before the timer goes out of scope
+	void Stop();
+
+private:
+	StageTimer(const StageTimer&);
+	StageTimer& operator=(const StageTimer&);
+
+	PipelineStage m_Stage;
+	TraceSpan m_Span;
+	bool m_Enabled;
+	StageTimer* m_Parent;
+	Stopwatch m_Wall;
+	double m_CpuStart;
+	double m_ChildWall;
+	double m_ChildCpu;
+};
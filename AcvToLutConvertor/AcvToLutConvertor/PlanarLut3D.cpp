@@ -0,0 +1,147 @@
+#include "PlanarLut3D.h"
+#include "Lut3D.h"
+#include "Platform.h"
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+
+unsigned short ToUnorm16(float value)
+{
+	float scaled = value * 65535.0f + 0.5f;
+	if (scaled <= 0.0f)
+	{
+		return 0;
+	}
+	if (scaled >= 65535.0f)
+	{
+		return 65535;
+	}
+	return (unsigned short)scaled;
+}
+
+size_t GetTexelSize(PlanarLutFormat format)
+{
+	return format == PLANAR_LUT_FLOAT ? sizeof(float) : sizeof(unsigned short);
+}
+
+} // namespace
+
+PlanarLut3D::PlanarLut3D()
+	: m_Data(nullptr)
+	, m_Size(0)
+	, m_PlaneStride(0)
+	, m_Format(PLANAR_LUT_FLOAT)
+{}
+
+PlanarLut3D::PlanarLut3D(const PlanarLut3D& other)
+	: m_Data(nullptr)
+	, m_Size(0)
+	, m_PlaneStride(0)
+	, m_Format(other.m_Format)
+{
+	if (other.m_Data && Allocate(other.m_Size, other.m_Format))
+	{
+		memcpy(m_Data, other.m_Data, 3 * m_PlaneStride);
+	}
+}
+
+PlanarLut3D::~PlanarLut3D()
+{
+	FreeAligned(m_Data);
+}
+
+PlanarLut3D& PlanarLut3D::operator=(PlanarLut3D other)
+{
+	Swap(other);
+	return *this;
+}
+
+void PlanarLut3D::Swap(PlanarLut3D& other)
+{
+	std::swap(m_Data, other.m_Data);
+	std::swap(m_Size, other.m_Size);
+	std::swap(m_PlaneStride, other.m_PlaneStride);
+	std::swap(m_Format, other.m_Format);
+}
+
+bool PlanarLut3D::Allocate(size_t size, PlanarLutFormat format)
+{
+	const size_t planeBytes = size * size * size * GetTexelSize(format);
+	const size_t planeStride = (planeBytes + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+
+	unsigned char* data = static_cast<unsigned char*>(AllocateAligned(3 * planeStride, ALIGNMENT));
+	if (!data)
+	{
+		std::cerr << "Out of memory for a " << size << "^3 LUT" << std::endl;
+		return false;
+	}
+	memset(data, 0, 3 * planeStride);
+
+	FreeAligned(m_Data);
+	m_Data = data;
+	m_Size = size;
+	m_PlaneStride = planeStride;
+	m_Format = format;
+	return true;
+}
+
+bool PlanarLut3D::Assign(const Lut3D& lut, PlanarLutFormat format)
+{
+	if (!Allocate(lut.GetSize(), format))
+	{
+		return false;
+	}
+
+	const size_t count = m_Size * m_Size * m_Size;
+	const float* texels = m_Size ? lut.GetTexel(0, 0, 0) : nullptr;
+	for (int c = 0; c < 3; ++c)
+	{
+		if (format == PLANAR_LUT_FLOAT)
+		{
+			float* plane = GetFloatPlane(c);
+			for (size_t i = 0; i < count; ++i)
+			{
+				plane[i] = texels[i * 3 + c];
+			}
+		}
+		else
+		{
+			unsigned short* plane = GetUnorm16Plane(c);
+			for (size_t i = 0; i < count; ++i)
+			{
+				plane[i] = ToUnorm16(texels[i * 3 + c]);
+			}
+		}
+	}
+	return true;
+}
+
+void PlanarLut3D::CopyTo(Lut3D& lut) const
+{
+	lut.Resize(m_Size);
+
+	const size_t count = m_Size * m_Size * m_Size;
+	float* texels = m_Size ? lut.GetTexel(0, 0, 0) : nullptr;
+	for (int c = 0; c < 3; ++c)
+	{
+		if (m_Format == PLANAR_LUT_FLOAT)
+		{
+			const float* plane = GetFloatPlane(c);
+			for (size_t i = 0; i < count; ++i)
+			{
+				texels[i * 3 + c] = plane[i];
+			}
+		}
+		else
+		{
+			const unsigned short* plane = GetUnorm16Plane(c);
+			for (size_t i = 0; i < count; ++i)
+			{
+				texels[i * 3 + c] = (float)plane[i] / 65535.0f;
+			}
+		}
+	}
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+
+class Lut3D;
+
+enum PlanarLutFormat
+{
+	PLANAR_LUT_FLOAT,   // 32-bit floats, 1.0 for full scale
+	PLANAR_LUT_UNORM16, // 0-65535
+};
+
+// A cube laid out for wide kernels: one plane per output channel (red, green,
+// blue) instead of RGB triples. Every plane starts on a 64-byte boundary and
+// is padded to whole 64-byte lines, so vector loads never straddle two planes
+// or run past the end. Inside a plane texels follow Lut3D's order.
+class PlanarLut3D
+{
+public:
+	static const size_t ALIGNMENT = 64;
+
+	PlanarLut3D();
+	PlanarLut3D(const PlanarLut3D& other);
+	~PlanarLut3D();
+
+	PlanarLut3D& operator=(PlanarLut3D other);
+
+	// Zero-filled planes, size texels per side
+	bool Allocate(size_t size, PlanarLutFormat format);
+
+	// Converts every texel, rounding to 16 bits for PLANAR_LUT_UNORM16
+	bool Assign(const Lut3D& lut, PlanarLutFormat format);
+
+	size_t GetSize() const { return m_Size; }
+	PlanarLutFormat GetFormat() const { return m_Format; }
+
+	// Bytes from the start of one plane to the next
+	size_t GetPlaneStride() const { return m_PlaneStride; }
+
+	float* GetFloatPlane(int channel) { return reinterpret_cast<float*>(m_Data + channel * m_PlaneStride); }
+	const float* GetFloatPlane(int channel) const { return reinterpret_cast<const float*>(m_Data + channel * m_PlaneStride); }
+
+	unsigned short* GetUnorm16Plane(int channel) { return reinterpret_cast<unsigned short*>(m_Data + channel * m_PlaneStride); }
+	const unsigned short* GetUnorm16Plane(int channel) const { return reinterpret_cast<const unsigned short*>(m_Data + channel * m_PlaneStride); }
+
+	// Back to RGB triples, for the scalar engine
+	void CopyTo(Lut3D& lut) const;
+
+	void Swap(PlanarLut3D& other);
+
+private:
+	unsigned char* m_Data;
+	size_t m_Size;
+	size_t m_PlaneStride;
+	PlanarLutFormat m_Format;
+};
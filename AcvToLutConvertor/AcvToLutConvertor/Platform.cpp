@@ -0,0 +1,313 @@
+#include "Platform.h"
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#include <malloc.h>
+#include <sys/stat.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <time.h>
+#ifdef __linux__
+#include <sched.h>
+#endif
+#endif
+#include <algorithm>
+
+FILE* OpenNativeFile(const PathChar* path, const char* mode)
+{
+#ifdef _WIN32
+	wchar_t wideMode[8] = {};
+	for (size_t i = 0; i < 7 && mode[i]; ++i)
+	{
+		wideMode[i] = (wchar_t)mode[i];
+	}
+	return _wfopen(path, wideMode);
+#else
+	return fopen(path, mode);
+#endif
+}
+
+std::string NarrowPath(const PathChar* path)
+{
+#ifdef _WIN32
+	int length = WideCharToMultiByte(CP_UTF8, 0, path, -1, nullptr, 0, nullptr, nullptr);
+	if (length <= 1)
+	{
+		return std::string();
+	}
+
+	std::string result(length - 1, '\0');
+	WideCharToMultiByte(CP_UTF8, 0, path, -1, &result[0], length, nullptr, nullptr);
+	return result;
+#else
+	return std::string(path);
+#endif
+}
+
+PathString WidenPath(const std::string& path)
+{
+#ifdef _WIN32
+	int length = MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, nullptr, 0);
+	if (length <= 1)
+	{
+		return PathString();
+	}
+
+	PathString result(length - 1, L'\0');
+	MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, &result[0], length);
+	return result;
+#else
+	return path;
+#endif
+}
+
+PathString GetAbsolutePath(const PathChar* path)
+{
+#ifdef _WIN32
+	wchar_t* absolute = _wfullpath(nullptr, path, 0);
+	if (!absolute)
+	{
+		return PathString(path);
+	}
+
+	PathString result(absolute);
+	free(absolute);
+	return result;
+#else
+	if (path[0] == '/')
+	{
+		return PathString(path);
+	}
+
+	std::string directory(256, '\0');
+	while (!getcwd(&directory[0], directory.size()))
+	{
+		if (directory.size() > 65536)
+		{
+			return PathString(path);
+		}
+		directory.resize(directory.size() * 2);
+	}
+	directory.resize(strlen(directory.c_str()));
+	return directory + "/" + path;
+#endif
+}
+
+bool GetFileStamp(const PathChar* path, FileStamp& stamp)
+{
+#ifdef _WIN32
+	struct _stat64 status;
+	if (_wstat64(path, &status) != 0)
+	{
+		return false;
+	}
+	stamp.Size = (unsigned long long)status.st_size;
+	stamp.ModifiedTime = (long long)status.st_mtime * 1000000000;
+#else
+	struct stat status;
+	if (stat(path, &status) != 0)
+	{
+		return false;
+	}
+	stamp.Size = (unsigned long long)status.st_size;
+#ifdef __APPLE__
+	stamp.ModifiedTime = (long long)status.st_mtimespec.tv_sec * 1000000000 + status.st_mtimespec.tv_nsec;
+#else
+	stamp.ModifiedTime = (long long)status.st_mtim.tv_sec * 1000000000 + status.st_mtim.tv_nsec;
+#endif
+#endif
+	return true;
+}
+
+namespace
+{
+
+void ListFilesUnder(const PathString& directory, const PathString& prefix, std::vector<PathString>& files)
+{
+#ifdef _WIN32
+	WIN32_FIND_DATAW found;
+	HANDLE find = FindFirstFileW((directory + L"\\*").c_str(), &found);
+	if (find == INVALID_HANDLE_VALUE)
+	{
+		return;
+	}
+	do
+	{
+		const PathString name = found.cFileName;
+		if (name == L"." || name == L"..")
+		{
+			continue;
+		}
+		if (found.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+		{
+			ListFilesUnder(directory + L"\\" + name, prefix + name + L"/", files);
+		}
+		else
+		{
+			files.push_back(prefix + name);
+		}
+	} while (FindNextFileW(find, &found));
+	FindClose(find);
+#else
+	DIR* listing = opendir(directory.c_str());
+	if (!listing)
+	{
+		return;
+	}
+	while (const dirent* entry = readdir(listing))
+	{
+		const PathString name = entry->d_name;
+		if (name == "." || name == "..")
+		{
+			continue;
+		}
+		struct stat status;
+		if (stat((directory + "/" + name).c_str(), &status) != 0)
+		{
+			continue;
+		}
+		if (S_ISDIR(status.st_mode))
+		{
+			ListFilesUnder(directory + "/" + name, prefix + name + "/", files);
+		}
+		else if (S_ISREG(status.st_mode))
+		{
+			files.push_back(prefix + name);
+		}
+	}
+	closedir(listing);
+#endif
+}
+
+} // namespace
+
+bool ListFiles(const PathChar* directory, std::vector<PathString>& files)
+{
+	FileStamp stamp;
+	if (!GetFileStamp(directory, stamp))
+	{
+		return false;
+	}
+
+	files.clear();
+	ListFilesUnder(directory, PathString(), files);
+	std::sort(files.begin(), files.end());
+	return true;
+}
+
+std::string GetPathExtension(const PathChar* path)
+{
+	std::string narrow = NarrowPath(path);
+
+	size_t dot = narrow.find_last_of('.');
+	size_t slash = narrow.find_last_of("/\\");
+	if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+	{
+		return std::string();
+	}
+
+	std::string extension = narrow.substr(dot + 1);
+	for (size_t i = 0; i < extension.size(); ++i)
+	{
+		extension[i] = (char)tolower((unsigned char)extension[i]);
+	}
+	return extension;
+}
+
+bool PinThreadToCpu(unsigned cpu)
+{
+#if defined(_WIN32)
+	return cpu < sizeof(DWORD_PTR) * 8 && SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << cpu) != 0;
+#elif defined(__linux__)
+	if (cpu >= CPU_SETSIZE)
+	{
+		return false;
+	}
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+	(void)cpu;
+	return false;
+#endif
+}
+
+double GetProcessCpuMilliseconds()
+{
+#ifdef _WIN32
+	FILETIME created, exited, kernel, user;
+	if (!GetProcessTimes(GetCurrentProcess(), &created, &exited, &kernel, &user))
+	{
+		return 0.0;
+	}
+	const unsigned long long ticks =
+		(((unsigned long long)kernel.dwHighDateTime << 32) | kernel.dwLowDateTime) +
+		(((unsigned long long)user.dwHighDateTime << 32) | user.dwLowDateTime);
+	return ticks / 10000.0;
+#else
+	timespec now;
+	if (clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now) != 0)
+	{
+		return 0.0;
+	}
+	return now.tv_sec * 1000.0 + now.tv_nsec / 1000000.0;
+#endif
+}
+
+unsigned long long GetPeakResidentBytes()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	return GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) ? counters.PeakWorkingSetSize : 0;
+#else
+	rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+	{
+		return 0;
+	}
+#ifdef __APPLE__
+	return (unsigned long long)usage.ru_maxrss;
+#else
+	return (unsigned long long)usage.ru_maxrss * 1024;
+#endif
+#endif
+}
+
+unsigned long long HashBytes(const void* data, size_t size, unsigned long long hash)
+{
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash = (hash ^ bytes[i]) * 1099511628211ull;
+	}
+	return hash;
+}
+
+void* AllocateAligned(size_t size, size_t alignment)
+{
+#ifdef _WIN32
+	return _aligned_malloc(size, alignment);
+#else
+	void* block = nullptr;
+	return posix_memalign(&block, alignment, size) == 0 ? block : nullptr;
+#endif
+}
+
+void FreeAligned(void* block)
+{
+#ifdef _WIN32
+	_aligned_free(block);
+#else
+	free(block);
+#endif
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// File names stay in the native character type so that wide paths keep
+// working on Windows while the portable parts also build elsewhere.
+#ifdef _WIN32
+typedef wchar_t PathChar;
+#define PATH_LITERAL(s) L##s
+#else
+typedef char PathChar;
+#define PATH_LITERAL(s) s
+#endif
+
+typedef std::basic_string<PathChar> PathString;
+
+// fopen() that accepts a native path
+FILE* OpenNativeFile(const PathChar* path, const char* mode);
+
+// Path converted to UTF-8, for error messages
+std::string NarrowPath(const PathChar* path);
+
+// UTF-8 converted back to a native path
+PathString WidenPath(const std::string& path);
+
+// The path made absolute against the current directory, for handing over to
+// another process
+PathString GetAbsolutePath(const PathChar* path);
+
+// Size and modification time, which change whenever a file is rewritten
+struct FileStamp
+{
+	unsigned long long Size;
+	long long ModifiedTime; // nanoseconds where the OS keeps them
+
+	bool operator==(const FileStamp& other) const { return Size == other.Size && ModifiedTime == other.ModifiedTime; }
+	bool operator!=(const FileStamp& other) const { return !(*this == other); }
+};
+
+// False, quietly, for files that cannot be found
+bool GetFileStamp(const PathChar* path, FileStamp& stamp);
+
+// Files under a directory and its subdirectories, as sorted paths relative to
+// it with '/' separators. False when the directory cannot be found.
+bool ListFiles(const PathChar* directory, std::vector<PathString>& files);
+
+// Lower-case extension without the dot, or an empty string
+std::string GetPathExtension(const PathChar* path);
+
+// Keeps the calling thread on one CPU, false where that is not supported
+bool PinThreadToCpu(unsigned cpu);
+
+// CPU time of every thread in the process so far
+double GetProcessCpuMilliseconds();
+
+// The most memory the process has had resident, or 0 where that is unknown
+unsigned long long GetPeakResidentBytes();
+
+// 64-bit FNV-1a of a block, or of several when each continues from the hash
+// of the one before
+const unsigned long long HASH_OFFSET_BASIS = 14695981039346656037ull;
+unsigned long long HashBytes(const void* data, size_t size, unsigned long long hash = HASH_OFFSET_BASIS);
+
+// Heap blocks aligned to a power of two, released with FreeAligned
+void* AllocateAligned(size_t size, size_t alignment);
+void FreeAligned(void* block);
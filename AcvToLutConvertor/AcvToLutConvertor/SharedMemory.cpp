@@ -0,0 +1,231 @@
+#include "SharedMemory.h"
+#include "Platform.h"
+#include <iostream>
+#include <sstream>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+SharedMemory::SharedMemory()
+	: m_Data(nullptr)
+	, m_Size(0)
+#ifdef _WIN32
+	, m_Mapping(nullptr)
+#else
+	, m_File(-1)
+#endif
+{}
+
+SharedMemory::~SharedMemory()
+{
+	Close();
+}
+
+std::string SharedMemory::MakeName(const char* prefix)
+{
+	static unsigned counter = 0;
+	std::ostringstream name;
+#ifdef _WIN32
+	name << "Local\\" << prefix << "-" << GetCurrentProcessId() << "-" << counter++;
+#else
+	name << "/" << prefix << "-" << getpid() << "-" << counter++;
+#endif
+	return name.str();
+}
+
+#ifdef _WIN32
+
+bool SharedMemory::Create(const char* name, size_t size)
+{
+	Close();
+
+	const unsigned long long wideSize = size;
+	m_Mapping = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+		(DWORD)(wideSize >> 32), (DWORD)wideSize, WidenPath(name).c_str());
+	if (!m_Mapping || GetLastError() == ERROR_ALREADY_EXISTS)
+	{
+		std::cerr << "Unable to create shared memory: " << name << std::endl;
+		Close();
+		return false;
+	}
+
+	m_Data = static_cast<unsigned char*>(MapViewOfFile(m_Mapping, FILE_MAP_ALL_ACCESS, 0, 0, size));
+	if (!m_Data)
+	{
+		std::cerr << "Unable to map shared memory: " << name << std::endl;
+		Close();
+		return false;
+	}
+	m_Size = size;
+	return true;
+}
+
+bool SharedMemory::Open(const char* name, int)
+{
+	Close();
+
+	m_Mapping = OpenFileMappingW(FILE_MAP_ALL_ACCESS, FALSE, WidenPath(name).c_str());
+	if (!m_Mapping)
+	{
+		std::cerr << "Unable to open shared memory: " << name << std::endl;
+		return false;
+	}
+
+	m_Data = static_cast<unsigned char*>(MapViewOfFile(m_Mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0));
+	MEMORY_BASIC_INFORMATION info;
+	if (!m_Data || VirtualQuery(m_Data, &info, sizeof(info)) == 0)
+	{
+		std::cerr << "Unable to map shared memory: " << name << std::endl;
+		Close();
+		return false;
+	}
+	m_Size = info.RegionSize;
+	return true;
+}
+
+int SharedMemory::GetDescriptor() const
+{
+	return -1;
+}
+
+void SharedMemory::Close()
+{
+	if (m_Data)
+	{
+		UnmapViewOfFile(m_Data);
+		m_Data = nullptr;
+	}
+	if (m_Mapping)
+	{
+		CloseHandle(m_Mapping);
+		m_Mapping = nullptr;
+	}
+	m_Size = 0;
+}
+
+#else
+
+bool SharedMemory::Create(const char* name, size_t size)
+{
+	Close();
+
+#ifdef SHARED_MEMORY_SEALED
+	m_File = memfd_create(name[0] == '/' ? name + 1 : name, MFD_CLOEXEC | MFD_ALLOW_SEALING);
+#else
+	m_File = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+#endif
+	if (m_File < 0)
+	{
+		std::cerr << "Unable to create shared memory: " << name << std::endl;
+		return false;
+	}
+#ifndef SHARED_MEMORY_SEALED
+	m_OwnedName = name;
+#endif
+
+	bool sized = ftruncate(m_File, (off_t)size) == 0;
+#ifdef SHARED_MEMORY_SEALED
+	sized = sized && fcntl(m_File, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) == 0;
+#endif
+	void* data = sized ? mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, m_File, 0) : MAP_FAILED;
+	if (data == MAP_FAILED)
+	{
+		std::cerr << "Unable to map shared memory: " << name << std::endl;
+		Close();
+		return false;
+	}
+
+	m_Data = static_cast<unsigned char*>(data);
+	m_Size = size;
+	return true;
+}
+
+bool SharedMemory::Open(const char* name, int descriptor)
+{
+	Close();
+
+#ifdef SHARED_MEMORY_SEALED
+	m_File = descriptor;
+	if (m_File < 0)
+	{
+		std::cerr << "Shared memory " << name << " came without its descriptor." << std::endl;
+		return false;
+	}
+
+	// The client keeps its descriptor, and could shrink the region from
+	// under the mapping if it were not sealed
+	const int seals = fcntl(m_File, F_GET_SEALS);
+	if (seals < 0 || !(seals & F_SEAL_SHRINK))
+	{
+		std::cerr << "Shared memory " << name << " is not sealed against shrinking." << std::endl;
+		Close();
+		return false;
+	}
+#else
+	if (descriptor >= 0)
+	{
+		close(descriptor);
+	}
+	m_File = shm_open(name, O_RDWR, 0);
+	if (m_File < 0)
+	{
+		std::cerr << "Unable to open shared memory: " << name << std::endl;
+		return false;
+	}
+#endif
+
+	struct stat status;
+	void* data = MAP_FAILED;
+	if (fstat(m_File, &status) == 0 && status.st_size > 0)
+	{
+		data = mmap(nullptr, (size_t)status.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_File, 0);
+	}
+	if (data == MAP_FAILED)
+	{
+		std::cerr << "Unable to map shared memory: " << name << std::endl;
+		Close();
+		return false;
+	}
+
+	m_Data = static_cast<unsigned char*>(data);
+	m_Size = (size_t)status.st_size;
+	return true;
+}
+
+int SharedMemory::GetDescriptor() const
+{
+#ifdef SHARED_MEMORY_SEALED
+	return m_File;
+#else
+	return -1;
+#endif
+}
+
+void SharedMemory::Close()
+{
+	if (m_Data)
+	{
+		munmap(m_Data, m_Size);
+		m_Data = nullptr;
+	}
+	if (!m_OwnedName.empty())
+	{
+		shm_unlink(m_OwnedName.c_str());
+		m_OwnedName.clear();
+	}
+	if (m_File >= 0)
+	{
+		close(m_File);
+		m_File = -1;
+	}
+	m_Size = 0;
+}
+
+#endif
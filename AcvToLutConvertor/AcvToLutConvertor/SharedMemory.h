@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#ifdef __linux__
+#define SHARED_MEMORY_SEALED 1
+#endif
+
+// A region of memory shared between processes, which none of them can shrink
+// under the others' mappings (touching a mapping past the end of its region
+// raises SIGBUS):
+//
+//  Linux    a memfd sealed against shrinking, handed over as its descriptor
+//           (see LocalSocket::Send); regions that come unsealed are refused
+//  Windows  a named file mapping backed by the paging file, whose size is
+//           fixed
+//  others   POSIX shared memory by name, which cannot be resized once sized
+//
+// The creator owns a name, which goes away when it closes the region;
+// processes that opened it keep their mapping until they close it too.
+class SharedMemory
+{
+public:
+	SharedMemory();
+	~SharedMemory();
+
+	bool Create(const char* name, size_t size);
+
+	// By the descriptor GetDescriptor gives the creator on Linux, which this
+	// then owns, and by name elsewhere
+	bool Open(const char* name, int descriptor);
+	void Close();
+
+	unsigned char* GetData() const { return m_Data; }
+	size_t GetSize() const { return m_Size; }
+
+	// The memfd on Linux, -1 elsewhere
+	int GetDescriptor() const;
+
+	// A name no other process uses, made of prefix and the process id
+	static std::string MakeName(const char* prefix);
+
+private:
+	SharedMemory(const SharedMemory&);
+	SharedMemory& operator=(const SharedMemory&);
+
+	unsigned char* m_Data;
+	size_t m_Size;
+	std::string m_OwnedName; // unlinked on close, POSIX only
+
+#ifdef _WIN32
+	void* m_Mapping;
+#else
+	int m_File;
+#endif
+};
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <chrono>
+
+class Stopwatch
+{
+public:
+	Stopwatch()
+		: m_Start(std::chrono::steady_clock::now())
+	{}
+
+	void Restart()
+	{
+		m_Start = std::chrono::steady_clock::now();
+	}
+
+	double GetElapsedMilliseconds() const
+	{
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - m_Start;
+		return elapsed.count();
+	}
+
+private:
+	std::chrono::steady_clock::time_point m_Start;
+};
@@ -0,0 +1,226 @@
+#include "Trace.h"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <cstdio>
+
+namespace
+{
+
+struct TraceEvent
+{
+	const char* Name;
+	const char* Category;
+	long long Start; // nanoseconds since StartTrace
+	long long Duration; // negative for counters
+	double Value;
+};
+
+// Written by its own thread only; the count tells readers how much of it is
+// complete
+struct ThreadTrace
+{
+	unsigned Id;
+	std::string Name; // under g_ThreadMutex
+	std::unique_ptr<TraceEvent[]> Events;
+	std::atomic<size_t> Count;
+	std::atomic<unsigned long long> Dropped;
+};
+
+std::atomic<bool> g_Tracing(false);
+std::chrono::steady_clock::time_point g_Start;
+size_t g_Capacity;
+
+// Buffers outlive their threads, so that late writes still find them
+std::mutex g_ThreadMutex;
+std::vector<std::unique_ptr<ThreadTrace>> g_Threads;
+
+thread_local ThreadTrace* t_Trace = nullptr;
+
+long long GetTraceTime()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - g_Start).count();
+}
+
+ThreadTrace& GetThreadTrace()
+{
+	if (!t_Trace)
+	{
+		std::unique_ptr<ThreadTrace> trace(new ThreadTrace());
+		trace->Events.reset(new TraceEvent[g_Capacity]);
+		trace->Count = 0;
+		trace->Dropped = 0;
+
+		std::lock_guard<std::mutex> lock(g_ThreadMutex);
+		trace->Id = (unsigned)g_Threads.size() + 1;
+		t_Trace = trace.get();
+		g_Threads.push_back(std::move(trace));
+	}
+	return *t_Trace;
+}
+
+void Record(const char* name, const char* category, long long start, long long duration, double value)
+{
+	ThreadTrace& trace = GetThreadTrace();
+	const size_t count = trace.Count.load(std::memory_order_relaxed);
+	if (count == g_Capacity)
+	{
+		trace.Dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	TraceEvent& event = trace.Events[count];
+	event.Name = name;
+	event.Category = category;
+	event.Start = start;
+	event.Duration = duration;
+	event.Value = value;
+	trace.Count.store(count + 1, std::memory_order_release);
+}
+
+void AppendJsonString(std::ostringstream& json, const char* text)
+{
+	json << '"';
+	for (const char* c = text; *c; ++c)
+	{
+		if (*c == '"' || *c == '\\')
+		{
+			json << '\\' << *c;
+		}
+		else if ((unsigned char)*c < 0x20)
+		{
+			json << ' ';
+		}
+		else
+		{
+			json << *c;
+		}
+	}
+	json << '"';
+}
+
+} // namespace
+
+void StartTrace(size_t eventsPerThread)
+{
+	if (g_Tracing || eventsPerThread == 0)
+	{
+		return;
+	}
+	g_Capacity = eventsPerThread;
+	g_Start = std::chrono::steady_clock::now();
+	g_Tracing.store(true, std::memory_order_release);
+}
+
+bool IsTracing()
+{
+	return g_Tracing.load(std::memory_order_acquire);
+}
+
+void SetTraceThreadName(const char* name)
+{
+	if (!IsTracing())
+	{
+		return;
+	}
+	ThreadTrace& trace = GetThreadTrace();
+	std::lock_guard<std::mutex> lock(g_ThreadMutex);
+	trace.Name = name;
+}
+
+void TraceCounter(const char* name, double value)
+{
+	if (IsTracing())
+	{
+		Record(name, "counter", GetTraceTime(), -1, value);
+	}
+}
+
+bool WriteTrace(const PathChar* path)
+{
+	std::ostringstream json;
+	json.precision(15);
+	json << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+	json << "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 0, \"args\": {\"name\": \"AcvToLutConvertor\"}}";
+
+	unsigned long long dropped = 0;
+	{
+		std::lock_guard<std::mutex> lock(g_ThreadMutex);
+		for (size_t t = 0; t < g_Threads.size(); ++t)
+		{
+			const ThreadTrace& trace = *g_Threads[t];
+			dropped += trace.Dropped.load(std::memory_order_relaxed);
+
+			std::ostringstream name;
+			name << "thread " << trace.Id;
+			json << ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << trace.Id << ", \"args\": {\"name\": ";
+			AppendJsonString(json, trace.Name.empty() ? name.str().c_str() : trace.Name.c_str());
+			json << "}}";
+
+			const size_t count = trace.Count.load(std::memory_order_acquire);
+			for (size_t i = 0; i < count; ++i)
+			{
+				const TraceEvent& event = trace.Events[i];
+				json << ",\n{\"name\": ";
+				AppendJsonString(json, event.Name);
+				json << ", \"cat\": ";
+				AppendJsonString(json, event.Category);
+				json << ", \"pid\": 1, \"tid\": " << trace.Id << ", \"ts\": " << event.Start / 1000.0;
+				if (event.Duration >= 0)
+				{
+					json << ", \"ph\": \"X\", \"dur\": " << event.Duration / 1000.0 << "}";
+				}
+				else
+				{
+					json << ", \"ph\": \"C\", \"args\": {\"value\": " << event.Value << "}}";
+				}
+			}
+		}
+	}
+	json << "\n]}\n";
+
+	if (dropped)
+	{
+		std::cerr << "The trace is missing " << dropped << " events that did not fit in the buffers." << std::endl;
+	}
+
+	FILE* file = OpenNativeFile(path, "wb");
+	if (!file)
+	{
+		std::cerr << "Unable to create file: " << NarrowPath(path) << std::endl;
+		return false;
+	}
+	const std::string text = json.str();
+	const bool ok = fwrite(text.data(), 1, text.size(), file) == text.size();
+	if (fclose(file) != 0 || !ok)
+	{
+		std::cerr << "Unable to write file: " << NarrowPath(path) << std::endl;
+		return false;
+	}
+	return true;
+}
+
+TraceSpan::TraceSpan(const char* name, const char* category)
+	: m_Name(name)
+	, m_Category(category)
+	, m_Start(IsTracing() ? GetTraceTime() : -1)
+{}
+
+TraceSpan::~TraceSpan()
+{
+	End();
+}
+
+void TraceSpan::End()
+{
+	if (m_Start >= 0)
+	{
+		Record(m_Name, m_Category, m_Start, GetTraceTime() - m_Start, 0.0);
+		m_Start = -1;
+	}
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "Platform.h"
+#include <cstddef>
+
+//
+// Scoped spans on a timeline that chrome://tracing and Perfetto open, one
+// track per thread. Every thread records into a buffer only it writes: an
+// event is stored, then published by bumping the buffer's count, so
+// recording takes no lock and WriteTrace can run while threads still record.
+// Nothing is recorded until StartTrace. A full buffer drops events instead of
+// growing, and WriteTrace reports how many were lost.
+//
+
+// Events each thread keeps
+const size_t DEFAULT_TRACE_EVENTS_PER_THREAD = 1 << 16;
+
+// Once per process, before the work to trace
+void StartTrace(size_t eventsPerThread = DEFAULT_TRACE_EVENTS_PER_THREAD);
+bool IsTracing();
+
+// Labels the calling thread's track; the name is copied
+void SetTraceThreadName(const char* name);
+
+// A value over time, such as how many clients wait, on a track of its own
+void TraceCounter(const char* name, double value);
+
+// Chrome trace-event JSON of everything recorded so far
+bool WriteTrace(const PathChar* path);
+
+// Records a span from construction to End or destruction. Names and
+// categories are kept as pointers, so they have to be string literals or
+// outlive the trace in some other way.
+class TraceSpan
+{
+public:
+	explicit TraceSpan(const char* name, const char* category = "pipeline");
+	~TraceSpan();
+
+	void End();
+
+private:
+	TraceSpan(const TraceSpan&);
+	TraceSpan& operator=(const TraceSpan&);
+
+	const char* m_Name;
+	const char* m_Category;
+	long long m_Start; // nanoseconds since StartTrace, negative when not tracing
+};
@@ -1,194 +1,1380 @@
 #define NOMINMAX
 
 #include <iostream>
-#include <fstream>
+#include <sstream>
 #include <vector>
 #include <algorithm>
 #include <string>
-#include <functional>
+#include <cwchar>
 #include "D3DXVolumeTextureSaver.h"
+#include "AcvCurves.h"
+#include "DdsVolume.h"
+#include "LutChain.h"
+#include "LutBatchApplier.h"
+#include "Lut3D.h"
+#include "LutApplier.h"
+#include "LazyLut3D.h"
+#include "Image.h"
+#include "ImageCodecs.h"
+#include "Stopwatch.h"
+#include "MappedApply.h"
+#include "LutBenchmark.h"
+#include "PipelineBenchmark.h"
+#include "CpuFeatures.h"
+#include "CurveGrader.h"
+#include "LutServer.h"
+#include "LutProtocol.h"
+#include "LocalSocket.h"
+#include "FrameRing.h"
+#include "LutPack.h"
+#include "PipelineStats.h"
+#include "Trace.h"
+#include "CubeSizing.h"
+#include "LutOutputs.h"
+#include "LutShaper.h"
 
-#define LITTLEENDIANIZE(shortnum) \
-	shortnum = (short)(((shortnum & 0xFF) << 8) | (shortnum >> 8))
-
-#define READ_BIG_ENDIAN_USHORT(stream, ush) \
-	stream.read(reinterpret_cast<char*>(&ush), sizeof(ush)); \
-	if (!stream.good()) \
-	{ \
-		std::cerr << "Unable to read data from file! (" << __LINE__ << ")" << std::endl; \
-		return false; \
-	} \
-	LITTLEENDIANIZE(ush); \
-
-//
-// http://www.adobe.com/devnet-apps/photoshop/fileformatashtml/PhotoshopFileFormats.htm#50577411_pgfId-1056330
-//  Curves file format
-// 
-// 	Length		Description
-// 
-// 	2			Version ( = 1 or = 4)
-// 	2			Count of curves in the file.
-// 
-// 	The following is the data for each curve specified by count above
-// 
-// 	2			Count of points in the curve (short integer from 2...19)
-// 
-// 	point		Curve points.Each curve point is a pair of short integers where the
-//  cnt * 4		first number is the output value (vertical coordinate on the Curves
-// 				dialog graph) and the second is the input value. All coordinates have
-// 				range 0 to 255. See also "Null curves" below.
-//
-
-template <typename T>
-static T clamp(const T& value, const T& min, const T& max)
-{
-	if (value > max)
-	{
-		return max;
-	}
-	else if (value < min)
-	{
-		return min;
+// Bakes the cube for an ACV file (at the converter's size) or a DDS volume
+static bool LoadLut(const wchar_t* lutFile, Lut3D& lut)
+{
+	LutChain chain;
+	if (!chain.AddFile(lutFile))
+	{
+		return false;
+	}
+
+	lut = chain.Bake(chain.GetNativeSize() ? chain.GetNativeSize() : DEFAULT_CUBE_SIZE);
+	return true;
+}
+
+// Parses --filter=exact (the default) or --filter=d3d11, which renders like the
+// viewer's sampler
+static bool ParseFilter(const wchar_t* option, LutFilter& filter)
+{
+	std::wstring name(wcsncmp(option, L"--filter=", 9) == 0 ? option + 9 : L"");
+	if (name == L"exact")
+	{
+		filter = LUT_FILTER_EXACT;
+	}
+	else if (name == L"d3d11")
+	{
+		filter = LUT_FILTER_D3D11;
+	}
+	else
+	{
+		std::cerr << "Filter must be exact or d3d11." << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// Parses --interpolation=nearest, trilinear or tetrahedral. Without one
+// separable cubes go through their 1D tables and the d3d11 filter blends like
+// the viewer's sampler.
+static bool ParseInterpolation(const wchar_t* option, LutInterpolation& interpolation)
+{
+	std::wstring name(wcsncmp(option, L"--interpolation=", 16) == 0 ? option + 16 : L"");
+	if (name == L"nearest")
+	{
+		interpolation = LUT_INTERPOLATION_NEAREST;
+	}
+	else if (name == L"trilinear")
+	{
+		interpolation = LUT_INTERPOLATION_TRILINEAR;
+	}
+	else if (name == L"tetrahedral")
+	{
+		interpolation = LUT_INTERPOLATION_TETRAHEDRAL;
+	}
+	else
+	{
+		std::cerr << "Interpolation must be nearest, trilinear or tetrahedral." << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// Parses --shaper=none, log, pq or fitted
+static bool ParseShaper(const wchar_t* option, LutShaperKind& kind)
+{
+	if (wcsncmp(option, L"--shaper=", 9) != 0 || !ParseShaperKind(NarrowPath(option + 9).c_str(), kind))
+	{
+		std::cerr << "Shaper must be none, log, pq or fitted." << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// Parses the error budget for picking a cube size: --bits=8|10,
+// --max-error=STEPS, --mean-error=STEPS, --interpolation=trilinear|tetrahedral,
+// --max-size=N and the --shaper the cubes go behind
+static bool ParseCubeSizeOption(const wchar_t* option, CubeSizeCriteria& criteria)
+{
+	if (wcsncmp(option, L"--bits=", 7) == 0)
+	{
+		criteria.Bits = wcstoul(option + 7, nullptr, 10);
+		if (criteria.Bits != 8 && criteria.Bits != 10)
+		{
+			std::cerr << "Errors are measured in 8 or 10-bit steps." << std::endl;
+			return false;
+		}
+	}
+	else if (wcsncmp(option, L"--max-error=", 12) == 0 || wcsncmp(option, L"--mean-error=", 13) == 0)
+	{
+		const bool maximum = option[3] == L'a';
+		double& bound = maximum ? criteria.MaxError : criteria.MeanError;
+		if (swscanf(option + (maximum ? 12 : 13), L"%lf", &bound) != 1 || !(bound > 0.0))
+		{
+			std::cerr << "Error bounds must be positive numbers of steps." << std::endl;
+			return false;
+		}
+	}
+	else if (wcsncmp(option, L"--interpolation=", 16) == 0)
+	{
+		if (!ParseInterpolation(option, criteria.Interpolation))
+		{
+			return false;
+		}
+		if (criteria.Interpolation == LUT_INTERPOLATION_NEAREST)
+		{
+			std::cerr << "Cube sizes are picked for trilinear or tetrahedral interpolation." << std::endl;
+			return false;
+		}
+	}
+	else if (wcsncmp(option, L"--max-size=", 11) == 0)
+	{
+		criteria.MaxSize = wcstoul(option + 11, nullptr, 10);
+		if (criteria.MaxSize < 2 || criteria.MaxSize > 256)
+		{
+			std::cerr << "Cube size must be between 2 and 256." << std::endl;
+			return false;
+		}
+	}
+	else if (wcsncmp(option, L"--shaper=", 9) == 0)
+	{
+		if (!ParseShaper(option, criteria.Shaper))
+		{
+			return false;
+		}
+	}
+	else
+	{
+		std::wcerr << L"Unknown option: " << option << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// Prints the smallest cube size within the error budget for each LUT file,
+// or for every ACV and DDS file under a directory
+static int SizeLuts(int argc, wchar_t* argv[])
+{
+	CubeSizeCriteria criteria;
+	std::vector<std::wstring> files;
+	for (int i = 2; i < argc; ++i)
+	{
+		if (wcsncmp(argv[i], L"--", 2) == 0)
+		{
+			if (!ParseCubeSizeOption(argv[i], criteria))
+			{
+				return -1;
+			}
+			continue;
+		}
+
+		const std::string extension = GetPathExtension(argv[i]);
+		std::vector<std::wstring> listed;
+		if (extension == "acv" || extension == "dds")
+		{
+			files.push_back(argv[i]);
+		}
+		else if (ListFiles(argv[i], listed))
+		{
+			for (size_t j = 0; j < listed.size(); ++j)
+			{
+				const std::string listedExtension = GetPathExtension(listed[j].c_str());
+				if ((listedExtension == "acv" || listedExtension == "dds") && !IsDdsShaperPath(listed[j].c_str()))
+				{
+					files.push_back(std::wstring(argv[i]) + L"/" + listed[j]);
+				}
+			}
+		}
+		else
+		{
+			std::wcerr << L"Not a LUT file or directory: " << argv[i] << std::endl;
+			return -2;
+		}
+	}
+
+	size_t met = 0;
+	Stopwatch stopwatch;
+	for (size_t i = 0; i < files.size(); ++i)
+	{
+		LutChain chain;
+		if (!chain.AddFile(files[i].c_str()))
+		{
+			continue;
+		}
+
+		CubeSizeError error;
+		const bool ok = SelectCubeSize(chain, criteria, error);
+		met += ok;
+		std::wcout << files[i] << L": " << error.Size << (ok ? L"" : L", over budget at the largest size")
+			<< L" (max " << error.MaxError << L", mean " << error.MeanError << L" " << criteria.Bits << L"-bit steps)" << std::endl;
+	}
+
+	std::cout << met << " of " << files.size() << " LUTs within max " << criteria.MaxError << " and mean " << criteria.MeanError
+		<< " steps, in " << stopwatch.GetElapsedMilliseconds() << " ms" << std::endl;
+	return met == files.size() ? 0 : -3;
+}
+
+// Serves conversions and applies on a UNIX domain socket until a client asks
+// for a shutdown
+static int RunDaemon(int argc, wchar_t* argv[])
+{
+	size_t cacheBudget = DEFAULT_LUT_CACHE_BUDGET;
+	unsigned workerCount = 0;
+	for (int i = 3; i < argc; ++i)
+	{
+		unsigned megabytes;
+		if (wcsncmp(argv[i], L"--workers=", 10) == 0)
+		{
+			if (swscanf(argv[i], L"--workers=%u", &workerCount) != 1 || workerCount == 0)
+			{
+				std::cerr << "The worker count must be given as --workers=N." << std::endl;
+				return -1;
+			}
+		}
+		else if (swscanf(argv[i], L"--cache-mb=%u", &megabytes) != 1 || megabytes == 0)
+		{
+			std::cerr << "The cache size must be given as --cache-mb=N." << std::endl;
+			return -1;
+		}
+		else
+		{
+			cacheBudget = (size_t)megabytes << 20;
+		}
+	}
+
+	LutServer server(cacheBudget, workerCount);
+	if (!server.Listen(NarrowPath(argv[2]).c_str()))
+	{
+		return -1;
+	}
+
+	std::cout << "Listening at " << NarrowPath(argv[2]) << std::endl;
+	const bool ok = server.Run();
+
+	const LutCacheStats stats = server.GetCacheStats();
+	std::cout << "LUT cache: " << stats.Hits << " hits, " << stats.Misses << " misses, " << stats.Shared << " shared, "
+		<< stats.Evictions << " evictions, " << stats.Entries << " LUTs in " << stats.Bytes << " bytes" << std::endl;
+	return ok ? 0 : -4;
+}
+
+// One request and its reply; the reply's error output is printed
+static bool ExchangeWithDaemon(LocalSocket& socket, LutRequest request, const std::vector<char>& payload, int& status,
+	int descriptor = -1)
+{
+	LutMessageHeader header;
+	std::vector<char> reply;
+	std::vector<std::string> output;
+	if (!SendLutMessage(socket, request, 0, payload, descriptor) || !ReceiveLutMessage(socket, header, reply) ||
+		header.Type != LUT_REQUEST_REPLY || !UnpackStrings(reply, output) || output.size() != 2)
+	{
+		std::cerr << "The daemon did not answer." << std::endl;
+		return false;
+	}
+
+	std::cerr << output[1];
+	status = header.Status;
+	return true;
+}
+
+// Grades frames through a daemon and a shared frame ring, then the same frames
+// in process, to show what going through the daemon costs
+static int BenchmarkFrames(const std::string& socketPath, int argc, wchar_t* argv[])
+{
+	const wchar_t* lutFile = nullptr;
+	unsigned width = 3840;
+	unsigned height = 2160;
+	size_t count = 100;
+	ImageFormat format = IMAGE_FORMAT_RGBA8;
+
+	for (int i = 4; i < argc; ++i)
+	{
+		if (wcsncmp(argv[i], L"--size=", 7) == 0)
+		{
+			if (swscanf(argv[i] + 7, L"%ux%u", &width, &height) != 2 || width == 0 || height == 0)
+			{
+				std::cerr << "Frame size must be WIDTHxHEIGHT." << std::endl;
+				return -1;
+			}
+		}
+		else if (wcsncmp(argv[i], L"--count=", 8) == 0)
+		{
+			count = wcstoul(argv[i] + 8, nullptr, 10);
+			if (count == 0)
+			{
+				std::cerr << "Frame count must be a positive number." << std::endl;
+				return -1;
+			}
+		}
+		else if (wcsncmp(argv[i], L"--format=", 9) == 0)
+		{
+			if (!ParseImageFormat(NarrowPath(argv[i] + 9).c_str(), format))
+			{
+				std::cerr << "Unknown pixel format." << std::endl;
+				return -1;
+			}
+		}
+		else if (!lutFile)
+		{
+			lutFile = argv[i];
+		}
+	}
+
+	Lut3D lut;
+	if (!lutFile || !LoadLut(lutFile, lut))
+	{
+		std::cerr << "A LUT (ACV or DDS) file is required." << std::endl;
+		return -2;
+	}
+
+	const size_t rowSize = (size_t)width * GetChannelCount(format) * GetBytesPerChannel(format);
+	FrameRing ring;
+	if (!ring.Create(SharedMemory::MakeName("acvtolut"), 2, rowSize * height))
+	{
+		return -4;
+	}
+	for (unsigned slot = 0; slot < 2; ++slot)
+	{
+		unsigned char* pixels = ring.GetSlot(slot);
+		for (size_t i = 0; i < rowSize * height; ++i)
+		{
+			pixels[i] = (unsigned char)(i * 2654435761u >> 24);
+		}
+	}
+
+	LocalSocket socket;
+	if (!socket.Connect(socketPath.c_str()))
+	{
+		return -1;
+	}
+
+	std::vector<std::string> arguments(1, ring.GetName());
+	std::vector<char> payload;
+	PackStrings(arguments, payload);
+	int ringNumber;
+	if (!ExchangeWithDaemon(socket, LUT_REQUEST_ATTACH, payload, ringNumber, ring.GetDescriptor()) || ringNumber < 0)
+	{
+		return -4;
+	}
+
+	LutFrameDescriptor frame;
+	frame.Ring = (unsigned)ringNumber;
+	frame.Width = width;
+	frame.Height = height;
+	frame.RowPitch = (unsigned)rowSize;
+	frame.Format = format;
+
+	arguments.assign(1, NarrowPath(GetAbsolutePath(lutFile).c_str()));
+	std::vector<char> strings;
+	PackStrings(arguments, strings);
+
+	Stopwatch stopwatch;
+	for (size_t i = 0; i < count; ++i)
+	{
+		frame.Slot = (unsigned)(i % 2);
+		payload.assign(reinterpret_cast<const char*>(&frame), reinterpret_cast<const char*>(&frame + 1));
+		payload.insert(payload.end(), strings.begin(), strings.end());
+
+		TraceSpan span("frame", "client");
+		int status;
+		if (!ExchangeWithDaemon(socket, LUT_REQUEST_FRAME, payload, status) || status != 0)
+		{
+			return -4;
+		}
+	}
+	const double daemonTime = stopwatch.GetElapsedMilliseconds() / count;
+
+	std::vector<unsigned char> copy(ring.GetSlot(0), ring.GetSlot(0) + rowSize * height);
+	LutApplier applier(lut);
+	stopwatch.Restart();
+	for (size_t i = 0; i < count; ++i)
+	{
+		TraceSpan span("local-frame", "client");
+		applier.Apply(&copy[0], format, &copy[0], format, (size_t)width * height);
+	}
+	const double localTime = stopwatch.GetElapsedMilliseconds() / count;
+
+	std::cout << count << " " << width << "x" << height << " " << GetImageFormatName(format) << " frames - through the daemon: "
+		<< daemonTime << " ms, in process: " << localTime << " ms, overhead: " << daemonTime - localTime << " ms per frame" << std::endl;
+	return 0;
+}
+
+// Sends one request to a daemon and prints what it answers. Paths go over as
+// absolute paths, the daemon having a working directory of its own. Pings
+// take --count=N and print the average round trip.
+static int RunClient(int argc, wchar_t* argv[])
+{
+	const std::string socketPath = NarrowPath(argv[2]);
+	if (std::wstring(argv[3]) == L"frames")
+	{
+		return BenchmarkFrames(socketPath, argc, argv);
+	}
+
+	LutRequest request;
+	if (!ParseRequest(NarrowPath(argv[3]).c_str(), request))
+	{
+		std::cerr << "Request must be ping, convert, apply, grade or shutdown." << std::endl;
+		return -1;
+	}
+
+	std::vector<std::string> arguments;
+	size_t count = 1;
+	for (int i = 4; i < argc; ++i)
+	{
+		if (request == LUT_REQUEST_PING && wcsncmp(argv[i], L"--count=", 8) == 0)
+		{
+			count = wcstoul(argv[i] + 8, nullptr, 10);
+			if (count == 0)
+			{
+				std::cerr << "Ping count must be a positive number." << std::endl;
+				return -1;
+			}
+		}
+		else if (wcsncmp(argv[i], L"--", 2) == 0)
+		{
+			arguments.push_back(NarrowPath(argv[i]));
+		}
+		else
+		{
+			arguments.push_back(NarrowPath(GetAbsolutePath(argv[i]).c_str()));
+		}
+	}
+
+	LocalSocket socket;
+	if (!socket.Connect(socketPath.c_str()))
+	{
+		return -1;
+	}
+
+	std::vector<char> payload;
+	PackStrings(arguments, payload);
+
+	LutMessageHeader header;
+	std::vector<char> reply;
+	Stopwatch stopwatch;
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (!SendLutMessage(socket, request, 0, payload) || !ReceiveLutMessage(socket, header, reply))
+		{
+			std::cerr << "The daemon did not answer." << std::endl;
+			return -4;
+		}
+	}
+	const double elapsed = stopwatch.GetElapsedMilliseconds();
+
+	std::vector<std::string> output;
+	if (header.Type != LUT_REQUEST_REPLY || !UnpackStrings(reply, output) || output.size() != 2)
+	{
+		std::cerr << "The daemon sent a malformed reply." << std::endl;
+		return -4;
+	}
+
+	std::cout << output[0];
+	std::cerr << output[1];
+	if (request == LUT_REQUEST_PING)
+	{
+		std::cout << count << " pings, " << elapsed * 1000.0 / count << " us per round trip" << std::endl;
+	}
+	return header.Status;
+}
+
+// Takes --cpu=LEVEL out of the arguments, wherever it is, and caps the
+// kernels to that level
+static bool TakeCpuOption(int& argc, wchar_t* argv[])
+{
+	for (int i = 1; i < argc; ++i)
+	{
+		if (wcsncmp(argv[i], L"--cpu=", 6) != 0)
+		{
+			continue;
+		}
+
+		std::string name;
+		for (const wchar_t* c = argv[i] + 6; *c; ++c)
+		{
+			name += *c < 128 ? (char)*c : '?';
+		}
+
+		CpuLevel level;
+		if (!ParseCpuLevel(name.c_str(), level))
+		{
+			std::cerr << "CPU level must be scalar, sse2, sse4.1, avx2 or avx512." << std::endl;
+			return false;
+		}
+		if (!SetCpuLevel(level))
+		{
+			return false;
+		}
+
+		std::copy(argv + i + 1, argv + argc, argv + i);
+		--argc;
+		--i;
+	}
+	return true;
+}
+
+enum StatsOutput
+{
+	STATS_NONE,
+	STATS_TEXT,
+	STATS_JSON
+};
+
+// Takes --stats, --stats=json or --stats=json:FILE out of the arguments,
+// wherever it is. Stats go to FILE, or to stderr so that they stay out of
+// what the command prints.
+static bool TakeStatsOption(int& argc, wchar_t* argv[], StatsOutput& output, const wchar_t*& path)
+{
+	output = STATS_NONE;
+	path = nullptr;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (std::wstring(argv[i]) == L"--stats")
+		{
+			output = STATS_TEXT;
+		}
+		else if (std::wstring(argv[i]) == L"--stats=json")
+		{
+			output = STATS_JSON;
+		}
+		else if (wcsncmp(argv[i], L"--stats=json:", 13) == 0 && argv[i][13])
+		{
+			output = STATS_JSON;
+			path = argv[i] + 13;
+		}
+		else if (wcsncmp(argv[i], L"--stats=", 8) == 0)
+		{
+			std::cerr << "Stats are printed as text (--stats) or as JSON (--stats=json, or --stats=json:FILE)." << std::endl;
+			return false;
+		}
+		else
+		{
+			continue;
+		}
+
+		std::copy(argv + i + 1, argv + argc, argv + i);
+		--argc;
+		--i;
+	}
+	return true;
+}
+
+// Takes --trace=FILE out of the arguments, wherever it is
+static const wchar_t* TakeTraceOption(int& argc, wchar_t* argv[])
+{
+	const wchar_t* path = nullptr;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (wcsncmp(argv[i], L"--trace=", 8) == 0)
+		{
+			path = argv[i] + 8;
+			std::copy(argv + i + 1, argv + argc, argv + i);
+			--argc;
+			--i;
+		}
+	}
+	return path;
+}
+
+static void PrintCpuLevel()
+{
+	std::cout << "CPU level: " << GetCpuLevelName(GetCpuLevel()) << " (supported: " << GetCpuLevelName(GetSupportedCpuLevel()) << ")" << std::endl;
+}
+
+// Composes several ACV and DDS files, in order, into one DDS volume
+static int ComposeLuts(int argc, wchar_t* argv[])
+{
+	const wchar_t* outputFile = nullptr;
+	size_t cubeSize = 0;
+	bool autoSize = false;
+	CubeSizeCriteria criteria;
+	LutChain chain;
+
+	for (int i = 2; i < argc; ++i)
+	{
+		if (std::wstring(argv[i]) == L"--size=auto")
+		{
+			autoSize = true;
+		}
+		else if (wcsncmp(argv[i], L"--size=", 7) == 0)
+		{
+			cubeSize = wcstoul(argv[i] + 7, nullptr, 10);
+			if (cubeSize < 2 || cubeSize > 256)
+			{
+				std::cerr << "Cube size must be between 2 and 256." << std::endl;
+				return -1;
+			}
+		}
+		else if (wcsncmp(argv[i], L"--", 2) == 0)
+		{
+			if (!ParseCubeSizeOption(argv[i], criteria))
+			{
+				return -1;
+			}
+		}
+		else if (!outputFile)
+		{
+			outputFile = argv[i];
+		}
+		else if (!chain.AddFile(argv[i]))
+		{
+			return -2;
+		}
+	}
+
+	if (!outputFile || chain.GetStageCount() == 0)
+	{
+		std::cerr << "An output file and at least one ACV or DDS file are required." << std::endl;
+		return -1;
+	}
+
+	if (autoSize)
+	{
+		CubeSizeError error;
+		if (!SelectCubeSize(chain, criteria, error))
+		{
+			std::cerr << "No size up to " << criteria.MaxSize << " is within the error budget; at " << error.Size
+				<< " the max error is " << error.MaxError << ", the mean " << error.MeanError << " " << criteria.Bits
+				<< "-bit steps. Raise --max-size or the error bounds, or give --size=N." << std::endl;
+			return -3;
+		}
+		std::cout << "Cube size " << error.Size << ": max error " << error.MaxError << ", mean " << error.MeanError
+			<< " " << criteria.Bits << "-bit steps" << std::endl;
+		cubeSize = error.Size;
+	}
+	else if (cubeSize == 0)
+	{
+		cubeSize = chain.GetNativeSize() ? chain.GetNativeSize() : DEFAULT_CUBE_SIZE;
+	}
+
+	const LutShaper shaper = LutShaper::Create(criteria.Shaper, chain, cubeSize);
+	Lut3D lut = chain.Bake(cubeSize, &shaper);
+	if (!WriteDdsVolume(outputFile, lut) || (!shaper.IsIdentity() && !WriteDdsShaper(GetDdsShaperPath(outputFile).c_str(), shaper)))
+	{
+		return -4;
+	}
+
+	std::cout << "Composed " << chain.GetStageCount() << " looks into a " << cubeSize << "^3 "
+		<< (chain.IsSeparable() ? "separable" : "resampled") << " cube" << std::endl;
+	return 0;
+}
+
+// Bakes a chain of looks once and writes it at several cube sizes and in
+// several formats, to output_prefix_SIZE.FORMAT
+static int BakeLutOutputs(int argc, wchar_t* argv[])
+{
+	const wchar_t* outputPrefix = nullptr;
+	std::vector<size_t> sizes;
+	std::vector<std::wstring> formats;
+	LutShaperKind shaperKind = LUT_SHAPER_NONE;
+	LutChain chain;
+
+	for (int i = 2; i < argc; ++i)
+	{
+		if (wcsncmp(argv[i], L"--sizes=", 8) == 0)
+		{
+			const wchar_t* list = argv[i] + 8;
+			while (*list)
+			{
+				wchar_t* end;
+				size_t size = wcstoul(list, &end, 10);
+				if (end == list || size < 2 || size > 256 || (*end && *end != L','))
+				{
+					std::cerr << "Sizes must be a comma separated list of numbers between 2 and 256." << std::endl;
+					return -1;
+				}
+				sizes.push_back(size);
+				list = *end ? end + 1 : end;
+			}
+		}
+		else if (wcsncmp(argv[i], L"--formats=", 10) == 0)
+		{
+			std::wstring list = argv[i] + 10;
+			for (size_t start = 0; start <= list.size();)
+			{
+				size_t comma = list.find(L',', start);
+				if (comma == std::wstring::npos)
+				{
+					comma = list.size();
+				}
+				const std::wstring format = list.substr(start, comma - start);
+				if (!IsLutOutputFormat(GetPathExtension((L"." + format).c_str())))
+				{
+					std::cerr << "Unknown LUT output format: " << NarrowPath(format.c_str()) << std::endl;
+					return -1;
+				}
+				formats.push_back(format);
+				start = comma + 1;
+			}
+		}
+		else if (wcsncmp(argv[i], L"--shaper=", 9) == 0)
+		{
+			if (!ParseShaper(argv[i], shaperKind))
+			{
+				return -1;
+			}
+		}
+		else if (!outputPrefix)
+		{
+			outputPrefix = argv[i];
+		}
+		else if (!chain.AddFile(argv[i]))
+		{
+			return -2;
+		}
+	}
+
+	if (!outputPrefix || chain.GetStageCount() == 0)
+	{
+		std::cerr << "An output prefix and at least one ACV or DDS file are required." << std::endl;
+		return -1;
+	}
+	if (sizes.empty())
+	{
+		sizes.push_back(16);
+		sizes.push_back(32);
+		sizes.push_back(64);
+	}
+	if (formats.empty())
+	{
+		formats.push_back(L"dds");
+	}
+
+	std::vector<LutOutputFile> outputs;
+	for (size_t s = 0; s < sizes.size(); ++s)
+	{
+		for (size_t f = 0; f < formats.size(); ++f)
+		{
+			LutOutputFile output;
+			output.Size = sizes[s];
+			output.Path = outputPrefix + (L"_" + std::to_wstring(sizes[s])) + L"." + formats[f];
+			outputs.push_back(output);
+		}
+	}
+
+	Stopwatch stopwatch;
+	if (!WriteLutOutputs(chain, outputs, shaperKind))
+	{
+		return -4;
+	}
+
+	std::cout << "Wrote " << outputs.size() << " LUTs from " << chain.GetStageCount() << " looks in "
+		<< stopwatch.GetElapsedMilliseconds() << " ms" << std::endl;
+	return 0;
+}
+
+// Grades an image on the CPU with the same cube the converter would write,
+// or with one baked at another size or behind a shaper. Cubes much larger
+// than the image (see IsWorthLazyCube), and any cube with --lazy, are worked
+// out only where the pixels sample them, unless another interpolation is
+// asked for.
+static int ApplyToImage(const wchar_t* lutFile, const wchar_t* inputFile, const wchar_t* outputFile, LutFilter filter, const LutInterpolation* interpolation,
+	LutShaperKind shaperKind, bool colourCache, size_t cubeSize, bool lazy)
+{
+	LutChain chain;
+	if (!chain.AddFile(lutFile))
+	{
+		return -2;
+	}
+	if (cubeSize == 0)
+	{
+		cubeSize = chain.GetNativeSize() ? chain.GetNativeSize() : DEFAULT_CUBE_SIZE;
+	}
+	const LutShaper shaper = LutShaper::Create(shaperKind, chain, cubeSize);
+
+	Image image;
+	Stopwatch stopwatch;
+	if (!ReadImage(inputFile, image, IMAGE_LAYOUT_INTERLEAVED))
+	{
+		return -4;
+	}
+	double decodeTime = stopwatch.GetElapsedMilliseconds();
+
+	const bool trilinear = !interpolation || *interpolation == LUT_INTERPOLATION_TRILINEAR;
+	if (lazy && !trilinear)
+	{
+		std::cerr << "Lazy cubes only interpolate trilinearly." << std::endl;
+		return -1;
+	}
+
+	double applyTime;
+	if (lazy || (trilinear && IsWorthLazyCube(cubeSize, (size_t)image.GetWidth() * image.GetHeight())))
+	{
+		stopwatch.Restart();
+		const LazyLut3D cube(chain, cubeSize, &shaper);
+		cube.Apply(image, filter);
+		applyTime = stopwatch.GetElapsedMilliseconds();
+		std::cout << "Worked out " << cube.GetEvaluatedCount() << " of " << cubeSize * cubeSize * cubeSize << " lattice points." << std::endl;
 	}
 	else
 	{
-		return value;
+		const Lut3D lut = chain.Bake(cubeSize, &shaper);
+		LutApplier applier(lut, filter, LUT_LAYOUT_AUTO, &shaper);
+		if (interpolation && !applier.SetInterpolation(*interpolation))
+		{
+			return -1;
+		}
+		applier.SetColourCache(colourCache);
+
+		if (applier.PassesThrough(image.GetFormat()))
+		{
+			std::cout << "The LUT is an identity, pixels pass through unchanged." << std::endl;
+		}
+
+		stopwatch.Restart();
+		applier.Apply(image);
+		applyTime = stopwatch.GetElapsedMilliseconds();
+	}
+
+	stopwatch.Restart();
+	if (!WriteImage(outputFile, image))
+	{
+		return -5;
 	}
+	double encodeTime = stopwatch.GetElapsedMilliseconds();
+
+	std::cout << image.GetWidth() << "x" << image.GetHeight()
+		<< " - decode: " << decodeTime << " ms, apply: " << applyTime << " ms, encode: " << encodeTime << " ms" << std::endl;
+	return 0;
 }
 
-template <typename T>
-static T saturate(const T& value)
+// Grades an image straight from ACV curves through tables fused for its pixel
+// format, with no cube in between
+static int GradeImage(const wchar_t* acvFile, const wchar_t* inputFile, const wchar_t* outputFile)
 {
-	return clamp(value, T(0), T(1));
-}
+	std::vector<CubicSpline> cubicSplines;
+	if (!ReadCurves(acvFile, cubicSplines))
+	{
+		return -2;
+	}
+
+	Image image;
+	Stopwatch stopwatch;
+	if (!ReadImage(inputFile, image, IMAGE_LAYOUT_INTERLEAVED))
+	{
+		return -4;
+	}
+	double decodeTime = stopwatch.GetElapsedMilliseconds();
 
-typedef std::vector<std::pair<float, float>> CurvePoints;
+	stopwatch.Restart();
+	CurveGrader grader(cubicSplines, image.GetFormat());
+	double tableTime = stopwatch.GetElapsedMilliseconds();
 
-class CubicSpline
-{
-public:
-	// Interpolation of natural splines
-	static CubicSpline InterpolateCubicSplineFromCurvePoints(const CurvePoints& curve)
+	stopwatch.Restart();
+	grader.Apply(image);
+	double gradeTime = stopwatch.GetElapsedMilliseconds();
+
+	stopwatch.Restart();
+	if (!WriteImage(outputFile, image))
 	{
-		std::vector<float> y2(curve.size()); // second derivatives
-		std::vector<float> u(curve.size());
+		return -5;
+	}
+	double encodeTime = stopwatch.GetElapsedMilliseconds();
+
+	std::cout << image.GetWidth() << "x" << image.GetHeight()
+		<< " - decode: " << decodeTime << " ms, tables: " << tableTime << " ms, grade: " << gradeTime
+		<< " ms, encode: " << encodeTime << " ms" << std::endl;
+	return 0;
+}
+
+// Grades one image with many LUTs, decoding it once. Each result is written to
+// output_prefix followed by the LUT's file name and the input's extension.
+static int PreviewLooks(int argc, wchar_t* argv[])
+{
+	const std::wstring inputFile = argv[2];
+	const std::wstring outputPrefix = argv[3];
 
-		y2[0] = 0;
+	const size_t dot = inputFile.find_last_of(L'.');
+	const std::wstring extension = dot == std::wstring::npos ? L"" : inputFile.substr(dot);
 
-		for (size_t i = 1; i < curve.size() - 1; ++i)
+	std::vector<Lut3D> luts(argc - 4);
+	std::vector<std::wstring> outputFiles;
+	for (int i = 4; i < argc; ++i)
+	{
+		if (!LoadLut(argv[i], luts[i - 4]))
 		{
-			float sig = (curve[i].first - curve[i - 1].first) / (curve[i + 1].first - curve[i - 1].first);
-			float p = sig * y2[i - 1] + 2.0f;
-			y2[i] = (sig - 1.0f) / p;
-			u[i] = (curve[i+1].second - curve[i].second)/(curve[i+1].first - curve[i].first) - (curve[i].second - curve[i-1].second)/(curve[i].first - curve[i-1].first);
-			u[i] = (6.0f * u[i] / (curve[i+1].first - curve[i-1].first) - sig*u[i-1]) / p;
+			return -2;
 		}
 
-		y2[curve.size() - 1] = 0;
+		std::wstring name = argv[i];
+		name = name.substr(name.find_last_of(L"/\\") + 1);
+		outputFiles.push_back(outputPrefix + name.substr(0, name.find_last_of(L'.')) + extension);
+	}
+
+	std::vector<const Lut3D*> lutPointers;
+	for (size_t k = 0; k < luts.size(); ++k)
+	{
+		lutPointers.push_back(&luts[k]);
+	}
+
+	Image image;
+	Stopwatch stopwatch;
+	if (!ReadImage(inputFile.c_str(), image, IMAGE_LAYOUT_INTERLEAVED))
+	{
+		return -4;
+	}
+	double decodeTime = stopwatch.GetElapsedMilliseconds();
+
+	stopwatch.Restart();
+	std::vector<Image> outputs;
+	LutBatchApplier(lutPointers).Apply(image, outputs);
+	double applyTime = stopwatch.GetElapsedMilliseconds();
 
-		for (int i = (int)curve.size() - 2; i >= 0; --i)
+	stopwatch.Restart();
+	for (size_t k = 0; k < outputs.size(); ++k)
+	{
+		if (!WriteImage(outputFiles[k].c_str(), outputs[k]))
 		{
-			y2[i] = y2[i] * y2[i + 1] + u[i];
+			return -5;
 		}
-
-		CubicSpline spline(curve, std::move(y2));
-		return spline;
 	}
+	double encodeTime = stopwatch.GetElapsedMilliseconds();
 
-	float ComputeAtPoint(float x)
+	std::cout << luts.size() << " looks on " << image.GetWidth() << "x" << image.GetHeight()
+		<< " - decode: " << decodeTime << " ms, apply: " << applyTime << " ms, encode: " << encodeTime << " ms" << std::endl;
+	return 0;
+}
+
+// Times the linear and bricked cube layouts on an image and on random colours,
+// for a list of cube sizes
+static int BenchmarkLayouts(int argc, wchar_t* argv[])
+{
+	const wchar_t* lutFile = nullptr;
+	const wchar_t* inputFile = nullptr;
+	std::vector<size_t> sizes;
+
+	for (int i = 2; i < argc; ++i)
 	{
-		int lo = 0;
-		int hi = (int)(m_Curve.size() - 1);
-		while (hi - lo > 1)
+		if (wcsncmp(argv[i], L"--sizes=", 8) == 0)
 		{
-			int k = (hi + lo) / 2;
-			if (m_Curve[k].first > x)
+			const wchar_t* list = argv[i] + 8;
+			while (*list)
 			{
-				hi = k;
+				wchar_t* end;
+				size_t size = wcstoul(list, &end, 10);
+				if (end == list || size < 2 || size > 256 || (*end && *end != L','))
+				{
+					std::cerr << "Sizes must be a comma separated list of numbers between 2 and 256." << std::endl;
+					return -1;
+				}
+				sizes.push_back(size);
+				list = *end ? end + 1 : end;
 			}
-			else
+		}
+		else if (!lutFile)
+		{
+			lutFile = argv[i];
+		}
+		else if (!inputFile)
+		{
+			inputFile = argv[i];
+		}
+	}
+
+	if (!lutFile || !inputFile)
+	{
+		std::cerr << "A LUT (ACV or DDS) file and an input image are required." << std::endl;
+		return -1;
+	}
+
+	if (sizes.empty())
+	{
+		const size_t defaultSizes[] = { 17, 33, 65, 129 };
+		sizes.assign(defaultSizes, defaultSizes + 4);
+	}
+
+	Lut3D lut;
+	if (!LoadLut(lutFile, lut))
+	{
+		return -2;
+	}
+
+	Image image;
+	if (!ReadImage(inputFile, image, IMAGE_LAYOUT_INTERLEAVED))
+	{
+		return -4;
+	}
+
+	PrintCpuLevel();
+
+	std::vector<BenchmarkResult> results;
+	if (!RunLayoutBenchmarks(lut, sizes, image, results))
+	{
+		return -4;
+	}
+
+	PrintBenchmarkResults(results);
+	return 0;
+}
+
+// Times every kernel of the apply engine on random pixels
+static int BenchmarkKernels(int argc, wchar_t* argv[])
+{
+	const wchar_t* lutFile = nullptr;
+	size_t pixelCount = 1 << 18;
+
+	for (int i = 2; i < argc; ++i)
+	{
+		if (wcsncmp(argv[i], L"--pixels=", 9) == 0)
+		{
+			wchar_t* end;
+			pixelCount = wcstoul(argv[i] + 9, &end, 10);
+			if (*end || pixelCount == 0)
 			{
-				lo = k;
+				std::cerr << "Pixel count must be a positive number." << std::endl;
+				return -1;
 			}
 		}
+		else if (!lutFile)
+		{
+			lutFile = argv[i];
+		}
+	}
 
-		float xhi = m_Curve[hi].first;
-		float xlo = m_Curve[lo].first;
-		float yhi = m_Curve[hi].second;
-		float ylo = m_Curve[lo].second;
-		float y2hi = m_Y2[hi];
-		float y2lo = m_Y2[lo];
-
-		float h = xhi - xlo;
-		if (h == 0) throw "Not a curve!";
+	if (!lutFile)
+	{
+		std::cerr << "A LUT (ACV or DDS) file is required." << std::endl;
+		return -1;
+	}
 
-		float a = (xhi - x) / h;
-		float b = (x - xlo) / h;
-		float y = a*ylo + b*yhi + ((a*a*a - a)*y2lo + (b*b*b - b)*y2hi)*h*h/6.0f;
-		return y;
+	Lut3D lut;
+	if (!LoadLut(lutFile, lut))
+	{
+		return -2;
 	}
 
-private:
-	CubicSpline(const CurvePoints& curve, std::vector<float>&& y2)
-		: m_Curve(curve)
-		, m_Y2(std::forward<std::vector<float>>(y2))
-	{}
+	PrintCpuLevel();
 
-private:
-	CurvePoints m_Curve;
-	std::vector<float> m_Y2;
-};
+	std::vector<BenchmarkResult> results;
+	RunKernelBenchmarks(lut, pixelCount, results);
+	PrintBenchmarkResults(results);
+	return 0;
+}
 
-static bool ReadACVFile(const wchar_t* filename, std::vector<CubicSpline>& outCubicSplines)
+// Grades PPM/PAM, TIFF or raw files through mapped windows, in place when no
+// output file is given
+static int ApplyToMappedFile(int argc, wchar_t* argv[])
 {
-	std::ifstream ifs(filename, std::ios_base::binary);
-	if (!ifs.good())
+	const wchar_t* lutFile = nullptr;
+	const wchar_t* inputFile = nullptr;
+	const wchar_t* outputFile = nullptr;
+	RawImageDesc raw = {};
+	bool isRaw = false;
+	LutFilter filter = LUT_FILTER_EXACT;
+	LutInterpolation interpolation = LUT_INTERPOLATION_TRILINEAR;
+	bool interpolate = false;
+
+	for (int i = 2; i < argc; ++i)
 	{
-		std::wcerr << L"Unable to open file: " << filename << std::endl;
-		return false;
+		if (wcsncmp(argv[i], L"--raw=", 6) == 0)
+		{
+			wchar_t formatName[16] = {};
+			raw.Offset = 0;
+			int fields = swscanf(argv[i] + 6, L"%ux%ux%15l[a-z0-9]+%llu", &raw.Width, &raw.Height, formatName, &raw.Offset);
+
+			// Format names are plain ASCII
+			std::string narrowName(formatName, formatName + wcslen(formatName));
+			if (fields < 3 || !ParseImageFormat(narrowName.c_str(), raw.Format))
+			{
+				std::cerr << "Raw layout must be given as WIDTHxHEIGHTxFORMAT[+OFFSET], FORMAT being rgb8, rgba8, rgb16, rgba16 or rgba16f" << std::endl;
+				return -1;
+			}
+			isRaw = true;
+		}
+		else if (wcsncmp(argv[i], L"--filter=", 9) == 0)
+		{
+			if (!ParseFilter(argv[i], filter))
+			{
+				return -1;
+			}
+		}
+		else if (wcsncmp(argv[i], L"--interpolation=", 16) == 0)
+		{
+			if (!ParseInterpolation(argv[i], interpolation))
+			{
+				return -1;
+			}
+			interpolate = true;
+		}
+		else if (wcsncmp(argv[i], L"--", 2) == 0)
+		{
+			std::cerr << "Unknown option: " << NarrowPath(argv[i]) << std::endl;
+			return -1;
+		}
+		else if (!lutFile)
+		{
+			lutFile = argv[i];
+		}
+		else if (!inputFile)
+		{
+			inputFile = argv[i];
+		}
+		else if (!outputFile)
+		{
+			outputFile = argv[i];
+		}
+	}
+
+	if (!lutFile || !inputFile)
+	{
+		std::cerr << "A LUT (ACV or DDS) file and an input image are required." << std::endl;
+		return -1;
 	}
 
-	unsigned short version;
-	READ_BIG_ENDIAN_USHORT(ifs, version);
+	Lut3D lut;
+	if (!LoadLut(lutFile, lut))
+	{
+		return -2;
+	}
 
-	if (version != 0x4)
+	LutApplier applier(lut, filter);
+	if (interpolate && !applier.SetInterpolation(interpolation))
 	{
-		std::cerr << "Unsupported ACV version - only version 4 is supported (cubic spline interpolation)." << std::endl;
-		return false;
+		return -1;
 	}
 
-	unsigned short curvesCount;
-	READ_BIG_ENDIAN_USHORT(ifs, curvesCount);
+	if (applier.IsIdentity())
+	{
+		std::cout << "The LUT is an identity." << std::endl;
+	}
 
-	for (short i = 0; i < curvesCount; ++i)
+	Stopwatch stopwatch;
+	if (!ApplyLutToMappedFile(applier, inputFile, outputFile, isRaw ? &raw : nullptr))
 	{
-		unsigned short curvePointsCount;
-		READ_BIG_ENDIAN_USHORT(ifs, curvePointsCount);
+		return -4;
+	}
 
-		CurvePoints curvePoints(curvePointsCount);
+	std::cout << "Graded in " << stopwatch.GetElapsedMilliseconds() << " ms" << std::endl;
+	return 0;
+}
 
-		for (int j = 0; j < curvePointsCount; ++j)
+// Packs every ACV and DDS file under a directory into one LutPack
+static int PackLuts(int argc, wchar_t* argv[])
+{
+	bool topLevelOnly = false;
+	for (int i = 4; i < argc; ++i)
+	{
+		if (std::wstring(argv[i]) != L"--top-level")
 		{
-			unsigned short x, y;
-			READ_BIG_ENDIAN_USHORT(ifs, y);
-			READ_BIG_ENDIAN_USHORT(ifs, x);
-
-			curvePoints[j]  = std::make_pair((float)x, (float)y);
+			std::cerr << "Unknown option: " << NarrowPath(argv[i]) << std::endl;
+			return -1;
 		}
+		topLevelOnly = true;
+	}
+
+	Stopwatch stopwatch;
+	LutPack pack;
+	if (!WriteLutPack(argv[2], argv[3], topLevelOnly) || !pack.Open(argv[2]))
+	{
+		return -4;
+	}
+
+	std::cout << "Packed " << pack.GetEntryCount() << " LUTs in " << stopwatch.GetElapsedMilliseconds() << " ms" << std::endl;
+	return 0;
+}
 
-		outCubicSplines.push_back(CubicSpline::InterpolateCubicSplineFromCurvePoints(curvePoints));
+// Lists the LUTs in a pack, timing how long opening it and finding them takes
+static int ListLutPack(const wchar_t* packFile)
+{
+	Stopwatch stopwatch;
+	LutPack pack;
+	if (!pack.Open(packFile))
+	{
+		return -2;
 	}
+	const double openTime = stopwatch.GetElapsedMilliseconds();
 
-	return true;
+	std::vector<std::string> names(pack.GetEntryCount());
+	for (size_t i = 0; i < pack.GetEntryCount(); ++i)
+	{
+		const LutPackEntry& entry = pack.GetEntry(i);
+		names[i] = pack.GetName(entry);
+		std::cout << names[i] << ": " << entry.Size << "^3, " << entry.DataSize << " bytes"
+			<< ((entry.Flags & LUT_PACK_TOP_LEVEL) ? " (top level)" : "") << std::endl;
+	}
+
+	stopwatch.Restart();
+	size_t found = 0;
+	for (size_t i = 0; i < names.size(); ++i)
+	{
+		found += pack.Find(names[i]) != nullptr;
+	}
+	const double findTime = stopwatch.GetElapsedMilliseconds();
+
+	std::cout << "Opened " << pack.GetEntryCount() << " LUTs in " << openTime << " ms, found " << found << " by name in "
+		<< (names.empty() ? 0.0 : findTime * 1000.0 / names.size()) << " us each" << std::endl;
+	return 0;
 }
 
-int wmain(int argc, wchar_t* argv[])
+static int RunCommand(int argc, wchar_t* argv[])
 {
 	std::vector<CubicSpline> cubicSplines;
 
+	if (argc >= 5 && std::wstring(argv[1]) == L"apply")
+	{
+		LutFilter filter = LUT_FILTER_EXACT;
+		LutInterpolation interpolation = LUT_INTERPOLATION_TRILINEAR;
+		bool interpolate = false;
+		LutShaperKind shaperKind = LUT_SHAPER_NONE;
+		bool colourCache = false;
+		size_t cubeSize = 0;
+		bool lazy = false;
+		for (int i = 5; i < argc; ++i)
+		{
+			if (std::wstring(argv[i]) == L"--colour-cache")
+			{
+				colourCache = true;
+			}
+			else if (std::wstring(argv[i]) == L"--lazy")
+			{
+				lazy = true;
+			}
+			else if (wcsncmp(argv[i], L"--size=", 7) == 0)
+			{
+				cubeSize = wcstoul(argv[i] + 7, nullptr, 10);
+				if (cubeSize < 2 || cubeSize > 256)
+				{
+					std::cerr << "Cube size must be between 2 and 256." << std::endl;
+					return -1;
+				}
+			}
+			else if (wcsncmp(argv[i], L"--interpolation=", 16) == 0)
+			{
+				if (!ParseInterpolation(argv[i], interpolation))
+				{
+					return -1;
+				}
+				interpolate = true;
+			}
+			else if (wcsncmp(argv[i], L"--shaper=", 9) == 0)
+			{
+				if (!ParseShaper(argv[i], shaperKind))
+				{
+					return -1;
+				}
+			}
+			else if (wcsncmp(argv[i], L"--filter=", 9) == 0)
+			{
+				if (!ParseFilter(argv[i], filter))
+				{
+					return -1;
+				}
+			}
+			else
+			{
+				std::cerr << "Unknown option: " << NarrowPath(argv[i]) << std::endl;
+				return -1;
+			}
+		}
+		if (filter == LUT_FILTER_D3D11 && shaperKind != LUT_SHAPER_NONE)
+		{
+			std::cerr << "The d3d11 filter samples like the viewer, which has no shaper." << std::endl;
+			return -1;
+		}
+		return ApplyToImage(argv[2], argv[3], argv[4], filter, interpolate ? &interpolation : nullptr, shaperKind, colourCache, cubeSize, lazy);
+	}
+
+	if (argc >= 3 && std::wstring(argv[1]) == L"daemon")
+	{
+		return RunDaemon(argc, argv);
+	}
+
+	if (argc >= 4 && std::wstring(argv[1]) == L"client")
+	{
+		return RunClient(argc, argv);
+	}
+
+	if (argc == 5 && std::wstring(argv[1]) == L"grade")
+	{
+		return GradeImage(argv[2], argv[3], argv[4]);
+	}
+
+	if (argc >= 4 && std::wstring(argv[1]) == L"apply-mapped")
+	{
+		return ApplyToMappedFile(argc, argv);
+	}
+
+	if (argc >= 5 && std::wstring(argv[1]) == L"preview")
+	{
+		return PreviewLooks(argc, argv);
+	}
+
+	if (argc >= 4 && std::wstring(argv[1]) == L"bench-layout")
+	{
+		return BenchmarkLayouts(argc, argv);
+	}
+
+	if (argc >= 3 && std::wstring(argv[1]) == L"bench-kernels")
+	{
+		return BenchmarkKernels(argc, argv);
+	}
+
+	if (argc >= 3 && std::wstring(argv[1]) == L"bench")
+	{
+		return RunPipelineBenchmarkCommand(argc - 2, argv + 2);
+	}
+
+	if (argc >= 3 && std::wstring(argv[1]) == L"size")
+	{
+		return SizeLuts(argc, argv);
+	}
+
+	if (argc >= 4 && std::wstring(argv[1]) == L"compose")
+	{
+		return ComposeLuts(argc, argv);
+	}
+
+	if (argc >= 4 && std::wstring(argv[1]) == L"bake")
+	{
+		return BakeLutOutputs(argc, argv);
+	}
+
+	if (argc >= 4 && std::wstring(argv[1]) == L"pack")
+	{
+		return PackLuts(argc, argv);
+	}
+
+	if (argc == 3 && std::wstring(argv[1]) == L"pack-list")
+	{
+		return ListLutPack(argv[2]);
+	}
+
 	if (argc != 3)
 	{
-		std::cout << "Usage: " << argv[0] << " acv_filename output_filename" << std::endl;
+		std::wcout << L"Usage: " << argv[0] << L" acv_filename output_filename" << std::endl;
+		std::wcout << L"       " << argv[0] << L" apply lut_filename input_image output_image [--filter=exact|d3d11] [--interpolation=nearest|trilinear|tetrahedral] [--shaper=log|pq|fitted] [--colour-cache] [--size=N] [--lazy]" << std::endl;
+		std::wcout << L"       " << argv[0] << L" grade acv_filename input_image output_image" << std::endl;
+		std::wcout << L"       " << argv[0] << L" apply-mapped lut_filename input_file [output_file] [--raw=WxHxFORMAT[+OFFSET]] [--filter=exact|d3d11] [--interpolation=...]" << std::endl;
+		std::wcout << L"       " << argv[0] << L" compose output_dds lut_filename... [--size=N|auto] [size options]" << std::endl;
+		std::wcout << L"       " << argv[0] << L" bake output_prefix lut_filename... [--sizes=16,32,64] [--formats=dds,cube] [--shaper=log|pq|fitted]" << std::endl;
+		std::wcout << L"       " << argv[0] << L" size lut_filename_or_directory... [--bits=8|10] [--max-error=1] [--mean-error=0.25] [--interpolation=trilinear|tetrahedral] [--max-size=65] [--shaper=log|pq|fitted]" << std::endl;
+		std::wcout << L"       " << argv[0] << L" preview input_image output_prefix lut_filename..." << std::endl;
+		std::wcout << L"       " << argv[0] << L" bench-layout lut_filename input_image [--sizes=17,33,65,129]" << std::endl;
+		std::wcout << L"       " << argv[0] << L" bench-kernels lut_filename [--pixels=N]" << std::endl;
+		std::wcout << L"       " << argv[0] << L" bench corpus_directory_or_file... [--json=results.json] [--warmup=2] [--runs=10] [--pin=0|none]" << std::endl;
+		std::wcout << L"       " << argv[0] << L" daemon socket_path [--cache-mb=256] [--workers=N]" << std::endl;
+		std::wcout << L"       " << argv[0] << L" client socket_path ping|convert|apply|grade|shutdown [arguments...]" << std::endl;
+		std::wcout << L"       " << argv[0] << L" client socket_path frames lut_filename [--size=WxH] [--count=N] [--format=rgba8]" << std::endl;
+		std::wcout << L"       " << argv[0] << L" pack output_lutpack directory [--top-level]" << std::endl;
+		std::wcout << L"       " << argv[0] << L" pack-list lutpack_filename" << std::endl;
+		std::wcout << L"LUT files are ACV curves or DDS volumes, or LUTs in a pack named like library.lutpack/Vintage.acv." << std::endl;
+		std::wcout << L"--shaper puts a 1D shaper in front of the cube; DDS volumes keep it next to them in a .shaper.dds file, .cube files in their 1D table." << std::endl;
+		std::wcout << L"--colour-cache reuses the graded colours of images with few of them, such as screenshots and posterized art." << std::endl;
+		std::wcout << L"--cpu=scalar|sse2|sse4.1|avx2|avx512 (or ACVTOLUT_CPU) caps the SIMD kernels, for testing." << std::endl;
+		std::wcout << L"--trace=FILE records a timeline of every stage and request that chrome://tracing or Perfetto opens." << std::endl;
+		std::wcout << L"--stats[=json[:FILE]] reports the time each stage took, bytes read and written, spline evaluations, cache hits and peak memory, on stderr or in FILE." << std::endl;
 		return -1;
 	}
 
@@ -205,24 +1391,82 @@ int wmain(int argc, wchar_t* argv[])
 
 	D3DXVolumeTextureSaver saver;
 
-	const size_t CUBE_SIZE = 16;
-	std::vector<float> red(CUBE_SIZE);
-	std::vector<float> green(CUBE_SIZE);
-	std::vector<float> blue(CUBE_SIZE);
+	std::vector<float> red, green, blue;
+	BakeCurveTables(cubicSplines, DEFAULT_CUBE_SIZE, red, green, blue);
+
+	saver.SaveToVolumeTexture(red, green, blue, argv[2]);
+	return 0;
+}
+
+static bool WriteStatsFile(const wchar_t* path, const std::string& text)
+{
+	FILE* file = OpenNativeFile(path, "wb");
+	if (!file)
+	{
+		std::cerr << "Unable to create file: " << NarrowPath(path) << std::endl;
+		return false;
+	}
+	const bool ok = fwrite(text.data(), 1, text.size(), file) == text.size();
+	if (fclose(file) != 0 || !ok)
+	{
+		std::cerr << "Unable to write file: " << NarrowPath(path) << std::endl;
+		return false;
+	}
+	return true;
+}
+
+int wmain(int argc, wchar_t* argv[])
+{
+	// Kernels are picked against the level from here on
+	GetCpuLevel();
+	StatsOutput stats;
+	const wchar_t* statsPath;
+	if (!TakeCpuOption(argc, argv) || !TakeStatsOption(argc, argv, stats, statsPath))
+	{
+		return -1;
+	}
+
+	if (stats != STATS_NONE)
+	{
+		EnablePipelineStats();
+	}
 
-	for (size_t i = 0; i < CUBE_SIZE; ++i)
+	const wchar_t* tracePath = TakeTraceOption(argc, argv);
+	if (tracePath)
 	{
-		float input = (float)i / (float)(CUBE_SIZE - 1);
-		float input255 = input * 255.0f;
+		StartTrace();
+		SetTraceThreadName("main");
+	}
+
+	const int result = RunCommand(argc, argv);
 
-		float redValue   = clamp(cubicSplines[1].ComputeAtPoint(input255), 0.0f, 255.0f);
-		float greenValue = clamp(cubicSplines[2].ComputeAtPoint(input255), 0.0f, 255.0f);
-		float blueValue  = clamp(cubicSplines[3].ComputeAtPoint(input255), 0.0f, 255.0f);
+	if (stats != STATS_NONE)
+	{
+		PipelineStats pipelineStats;
+		GetPipelineStats(pipelineStats);
+		std::ostringstream text;
+		if (stats == STATS_JSON)
+		{
+			WritePipelineStatsJson(text, pipelineStats);
+		}
+		else
+		{
+			PrintPipelineStats(text, pipelineStats);
+		}
 
-		red[i]   = saturate(cubicSplines[0].ComputeAtPoint(redValue) / 255.0f);
-		green[i] = saturate(cubicSplines[0].ComputeAtPoint(greenValue) / 255.0f);
-		blue[i]  = saturate(cubicSplines[0].ComputeAtPoint(blueValue) / 255.0f);
+		if (!statsPath)
+		{
+			std::cerr << text.str();
+		}
+		else if (!WriteStatsFile(statsPath, text.str()))
+		{
+			return -4;
+		}
 	}
 
-	saver.SaveToVolumeTexture(red, green, blue, argv[2]);
+	if (tracePath && !WriteTrace(tracePath))
+	{
+		return -4;
+	}
+	return result;
 }
\ No newline at end of file
@@ -0,0 +1,116 @@
+#include "Test.h"
+#include "LutBatchApplier.h"
+#include "LutApplier.h"
+#include "Image.h"
+
+namespace
+{
+
+const size_t PIXEL_COUNT = 3001; // a few tiles and a partial one
+
+std::vector<unsigned char> MakePixels(size_t size)
+{
+	std::vector<unsigned char> pixels(size);
+	for (size_t i = 0; i < pixels.size(); ++i)
+	{
+		pixels[i] = (unsigned char)((i * 2654435761u) >> 13);
+	}
+	return pixels;
+}
+
+// Cubes of two sizes, two sharing one, a separable cube and an identity
+std::vector<Lut3D> MakeLuts()
+{
+	std::vector<float> tables[3];
+	std::vector<float> ramp;
+	for (size_t i = 0; i < 9; ++i)
+	{
+		const float x = i / 8.0f;
+		ramp.push_back(x);
+		for (int c = 0; c < 3; ++c)
+		{
+			tables[c].push_back(x * x * (1.0f + c * 0.3f) / (1.0f + c * 0.3f * x));
+		}
+	}
+
+	std::vector<Lut3D> luts;
+	luts.push_back(MakeTestCube(17, 21));
+	luts.push_back(MakeTestCube(9, 22));
+	luts.push_back(Lut3D::FromSeparableTables(tables[0], tables[1], tables[2]));
+	luts.push_back(MakeTestCube(17, 23));
+	luts.push_back(Lut3D::FromSeparableTables(ramp, ramp, ramp));
+	return luts;
+}
+
+std::vector<const Lut3D*> GetPointers(const std::vector<Lut3D>& luts)
+{
+	std::vector<const Lut3D*> pointers;
+	for (size_t i = 0; i < luts.size(); ++i)
+	{
+		pointers.push_back(&luts[i]);
+	}
+	return pointers;
+}
+
+} // namespace
+
+// Every output of the batch is what grading with its LUT alone gives, to the
+// bit, with alpha copied
+TEST(BatchApplierMatchesSeparateApplies)
+{
+	const std::vector<Lut3D> luts = MakeLuts();
+	const LutBatchApplier batch(GetPointers(luts));
+	CHECK(batch.GetLutCount() == luts.size());
+
+	for (unsigned channels = 3; channels <= 4; ++channels)
+	{
+		const std::vector<unsigned char> pixels = MakePixels(PIXEL_COUNT * channels);
+		std::vector<std::vector<unsigned char>> graded(luts.size(), std::vector<unsigned char>(pixels.size()));
+		std::vector<unsigned char*> outputs;
+		for (size_t k = 0; k < luts.size(); ++k)
+		{
+			outputs.push_back(&graded[k][0]);
+		}
+		batch.ApplyInterleaved(&pixels[0], PIXEL_COUNT, channels, &outputs[0]);
+
+		for (size_t k = 0; k < luts.size(); ++k)
+		{
+			LutApplier applier(luts[k]);
+			applier.SetColourCache(false);
+			std::vector<unsigned char> expected(pixels.size());
+			applier.ApplyInterleaved(&pixels[0], &expected[0], PIXEL_COUNT, channels);
+			CHECK(graded[k] == expected);
+		}
+	}
+}
+
+// Images of the formats the batch does not take go through LutApplier
+TEST(BatchApplierGradesWideImages)
+{
+	const std::vector<Lut3D> luts = MakeLuts();
+	const LutBatchApplier batch(GetPointers(luts));
+	const unsigned width = 37;
+	const unsigned height = 23;
+
+	Image source;
+	CHECK(source.Allocate(width, height, IMAGE_FORMAT_RGBA16, IMAGE_LAYOUT_INTERLEAVED));
+	const std::vector<unsigned char> pixels = MakePixels(width * source.GetPixelSize());
+	for (unsigned y = 0; y < height; ++y)
+	{
+		source.StoreRow(y, &pixels[0]);
+	}
+
+	std::vector<Image> outputs;
+	batch.Apply(source, outputs);
+	CHECK(outputs.size() == luts.size());
+	for (size_t k = 0; k < outputs.size() && k < luts.size(); ++k)
+	{
+		Image expected = source;
+		LutApplier(luts[k]).Apply(expected);
+		for (unsigned y = 0; y < height; ++y)
+		{
+			CHECK(std::vector<unsigned char>(outputs[k].GetRow(y), outputs[k].GetRow(y) + width * 8) ==
+				std::vector<unsigned char>(expected.GetRow(y), expected.GetRow(y) + width * 8));
+		}
+	}
+}
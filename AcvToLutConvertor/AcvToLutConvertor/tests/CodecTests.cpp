@@ -0,0 +1,145 @@
+#include "Test.h"
+#include "ImageCodecs.h"
+#include "Deflate.h"
+#include <cstring>
+
+namespace
+{
+
+Image MakeTestImage(unsigned width, unsigned height, ImageFormat format)
+{
+	Image image;
+	image.Allocate(width, height, format, IMAGE_LAYOUT_INTERLEAVED);
+	for (unsigned y = 0; y < height; ++y)
+	{
+		unsigned char* row = image.GetRow(y);
+		for (size_t i = 0; i < width * image.GetPixelSize(); ++i)
+		{
+			row[i] = (unsigned char)(i * 31 + y * 17 + (i >> 3));
+		}
+	}
+	return image;
+}
+
+bool HaveSamePixels(const Image& a, const Image& b)
+{
+	if (a.GetWidth() != b.GetWidth() || a.GetHeight() != b.GetHeight() || a.GetFormat() != b.GetFormat())
+	{
+		return false;
+	}
+
+	std::vector<unsigned char> rowA(a.GetWidth() * a.GetPixelSize());
+	std::vector<unsigned char> rowB(rowA.size());
+	for (unsigned y = 0; y < a.GetHeight(); ++y)
+	{
+		a.LoadRow(y, &rowA[0]);
+		b.LoadRow(y, &rowB[0]);
+		if (rowA != rowB)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool RoundTrips(const char* name, ImageFormat format, ImageLayout layout)
+{
+	// Odd widths leave BMP rows padded
+	const Image image = MakeTestImage(7, 5, format);
+	const PathString path = GetScratchPath(name);
+	Image read;
+	return WriteImage(path.c_str(), image) && ReadImage(path.c_str(), read, layout) &&
+		read.GetLayout() == layout && HaveSamePixels(image, read);
+}
+
+// A 1x1 PNG with other dimensions written into its header, CRC and all
+std::vector<unsigned char> MakePngWithDimensions(unsigned width, unsigned height)
+{
+	const PathString path = GetScratchPath("pixel.png");
+	WriteImage(path.c_str(), MakeTestImage(1, 1, IMAGE_FORMAT_RGB8));
+
+	std::vector<unsigned char> data;
+	FILE* file = OpenNativeFile(path.c_str(), "rb");
+	unsigned char buffer[4096];
+	size_t read;
+	while (file && (read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+	{
+		data.insert(data.end(), buffer, buffer + read);
+	}
+	if (file)
+	{
+		fclose(file);
+	}
+
+	// Signature, then the IHDR length and type, its 13 bytes and its CRC
+	const unsigned dimensions[2] = { width, height };
+	for (int i = 0; i < 2; ++i)
+	{
+		for (int b = 0; b < 4; ++b)
+		{
+			data[16 + i * 4 + b] = (unsigned char)(dimensions[i] >> (24 - b * 8));
+		}
+	}
+	const unsigned crc = UpdateCrc32(0, &data[12], 17);
+	for (int b = 0; b < 4; ++b)
+	{
+		data[29 + b] = (unsigned char)(crc >> (24 - b * 8));
+	}
+	return data;
+}
+
+bool Reads(const char* name, const void* data, size_t size)
+{
+	const PathString path = GetScratchPath(name);
+	Image image;
+	return WriteTestFile(path.c_str(), data, size) && ReadImage(path.c_str(), image, IMAGE_LAYOUT_INTERLEAVED);
+}
+
+bool Reads(const char* name, const char* text)
+{
+	return Reads(name, text, strlen(text));
+}
+
+} // namespace
+
+TEST(CodecsRoundTripPnm)
+{
+	CHECK(RoundTrips("rgb8.ppm", IMAGE_FORMAT_RGB8, IMAGE_LAYOUT_INTERLEAVED));
+	CHECK(RoundTrips("rgb16.ppm", IMAGE_FORMAT_RGB16, IMAGE_LAYOUT_INTERLEAVED));
+	CHECK(RoundTrips("rgba8.pam", IMAGE_FORMAT_RGBA8, IMAGE_LAYOUT_INTERLEAVED));
+	CHECK(RoundTrips("rgba16.pam", IMAGE_FORMAT_RGBA16, IMAGE_LAYOUT_PLANAR));
+}
+
+TEST(CodecsRoundTripBmpAndTga)
+{
+	CHECK(RoundTrips("rgb8.bmp", IMAGE_FORMAT_RGB8, IMAGE_LAYOUT_INTERLEAVED));
+	CHECK(RoundTrips("rgba8.bmp", IMAGE_FORMAT_RGBA8, IMAGE_LAYOUT_PLANAR));
+	CHECK(RoundTrips("rgb8.tga", IMAGE_FORMAT_RGB8, IMAGE_LAYOUT_PLANAR));
+	CHECK(RoundTrips("rgba8.tga", IMAGE_FORMAT_RGBA8, IMAGE_LAYOUT_INTERLEAVED));
+}
+
+TEST(CodecsRoundTripPng)
+{
+	CHECK(RoundTrips("rgb8.png", IMAGE_FORMAT_RGB8, IMAGE_LAYOUT_INTERLEAVED));
+	CHECK(RoundTrips("rgba8.png", IMAGE_FORMAT_RGBA8, IMAGE_LAYOUT_PLANAR));
+	CHECK(RoundTrips("rgb16.png", IMAGE_FORMAT_RGB16, IMAGE_LAYOUT_PLANAR));
+	CHECK(RoundTrips("rgba16.png", IMAGE_FORMAT_RGBA16, IMAGE_LAYOUT_INTERLEAVED));
+}
+
+// Images with no pixels, or more than could be allocated, are refused from
+// their headers
+TEST(CodecsRejectBadDimensions)
+{
+	CHECK(Reads("good.ppm", "P6\n1 1\n255\nabc"));
+	CHECK(!Reads("zero-width.ppm", "P6\n0 4\n255\n"));
+	CHECK(!Reads("zero-height.pgm", "P5\n4 0\n255\n"));
+	CHECK(!Reads("huge.ppm", "P6\n100000 100000\n255\n"));
+	CHECK(!Reads("huge.pam", "P7\nWIDTH 70000\nHEIGHT 2\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\nENDHDR\n"));
+
+	const std::vector<unsigned char> good = MakePngWithDimensions(1, 1);
+	const std::vector<unsigned char> zero = MakePngWithDimensions(0, 1);
+	const std::vector<unsigned char> huge = MakePngWithDimensions(60000, 60000);
+	CHECK(Reads("good.png", &good[0], good.size()));
+	CHECK(!Reads("zero.png", &zero[0], zero.size()));
+	CHECK(!Reads("huge.png", &huge[0], huge.size()));
+}
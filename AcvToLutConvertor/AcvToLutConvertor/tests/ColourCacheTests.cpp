@@ -0,0 +1,92 @@
+#include "Test.h"
+#include "LutApplier.h"
+#include "PipelineStats.h"
+#include "Half.h"
+
+namespace
+{
+
+const unsigned WIDTH = 320;
+const unsigned HEIGHT = 300; // more than one tile of the cache
+
+// Rows from firstNoisyRow down are noise; the ones above hold a few dozen
+// colours
+Image MakeImage(ImageFormat format, unsigned firstNoisyRow)
+{
+	Image image;
+	CHECK(image.Allocate(WIDTH, HEIGHT, format, IMAGE_LAYOUT_INTERLEAVED));
+	const unsigned channels = image.GetChannelCount();
+	for (unsigned y = 0; y < HEIGHT; ++y)
+	{
+		unsigned char* row = image.GetRow(y);
+		unsigned short* row16 = reinterpret_cast<unsigned short*>(row);
+		for (unsigned i = 0; i < WIDTH * channels; ++i)
+		{
+			const unsigned hash = (y * WIDTH * channels + i) * 2654435761u;
+			const unsigned level = y < firstNoisyRow ? (i / channels / 10 + y / 40 * 3 + i % channels) % 4 * 85 : hash >> 24;
+			if (GetBytesPerChannel(format) == 1)
+			{
+				row[i] = (unsigned char)level;
+			}
+			else
+			{
+				row16[i] = format == IMAGE_FORMAT_RGBA16F ? FloatToHalf(level / 255.0f) : (unsigned short)(level * 257 + (y < firstNoisyRow ? 0 : hash & 0xFF));
+			}
+		}
+	}
+	return image;
+}
+
+bool IsSameImage(const Image& a, const Image& b)
+{
+	bool same = true;
+	for (unsigned y = 0; y < HEIGHT; ++y)
+	{
+		same &= std::vector<unsigned char>(a.GetRow(y), a.GetRow(y) + a.GetRowPitch()) ==
+			std::vector<unsigned char>(b.GetRow(y), b.GetRow(y) + b.GetRowPitch());
+	}
+	return same;
+}
+
+unsigned long long GetColourCacheHits()
+{
+	PipelineStats stats;
+	GetPipelineStats(stats);
+	return stats.Counters[PIPELINE_COUNTER_COLOUR_CACHE_HITS];
+}
+
+} // namespace
+
+// With the cache on, images come out the same to the bit, whether it keeps
+// finding their colours, gives up after the first tiles or never pays
+TEST(ColourCacheMatchesUncached)
+{
+	EnablePipelineStats();
+	const Lut3D lut = MakeTestCube(17, 80);
+	const ImageFormat formats[] = { IMAGE_FORMAT_RGB8, IMAGE_FORMAT_RGBA8, IMAGE_FORMAT_RGB16, IMAGE_FORMAT_RGBA16, IMAGE_FORMAT_RGBA16F };
+	const LutInterpolation interpolations[] = { LUT_INTERPOLATION_TRILINEAR, LUT_INTERPOLATION_TETRAHEDRAL };
+	const unsigned noisyRows[] = { HEIGHT, 250, 0 };
+
+	for (size_t f = 0; f < sizeof(formats) / sizeof(formats[0]); ++f)
+	{
+		for (size_t i = 0; i < 2; ++i)
+		{
+			LutApplier applier(lut);
+			CHECK(applier.SetInterpolation(interpolations[i]));
+			for (size_t n = 0; n < 3; ++n)
+			{
+				const Image original = MakeImage(formats[f], noisyRows[n]);
+				Image uncached = original;
+				applier.SetColourCache(false);
+				applier.Apply(uncached);
+
+				Image cached = original;
+				applier.SetColourCache(true);
+				const unsigned long long hits = GetColourCacheHits();
+				applier.Apply(cached);
+				CHECK(IsSameImage(cached, uncached));
+				CHECK(n == 2 || GetColourCacheHits() - hits > (unsigned long long)WIDTH * 200);
+			}
+		}
+	}
+}
@@ -0,0 +1,39 @@
+#include "Test.h"
+#include "CubeSizing.h"
+
+namespace
+{
+
+bool IsWithin(const CubeSizeError& error, const CubeSizeCriteria& criteria)
+{
+	return error.MaxError <= criteria.MaxError && error.MeanError <= criteria.MeanError;
+}
+
+} // namespace
+
+// The size picked is the smallest within budget: capped one below it, the
+// search fails and reports the errors of the largest size it was allowed
+TEST(CubeSizingPicksSmallestWithinBudget)
+{
+	const PathString path = GetScratchPath("sizing.acv");
+	CHECK(WriteAcvFile(path.c_str(), MakeTestCurves(12)));
+	LutChain chain;
+	CHECK(chain.AddFile(path.c_str()));
+
+	CubeSizeCriteria criteria;
+	CubeSizeError picked;
+	CHECK(SelectCubeSize(chain, criteria, picked));
+	CHECK(picked.Size > 2 && picked.Size <= criteria.MaxSize && IsWithin(picked, criteria));
+
+	criteria.MaxSize = picked.Size - 1;
+	CubeSizeError capped;
+	CHECK(!SelectCubeSize(chain, criteria, capped));
+	CHECK(capped.Size == criteria.MaxSize && !IsWithin(capped, criteria));
+
+	// Tighter bounds never pick a smaller cube
+	criteria = CubeSizeCriteria();
+	criteria.MaxError = 0.5;
+	criteria.MeanError = 0.1;
+	CubeSizeError tight;
+	CHECK(!SelectCubeSize(chain, criteria, tight) || tight.Size >= picked.Size);
+}
@@ -0,0 +1,129 @@
+#include "Test.h"
+#include "CurveGrader.h"
+#include "LutApplier.h"
+#include "LutChain.h"
+#include "Half.h"
+#include <cmath>
+
+namespace
+{
+
+const size_t PIXEL_COUNT = 1001;
+
+std::vector<CubicSpline> MakeTestSplines(unsigned seed)
+{
+	const std::vector<CurvePoints> curves = MakeTestCurves(seed);
+	std::vector<CubicSpline> splines;
+	for (size_t i = 0; i < curves.size(); ++i)
+	{
+		splines.push_back(CubicSpline::InterpolateCubicSplineFromCurvePoints(curves[i]));
+	}
+	return splines;
+}
+
+// Samples of a format as bytes, half floats within [0, 1]
+std::vector<unsigned char> MakeSamples(ImageFormat format, size_t count)
+{
+	std::vector<unsigned char> bytes(count * GetChannelCount(format) * GetBytesPerChannel(format));
+	unsigned short* samples = reinterpret_cast<unsigned short*>(&bytes[0]);
+	for (size_t i = 0; i < bytes.size() / GetBytesPerChannel(format); ++i)
+	{
+		const unsigned hash = (unsigned)(i * 2654435761u);
+		if (GetBytesPerChannel(format) == 1)
+		{
+			bytes[i] = (unsigned char)(hash >> 13);
+		}
+		else
+		{
+			samples[i] = format == IMAGE_FORMAT_RGBA16F ? FloatToHalf((float)(hash >> 8) / (1 << 24)) : (unsigned short)(hash >> 11);
+		}
+	}
+	return bytes;
+}
+
+unsigned ToLevel(float value, float scale)
+{
+	const float scaled = value * scale + 0.5f;
+	return scaled <= 0.0f ? 0 : (scaled >= scale ? (unsigned)scale : (unsigned)scaled);
+}
+
+// The curves evaluated for one sample, in the sample's encoding
+unsigned GradeSample(const std::vector<CubicSpline>& splines, ImageFormat format, int channel, unsigned sample)
+{
+	if (format == IMAGE_FORMAT_RGBA16F)
+	{
+		return FloatToHalf(EvaluateCurves(splines, channel, HalfToFloat((unsigned short)sample)));
+	}
+	const float scale = GetBytesPerChannel(format) == 1 ? 255.0f : 65535.0f;
+	return ToLevel(EvaluateCurves(splines, channel, sample / scale), scale);
+}
+
+unsigned GetSample(const std::vector<unsigned char>& bytes, ImageFormat format, size_t index)
+{
+	return GetBytesPerChannel(format) == 1 ? bytes[index] : reinterpret_cast<const unsigned short*>(&bytes[0])[index];
+}
+
+} // namespace
+
+// Every sample comes out as the curves give it, rounded once to its encoding;
+// alpha is left alone
+TEST(CurveGraderMatchesCurves)
+{
+	const std::vector<CubicSpline> splines = MakeTestSplines(16);
+	const ImageFormat formats[] = { IMAGE_FORMAT_RGB8, IMAGE_FORMAT_RGBA8, IMAGE_FORMAT_RGB16, IMAGE_FORMAT_RGBA16, IMAGE_FORMAT_RGBA16F };
+	for (size_t f = 0; f < sizeof(formats) / sizeof(formats[0]); ++f)
+	{
+		const ImageFormat format = formats[f];
+		const unsigned channels = GetChannelCount(format);
+		const std::vector<unsigned char> pixels = MakeSamples(format, PIXEL_COUNT);
+		std::vector<unsigned char> graded(pixels.size());
+		const CurveGrader grader(splines, format);
+		grader.Apply(&pixels[0], &graded[0], format, PIXEL_COUNT);
+
+		bool matches = true;
+		for (size_t i = 0; i < PIXEL_COUNT * channels; ++i)
+		{
+			const int channel = (int)(i % channels);
+			const unsigned sample = GetSample(pixels, format, i);
+			matches &= GetSample(graded, format, i) == (channel < 3 ? GradeSample(splines, format, channel, sample) : sample);
+		}
+		CHECK(matches);
+	}
+}
+
+// In 8 bits, grading is what applying a bake with a texel for every level
+// gives, and planar images grade like interleaved ones
+TEST(CurveGraderMatchesFullBake)
+{
+	const std::vector<CubicSpline> splines = MakeTestSplines(17);
+	LutChain chain;
+	chain.AddCurves(splines);
+	const LutApplier applier(chain.Bake(256));
+	const CurveGrader grader(splines, IMAGE_FORMAT_RGB8);
+
+	const unsigned width = 61;
+	const unsigned height = 17;
+	const std::vector<unsigned char> pixels = MakeSamples(IMAGE_FORMAT_RGB8, width * height);
+	Image interleaved;
+	Image planar;
+	CHECK(interleaved.Allocate(width, height, IMAGE_FORMAT_RGB8, IMAGE_LAYOUT_INTERLEAVED));
+	CHECK(planar.Allocate(width, height, IMAGE_FORMAT_RGB8, IMAGE_LAYOUT_PLANAR));
+	for (unsigned y = 0; y < height; ++y)
+	{
+		interleaved.StoreRow(y, &pixels[y * width * 3]);
+		planar.StoreRow(y, &pixels[y * width * 3]);
+	}
+	Image baked = interleaved;
+	applier.Apply(baked);
+	grader.Apply(interleaved);
+	grader.Apply(planar);
+
+	std::vector<unsigned char> row(width * 3);
+	for (unsigned y = 0; y < height; ++y)
+	{
+		const std::vector<unsigned char> expected(baked.GetRow(y), baked.GetRow(y) + width * 3);
+		CHECK(std::vector<unsigned char>(interleaved.GetRow(y), interleaved.GetRow(y) + width * 3) == expected);
+		planar.LoadRow(y, &row[0]);
+		CHECK(row == expected);
+	}
+}
@@ -0,0 +1,87 @@
+#include "Test.h"
+#include "CurveSet.h"
+#include "LutChain.h"
+
+namespace
+{
+
+const size_t CUBE_SIZE = 33;
+
+// The set's tables and cube against a bake of its points from scratch
+bool MatchesRebake(const CurveSet& set)
+{
+	std::vector<CubicSpline> splines;
+	for (size_t k = 0; k < 5; ++k)
+	{
+		splines.push_back(CubicSpline::InterpolateCubicSplineFromCurvePoints(set.GetPoints(k)));
+	}
+
+	std::vector<float> tables[3];
+	BakeCurveTables(splines, CUBE_SIZE, tables[0], tables[1], tables[2]);
+	for (int channel = 0; channel < 3; ++channel)
+	{
+		if (set.GetTable(channel) != tables[channel])
+		{
+			return false;
+		}
+	}
+
+	LutChain chain;
+	chain.AddCurves(splines);
+	return GetMaxDifference(set.GetCube(), chain.Bake(CUBE_SIZE)) == 0.0f;
+}
+
+} // namespace
+
+// Every kind of edit, patched in by Update, gives what baking the edited
+// curves does, to the bit
+TEST(CurveSetPatchesLikeRebake)
+{
+	CurveSet set(MakeTestCurves(1), CUBE_SIZE);
+	CHECK(MatchesRebake(set));
+	CHECK(set.Update() == 0);
+
+	// A channel curve: only its axis changes
+	CHECK(set.MoveKnot(2, 1, 70.0f, 90.0f));
+	CHECK(set.Update() > 0);
+	CHECK(set.GetChangedEntries(0).empty() && set.GetChangedEntries(2).empty());
+	CHECK(!set.GetChangedEntries(1).empty());
+	CHECK(MatchesRebake(set));
+
+	// The composite curve reaches every channel
+	CHECK(set.InsertKnot(0, 128.0f, 150.0f));
+	CHECK(set.Update() > 0);
+	CHECK(MatchesRebake(set));
+
+	CHECK(set.RemoveKnot(1, 1));
+	CHECK(set.MoveKnot(3, 2, 200.0f, 180.0f));
+	CHECK(set.Update() > 0);
+	CHECK(MatchesRebake(set));
+
+	// Back to an identity channel
+	CurvePoints identity;
+	identity.push_back(std::make_pair(0.0f, 0.0f));
+	identity.push_back(std::make_pair(255.0f, 255.0f));
+	CHECK(set.SetPoints(3, identity));
+	CHECK(set.Update() > 0);
+	CHECK(MatchesRebake(set));
+
+	// Alpha is read by nothing
+	CHECK(set.InsertKnot(4, 100.0f, 20.0f));
+	CHECK(set.Update() == 0);
+	CHECK(MatchesRebake(set));
+}
+
+TEST(CurveSetRefusesBadEdits)
+{
+	CurveSet set(MakeTestCurves(2), CUBE_SIZE);
+	const CurvePoints before = set.GetPoints(1);
+
+	CHECK(!set.MoveKnot(1, 1, 0.0f, 10.0f)); // onto the first knot's input
+	CHECK(!set.MoveKnot(1, 1, 300.0f, 10.0f));
+	CHECK(!set.InsertKnot(1, 64.0f, 10.0f)); // an input already taken
+	CHECK(!set.RemoveKnot(4, 0)); // alpha has only two knots
+	CHECK(set.GetPoints(1) == before);
+	CHECK(set.Update() == 0);
+	CHECK(MatchesRebake(set));
+}
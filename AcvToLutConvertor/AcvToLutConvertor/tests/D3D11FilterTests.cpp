@@ -0,0 +1,125 @@
+#include "Test.h"
+#include "LutApplier.h"
+#include "CpuFeatures.h"
+
+namespace
+{
+
+unsigned ToLevel(float value, float scale)
+{
+	const float scaled = value * scale + 0.5f;
+	return scaled <= 0.0f ? 0 : (scaled >= scale ? (unsigned)scale : (unsigned)scaled);
+}
+
+// Inputs on a grid through every channel's range, both ends included
+template <typename Sample>
+std::vector<Sample> MakeGrid(unsigned steps, unsigned maximum)
+{
+	std::vector<Sample> pixels;
+	for (unsigned b = 0; b < steps; ++b)
+	{
+		for (unsigned g = 0; g < steps; ++g)
+		{
+			for (unsigned r = 0; r < steps; ++r)
+			{
+				pixels.push_back((Sample)(r * maximum / (steps - 1)));
+				pixels.push_back((Sample)(g * maximum / (steps - 1)));
+				pixels.push_back((Sample)(b * maximum / (steps - 1)));
+			}
+		}
+	}
+	return pixels;
+}
+
+// Every pixel graded with the D3D11 filter, in 8-bit and in 16-bit RGB, is
+// what Lut3D::SampleD3D11 gives for it, rounded to the output's levels
+void CheckAgainstSampler(const Lut3D& lut)
+{
+	LutApplier applier(lut, LUT_FILTER_D3D11);
+	applier.SetColourCache(false);
+	CHECK(applier.GetInterpolation() == LUT_INTERPOLATION_D3D11);
+
+	const std::vector<unsigned char> pixels8 = MakeGrid<unsigned char>(52, 255);
+	std::vector<unsigned char> graded8(pixels8.size());
+	applier.Apply(&pixels8[0], IMAGE_FORMAT_RGB8, &graded8[0], IMAGE_FORMAT_RGB8, pixels8.size() / 3);
+
+	const std::vector<unsigned short> pixels16 = MakeGrid<unsigned short>(29, 65535);
+	std::vector<unsigned short> graded16(pixels16.size());
+	applier.Apply(&pixels16[0], IMAGE_FORMAT_RGB16, &graded16[0], IMAGE_FORMAT_RGB16, pixels16.size() / 3);
+
+	bool matches = true;
+	for (size_t i = 0; i < pixels8.size(); i += 3)
+	{
+		float expected[3];
+		lut.SampleD3D11(pixels8[i] / 255.0f, pixels8[i + 1] / 255.0f, pixels8[i + 2] / 255.0f, expected);
+		for (int c = 0; c < 3; ++c)
+		{
+			matches &= graded8[i + c] == ToLevel(expected[c], 255.0f);
+		}
+	}
+	for (size_t i = 0; i < pixels16.size(); i += 3)
+	{
+		float expected[3];
+		lut.SampleD3D11(pixels16[i] / 65535.0f, pixels16[i + 1] / 65535.0f, pixels16[i + 2] / 65535.0f, expected);
+		for (int c = 0; c < 3; ++c)
+		{
+			matches &= graded16[i + c] == ToLevel(expected[c], 65535.0f);
+		}
+	}
+	CHECK(matches);
+}
+
+} // namespace
+
+// The sampler itself: texel centres at (i + 0.5) / size, so both ends of the
+// range clamp to the edge texels, read as 8-bit levels
+TEST(D3D11SamplerClampsToEdgeTexels)
+{
+	const Lut3D lut = MakeTestCube(17, 31);
+	for (int corner = 0; corner < 8; ++corner)
+	{
+		const size_t r = corner & 1 ? 16 : 0;
+		const size_t g = corner & 2 ? 16 : 0;
+		const size_t b = corner & 4 ? 16 : 0;
+		float out[3];
+		lut.SampleD3D11(r ? 1.0f : 0.0f, g ? 1.0f : 0.0f, b ? 1.0f : 0.0f, out);
+		for (int c = 0; c < 3; ++c)
+		{
+			CHECK(out[c] == ToTextureLevel(lut.GetTexel(r, g, b)[c]) / 255.0f);
+		}
+	}
+
+	// Half a texel in from the edge the first texel stops counting alone
+	float edge[3];
+	float inside[3];
+	lut.SampleD3D11(0.5f / 17, 0.0f, 0.0f, edge);
+	lut.SampleD3D11(1.5f / 17, 0.0f, 0.0f, inside);
+	CHECK(edge[0] == ToTextureLevel(lut.GetTexel(0, 0, 0)[0]) / 255.0f);
+	CHECK(inside[0] == ToTextureLevel(lut.GetTexel(1, 0, 0)[0]) / 255.0f);
+}
+
+// The applier's D3D11 filter against the sampler, for cubes of several sizes,
+// a separable cube, and on every SIMD level
+TEST(D3D11FilterMatchesSampler)
+{
+	std::vector<float> tables[3];
+	for (int c = 0; c < 3; ++c)
+	{
+		for (size_t i = 0; i < 17; ++i)
+		{
+			const float x = i / 16.0f;
+			tables[c].push_back(x * x * (1.0f + c * 0.3f) / (1.0f + c * 0.3f * x));
+		}
+	}
+
+	const CpuLevel previous = GetCpuLevel();
+	for (int level = CPU_LEVEL_SCALAR; level <= GetSupportedCpuLevel(); ++level)
+	{
+		CHECK(SetCpuLevel((CpuLevel)level));
+		CheckAgainstSampler(MakeTestCube(2, 32));
+		CheckAgainstSampler(MakeTestCube(17, 33));
+		CheckAgainstSampler(MakeTestCube(33, 34));
+		CheckAgainstSampler(Lut3D::FromSeparableTables(tables[0], tables[1], tables[2]));
+	}
+	SetCpuLevel(previous);
+}
@@ -0,0 +1,143 @@
+#include "Test.h"
+#include "DdsVolume.h"
+#include "PlanarLut3D.h"
+#include <cstring>
+
+namespace
+{
+
+// Header fields, from the start of the file
+const size_t DDS_DEPTH = 24;
+const size_t DDS_MIPMAPCOUNT = 28;
+const size_t DDS_PF_RMASK = 92;
+const size_t DDS_PF_GMASK = 96;
+const size_t DDS_PF_BMASK = 100;
+const size_t DDS_CAPS2 = 112;
+
+void PutUInt(std::vector<unsigned char>& bytes, size_t offset, unsigned value)
+{
+	for (int i = 0; i < 4; ++i)
+	{
+		bytes[offset + i] = (unsigned char)(value >> (i * 8));
+	}
+}
+
+unsigned GetUInt(const std::vector<unsigned char>& bytes, size_t offset)
+{
+	return bytes[offset] | ((unsigned)bytes[offset + 1] << 8) | ((unsigned)bytes[offset + 2] << 16) | ((unsigned)bytes[offset + 3] << 24);
+}
+
+// What a texel reads back as: its 8-bit level, scaled like the readers do
+float GetStoredValue(float value)
+{
+	return ToTextureLevel(value) * (1.0f / 255.0f);
+}
+
+bool ReadsBack(const char* name, const std::vector<unsigned char>& bytes, Lut3D& lut)
+{
+	const PathString path = GetScratchPath(name);
+	PlanarLut3D cube;
+	return WriteTestFile(path.c_str(), &bytes[0], bytes.size()) &&
+		ReadDdsVolume(path.c_str(), lut) && ReadDdsVolume(path.c_str(), cube, PLANAR_LUT_FLOAT);
+}
+
+} // namespace
+
+// A volume reads back as the 8-bit levels it was written in, the same from
+// both readers; unorm16 planes hold each level times 257, planes aligned
+TEST(DdsVolumeReadsBack)
+{
+	const Lut3D written = MakeTestCube(17, 41);
+	const PathString path = GetScratchPath("readback.dds");
+	CHECK(WriteDdsVolume(path.c_str(), written));
+
+	Lut3D lut;
+	PlanarLut3D floats;
+	PlanarLut3D unorms;
+	CHECK(ReadDdsVolume(path.c_str(), lut) && lut.GetSize() == 17);
+	CHECK(ReadDdsVolume(path.c_str(), floats, PLANAR_LUT_FLOAT) && floats.GetSize() == 17);
+	CHECK(ReadDdsVolume(path.c_str(), unorms, PLANAR_LUT_UNORM16) && unorms.GetSize() == 17);
+	if (lut.GetSize() != 17 || floats.GetSize() != 17 || unorms.GetSize() != 17)
+	{
+		return;
+	}
+
+	for (int c = 0; c < 3; ++c)
+	{
+		CHECK((size_t)floats.GetFloatPlane(c) % PlanarLut3D::ALIGNMENT == 0);
+		CHECK((size_t)unorms.GetUnorm16Plane(c) % PlanarLut3D::ALIGNMENT == 0);
+	}
+
+	bool matches = true;
+	for (size_t i = 0; i < 17 * 17 * 17; ++i)
+	{
+		for (int c = 0; c < 3; ++c)
+		{
+			const unsigned level = ToTextureLevel(written.GetTexel(0, 0, 0)[i * 3 + c]);
+			const float value = lut.GetTexel(0, 0, 0)[i * 3 + c];
+			matches &= value == level * (1.0f / 255.0f) && floats.GetFloatPlane(c)[i] == value;
+			matches &= unorms.GetUnorm16Plane(c)[i] == level * 257;
+		}
+	}
+	CHECK(matches);
+
+	Lut3D copied;
+	floats.CopyTo(copied);
+	CHECK(GetMaxDifference(copied, lut) == 0.0f);
+}
+
+// Channels are found through the masks, wherever they sit
+TEST(DdsVolumeFollowsChannelMasks)
+{
+	const Lut3D written = MakeTestCube(9, 42);
+	std::vector<unsigned char> bytes;
+	EncodeDdsVolume(written, bytes);
+	const unsigned red = GetUInt(bytes, DDS_PF_RMASK);
+	PutUInt(bytes, DDS_PF_RMASK, GetUInt(bytes, DDS_PF_BMASK));
+	PutUInt(bytes, DDS_PF_BMASK, red);
+
+	Lut3D swapped;
+	CHECK(ReadsBack("swapped.dds", bytes, swapped) && swapped.GetSize() == 9);
+	for (size_t i = 0; i < 9 * 9 * 9 && swapped.GetSize() == 9; ++i)
+	{
+		const float* texel = &written.GetTexel(0, 0, 0)[i * 3];
+		const float* read = &swapped.GetTexel(0, 0, 0)[i * 3];
+		CHECK(read[0] == GetStoredValue(texel[2]) && read[1] == GetStoredValue(texel[1]) && read[2] == GetStoredValue(texel[0]));
+	}
+}
+
+// Headers that do not describe a whole cube volume of 32-bit texels
+TEST(DdsVolumeRejectsMalformedFiles)
+{
+	std::vector<unsigned char> good;
+	EncodeDdsVolume(MakeTestCube(9, 43), good);
+	Lut3D lut;
+	CHECK(ReadsBack("good.dds", good, lut));
+
+	std::vector<unsigned char> bytes = good;
+	bytes.pop_back(); // the last mip level comes up short
+	CHECK(!ReadsBack("truncated.dds", bytes, lut));
+
+	bytes = good;
+	PutUInt(bytes, DDS_MIPMAPCOUNT, GetUInt(good, DDS_MIPMAPCOUNT) + 1);
+	CHECK(!ReadsBack("extra-mip.dds", bytes, lut));
+
+	bytes = good;
+	PutUInt(bytes, DDS_DEPTH, 8);
+	CHECK(!ReadsBack("not-cube.dds", bytes, lut));
+
+	bytes = good;
+	PutUInt(bytes, DDS_CAPS2, 0);
+	CHECK(!ReadsBack("not-volume.dds", bytes, lut));
+
+	bytes = good;
+	PutUInt(bytes, DDS_PF_GMASK, GetUInt(good, DDS_PF_RMASK) | 0x100);
+	CHECK(!ReadsBack("overlapping.dds", bytes, lut));
+
+	bytes = good;
+	PutUInt(bytes, DDS_PF_RMASK, 0x00F0000F);
+	CHECK(!ReadsBack("split.dds", bytes, lut));
+
+	bytes.assign(good.begin(), good.begin() + 64);
+	CHECK(!ReadsBack("short.dds", bytes, lut));
+}
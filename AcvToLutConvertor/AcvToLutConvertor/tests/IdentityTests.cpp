@@ -0,0 +1,109 @@
+#include "Test.h"
+#include "LutApplier.h"
+#include "DdsVolume.h"
+
+namespace
+{
+
+std::vector<float> MakeRamp(size_t size, size_t divisor)
+{
+	std::vector<float> ramp(size);
+	for (size_t i = 0; i < size; ++i)
+	{
+		ramp[i] = (float)i / (float)divisor;
+	}
+	return ramp;
+}
+
+Lut3D MakeIdentityCube(size_t size)
+{
+	const std::vector<float> ramp = MakeRamp(size, size - 1);
+	return Lut3D::FromSeparableTables(ramp, ramp, ramp);
+}
+
+std::vector<unsigned char> MakeBytes(size_t size)
+{
+	std::vector<unsigned char> bytes(size);
+	for (size_t i = 0; i < size; ++i)
+	{
+		bytes[i] = (unsigned char)((i * 2654435761u) >> 13);
+	}
+	return bytes;
+}
+
+} // namespace
+
+// Curves on the diagonal are identities, and channels made of them leave
+// every input as it was
+TEST(IdentityCurvesAreDetected)
+{
+	CurvePoints diagonal;
+	diagonal.push_back(std::make_pair(0.0f, 0.0f));
+	diagonal.push_back(std::make_pair(128.0f, 128.0f));
+	diagonal.push_back(std::make_pair(255.0f, 255.0f));
+	CurvePoints lifted = diagonal;
+	lifted[1].second = 140.0f;
+
+	std::vector<CubicSpline> splines(5, CubicSpline::InterpolateCubicSplineFromCurvePoints(diagonal));
+	splines[2] = CubicSpline::InterpolateCubicSplineFromCurvePoints(lifted);
+	CHECK(splines[0].IsIdentity() && !splines[2].IsIdentity());
+	CHECK(IsIdentityChannel(splines, 0) && !IsIdentityChannel(splines, 1) && IsIdentityChannel(splines, 2));
+
+	bool passes = true;
+	for (unsigned i = 0; i <= 1000; ++i)
+	{
+		const float value = i / 1000.0f;
+		passes &= EvaluateCurves(splines, 0, value) == value && EvaluateCurves(splines, 2, value) == value;
+	}
+	CHECK(passes && EvaluateCurves(splines, 1, 0.5f) > 0.52f);
+}
+
+// Ramps are identities within half an 8-bit level; i / size only counts from
+// 16 entries up
+TEST(IdentityTablesAreDetected)
+{
+	CHECK(IsIdentityTable(MakeRamp(2, 1)) && IsIdentityTable(MakeRamp(17, 16)));
+	CHECK(IsIdentityTable(MakeRamp(16, 16)) && !IsIdentityTable(MakeRamp(8, 8)));
+
+	std::vector<float> nudged = MakeRamp(17, 16);
+	nudged[5] += 0.4f / 255.0f;
+	CHECK(IsIdentityTable(nudged));
+	nudged[5] += 0.2f / 255.0f;
+	CHECK(!IsIdentityTable(nudged));
+
+	CHECK(MakeIdentityCube(17).IsIdentity() && !MakeTestCube(17, 70).IsIdentity());
+	Lut3D off = MakeIdentityCube(17);
+	off.GetTexel(3, 4, 5)[1] += 2.0f / 255.0f;
+	CHECK(!off.IsIdentity());
+}
+
+// An identity volume, as read back in 8-bit levels, leaves unorm pixels alone
+// under the exact filter. The D3D11 filter and half floats still grade.
+TEST(IdentityLutsPassPixelsThrough)
+{
+	const PathString path = GetScratchPath("identity.dds");
+	CHECK(WriteDdsVolume(path.c_str(), MakeIdentityCube(17)));
+	Lut3D lut;
+	CHECK(ReadDdsVolume(path.c_str(), lut) && lut.IsIdentity());
+
+	const LutApplier applier(lut);
+	CHECK(applier.IsIdentity());
+	CHECK(applier.PassesThrough(IMAGE_FORMAT_RGB8) && applier.PassesThrough(IMAGE_FORMAT_RGBA16));
+	CHECK(!applier.PassesThrough(IMAGE_FORMAT_RGBA16F));
+	CHECK(!LutApplier(lut, LUT_FILTER_D3D11).PassesThrough(IMAGE_FORMAT_RGB8));
+
+	const ImageFormat formats[] = { IMAGE_FORMAT_RGB8, IMAGE_FORMAT_RGBA8, IMAGE_FORMAT_RGB16, IMAGE_FORMAT_RGBA16 };
+	for (size_t f = 0; f < sizeof(formats) / sizeof(formats[0]); ++f)
+	{
+		const size_t count = 1001;
+		const std::vector<unsigned char> pixels = MakeBytes(count * GetChannelCount(formats[f]) * GetBytesPerChannel(formats[f]));
+		std::vector<unsigned char> graded(pixels.size());
+		applier.Apply(&pixels[0], formats[f], &graded[0], formats[f], count);
+		CHECK(graded == pixels);
+	}
+
+	// One texel two levels off is a look
+	Lut3D off = lut;
+	off.GetTexel(8, 8, 8)[0] += 2.0f / 255.0f;
+	CHECK(!LutApplier(off).IsIdentity());
+}
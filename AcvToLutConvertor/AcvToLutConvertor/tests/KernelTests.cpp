@@ -0,0 +1,202 @@
+#include "Test.h"
+#include "LutApplier.h"
+#include "CpuFeatures.h"
+#include "Half.h"
+#include <cstring>
+#include <cstdlib>
+
+namespace
+{
+
+const size_t PIXEL_COUNT = 1001; // leaves a tail for the scalar kernel at every vector width
+
+std::vector<unsigned char> MakePixels(unsigned channels)
+{
+	std::vector<unsigned char> pixels(PIXEL_COUNT * channels);
+	for (size_t i = 0; i < pixels.size(); ++i)
+	{
+		pixels[i] = (unsigned char)((i * 2654435761u) >> 13);
+	}
+	// The corners of the cube and both ends of every channel
+	for (size_t corner = 0; corner < 8; ++corner)
+	{
+		for (unsigned channel = 0; channel < 3; ++channel)
+		{
+			pixels[corner * channels + channel] = (corner >> channel & 1) ? 255 : 0;
+		}
+	}
+	return pixels;
+}
+
+std::vector<unsigned char> Grade(const Lut3D& lut, LutLayout layout, const std::vector<unsigned char>& pixels, unsigned channels)
+{
+	LutApplier applier(lut, LUT_FILTER_EXACT, layout);
+	applier.SetColourCache(false);
+	std::vector<unsigned char> graded(pixels.size());
+	applier.ApplyInterleaved(&pixels[0], &graded[0], PIXEL_COUNT, channels);
+	return graded;
+}
+
+// Pixels of any format as bytes: the 8-bit ones above, 16-bit codes over the
+// whole range, and half floats a little past both ends of [0, 1]
+std::vector<unsigned char> MakeSamples(ImageFormat format)
+{
+	const unsigned channels = GetChannelCount(format);
+	if (GetBytesPerChannel(format) == 1)
+	{
+		return MakePixels(channels);
+	}
+
+	std::vector<unsigned short> samples(PIXEL_COUNT * channels);
+	for (size_t i = 0; i < samples.size(); ++i)
+	{
+		const unsigned hash = (unsigned)(i * 2654435761u);
+		samples[i] = format == IMAGE_FORMAT_RGBA16F ? FloatToHalf((float)(hash >> 8) / (1 << 24) * 1.2f - 0.1f) : (unsigned short)(hash >> 11);
+	}
+	for (size_t corner = 0; corner < 8; ++corner)
+	{
+		for (unsigned channel = 0; channel < 3; ++channel)
+		{
+			const bool high = (corner >> channel & 1) != 0;
+			samples[corner * channels + channel] = format == IMAGE_FORMAT_RGBA16F ? FloatToHalf(high ? 1.0f : 0.0f) : (high ? 65535 : 0);
+		}
+	}
+
+	const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&samples[0]);
+	return std::vector<unsigned char>(bytes, bytes + samples.size() * sizeof(unsigned short));
+}
+
+std::vector<unsigned char> Grade(const Lut3D& lut, LutLayout layout, LutInterpolation interpolation,
+	const std::vector<unsigned char>& pixels, ImageFormat format, bool inPlace)
+{
+	LutApplier applier(lut, LUT_FILTER_EXACT, layout);
+	applier.SetColourCache(false);
+	CHECK(applier.SetInterpolation(interpolation));
+	std::vector<unsigned char> graded = inPlace ? pixels : std::vector<unsigned char>(pixels.size());
+	applier.Apply(inPlace ? &graded[0] : &pixels[0], format, &graded[0], format, PIXEL_COUNT);
+	return graded;
+}
+
+} // namespace
+
+// Every SIMD build gives the scalar kernel's results to the bit, for every
+// format graded into itself, trilinear and tetrahedral, in both layouts,
+// also in place, and passes alpha through
+TEST(KernelsMatchScalar)
+{
+	const Lut3D lut = MakeTestCube(33, 1);
+	const CpuLevel previous = GetCpuLevel();
+	const CpuLevel supported = GetSupportedCpuLevel();
+	const ImageFormat formats[] = { IMAGE_FORMAT_RGB8, IMAGE_FORMAT_RGBA8, IMAGE_FORMAT_RGB16, IMAGE_FORMAT_RGBA16, IMAGE_FORMAT_RGBA16F };
+	const LutInterpolation interpolations[] = { LUT_INTERPOLATION_TRILINEAR, LUT_INTERPOLATION_TETRAHEDRAL };
+	const LutLayout layouts[] = { LUT_LAYOUT_LINEAR, LUT_LAYOUT_BRICKED };
+
+	for (size_t f = 0; f < sizeof(formats) / sizeof(formats[0]); ++f)
+	{
+		const std::vector<unsigned char> pixels = MakeSamples(formats[f]);
+		for (size_t i = 0; i < 2; ++i)
+		{
+			for (size_t l = 0; l < 2; ++l)
+			{
+				SetCpuLevel(CPU_LEVEL_SCALAR);
+				const std::vector<unsigned char> expected = Grade(lut, layouts[l], interpolations[i], pixels, formats[f], false);
+
+				for (int level = CPU_LEVEL_SSE2; level <= supported; ++level)
+				{
+					CHECK(SetCpuLevel((CpuLevel)level));
+					CHECK(Grade(lut, layouts[l], interpolations[i], pixels, formats[f], false) == expected);
+					CHECK(Grade(lut, layouts[l], interpolations[i], pixels, formats[f], true) == expected);
+				}
+			}
+		}
+	}
+	SetCpuLevel(previous);
+}
+
+// The scalar kernel against Lut3D::Sample, the trilinear reference, within
+// the rounding of the 8-bit result
+TEST(KernelsMatchReference)
+{
+	const Lut3D lut = MakeTestCube(17, 2);
+	const std::vector<unsigned char> pixels = MakePixels(4);
+
+	const CpuLevel previous = GetCpuLevel();
+	SetCpuLevel(CPU_LEVEL_SCALAR);
+	const std::vector<unsigned char> graded = Grade(lut, LUT_LAYOUT_LINEAR, pixels, 4);
+	SetCpuLevel(previous);
+
+	for (size_t i = 0; i < PIXEL_COUNT; ++i)
+	{
+		const unsigned char* pixel = &pixels[i * 4];
+		float expected[3];
+		lut.Sample(pixel[0] / 255.0f, pixel[1] / 255.0f, pixel[2] / 255.0f, expected);
+		for (int channel = 0; channel < 3; ++channel)
+		{
+			const int level = (int)(expected[channel] * 255.0f + 0.5f);
+			CHECK(abs(graded[i * 4 + channel] - level) <= 1);
+		}
+		CHECK(graded[i * 4 + 3] == pixel[3]);
+	}
+}
+
+// Every cell of the bricked copy finds its eight corners from one offset at
+// strides of 1, 5 and 25 texels, including the cells of partial bricks
+TEST(BrickedLayoutHoldsEveryCell)
+{
+	const size_t sizes[] = { 2, 5, 17, 18 };
+	for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s)
+	{
+		const size_t size = sizes[s];
+		const Lut3D lut = MakeTestCube(size, 50 + (unsigned)s);
+		std::vector<float> bricked;
+		lut.CopyBricked(bricked);
+		CHECK(bricked.size() == lut.GetBrickedTexelCount() * 3);
+
+		bool matches = true;
+		for (size_t b = 0; b + 1 < size; ++b)
+		{
+			for (size_t g = 0; g + 1 < size; ++g)
+			{
+				for (size_t r = 0; r + 1 < size; ++r)
+				{
+					const size_t first = Lut3D::GetBrickedOffset(r, 0, size) + Lut3D::GetBrickedOffset(g, 1, size) + Lut3D::GetBrickedOffset(b, 2, size);
+					for (size_t corner = 0; corner < 8; ++corner)
+					{
+						const size_t dr = corner & 1;
+						const size_t dg = corner >> 1 & 1;
+						const size_t db = corner >> 2;
+						const float* texel = &bricked[(first + dr + dg * 5 + db * 25) * 3];
+						matches &= memcmp(texel, lut.GetTexel(r + dr, g + dg, b + db), 3 * sizeof(float)) == 0;
+					}
+				}
+			}
+		}
+		CHECK(matches);
+	}
+}
+
+// Bricked and linear cubes grade every format the same to the bit; the
+// automatic choice bricks the larger cubes only
+TEST(BrickedLayoutMatchesLinear)
+{
+	const ImageFormat formats[] = { IMAGE_FORMAT_RGB8, IMAGE_FORMAT_RGBA8, IMAGE_FORMAT_RGB16, IMAGE_FORMAT_RGBA16, IMAGE_FORMAT_RGBA16F };
+	const LutInterpolation interpolations[] = { LUT_INTERPOLATION_TRILINEAR, LUT_INTERPOLATION_TETRAHEDRAL };
+	const size_t sizes[] = { 17, 18, 33 };
+
+	for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s)
+	{
+		const Lut3D lut = MakeTestCube(sizes[s], 60 + (unsigned)s);
+		CHECK(LutApplier(lut, LUT_FILTER_EXACT, LUT_LAYOUT_BRICKED).GetLayout() == LUT_LAYOUT_BRICKED);
+		CHECK(LutApplier(lut).GetLayout() == (sizes[s] >= 33 ? LUT_LAYOUT_BRICKED : LUT_LAYOUT_LINEAR));
+
+		for (size_t f = 0; f < sizeof(formats) / sizeof(formats[0]); ++f)
+		{
+			const std::vector<unsigned char> pixels = MakeSamples(formats[f]);
+			for (size_t i = 0; i < 2; ++i)
+			{
+				CHECK(Grade(lut, LUT_LAYOUT_BRICKED, interpolations[i], pixels, formats[f], false) ==
+					Grade(lut, LUT_LAYOUT_LINEAR, interpolations[i], pixels, formats[f], false));
+			}
+		}
+	}
+}
@@ -0,0 +1,237 @@
+#include "Test.h"
+#include "LazyLut3D.h"
+#include "LutApplier.h"
+#include "Half.h"
+#include <thread>
+#include <cstring>
+
+namespace
+{
+
+LutChain MakeChain(bool separable)
+{
+	const std::vector<CurvePoints> curves = MakeTestCurves(19);
+	std::vector<CubicSpline> splines;
+	for (size_t i = 0; i < curves.size(); ++i)
+	{
+		splines.push_back(CubicSpline::InterpolateCubicSplineFromCurvePoints(curves[i]));
+	}
+
+	LutChain chain;
+	chain.AddCurves(splines);
+	if (!separable)
+	{
+		chain.AddCube(MakeTestCube(9, 19));
+	}
+	return chain;
+}
+
+bool IsSameTexel(const LazyTexel& lazy, const float* baked)
+{
+	const float texel[3] = { lazy[0], lazy[1], lazy[2] };
+	return memcmp(texel, baked, sizeof(texel)) == 0;
+}
+
+// Every texel of the lazy cube against the bake
+bool MatchesBake(const LazyLut3D& lazy, const Lut3D& baked)
+{
+	const size_t size = baked.GetSize();
+	bool matches = lazy.GetSize() == size;
+	for (size_t b = 0; b < size && matches; ++b)
+	{
+		for (size_t g = 0; g < size; ++g)
+		{
+			for (size_t r = 0; r < size; ++r)
+			{
+				matches &= IsSameTexel(lazy.GetTexel(r, g, b), baked.GetTexel(r, g, b));
+			}
+		}
+	}
+	return matches;
+}
+
+Image MakeImage(ImageFormat format, unsigned width, unsigned height)
+{
+	Image image;
+	CHECK(image.Allocate(width, height, format, IMAGE_LAYOUT_INTERLEAVED));
+	const bool half = format == IMAGE_FORMAT_RGBA16F;
+	for (unsigned y = 0; y < height; ++y)
+	{
+		unsigned char* row = image.GetRow(y);
+		unsigned short* row16 = reinterpret_cast<unsigned short*>(row);
+		const size_t count = (size_t)width * image.GetChannelCount();
+		for (size_t i = 0; i < count; ++i)
+		{
+			const unsigned hash = (unsigned)((y * count + i) * 2654435761u);
+			if (GetBytesPerChannel(format) == 1)
+			{
+				row[i] = (unsigned char)(hash >> 13);
+			}
+			else
+			{
+				row16[i] = half ? FloatToHalf((float)(hash >> 8) / (1 << 24)) : (unsigned short)(hash >> 11);
+			}
+		}
+	}
+	return image;
+}
+
+std::vector<unsigned char> GetPixels(const Image& image)
+{
+	std::vector<unsigned char> pixels;
+	for (unsigned y = 0; y < image.GetHeight(); ++y)
+	{
+		pixels.insert(pixels.end(), image.GetRow(y), image.GetRow(y) + image.GetWidth() * image.GetPixelSize());
+	}
+	return pixels;
+}
+
+// A sample as stored, and as a value in [0, 1]
+unsigned GetCode(const Image& image, unsigned y, size_t index)
+{
+	const unsigned char* row = image.GetRow(y);
+	return GetBytesPerChannel(image.GetFormat()) == 1 ? row[index] : reinterpret_cast<const unsigned short*>(row)[index];
+}
+
+float GetSample(const Image& image, unsigned y, size_t index)
+{
+	const unsigned code = GetCode(image, y, index);
+	if (image.GetFormat() == IMAGE_FORMAT_RGBA16F)
+	{
+		return HalfToFloat((unsigned short)code);
+	}
+	return GetBytesPerChannel(image.GetFormat()) == 1 ? code * (1.0f / 255.0f) : code * (1.0f / 65535.0f);
+}
+
+// What a format stores for a value, rounded and clamped
+unsigned EncodeSample(ImageFormat format, float value)
+{
+	if (format == IMAGE_FORMAT_RGBA16F)
+	{
+		return FloatToHalf(value);
+	}
+	const float maximum = GetBytesPerChannel(format) == 1 ? 255.0f : 65535.0f;
+	const float scaled = value * maximum + 0.5f;
+	return scaled <= 0.0f ? 0 : (scaled >= maximum ? (unsigned)maximum : (unsigned)scaled);
+}
+
+} // namespace
+
+// Points hold what LutChain::Bake puts there, to the bit, with and without a
+// shaper, and only the points read are worked out
+TEST(LazyCubeMatchesBake)
+{
+	for (int separable = 0; separable < 2; ++separable)
+	{
+		const LutChain chain = MakeChain(separable != 0);
+		for (int shaped = 0; shaped < 2; ++shaped)
+		{
+			const LutShaper shaper = shaped ? LutShaper::Create(LUT_SHAPER_LOG, chain, 33) : LutShaper();
+			const Lut3D baked = chain.Bake(33, &shaper);
+			const LazyLut3D lazy(chain, 33, &shaper);
+			CHECK(lazy.GetEvaluatedCount() == 0);
+
+			CHECK(IsSameTexel(lazy.GetTexel(5, 6, 7), baked.GetTexel(5, 6, 7)));
+			CHECK(IsSameTexel(lazy.GetTexel(5, 6, 7), baked.GetTexel(5, 6, 7)));
+			CHECK(IsSameTexel(lazy.GetTexel(32, 0, 32), baked.GetTexel(32, 0, 32)));
+			CHECK(lazy.GetEvaluatedCount() == 2);
+
+			CHECK(MatchesBake(lazy, baked) && lazy.GetEvaluatedCount() == 33 * 33 * 33);
+		}
+	}
+}
+
+// Threads sampling the same cube at once fill it in with the bake's values
+TEST(LazyCubeFillsInFromThreads)
+{
+	const LutChain chain = MakeChain(false);
+	const LazyLut3D lazy(chain, 65);
+	std::vector<std::thread> threads;
+	for (unsigned t = 0; t < 4; ++t)
+	{
+		threads.push_back(std::thread([&lazy, t]
+		{
+			unsigned seed = t / 2; // two threads on each sequence
+			float out[3];
+			for (int i = 0; i < 20000; ++i)
+			{
+				float in[3];
+				for (int c = 0; c < 3; ++c)
+				{
+					seed = seed * 1664525u + 1013904223u;
+					in[c] = (float)(seed >> 8) / (1 << 24);
+				}
+				lazy.Sample(in[0], in[1], in[2], out);
+			}
+		}));
+	}
+	for (size_t t = 0; t < threads.size(); ++t)
+	{
+		threads[t].join();
+	}
+
+	const size_t evaluated = lazy.GetEvaluatedCount();
+	CHECK(evaluated > 0 && evaluated < 65 * 65 * 65);
+	CHECK(MatchesBake(lazy, chain.Bake(65)));
+}
+
+// Grading through a lazy cube gives what sampling the baked cube gives, and
+// without a shaper what the applier gives for wide formats. A small image
+// reaches a small part of a large cube.
+TEST(LazyApplyMatchesBakedCube)
+{
+	const LutChain chain = MakeChain(false);
+	const LutShaper log = LutShaper::Create(LUT_SHAPER_LOG, chain, 65);
+	const ImageFormat formats[] = { IMAGE_FORMAT_RGB8, IMAGE_FORMAT_RGBA8, IMAGE_FORMAT_RGB16, IMAGE_FORMAT_RGBA16, IMAGE_FORMAT_RGBA16F };
+
+	for (int mode = 0; mode < 3; ++mode)
+	{
+		const LutFilter filter = mode == 2 ? LUT_FILTER_D3D11 : LUT_FILTER_EXACT;
+		const LutShaper shaper = mode == 1 ? log : LutShaper();
+		const Lut3D baked = chain.Bake(65, &shaper);
+		for (size_t f = 0; f < sizeof(formats) / sizeof(formats[0]); ++f)
+		{
+			const LazyLut3D lazy(chain, 65, &shaper);
+			const Image original = MakeImage(formats[f], 40, 30);
+			Image image = original;
+			lazy.Apply(image, filter);
+			CHECK(IsWorthLazyCube(65, 40 * 30) && lazy.GetEvaluatedCount() < 65 * 65 * 65 / 10);
+
+			bool matches = true;
+			const unsigned channels = original.GetChannelCount();
+			for (unsigned y = 0; y < original.GetHeight(); ++y)
+			{
+				for (size_t i = 0; i < (size_t)original.GetWidth() * channels; i += channels)
+				{
+					float color[3];
+					for (int c = 0; c < 3; ++c)
+					{
+						color[c] = GetSample(original, y, i + c);
+						color[c] = shaper.IsIdentity() ? color[c] : shaper.Forward(color[c]);
+					}
+					if (filter == LUT_FILTER_D3D11)
+					{
+						baked.SampleD3D11(color[0], color[1], color[2], color);
+					}
+					else
+					{
+						baked.Sample(color[0], color[1], color[2], color);
+					}
+					for (int c = 0; c < 3; ++c)
+					{
+						matches &= GetCode(image, y, i + c) == EncodeSample(formats[f], color[c]);
+					}
+					matches &= channels == 3 || GetCode(image, y, i + 3) == GetCode(original, y, i + 3);
+				}
+			}
+			CHECK(matches);
+
+			if (shaper.IsIdentity() && GetBytesPerChannel(formats[f]) == 2)
+			{
+				Image expected = original;
+				LutApplier(baked, filter).Apply(expected);
+				CHECK(GetPixels(image) == GetPixels(expected));
+			}
+		}
+	}
+}
@@ -0,0 +1,141 @@
+#include "Test.h"
+#include "LutCache.h"
+#include "LutPack.h"
+#include "DdsVolume.h"
+#include <cstdio>
+
+namespace
+{
+
+// What a cache that never saw the file before makes of it
+Lut3D LoadFresh(const PathString& path)
+{
+	LutCache cache;
+	std::shared_ptr<const BakedLut> baked = cache.Get(path.c_str());
+	return baked ? baked->Lut : Lut3D();
+}
+
+bool IsFresh(LutCache& cache, const PathString& path)
+{
+	std::shared_ptr<const BakedLut> baked = cache.Get(path.c_str());
+	return baked && GetMaxDifference(baked->Lut, LoadFresh(path)) == 0.0f;
+}
+
+} // namespace
+
+TEST(LutCacheReloadsChangedFiles)
+{
+	const PathString path = GetScratchPath("cached.acv");
+	CHECK(WriteAcvFile(path.c_str(), MakeTestCurves(6)));
+
+	LutCache cache;
+	std::shared_ptr<const BakedLut> first = cache.Get(path.c_str());
+	CHECK(first && cache.Get(path.c_str()) == first);
+	CHECK(cache.GetStats().Hits == 1 && cache.GetStats().Misses == 1);
+
+	// One more knot, so the size changes whatever the clock does
+	std::vector<CurvePoints> curves = MakeTestCurves(6);
+	curves[1].insert(curves[1].begin() + 1, std::make_pair(32.0f, 60.0f));
+	CHECK(WriteAcvFile(path.c_str(), curves));
+	std::shared_ptr<const BakedLut> second = cache.Get(path.c_str());
+	CHECK(second && second != first && IsFresh(cache, path));
+	CHECK(GetMaxDifference(first->Lut, second->Lut) > 0.0f);
+
+	// The same bytes under another name share the bake
+	const PathString copy = GetScratchPath("copy.acv");
+	CHECK(WriteAcvFile(copy.c_str(), curves));
+	CHECK(cache.Get(copy.c_str()) == second);
+	CHECK(cache.GetStats().Shared == 1);
+
+	CHECK(!cache.Get(GetScratchPath("missing.acv").c_str()));
+}
+
+// A DDS volume's entry goes stale when its shaper sidecar appears, changes or
+// goes away
+TEST(LutCacheFollowsShaperSidecar)
+{
+	const PathString path = GetScratchPath("sidecar.dds");
+	const PathString shaperPath = GetDdsShaperPath(path.c_str());
+	CHECK(WriteShapedVolume(path.c_str(), true));
+
+	LutCache cache;
+	std::shared_ptr<const BakedLut> shaped = cache.Get(path.c_str());
+	CHECK(shaped && IsFresh(cache, path));
+
+	CHECK(RemoveTestFile(shaperPath.c_str()));
+	std::shared_ptr<const BakedLut> unshaped = cache.Get(path.c_str());
+	CHECK(unshaped && unshaped != shaped && IsFresh(cache, path));
+	CHECK(GetMaxDifference(shaped->Lut, unshaped->Lut) > 0.01f);
+
+	CHECK(WriteShapedVolume(path.c_str(), true));
+	CHECK(IsFresh(cache, path));
+	CHECK(GetMaxDifference(cache.Get(path.c_str())->Lut, shaped->Lut) == 0.0f);
+}
+
+TEST(LutCacheReloadsRewrittenPacks)
+{
+	CHECK(CreateScratchDirectory("repacked"));
+	const PathString acvPath = GetScratchPath("repacked/look.acv");
+	const PathString packPath = GetScratchPath("repacked.lutpack");
+	const PathString packed = GetScratchPackPath("repacked.lutpack", "look.acv");
+	CHECK(WriteAcvFile(acvPath.c_str(), MakeTestCurves(7)));
+	CHECK(WriteLutPack(packPath.c_str(), GetScratchPath("repacked").c_str(), false));
+
+	LutCache cache;
+	std::shared_ptr<const BakedLut> first = cache.Get(packed.c_str());
+	CHECK(first && IsFresh(cache, packed));
+
+	std::vector<CurvePoints> curves = MakeTestCurves(8);
+	curves[0].insert(curves[0].begin() + 1, std::make_pair(16.0f, 40.0f));
+	CHECK(WriteAcvFile(acvPath.c_str(), curves));
+	CHECK(WriteLutPack(packPath.c_str(), GetScratchPath("repacked").c_str(), false));
+	std::shared_ptr<const BakedLut> second = cache.Get(packed.c_str());
+	CHECK(second && second != first && IsFresh(cache, packed));
+	CHECK(GetMaxDifference(first->Lut, second->Lut) > 0.0f);
+}
+
+// A volume and the same volume in a pack share a bake; another volume of the
+// same size does not
+TEST(LutCacheSharesOnlyEqualBytes)
+{
+	CHECK(CreateScratchDirectory("shared"));
+	const PathString volumePath = GetScratchPath("shared/cube.dds");
+	CHECK(WriteDdsVolume(volumePath.c_str(), MakeTestCube(17, 3)));
+	CHECK(WriteLutPack(GetScratchPath("shared.lutpack").c_str(), GetScratchPath("shared").c_str(), false));
+
+	LutCache cache;
+	std::shared_ptr<const BakedLut> volume = cache.Get(volumePath.c_str());
+	CHECK(volume && !volume->Content.empty() && volume->Bytes > volume->Content.size());
+	CHECK(cache.Get(GetScratchPackPath("shared.lutpack", "cube.dds").c_str()) == volume);
+	CHECK(cache.GetStats().Shared == 1);
+
+	const PathString otherPath = GetScratchPath("other.dds");
+	CHECK(WriteDdsVolume(otherPath.c_str(), MakeTestCube(17, 4)));
+	std::shared_ptr<const BakedLut> other = cache.Get(otherPath.c_str());
+	CHECK(other && other != volume && other->Content.size() == volume->Content.size());
+	CHECK(cache.GetStats().Shared == 1 && cache.GetStats().Misses == 2);
+}
+
+// Over budget, shards keep only the entry used last; what callers hold stays
+// valid
+TEST(LutCacheEvictsOverBudget)
+{
+	LutCache cache(1);
+	std::shared_ptr<const BakedLut> first;
+	for (unsigned i = 0; i < 40; ++i)
+	{
+		char name[32];
+		snprintf(name, sizeof(name), "budget%u.acv", i);
+		CHECK(WriteAcvFile(GetScratchPath(name).c_str(), MakeTestCurves(20 + i)));
+		std::shared_ptr<const BakedLut> baked = cache.Get(GetScratchPath(name).c_str());
+		CHECK(baked);
+		if (i == 0)
+		{
+			first = baked;
+		}
+	}
+
+	const LutCacheStats stats = cache.GetStats();
+	CHECK(stats.Entries <= 16 && stats.Evictions >= 24);
+	CHECK(first && GetMaxDifference(first->Lut, BakeLutFile(GetScratchPath("budget0.acv"), first->Lut.GetSize())) == 0.0f);
+}
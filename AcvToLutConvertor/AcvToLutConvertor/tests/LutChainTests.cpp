@@ -0,0 +1,131 @@
+#include "Test.h"
+#include "LutChain.h"
+#include "DdsVolume.h"
+#include <cmath>
+
+namespace
+{
+
+std::vector<CubicSpline> MakeTestSplines(unsigned seed)
+{
+	const std::vector<CurvePoints> curves = MakeTestCurves(seed);
+	std::vector<CubicSpline> splines;
+	for (size_t i = 0; i < curves.size(); ++i)
+	{
+		splines.push_back(CubicSpline::InterpolateCubicSplineFromCurvePoints(curves[i]));
+	}
+	return splines;
+}
+
+// Largest difference between a baked cube and what the stages give at its
+// lattice points, run one after another
+template <typename Stages>
+float GetLatticeError(const Lut3D& baked, Stages stages)
+{
+	const size_t size = baked.GetSize();
+	float error = 0.0f;
+	for (size_t b = 0; b < size; ++b)
+	{
+		for (size_t g = 0; g < size; ++g)
+		{
+			for (size_t r = 0; r < size; ++r)
+			{
+				float color[3] = { (float)r / (size - 1), (float)g / (size - 1), (float)b / (size - 1) };
+				stages(color);
+				for (int c = 0; c < 3; ++c)
+				{
+					error = std::max(error, fabsf(baked.GetTexel(r, g, b)[c] - color[c]));
+				}
+			}
+		}
+	}
+	return error;
+}
+
+} // namespace
+
+// Curves, a cube and curves again bake to the three applied in that order
+TEST(LutChainComposesInOrder)
+{
+	const std::vector<CubicSpline> before = MakeTestSplines(11);
+	const std::vector<CubicSpline> after = MakeTestSplines(12);
+	const Lut3D cube = MakeTestCube(9, 11);
+
+	LutChain chain;
+	chain.AddCurves(before);
+	chain.AddCube(cube);
+	chain.AddCurves(after);
+	CHECK(chain.GetStageCount() == 3 && !chain.IsSeparable() && chain.GetNativeSize() == 9);
+
+	const Lut3D baked = chain.Bake(17);
+	CHECK(GetLatticeError(baked, [&](float color[3])
+	{
+		for (int c = 0; c < 3; ++c)
+		{
+			color[c] = EvaluateCurves(before, c, color[c]);
+		}
+		cube.Sample(color[0], color[1], color[2], color);
+		for (int c = 0; c < 3; ++c)
+		{
+			color[c] = EvaluateCurves(after, c, color[c]);
+		}
+	}) <= 1e-6f);
+
+	LutChain swapped;
+	swapped.AddCurves(after);
+	swapped.AddCube(cube);
+	swapped.AddCurves(before);
+	CHECK(GetMaxDifference(swapped.Bake(17), baked) > 0.01f);
+}
+
+// Curves around a per-channel cube stay separable and compose channel by
+// channel through the cube's tables
+TEST(LutChainComposesSeparableStages)
+{
+	const std::vector<CubicSpline> before = MakeTestSplines(13);
+	const std::vector<CubicSpline> after = MakeTestSplines(14);
+	std::vector<float> tables[3];
+	for (int c = 0; c < 3; ++c)
+	{
+		for (size_t i = 0; i < 5; ++i)
+		{
+			const float x = i / 4.0f;
+			tables[c].push_back(x * x * (1.0f + c * 0.2f) / (1.0f + (c * 0.2f) * x));
+		}
+	}
+
+	LutChain chain;
+	chain.AddCurves(before);
+	chain.AddCube(Lut3D::FromSeparableTables(tables[0], tables[1], tables[2]));
+	chain.AddCurves(after);
+	CHECK(chain.IsSeparable());
+
+	CHECK(GetLatticeError(chain.Bake(33), [&](float color[3])
+	{
+		for (int c = 0; c < 3; ++c)
+		{
+			color[c] = EvaluateCurves(after, c, SampleTable(tables[c], EvaluateCurves(before, c, color[c])));
+		}
+	}) <= 1e-5f);
+}
+
+// Files bake the same as the curves and cube they hold
+TEST(LutChainReadsFiles)
+{
+	const PathString acvPath = GetScratchPath("chain.acv");
+	const PathString ddsPath = GetScratchPath("chain.dds");
+	CHECK(WriteAcvFile(acvPath.c_str(), MakeTestCurves(15)));
+	CHECK(WriteDdsVolume(ddsPath.c_str(), MakeTestCube(9, 15)));
+	std::vector<CubicSpline> splines;
+	Lut3D cube;
+	CHECK(ReadCurves(acvPath.c_str(), splines) && ReadDdsVolume(ddsPath.c_str(), cube));
+
+	LutChain files;
+	CHECK(files.AddFile(acvPath.c_str()) && files.AddFile(ddsPath.c_str()));
+	CHECK(!files.AddFile(GetScratchPath("chain.txt").c_str()));
+
+	LutChain memory;
+	memory.AddCurves(splines);
+	memory.AddCube(cube);
+	CHECK(files.GetStageCount() == 2 && GetMaxDifference(files.Bake(17), memory.Bake(17)) == 0.0f);
+}
@@ -0,0 +1,102 @@
+#include "Test.h"
+#include "LutOutputs.h"
+#include "DdsVolume.h"
+#include "CubeFile.h"
+#include "MappedFile.h"
+
+namespace
+{
+
+std::vector<unsigned char> ReadTestFile(const PathString& path)
+{
+	MappedFile file;
+	const unsigned char* bytes = file.Open(path.c_str(), false) ? file.MapWindow(0, (size_t)file.GetSize()) : nullptr;
+	return bytes ? std::vector<unsigned char>(bytes, bytes + file.GetSize()) : std::vector<unsigned char>();
+}
+
+LutChain MakeChain(bool separable)
+{
+	const std::vector<CurvePoints> curves = MakeTestCurves(18);
+	std::vector<CubicSpline> splines;
+	for (size_t i = 0; i < curves.size(); ++i)
+	{
+		splines.push_back(CubicSpline::InterpolateCubicSplineFromCurvePoints(curves[i]));
+	}
+
+	LutChain chain;
+	chain.AddCurves(splines);
+	if (!separable)
+	{
+		chain.AddCube(MakeTestCube(9, 18));
+	}
+	return chain;
+}
+
+LutOutputFile MakeOutput(size_t size, const char* name)
+{
+	LutOutputFile output;
+	output.Size = size;
+	output.Path = GetScratchPath(name);
+	return output;
+}
+
+// Each output is the file a bake at its size alone gives
+void CheckOutputs(const LutChain& chain, LutShaperKind shaperKind)
+{
+	std::vector<LutOutputFile> outputs;
+	outputs.push_back(MakeOutput(16, "outputs_16.dds"));
+	outputs.push_back(MakeOutput(2, "outputs_2.dds"));
+	outputs.push_back(MakeOutput(33, "outputs_33.dds"));
+	outputs.push_back(MakeOutput(16, "outputs_16.cube"));
+	CHECK(WriteLutOutputs(chain, outputs, shaperKind));
+
+	for (size_t i = 0; i < outputs.size(); ++i)
+	{
+		const LutShaper shaper = LutShaper::Create(shaperKind, chain, outputs[i].Size);
+		const Lut3D lut = chain.Bake(outputs[i].Size, &shaper);
+		const bool dds = GetPathExtension(outputs[i].Path.c_str()) == "dds";
+		const PathString expectedPath = GetScratchPath(dds ? "expected.dds" : "expected.cube");
+		if (dds)
+		{
+			CHECK(WriteDdsVolume(expectedPath.c_str(), lut));
+			const PathString shaperPath = GetDdsShaperPath(outputs[i].Path.c_str());
+			FileStamp stamp;
+			CHECK(GetFileStamp(shaperPath.c_str(), stamp) == !shaper.IsIdentity());
+			if (!shaper.IsIdentity())
+			{
+				CHECK(WriteDdsShaper(GetScratchPath("expected.shaper.dds").c_str(), shaper));
+				CHECK(ReadTestFile(shaperPath) == ReadTestFile(GetScratchPath("expected.shaper.dds")));
+				CHECK(RemoveTestFile(shaperPath.c_str()));
+			}
+		}
+		else
+		{
+			CHECK(WriteCubeFile(expectedPath.c_str(), lut, &shaper));
+		}
+		const std::vector<unsigned char> written = ReadTestFile(outputs[i].Path);
+		CHECK(!written.empty() && written == ReadTestFile(expectedPath));
+	}
+}
+
+} // namespace
+
+// Separable chains go through one batch for all sizes, the others are
+// resampled per size; both write what baking each size on its own does
+TEST(LutOutputsMatchSingleBakes)
+{
+	CheckOutputs(MakeChain(true), LUT_SHAPER_NONE);
+	CheckOutputs(MakeChain(false), LUT_SHAPER_NONE);
+}
+
+// Behind a shaper, every size gets its own, and DDS volumes a sidecar
+TEST(LutOutputsWriteShapers)
+{
+	CheckOutputs(MakeChain(true), LUT_SHAPER_FITTED);
+	CheckOutputs(MakeChain(false), LUT_SHAPER_LOG);
+}
+
+TEST(LutOutputsRejectUnknownFormats)
+{
+	CHECK(IsLutOutputFormat("dds") && IsLutOutputFormat("cube") && !IsLutOutputFormat("png"));
+	CHECK(!WriteLutOutputs(MakeChain(true), std::vector<LutOutputFile>(1, MakeOutput(16, "outputs.png"))));
+}
@@ -0,0 +1,81 @@
+#include "Test.h"
+#include "LutPack.h"
+#include "DdsVolume.h"
+#include "LutShaper.h"
+
+// LUTs read from a pack bake like the files they were packed from, whole or
+// top level only. ACV files are packed as the converter writes them.
+TEST(LutPackMatchesFiles)
+{
+	CHECK(CreateScratchDirectory("looks"));
+	CHECK(CreateScratchDirectory("looks/film"));
+	CHECK(WriteDdsVolume(GetScratchPath("looks/cube.dds").c_str(), MakeTestCube(17, 3)));
+	CHECK(WriteAcvFile(GetScratchPath("looks/film/curves.acv").c_str(), MakeTestCurves(5)));
+	CHECK(WriteDdsVolume(GetScratchPath("converted.dds").c_str(), BakeLutFile(GetScratchPath("looks/film/curves.acv"), DEFAULT_CUBE_SIZE)));
+
+	const char* names[] = { "cube.dds", "film/curves.acv" };
+	const char* files[] = { "looks/cube.dds", "converted.dds" };
+	for (int topLevelOnly = 0; topLevelOnly < 2; ++topLevelOnly)
+	{
+		const PathString packPath = GetScratchPath("looks.lutpack");
+		CHECK(WriteLutPack(packPath.c_str(), GetScratchPath("looks").c_str(), topLevelOnly != 0));
+
+		LutPack pack;
+		CHECK(pack.Open(packPath.c_str()));
+		CHECK(pack.GetEntryCount() == 2);
+		CHECK(pack.Find("missing.dds") == nullptr);
+
+		for (size_t n = 0; n < 2; ++n)
+		{
+			const LutPackEntry* entry = pack.Find(names[n]);
+			CHECK(entry && pack.GetName(*entry) == names[n]);
+			CHECK(entry && ((entry->Flags & LUT_PACK_TOP_LEVEL) != 0) == (topLevelOnly != 0));
+
+			const Lut3D file = BakeLutFile(GetScratchPath(files[n]), 33);
+			const Lut3D packed = BakeLutFile(GetScratchPackPath("looks.lutpack", names[n]), 33);
+			CHECK(file.GetSize() == 33 && GetMaxDifference(file, packed) == 0.0f);
+		}
+	}
+
+	// Cut short, the index no longer fits
+	const char truncated[64] = "LUTP";
+	CHECK(WriteTestFile(GetScratchPath("truncated.lutpack").c_str(), truncated, sizeof(truncated)));
+	LutPack pack;
+	CHECK(!pack.Open(GetScratchPath("truncated.lutpack").c_str()));
+}
+
+// A volume with a shaper sidecar is packed with its shaper, and the sidecar
+// is not packed on its own
+TEST(LutPackKeepsShapers)
+{
+	CHECK(CreateScratchDirectory("shaped"));
+	CHECK(WriteShapedVolume(GetScratchPath("shaped/shaped.dds").c_str(), true));
+	CHECK(WriteShapedVolume(GetScratchPath("shaped/plain.dds").c_str(), false));
+
+	const char* names[] = { "shaped.dds", "plain.dds" };
+	for (int topLevelOnly = 0; topLevelOnly < 2; ++topLevelOnly)
+	{
+		const PathString packPath = GetScratchPath("shaped.lutpack");
+		CHECK(WriteLutPack(packPath.c_str(), GetScratchPath("shaped").c_str(), topLevelOnly != 0));
+
+		LutPack pack;
+		CHECK(pack.Open(packPath.c_str()));
+		CHECK(pack.GetEntryCount() == 2);
+		CHECK(pack.Find("shaped.shaper.dds") == nullptr);
+
+		for (size_t n = 0; n < 2; ++n)
+		{
+			const Lut3D file = BakeLutFile(GetScratchPath((std::string("shaped/") + names[n]).c_str()), 33);
+			const Lut3D packed = BakeLutFile(GetScratchPackPath("shaped.lutpack", names[n]), 33);
+			CHECK(file.GetSize() == 33 && GetMaxDifference(file, packed) == 0.0f);
+		}
+
+		const LutPackEntry* shaped = pack.Find("shaped.dds");
+		const LutPackEntry* plain = pack.Find("plain.dds");
+		LutShaper shaper;
+		CHECK(shaped && shaped->ShaperSize != 0 && pack.ReadShaper(*shaped, shaper) && !shaper.IsIdentity());
+		CHECK(plain && plain->ShaperSize == 0 && pack.ReadShaper(*plain, shaper) && shaper.IsIdentity());
+		CHECK(GetMaxDifference(BakeLutFile(GetScratchPackPath("shaped.lutpack", "shaped.dds"), 33),
+			BakeLutFile(GetScratchPackPath("shaped.lutpack", "plain.dds"), 33)) > 0.01f);
+	}
+}
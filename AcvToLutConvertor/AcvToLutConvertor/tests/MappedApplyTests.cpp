@@ -0,0 +1,117 @@
+#include "Test.h"
+#include "MappedApply.h"
+#include "MappedFile.h"
+#include "LutApplier.h"
+#include <cstring>
+
+namespace
+{
+
+// Small windows, so that every file below spans several
+const size_t WINDOW_SIZE = 4096;
+
+std::vector<unsigned char> ReadTestFile(const PathString& path)
+{
+	MappedFile file;
+	const unsigned char* bytes = file.Open(path.c_str(), false) ? file.MapWindow(0, (size_t)file.GetSize()) : nullptr;
+	return bytes ? std::vector<unsigned char>(bytes, bytes + file.GetSize()) : std::vector<unsigned char>();
+}
+
+std::vector<unsigned char> MakeBytes(size_t size, unsigned seed)
+{
+	std::vector<unsigned char> bytes(size);
+	for (size_t i = 0; i < size; ++i)
+	{
+		bytes[i] = (unsigned char)(((i + seed) * 2654435761u) >> 13);
+	}
+	return bytes;
+}
+
+std::vector<unsigned char> Concatenate(const std::string& header, const std::vector<unsigned char>& pixels)
+{
+	std::vector<unsigned char> bytes(header.begin(), header.end());
+	bytes.insert(bytes.end(), pixels.begin(), pixels.end());
+	return bytes;
+}
+
+void SwapBytes16(std::vector<unsigned char>& bytes)
+{
+	for (size_t i = 0; i + 1 < bytes.size(); i += 2)
+	{
+		std::swap(bytes[i], bytes[i + 1]);
+	}
+}
+
+} // namespace
+
+// An 8-bit PPM graded in place comes out as LutApplier grades its pixels in
+// memory, header untouched
+TEST(MappedApplyGradesInPlace)
+{
+	const Lut3D lut = MakeTestCube(17, 5);
+	const LutApplier applier(lut);
+	const unsigned width = 61;
+	const unsigned height = 47;
+	const std::string header = "P6\n61 47\n255\n";
+	const std::vector<unsigned char> pixels = MakeBytes(width * height * 3, 1);
+
+	const PathString path = GetScratchPath("mapped.ppm");
+	const std::vector<unsigned char> file = Concatenate(header, pixels);
+	CHECK(WriteTestFile(path.c_str(), &file[0], file.size()));
+	CHECK(ApplyLutToMappedFile(applier, path.c_str(), nullptr, nullptr, WINDOW_SIZE));
+
+	std::vector<unsigned char> expected(pixels.size());
+	applier.Apply(&pixels[0], IMAGE_FORMAT_RGB8, &expected[0], IMAGE_FORMAT_RGB8, width * height);
+	CHECK(ReadTestFile(path) == Concatenate(header, expected));
+}
+
+// 16-bit PAM samples are big-endian on disk; written to a new file, the input
+// stays as it was
+TEST(MappedApplyWritesBigEndianPam)
+{
+	const Lut3D lut = MakeTestCube(17, 6);
+	const LutApplier applier(lut);
+	const unsigned width = 29;
+	const unsigned height = 31;
+	const std::string header = "P7\nWIDTH 29\nHEIGHT 31\nDEPTH 4\nMAXVAL 65535\nTUPLTYPE RGB_ALPHA\nENDHDR\n";
+	const std::vector<unsigned char> native = MakeBytes(width * height * 8, 2);
+	std::vector<unsigned char> stored = native;
+	SwapBytes16(stored);
+
+	const PathString inputPath = GetScratchPath("mapped.pam");
+	const PathString outputPath = GetScratchPath("mapped-graded.pam");
+	const std::vector<unsigned char> input = Concatenate(header, stored);
+	CHECK(WriteTestFile(inputPath.c_str(), &input[0], input.size()));
+	CHECK(ApplyLutToMappedFile(applier, inputPath.c_str(), outputPath.c_str(), nullptr, WINDOW_SIZE));
+
+	std::vector<unsigned char> expected(native.size());
+	applier.Apply(&native[0], IMAGE_FORMAT_RGBA16, &expected[0], IMAGE_FORMAT_RGBA16, width * height);
+	SwapBytes16(expected);
+	CHECK(ReadTestFile(outputPath) == Concatenate(header, expected));
+	CHECK(ReadTestFile(inputPath) == input);
+}
+
+// Raw files are graded past their offset, the bytes before it left alone
+TEST(MappedApplyGradesRawFiles)
+{
+	const Lut3D lut = MakeTestCube(17, 7);
+	const LutApplier applier(lut);
+	const RawImageDesc raw = { 53, 19, IMAGE_FORMAT_RGBA8, 100 };
+	const std::vector<unsigned char> prefix = MakeBytes(100, 3);
+	const std::vector<unsigned char> pixels = MakeBytes(53 * 19 * 4, 4);
+
+	const PathString path = GetScratchPath("mapped.raw");
+	std::vector<unsigned char> file = prefix;
+	file.insert(file.end(), pixels.begin(), pixels.end());
+	CHECK(WriteTestFile(path.c_str(), &file[0], file.size()));
+	CHECK(ApplyLutToMappedFile(applier, path.c_str(), nullptr, &raw, WINDOW_SIZE));
+
+	std::vector<unsigned char> expected = prefix;
+	expected.resize(file.size());
+	applier.Apply(&pixels[0], IMAGE_FORMAT_RGBA8, &expected[prefix.size()], IMAGE_FORMAT_RGBA8, 53 * 19);
+	CHECK(ReadTestFile(path) == expected);
+
+	// A raw layout larger than the file is refused
+	const RawImageDesc tooLarge = { 54, 19, IMAGE_FORMAT_RGBA8, 100 };
+	CHECK(!ApplyLutToMappedFile(applier, path.c_str(), nullptr, &tooLarge, WINDOW_SIZE));
+}
@@ -0,0 +1,109 @@
+#include "Test.h"
+#include "LutProtocol.h"
+#include "LocalSocket.h"
+#include <thread>
+#include <cstring>
+
+namespace
+{
+
+// Writes raw bytes, as a client that does not follow the protocol would
+bool ReceivesAfter(const void* data, size_t size, bool closeAfter)
+{
+	LocalSocket client, server;
+	if (!LocalSocket::CreatePair(client, server) || !client.Send(data, size))
+	{
+		return false;
+	}
+	if (closeAfter)
+	{
+		client.Close();
+	}
+	LutMessageHeader header;
+	std::vector<char> payload;
+	return ReceiveLutMessage(server, header, payload);
+}
+
+} // namespace
+
+TEST(ProtocolPacksStrings)
+{
+	std::vector<std::string> strings;
+	strings.push_back("/looks/Vintage.acv");
+	strings.push_back("");
+	strings.push_back("--interpolation=tetrahedral");
+	strings.push_back("\xC3\xA9t\xC3\xA9.png");
+
+	std::vector<char> payload;
+	PackStrings(strings, payload);
+	std::vector<std::string> unpacked;
+	CHECK(UnpackStrings(payload, unpacked) && unpacked == strings);
+
+	payload.clear();
+	CHECK(UnpackStrings(payload, unpacked) && unpacked.empty());
+
+	// Unterminated
+	payload.push_back('a');
+	CHECK(!UnpackStrings(payload, unpacked));
+}
+
+TEST(ProtocolFramesMessages)
+{
+	LocalSocket client, server;
+	CHECK(LocalSocket::CreatePair(client, server));
+
+	std::vector<std::string> strings(1, "ping");
+	std::vector<char> payload;
+	PackStrings(strings, payload);
+	CHECK(SendLutMessage(client, LUT_REQUEST_APPLY, -3, payload));
+	CHECK(SendLutMessage(client, LUT_REQUEST_PING, 0, std::vector<char>()));
+
+	LutMessageHeader header;
+	std::vector<char> received;
+	CHECK(ReceiveLutMessage(server, header, received));
+	CHECK(header.Magic == LUT_PROTOCOL_MAGIC && header.Type == LUT_REQUEST_APPLY && header.Status == -3);
+	CHECK(received == payload);
+	CHECK(ReceiveLutMessage(server, header, received));
+	CHECK(header.Type == LUT_REQUEST_PING && header.Size == 0 && received.empty());
+
+	// The largest payload, while the other end reads it
+	std::vector<char> large(LUT_PROTOCOL_MAX_PAYLOAD, 'x');
+	bool sent = false;
+	std::thread sender([&] { sent = SendLutMessage(client, LUT_REQUEST_REPLY, 1, large); });
+	CHECK(ReceiveLutMessage(server, header, received));
+	sender.join();
+	CHECK(sent && header.Size == LUT_PROTOCOL_MAX_PAYLOAD && received == large);
+
+	large.push_back('x');
+	CHECK(!SendLutMessage(client, LUT_REQUEST_REPLY, 0, large));
+
+	// A peer closing between messages
+	client.Close();
+	CHECK(!ReceiveLutMessage(server, header, received));
+}
+
+TEST(ProtocolRejectsMalformedMessages)
+{
+	LutMessageHeader header = { LUT_PROTOCOL_MAGIC, LUT_REQUEST_PING, 0, 0 };
+	CHECK(ReceivesAfter(&header, sizeof(header), false));
+
+	LutMessageHeader bad = header;
+	bad.Magic = 0x12345678;
+	CHECK(!ReceivesAfter(&bad, sizeof(bad), false));
+
+	bad = header;
+	bad.Type = LUT_REQUEST_REPLY + 1;
+	CHECK(!ReceivesAfter(&bad, sizeof(bad), false));
+
+	bad = header;
+	bad.Size = LUT_PROTOCOL_MAX_PAYLOAD + 1;
+	CHECK(!ReceivesAfter(&bad, sizeof(bad), false));
+
+	// Cut short in the header, then in the payload
+	CHECK(!ReceivesAfter(&header, sizeof(header) - 2, true));
+	bad = header;
+	bad.Size = 16;
+	char message[sizeof(bad) + 8] = {};
+	memcpy(message, &bad, sizeof(bad));
+	CHECK(!ReceivesAfter(message, sizeof(message), true));
+}
@@ -0,0 +1,215 @@
+#include "Test.h"
+#include "LutServer.h"
+#include "DdsVolume.h"
+#include "Image.h"
+#include "Stopwatch.h"
+#include <thread>
+#include <chrono>
+#include <cstring>
+#ifdef SHARED_MEMORY_SEALED
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+
+// A daemon serving on a thread of its own until the test is done with it
+class TestServer
+{
+public:
+	TestServer()
+		: m_Server(DEFAULT_LUT_CACHE_BUDGET, 2)
+		, m_Path(NarrowPath(GetScratchPath("daemon.sock").c_str()))
+		, m_Running(false)
+	{
+		if (m_Server.Listen(m_Path.c_str()))
+		{
+			m_Thread = std::thread([this] { m_Server.Run(); });
+			m_Running = true;
+		}
+	}
+
+	~TestServer()
+	{
+		if (m_Running)
+		{
+			LocalSocket socket;
+			Request(socket, LUT_REQUEST_SHUTDOWN, std::vector<std::string>());
+			m_Thread.join();
+		}
+	}
+
+	bool IsRunning() const { return m_Running; }
+
+	// The reply's status, after connecting the socket if it is not yet. A
+	// large negative value when the exchange itself failed.
+	int Request(LocalSocket& socket, LutRequest type, const std::vector<std::string>& arguments,
+		const std::vector<char>& head = std::vector<char>(), std::string* errors = nullptr, int descriptor = -1)
+	{
+		if (!socket.IsOpen() && !socket.Connect(m_Path.c_str()))
+		{
+			return -1000;
+		}
+
+		std::vector<char> payload;
+		PackStrings(arguments, payload);
+		payload.insert(payload.begin(), head.begin(), head.end());
+		LutMessageHeader header;
+		std::vector<std::string> output;
+		if (!SendLutMessage(socket, type, 0, payload, descriptor) || !ReceiveLutMessage(socket, header, payload) ||
+			header.Type != LUT_REQUEST_REPLY || !UnpackStrings(payload, output) || output.size() != 2)
+		{
+			return -1001;
+		}
+		if (errors)
+		{
+			*errors = output[1];
+		}
+		return header.Status;
+	}
+
+private:
+	LutServer m_Server;
+	std::string m_Path;
+	std::thread m_Thread;
+	bool m_Running;
+};
+
+std::string GetAbsoluteScratchPath(const char* name)
+{
+	return NarrowPath(GetAbsolutePath(GetScratchPath(name).c_str()).c_str());
+}
+
+} // namespace
+
+// A file that fails to parse gets an error back; the daemon carries on
+TEST(ServerSurvivesBadAcv)
+{
+	TestServer server;
+	CHECK(server.IsRunning());
+
+	// A curve of one point, and one of none
+	std::vector<CurvePoints> curves = MakeTestCurves(9);
+	curves[1].resize(1);
+	CHECK(WriteAcvFile(GetScratchPath("one-point.acv").c_str(), curves));
+	curves[1].clear();
+	CHECK(WriteAcvFile(GetScratchPath("no-points.acv").c_str(), curves));
+	CHECK(WriteAcvFile(GetScratchPath("good.acv").c_str(), MakeTestCurves(9)));
+
+	const char* files[] = { "one-point.acv", "no-points.acv", "good.acv" };
+	for (size_t i = 0; i < 3; ++i)
+	{
+		LocalSocket socket;
+		std::vector<std::string> arguments;
+		arguments.push_back(GetAbsoluteScratchPath(files[i]));
+		arguments.push_back(GetAbsoluteScratchPath("converted.dds"));
+		std::string errors;
+		const int status = server.Request(socket, LUT_REQUEST_CONVERT, arguments, std::vector<char>(), &errors);
+		CHECK(i < 2 ? status < 0 && status > -1000 && !errors.empty() : status == 0);
+		CHECK(server.Request(socket, LUT_REQUEST_PING, std::vector<std::string>()) == 0);
+	}
+
+	Lut3D lut;
+	CHECK(ReadDdsVolume(GetScratchPath("converted.dds").c_str(), lut) && lut.GetSize() > 0);
+}
+
+// A client does not hold up the others by stopping halfway through a message
+TEST(ServerAnswersAroundStalledClient)
+{
+	TestServer server;
+	CHECK(server.IsRunning());
+
+	LocalSocket stalled;
+	CHECK(stalled.Connect(NarrowPath(GetScratchPath("daemon.sock").c_str()).c_str()));
+	CHECK(stalled.Send("AL", 2));
+
+	LocalSocket socket;
+	CHECK(server.Request(socket, LUT_REQUEST_PING, std::vector<std::string>()) == 0);
+}
+
+// A client sending a byte at a time, each well within the timeout, is still
+// dropped once the message as a whole has taken too long
+TEST(ServerDropsTricklingClient)
+{
+	TestServer server;
+	CHECK(server.IsRunning());
+
+	LocalSocket trickling;
+	CHECK(trickling.Connect(NarrowPath(GetScratchPath("daemon.sock").c_str()).c_str()));
+	LutMessageHeader header;
+	header.Magic = LUT_PROTOCOL_MAGIC;
+	header.Type = LUT_REQUEST_PING;
+	header.Status = 0;
+	header.Size = 64;
+	CHECK(trickling.Send(&header, sizeof(header)));
+
+	// 6 seconds' worth, were the daemon to wait for it all
+	const Stopwatch stopwatch;
+	unsigned sent = 0;
+	while (sent < 30 && trickling.Send("x", 1))
+	{
+		++sent;
+		std::this_thread::sleep_for(std::chrono::milliseconds(200));
+	}
+	CHECK(sent < 30 && stopwatch.GetElapsedMilliseconds() < 4000.0);
+	CHECK(!trickling.Receive(&header, sizeof(header)));
+
+	LocalSocket socket;
+	CHECK(server.Request(socket, LUT_REQUEST_PING, std::vector<std::string>()) == 0);
+}
+
+// Frames are graded in place. The ring cannot be shrunk under the daemon, and
+// a region that could be is refused.
+TEST(ServerGradesFramesInSealedRings)
+{
+	TestServer server;
+	CHECK(server.IsRunning());
+	CHECK(WriteAcvFile(GetScratchPath("frame.acv").c_str(), MakeTestCurves(10)));
+
+	const unsigned width = 64;
+	const unsigned height = 64;
+	FrameRing ring;
+	const std::string name = SharedMemory::MakeName("acvtolut-test");
+	CHECK(ring.Create(name, 2, width * height * 4));
+
+	LocalSocket socket;
+	const int ringNumber = server.Request(socket, LUT_REQUEST_ATTACH, std::vector<std::string>(1, name),
+		std::vector<char>(), nullptr, ring.GetDescriptor());
+	CHECK(ringNumber >= 0);
+
+	memset(ring.GetSlot(1), 128, width * height * 4);
+	const LutFrameDescriptor frame = { (unsigned)ringNumber, 1, width, height, width * 4, IMAGE_FORMAT_RGBA8 };
+	const std::vector<char> head((const char*)&frame, (const char*)&frame + sizeof(frame));
+	const std::vector<std::string> arguments(1, GetAbsoluteScratchPath("frame.acv"));
+	CHECK(server.Request(socket, LUT_REQUEST_FRAME, arguments, head) == 0);
+	CHECK(ring.GetSlot(1)[0] != 128 && ring.GetSlot(1)[3] == 128);
+
+#ifdef SHARED_MEMORY_SEALED
+	CHECK(ftruncate(ring.GetDescriptor(), 4096) != 0);
+	CHECK(server.Request(socket, LUT_REQUEST_FRAME, arguments, head) == 0);
+
+	// A plain memfd of the right shape, but its owner could still shrink it
+	const size_t size = 8192;
+	const int file = memfd_create("acvtolut-unsealed", MFD_CLOEXEC);
+	CHECK(file >= 0 && ftruncate(file, size) == 0);
+	void* view = file >= 0 ? mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0) : MAP_FAILED;
+	CHECK(view != MAP_FAILED);
+	if (view != MAP_FAILED)
+	{
+		const FrameRingHeader header = { FRAME_RING_MAGIC, 1, 4096 };
+		memcpy(view, &header, sizeof(header));
+		munmap(view, size);
+	}
+
+	std::string errors;
+	CHECK(server.Request(socket, LUT_REQUEST_ATTACH, std::vector<std::string>(1, "/acvtolut-unsealed"),
+		std::vector<char>(), &errors, file) < 0);
+	CHECK(errors.find("sealed") != std::string::npos);
+	if (file >= 0)
+	{
+		close(file);
+	}
+#endif
+	CHECK(server.Request(socket, LUT_REQUEST_PING, std::vector<std::string>()) == 0);
+}
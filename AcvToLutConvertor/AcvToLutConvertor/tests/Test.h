@@ -0,0 +1,73 @@
+#pragma once
+
+#include "Platform.h"
+#include "AcvCurves.h"
+#include "Lut3D.h"
+#include <string>
+#include <vector>
+
+//
+// A small harness for the tests in this directory, which "make test" builds
+// against the portable sources and runs. TEST registers a function under its
+// name; CHECK reports a condition that does not hold and lets the test go on.
+// The run fails when any check did.
+//
+// Tests write their files to the scratch directory the run is given. Messages
+// the code under test prints on purpose, such as for the malformed files fed
+// to it, show up between the results.
+//
+
+typedef void (*TestFunction)();
+
+struct TestRegistration
+{
+	TestRegistration(const char* name, TestFunction function);
+};
+
+#define TEST(name) \
+	static void name(); \
+	static const TestRegistration name##Registration(#name, &name); \
+	static void name()
+
+void ReportFailure(const char* file, int line, const char* condition);
+
+#define CHECK(condition) \
+	do \
+	{ \
+		if (!(condition)) \
+		{ \
+			ReportFailure(__FILE__, __LINE__, #condition); \
+		} \
+	} while (false)
+
+// A file in the scratch directory
+PathString GetScratchPath(const char* name);
+
+// Directories and files under it, for tests that need them
+bool CreateScratchDirectory(const char* name);
+bool WriteTestFile(const PathChar* path, const void* data, size_t size);
+bool RemoveTestFile(const PathChar* path);
+
+// Writes the five curves (composite, red, green, blue, alpha) as an ACV file
+bool WriteAcvFile(const PathChar* path, const std::vector<CurvePoints>& curves);
+
+// Five curves that change every channel, varied by seed
+std::vector<CurvePoints> MakeTestCurves(unsigned seed);
+
+// A cube of pseudo-random texels in [0, 1], far from separable
+Lut3D MakeTestCube(size_t size, unsigned seed);
+
+// A look of curves and a cube baked behind a log shaper into a DDS volume,
+// with its .shaper.dds sidecar or without one
+bool WriteShapedVolume(const PathChar* path, bool withShaper);
+
+// Bakes a LUT file, or a LUT in a pack, through a LutChain; an empty cube
+// when it cannot be read
+Lut3D BakeLutFile(const PathString& path, size_t cubeSize);
+
+// The path of a LUT in a pack in the scratch directory
+PathString GetScratchPackPath(const char* pack, const char* name);
+
+// Largest difference between two texels of cubes of the same size, or a
+// large value when the sizes differ
+float GetMaxDifference(const Lut3D& a, const Lut3D& b);
@@ -0,0 +1,245 @@
+#include "Test.h"
+#include "LutChain.h"
+#include "LutShaper.h"
+#include "DdsVolume.h"
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+namespace
+{
+
+struct RegisteredTest
+{
+	const char* Name;
+	TestFunction Function;
+};
+
+std::vector<RegisteredTest>& GetTests()
+{
+	static std::vector<RegisteredTest> tests;
+	return tests;
+}
+
+std::string g_ScratchDirectory;
+unsigned g_Failures = 0;
+
+// Linear congruential, so that every platform makes the same test data
+unsigned NextRandom(unsigned& state)
+{
+	state = state * 1664525u + 1013904223u;
+	return state >> 8;
+}
+
+void WriteBigEndianUShort(std::vector<unsigned char>& data, unsigned value)
+{
+	data.push_back((unsigned char)(value >> 8));
+	data.push_back((unsigned char)value);
+}
+
+} // namespace
+
+TestRegistration::TestRegistration(const char* name, TestFunction function)
+{
+	RegisteredTest test = { name, function };
+	GetTests().push_back(test);
+}
+
+void ReportFailure(const char* file, int line, const char* condition)
+{
+	fprintf(stderr, "%s(%d): check failed: %s\n", file, line, condition);
+	++g_Failures;
+}
+
+PathString GetScratchPath(const char* name)
+{
+	return WidenPath(g_ScratchDirectory + "/" + name);
+}
+
+bool CreateScratchDirectory(const char* name)
+{
+	const PathString path = GetScratchPath(name);
+#ifdef _WIN32
+	return _wmkdir(path.c_str()) == 0;
+#else
+	return mkdir(path.c_str(), 0755) == 0;
+#endif
+}
+
+bool WriteTestFile(const PathChar* path, const void* data, size_t size)
+{
+	FILE* file = OpenNativeFile(path, "wb");
+	if (!file)
+	{
+		return false;
+	}
+	const bool ok = fwrite(data, 1, size, file) == size;
+	return fclose(file) == 0 && ok;
+}
+
+bool WriteAcvFile(const PathChar* path, const std::vector<CurvePoints>& curves)
+{
+	std::vector<unsigned char> data;
+	WriteBigEndianUShort(data, 4);
+	WriteBigEndianUShort(data, (unsigned)curves.size());
+	for (size_t i = 0; i < curves.size(); ++i)
+	{
+		WriteBigEndianUShort(data, (unsigned)curves[i].size());
+		for (size_t j = 0; j < curves[i].size(); ++j)
+		{
+			WriteBigEndianUShort(data, (unsigned)curves[i][j].second);
+			WriteBigEndianUShort(data, (unsigned)curves[i][j].first);
+		}
+	}
+	return WriteTestFile(path, &data[0], data.size());
+}
+
+bool RemoveTestFile(const PathChar* path)
+{
+#ifdef _WIN32
+	return _wremove(path) == 0;
+#else
+	return remove(path) == 0;
+#endif
+}
+
+std::vector<CurvePoints> MakeTestCurves(unsigned seed)
+{
+	std::vector<CurvePoints> curves(5);
+	for (size_t i = 0; i < curves.size(); ++i)
+	{
+		curves[i].push_back(std::make_pair(0.0f, 0.0f));
+		if (i < 4)
+		{
+			const float lift = (float)((seed * 7 + i * 13) % 40);
+			curves[i].push_back(std::make_pair(64.0f, 64.0f + lift));
+			curves[i].push_back(std::make_pair(192.0f, 192.0f - lift / 2));
+		}
+		curves[i].push_back(std::make_pair(255.0f, 255.0f));
+	}
+	return curves;
+}
+
+Lut3D MakeTestCube(size_t size, unsigned seed)
+{
+	Lut3D lut(size);
+	unsigned state = seed;
+	for (size_t b = 0; b < size; ++b)
+	{
+		for (size_t g = 0; g < size; ++g)
+		{
+			for (size_t r = 0; r < size; ++r)
+			{
+				float* texel = lut.GetTexel(r, g, b);
+				for (int channel = 0; channel < 3; ++channel)
+				{
+					texel[channel] = (NextRandom(state) & 0xFFFF) / 65535.0f;
+				}
+			}
+		}
+	}
+	return lut;
+}
+
+bool WriteShapedVolume(const PathChar* path, bool withShaper)
+{
+	const std::vector<CurvePoints> curves = MakeTestCurves(4);
+	std::vector<CubicSpline> splines;
+	for (size_t k = 0; k < curves.size(); ++k)
+	{
+		splines.push_back(CubicSpline::InterpolateCubicSplineFromCurvePoints(curves[k]));
+	}
+	LutChain look;
+	look.AddCurves(splines);
+	look.AddCube(MakeTestCube(5, 4));
+
+	const LutShaper shaper = LutShaper::Create(LUT_SHAPER_LOG, look, 17);
+	if (!WriteDdsVolume(path, look.Bake(17, &shaper)))
+	{
+		return false;
+	}
+
+	const PathString shaperPath = GetDdsShaperPath(path);
+	if (withShaper)
+	{
+		return WriteDdsShaper(shaperPath.c_str(), shaper);
+	}
+	RemoveTestFile(shaperPath.c_str());
+	return true;
+}
+
+Lut3D BakeLutFile(const PathString& path, size_t cubeSize)
+{
+	LutChain chain;
+	if (!chain.AddFile(path.c_str()))
+	{
+		return Lut3D();
+	}
+	return chain.Bake(cubeSize);
+}
+
+PathString GetScratchPackPath(const char* pack, const char* name)
+{
+	return GetScratchPath(pack) + PATH_LITERAL("/") + WidenPath(name);
+}
+
+float GetMaxDifference(const Lut3D& a, const Lut3D& b)
+{
+	const size_t size = a.GetSize();
+	if (size != b.GetSize() || size == 0)
+	{
+		return 1e30f;
+	}
+
+	const float* texelsA = a.GetTexel(0, 0, 0);
+	const float* texelsB = b.GetTexel(0, 0, 0);
+	float difference = 0.0f;
+	for (size_t i = 0; i < size * size * size * 3; ++i)
+	{
+		difference = std::max(difference, std::fabs(texelsA[i] - texelsB[i]));
+	}
+	return difference;
+}
+
+// acvtolut-tests scratch_directory [name_filter]
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "Usage: acvtolut-tests scratch_directory [name_filter]\n");
+		return 2;
+	}
+	g_ScratchDirectory = argv[1];
+	const char* filter = argc > 2 ? argv[2] : nullptr;
+
+	unsigned run = 0;
+	unsigned failed = 0;
+	const std::vector<RegisteredTest>& tests = GetTests();
+	for (std::vector<RegisteredTest>::const_iterator test = tests.begin(); test != tests.end(); ++test)
+	{
+		if (filter && !strstr(test->Name, filter))
+		{
+			continue;
+		}
+
+		printf("%s\n", test->Name);
+		fflush(stdout);
+		const unsigned failures = g_Failures;
+		test->Function();
+		++run;
+		if (g_Failures != failures)
+		{
+			printf("%s FAILED\n", test->Name);
+			++failed;
+		}
+	}
+
+	printf("%u of %u tests passed\n", run - failed, run);
+	return failed == 0 && run > 0 ? 0 : 1;
+}
@@ -0,0 +1,91 @@
+#include "Test.h"
+#include "Trace.h"
+#include "MappedFile.h"
+#include <thread>
+#include <string>
+#include <cstdlib>
+#include <cstring>
+
+namespace
+{
+
+std::string ReadText(const PathString& path)
+{
+	MappedFile file;
+	const unsigned char* bytes = file.Open(path.c_str(), false) ? file.MapWindow(0, (size_t)file.GetSize()) : nullptr;
+	return bytes ? std::string((const char*)bytes, (size_t)file.GetSize()) : std::string();
+}
+
+size_t CountOccurrences(const std::string& text, const std::string& pattern)
+{
+	size_t count = 0;
+	for (size_t at = text.find(pattern); at != std::string::npos; at = text.find(pattern, at + 1))
+	{
+		++count;
+	}
+	return count;
+}
+
+// A number following key in the event named name, or -1 without one
+double GetEventNumber(const std::string& text, const char* name, const char* key)
+{
+	const size_t event = text.find(std::string("{\"name\": \"") + name + "\"");
+	const size_t end = text.find('\n', event);
+	const size_t at = event == std::string::npos ? event : text.find(std::string("\"") + key + "\": ", event);
+	if (at == std::string::npos || at > end)
+	{
+		return -1.0;
+	}
+	return atof(text.c_str() + at + strlen(key) + 4);
+}
+
+} // namespace
+
+// Spans nest on their thread's track, named tracks and counters come out as
+// metadata and counter events, and a full buffer drops what does not fit.
+// Tracing stays on for the rest of the run once started, so this is the only
+// test that starts it.
+TEST(TraceRecordsSpansPerThread)
+{
+	CHECK(!IsTracing());
+	{
+		TraceSpan ignored("before-start");
+	}
+
+	StartTrace(8);
+	CHECK(IsTracing());
+	SetTraceThreadName("test \"main\"");
+	{
+		TraceSpan outer("outer");
+		{
+			TraceSpan inner("inner", "test");
+		}
+		TraceCounter("waiting", 3.0);
+	}
+
+	std::thread worker([]
+	{
+		SetTraceThreadName("worker");
+		for (int i = 0; i < 20; ++i)
+		{
+			TraceSpan span("busy");
+		}
+	});
+	worker.join();
+
+	const PathString path = GetScratchPath("trace.json");
+	CHECK(WriteTrace(path.c_str()));
+	const std::string text = ReadText(path);
+	CHECK(text.find("\"traceEvents\": [") != std::string::npos && text.find("before-start") == std::string::npos);
+	CHECK(text.find("\"args\": {\"name\": \"test \\\"main\\\"\"}") != std::string::npos);
+	CHECK(text.find("\"args\": {\"name\": \"worker\"}") != std::string::npos);
+	CHECK(CountOccurrences(text, "\"name\": \"busy\"") == 8);
+
+	const double outerStart = GetEventNumber(text, "outer", "ts");
+	const double innerStart = GetEventNumber(text, "inner", "ts");
+	CHECK(outerStart >= 0.0 && innerStart >= outerStart);
+	CHECK(innerStart + GetEventNumber(text, "inner", "dur") <= outerStart + GetEventNumber(text, "outer", "dur"));
+	CHECK(text.find("\"name\": \"inner\", \"cat\": \"test\"") != std::string::npos);
+	CHECK(text.find("\"name\": \"waiting\", \"cat\": \"counter\"") != std::string::npos);
+	CHECK(text.find("\"ph\": \"C\", \"args\": {\"value\": 3}") != std::string::npos);
+}